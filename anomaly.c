@@ -0,0 +1,122 @@
+/* anomaly.c — EWMA / z-score, phát hiện spike và sensor bị kẹt
+ *
+ * Xem mô tả các loại bất thường trong anomaly.h.
+ */
+
+#include "anomaly.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Độ lệch chuẩn tối thiểu (cột min_sd): tránh báo động khi tín hiệu gần như phẳng */
+#define MIN_SD_(field, stat, wtype, wire, key, label, unit, lo, hi, min_sd, ...) min_sd,
+
+void anomaly_init(anomaly_t *a) {
+    static const float min_sd[ANOMALY_METRICS] = { SENSOR_FIELDS(MIN_SD_) };
+    memset(a, 0, sizeof(*a));
+    for (int i = 0; i < ANOMALY_METRICS; i++) {
+        a->m[i].min_var = min_sd[i] * min_sd[i];
+    }
+}
+
+static inline anomaly_kind_t metric_update(anomaly_metric_t *m, float x, float *d2_over_var) {
+    if (x != x) {
+        return ANOMALY_OUTLIER;     // NaN: không đưa vào baseline
+    }
+    if (m->n == 0) {
+        m->mean = x;
+        m->var = m->min_var;
+        m->last = x;
+        m->n = 1;
+        return ANOMALY_NONE;
+    }
+
+    float var = m->var;
+    float d = x - m->mean;
+    float d2 = d * d;
+    float jump = x - m->last;
+    anomaly_kind_t kind = ANOMALY_NONE;
+
+    if (jump == 0.0f) {
+        if (++m->stuck_run >= ANOMALY_STUCK_RUN) kind = ANOMALY_STUCK;
+    } else {
+        m->stuck_run = 0;
+    }
+
+    if (m->n >= ANOMALY_WARMUP && kind == ANOMALY_NONE) {
+        if (jump * jump > ANOMALY_SPIKE_Z * ANOMALY_SPIKE_Z * var) {
+            kind = ANOMALY_SPIKE;
+        } else if (d2 > ANOMALY_Z_ALERT * ANOMALY_Z_ALERT * var) {
+            kind = ANOMALY_OUTLIER;
+        } else if (d2 > ANOMALY_Z_WARN * ANOMALY_Z_WARN * var) {
+            kind = ANOMALY_DRIFT;
+        }
+    }
+    if (kind != ANOMALY_NONE) {
+        *d2_over_var = (kind == ANOMALY_SPIKE ? jump * jump : d2) / var;
+    }
+
+    // Mẫu bất thường chỉ kéo baseline đi tối đa Z_ALERT * sd (sqrt chỉ ở nhánh hiếm)
+    float limit2 = ANOMALY_Z_ALERT * ANOMALY_Z_ALERT * var;
+    if (d2 > limit2) {
+        d = d > 0.0f ? sqrtf(limit2) : -sqrtf(limit2);
+    }
+    float incr = ANOMALY_ALPHA * d;
+    m->mean += incr;
+    m->var = (1.0f - ANOMALY_ALPHA) * (m->var + d * incr);
+    if (m->var < m->min_var) {
+        m->var = m->min_var;    // tín hiệu phẳng: không để var trôi về số denormal (rất chậm)
+    }
+    m->last = x;
+    if (m->n < ANOMALY_WARMUP) m->n++;
+    return kind;
+}
+
+anomaly_kind_t anomaly_update(anomaly_t *a, const float x[ANOMALY_METRICS],
+                              int *metric, float *z) {
+    anomaly_kind_t worst = ANOMALY_NONE;
+    float worst_z2 = 0.0f;
+    int worst_metric = -1;
+
+    for (int i = 0; i < ANOMALY_METRICS; i++) {
+        float z2 = 0.0f;
+        anomaly_kind_t k = metric_update(&a->m[i], x[i], &z2);
+        if (k > worst) {
+            worst = k;
+            worst_z2 = z2;
+            worst_metric = i;
+        }
+    }
+
+    if (metric) *metric = worst_metric;
+    if (z) *z = worst == ANOMALY_NONE ? 0.0f : sqrtf(worst_z2);
+    return worst;
+}
+
+int anomaly_quality(anomaly_kind_t kind) {
+    switch (kind) {
+        case ANOMALY_DRIFT:   return 70;
+        case ANOMALY_OUTLIER: return 40;
+        case ANOMALY_SPIKE:   return 20;
+        case ANOMALY_STUCK:   return 10;
+        default:              return 100;
+    }
+}
+
+anomaly_kind_t anomaly_from_quality(int quality) {
+    if (quality <= 10) return ANOMALY_STUCK;
+    if (quality <= 20) return ANOMALY_SPIKE;
+    if (quality <= 40) return ANOMALY_OUTLIER;
+    if (quality <= 70) return ANOMALY_DRIFT;
+    return ANOMALY_NONE;
+}
+
+const char* anomaly_name(anomaly_kind_t kind) {
+    switch (kind) {
+        case ANOMALY_DRIFT:   return "drift";
+        case ANOMALY_OUTLIER: return "outlier";
+        case ANOMALY_SPIKE:   return "spike";
+        case ANOMALY_STUCK:   return "stuck";
+        default:              return "ok";
+    }
+}
@@ -0,0 +1,82 @@
+/* anomaly.h — Phát hiện bất thường trực tuyến cho từng sensor
+ *
+ * Ngưỡng tĩnh (T > 35 °C) bỏ sót sensor trôi dần hoặc bị kẹt, và báo động
+ * liên tục khi giá trị cao kéo dài. Ở đây mỗi đại lượng của mỗi sensor giữ
+ * một trạng thái O(1):
+ *
+ *   - EWMA trung bình / phương sai  → z = (x - mean) / sd
+ *   - DRIFT    |z| > ANOMALY_Z_WARN
+ *   - OUTLIER  |z| > ANOMALY_Z_ALERT
+ *   - SPIKE    bước nhảy giữa hai mẫu liên tiếp > ANOMALY_SPIKE_Z * sd
+ *   - STUCK    cùng một giá trị ANOMALY_STUCK_RUN mẫu liên tiếp
+ *
+ * Baseline tự thích nghi (giá trị cao kéo dài dần thành bình thường) nhưng
+ * mỗi mẫu bất thường chỉ kéo mean đi tối đa ANOMALY_Z_ALERT * sd.
+ * Không có sqrt/chia trên đường thường: so sánh d² với z² * var.
+ *
+ * Kết quả được ghi vào trường quality (0-100) của bản ghi, xem
+ * anomaly_quality().
+ */
+#ifndef ANOMALY_H
+#define ANOMALY_H
+
+#include <stdint.h>
+
+#include "schema.h"
+
+#define ANOMALY_METRICS     SENSOR_FIELD_COUNT  /* các đại lượng trong schema.h */
+#define ANOMALY_ALPHA       0.05f   /* trọng số EWMA (~20 mẫu gần nhất) */
+#define ANOMALY_WARMUP      20      /* số mẫu trước khi bắt đầu đánh giá */
+#define ANOMALY_Z_WARN      3.0f
+#define ANOMALY_Z_ALERT     5.0f
+#define ANOMALY_SPIKE_Z     6.0f
+#define ANOMALY_STUCK_RUN   60
+
+/* Mức nghiêm trọng tăng dần */
+typedef enum {
+    ANOMALY_NONE = 0,
+    ANOMALY_DRIFT,
+    ANOMALY_OUTLIER,
+    ANOMALY_SPIKE,
+    ANOMALY_STUCK
+} anomaly_kind_t;
+
+typedef struct {
+    float    mean;
+    float    var;
+    float    min_var;
+    float    last;
+    uint32_t n;             /* số mẫu đã thấy, dừng đếm ở ANOMALY_WARMUP */
+    uint32_t stuck_run;
+} anomaly_metric_t;
+
+typedef struct {
+    anomaly_metric_t m[ANOMALY_METRICS];
+} anomaly_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void anomaly_init(anomaly_t *a);
+
+/* Đánh giá một mẫu (x theo thứ tự SENSOR_FIELDS) rồi cập nhật
+ * baseline. Trả về mức nghiêm trọng nhất; *metric (nếu khác NULL) là chỉ số
+ * đại lượng gây ra nó, *z là độ lệch tính theo sd. */
+anomaly_kind_t anomaly_update(anomaly_t *a, const float x[ANOMALY_METRICS],
+                              int *metric, float *z);
+
+/* Điểm chất lượng ghi vào sensor_data_t.quality */
+int anomaly_quality(anomaly_kind_t kind);
+
+/* Ngược lại: loại bất thường ứng với một điểm quality. Đây cũng là quy tắc
+ * đếm bất thường trong thống kê và báo cáo (khác ANOMALY_NONE). */
+anomaly_kind_t anomaly_from_quality(int quality);
+
+const char* anomaly_name(anomaly_kind_t kind);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ANOMALY_H */
@@ -0,0 +1,406 @@
+#include "system.h"
+
+// ============================================================================
+// COLUMNAR EXPORT (Apache Arrow IPC file / Feather v2)
+// ============================================================================
+//
+// Writes the store as an Arrow IPC file that pyarrow.feather.read_table(),
+// pandas.read_feather() or any Arrow reader can memory-map directly:
+//
+//   "ARROW1\0\0"  Schema message  RecordBatch message * N  EOS  Footer
+//   footer length (int32)  "ARROW1"
+//
+// Each record batch holds up to ARROW_BATCH_ROWS rows (the row group): the
+// rows are transposed from the store into one little-endian array per column
+// and written as-is, no text formatting and no per-value conversion. Columns:
+//
+//   timestamp  timestamp[s, UTC]   sensor_id  int32
+//   one float32 per SENSOR_FIELDS entry, in table order   quality  int32
+//
+// Metadata is FlatBuffers. The tiny builder below writes front to back:
+// a table is written first with zeroed offset slots, its children follow
+// (FlatBuffers offsets always point forward) and the slots are patched.
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Arrow export writes host-order column buffers; Arrow requires little-endian"
+#endif
+
+#define ARROW_BATCH_ROWS    65536
+#define ARROW_COLUMNS       (3 + SENSOR_FIELD_COUNT)
+#define ARROW_METADATA_V5   4
+
+// Message header / type union tags from Arrow's Message.fbs and Schema.fbs
+#define ARROW_HEADER_SCHEMA         1
+#define ARROW_HEADER_RECORD_BATCH   3
+#define ARROW_TYPE_INT              2
+#define ARROW_TYPE_FLOAT            3
+#define ARROW_TYPE_TIMESTAMP        10
+
+// ============================================================================
+// FLATBUFFER BUILDER
+// ============================================================================
+
+typedef struct fb {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    int failed;
+} fb_t;
+
+static void fb_reserve(fb_t *b, size_t n) {
+    if (b->len + n <= b->cap) {
+        return;
+    }
+    size_t cap = b->cap ? b->cap : 1024;
+    while (cap < b->len + n) cap *= 2;
+    uint8_t *p = realloc(b->buf, cap);
+    if (!p) {
+        b->failed = 1;
+        return;
+    }
+    b->buf = p;
+    b->cap = cap;
+}
+
+static size_t fb_put(fb_t *b, const void *data, size_t n) {
+    fb_reserve(b, n);
+    if (b->failed) return b->len;
+    size_t pos = b->len;
+    if (data) memcpy(b->buf + pos, data, n);
+    else memset(b->buf + pos, 0, n);
+    b->len += n;
+    return pos;
+}
+
+static void fb_pad(fb_t *b, size_t align) {
+    while (b->len % align) {
+        fb_put(b, NULL, 1);
+    }
+}
+
+// Point the uoffset at `slot` to `target` (always after the slot)
+static void fb_link(fb_t *b, size_t slot, size_t target) {
+    if (b->failed) return;
+    uint32_t rel = (uint32_t)(target - slot);
+    memcpy(b->buf + slot, &rel, sizeof(rel));
+}
+
+typedef struct fb_field {
+    uint8_t size;       // 0 = absent; offsets are size 4 and patched later
+    uint64_t value;
+} fb_field_t;
+
+// Writes a vtable followed by its table. slots[i] receives the position of
+// field i inside the table (used to patch offset fields).
+static size_t fb_table(fb_t *b, const fb_field_t *fields, int count, size_t *slots) {
+    uint16_t vt[2 + 16];
+    uint16_t off = 4;   // after the soffset to the vtable
+    for (int i = 0; i < count; i++) {
+        if (fields[i].size == 0) {
+            vt[2 + i] = 0;
+            continue;
+        }
+        off = (uint16_t)((off + fields[i].size - 1) / fields[i].size * fields[i].size);
+        vt[2 + i] = off;
+        off = (uint16_t)(off + fields[i].size);
+    }
+    vt[0] = (uint16_t)(4 + 2 * count);
+    vt[1] = off;
+
+    fb_pad(b, 8);
+    size_t vt_pos = fb_put(b, vt, vt[0]);
+    fb_pad(b, 8);
+    size_t table = fb_put(b, NULL, off);
+    if (b->failed) return table;
+
+    int32_t soff = (int32_t)(table - vt_pos);
+    memcpy(b->buf + table, &soff, sizeof(soff));
+    for (int i = 0; i < count; i++) {
+        if (fields[i].size) {
+            memcpy(b->buf + table + vt[2 + i], &fields[i].value, fields[i].size);
+            if (slots) slots[i] = table + vt[2 + i];
+        }
+    }
+    return table;
+}
+
+// Vector of count elements; the elements are aligned to `align`
+static size_t fb_vector(fb_t *b, const void *data, size_t elem_size, size_t count, size_t align) {
+    if (align < 4) align = 4;
+    while ((b->len + 4) % align) fb_put(b, NULL, 1);
+    uint32_t n = (uint32_t)count;
+    size_t pos = fb_put(b, &n, 4);
+    fb_put(b, data, elem_size * count);
+    return pos;
+}
+
+static size_t fb_string(fb_t *b, const char *s) {
+    size_t len = strlen(s);
+    size_t pos = fb_vector(b, s, 1, len, 4);
+    fb_put(b, NULL, 1);     // NUL terminator
+    return pos;
+}
+
+// ============================================================================
+// ARROW METADATA
+// ============================================================================
+
+typedef struct arrow_column {
+    const char *name;
+    int type;           // ARROW_TYPE_*
+    int bits;
+    int is_signed;
+} arrow_column_t;
+
+static const arrow_column_t columns[ARROW_COLUMNS] = {
+    { "timestamp",   ARROW_TYPE_TIMESTAMP, 64, 1 },
+    { "sensor_id",   ARROW_TYPE_INT,       32, 1 },
+#define ARROW_FIELD_(field, ...) \
+    { #field,        ARROW_TYPE_FLOAT,     32, 1 },
+    SENSOR_FIELDS(ARROW_FIELD_)
+    { "quality",     ARROW_TYPE_INT,       32, 1 },
+};
+
+static size_t put_type(fb_t *b, const arrow_column_t *col) {
+    switch (col->type) {
+        case ARROW_TYPE_INT: {
+            fb_field_t f[2] = { { 4, (uint64_t)col->bits }, { 1, (uint64_t)col->is_signed } };
+            return fb_table(b, f, 2, NULL);
+        }
+        case ARROW_TYPE_FLOAT: {
+            fb_field_t f[1] = { { 2, col->bits == 64 ? 2 : 1 } };    // SINGLE / DOUBLE
+            return fb_table(b, f, 1, NULL);
+        }
+        default: {
+            size_t slots[2];
+            fb_field_t f[2] = { { 2, 0 }, { 4, 0 } };                 // unit SECOND, timezone
+            size_t table = fb_table(b, f, 2, slots);
+            fb_link(b, slots[1], fb_string(b, "UTC"));
+            return table;
+        }
+    }
+}
+
+static size_t put_field(fb_t *b, const arrow_column_t *col) {
+    // name, nullable, type_type, type, dictionary, children
+    size_t slots[6];
+    fb_field_t f[6] = {
+        { 4, 0 }, { 1, 0 }, { 1, (uint64_t)col->type }, { 4, 0 }, { 0, 0 }, { 4, 0 }
+    };
+    size_t table = fb_table(b, f, 6, slots);
+    fb_link(b, slots[0], fb_string(b, col->name));
+    fb_link(b, slots[3], put_type(b, col));
+    fb_link(b, slots[5], fb_vector(b, NULL, 4, 0, 4));     // readers require the vector
+    return table;
+}
+
+static size_t put_schema(fb_t *b) {
+    // endianness (Little = 0), fields
+    size_t slots[2];
+    fb_field_t f[2] = { { 2, 0 }, { 4, 0 } };
+    size_t table = fb_table(b, f, 2, slots);
+
+    size_t vec = fb_vector(b, NULL, 4, ARROW_COLUMNS, 4);
+    fb_link(b, slots[1], vec);
+    for (int i = 0; i < ARROW_COLUMNS; i++) {
+        fb_link(b, vec + 4 + 4 * (size_t)i, put_field(b, &columns[i]));
+    }
+    return table;
+}
+
+// Message wrapper; the header table is written by `put_header`
+static void put_message(fb_t *b, int header_type, int64_t body_length,
+                        size_t (*put_header)(fb_t *, const void *), const void *ctx) {
+    size_t root = fb_put(b, NULL, 4);
+    // version, header_type, header, bodyLength
+    size_t slots[4];
+    fb_field_t f[4] = {
+        { 2, ARROW_METADATA_V5 }, { 1, (uint64_t)header_type }, { 4, 0 }, { 8, (uint64_t)body_length }
+    };
+    fb_link(b, root, fb_table(b, f, 4, slots));
+    fb_link(b, slots[2], put_header(b, ctx));
+}
+
+static size_t put_schema_header(fb_t *b, const void *ctx) {
+    (void)ctx;
+    return put_schema(b);
+}
+
+typedef struct batch_meta {
+    int64_t rows;
+    int64_t buffers[ARROW_COLUMNS * 2][2];  // offset, length in the body
+} batch_meta_t;
+
+static size_t put_batch_header(fb_t *b, const void *ctx) {
+    const batch_meta_t *m = ctx;
+    // length, nodes, buffers
+    size_t slots[3];
+    fb_field_t f[3] = { { 8, (uint64_t)m->rows }, { 4, 0 }, { 4, 0 } };
+    size_t table = fb_table(b, f, 3, slots);
+
+    int64_t nodes[ARROW_COLUMNS][2];
+    for (int i = 0; i < ARROW_COLUMNS; i++) {
+        nodes[i][0] = m->rows;      // length
+        nodes[i][1] = 0;            // null_count
+    }
+    fb_link(b, slots[1], fb_vector(b, nodes, 16, ARROW_COLUMNS, 8));
+    fb_link(b, slots[2], fb_vector(b, m->buffers, 16, ARROW_COLUMNS * 2, 8));
+    return table;
+}
+
+typedef struct arrow_block {
+    int64_t offset;
+    int32_t metadata_length;
+    int32_t pad;
+    int64_t body_length;
+} arrow_block_t;
+
+typedef struct footer_ctx {
+    const arrow_block_t *blocks;
+    size_t count;
+} footer_ctx_t;
+
+static size_t put_footer(fb_t *b, const footer_ctx_t *ctx) {
+    size_t root = fb_put(b, NULL, 4);
+    // version, schema, dictionaries, recordBatches
+    size_t slots[4];
+    fb_field_t f[4] = { { 2, ARROW_METADATA_V5 }, { 4, 0 }, { 4, 0 }, { 4, 0 } };
+    size_t table = fb_table(b, f, 4, slots);
+    fb_link(b, root, table);
+    fb_link(b, slots[1], put_schema(b));
+    fb_link(b, slots[2], fb_vector(b, NULL, 24, 0, 8));
+    fb_link(b, slots[3], fb_vector(b, ctx->blocks, sizeof(arrow_block_t), ctx->count, 8));
+    return table;
+}
+
+// ============================================================================
+// FILE WRITER
+// ============================================================================
+
+static const uint8_t zeros[64];
+
+// Encapsulated message: continuation marker, metadata length, flatbuffer
+// padded to 8 bytes. Returns the bytes written (the block's metadata length).
+static int32_t write_message(FILE *fp, fb_t *b) {
+    fb_pad(b, 8);
+    uint32_t head[2] = { 0xFFFFFFFFu, (uint32_t)b->len };
+    fwrite(head, sizeof(head), 1, fp);
+    fwrite(b->buf, 1, b->len, fp);
+    return (int32_t)(sizeof(head) + b->len);
+}
+
+// Column scratch for one batch; heap-allocated so exports can run on
+// several threads at once
+typedef struct arrow_batch {
+    int64_t ts[ARROW_BATCH_ROWS];
+    int32_t id[ARROW_BATCH_ROWS];
+    float field[SENSOR_FIELD_COUNT][ARROW_BATCH_ROWS];
+    int32_t quality[ARROW_BATCH_ROWS];
+    char iobuf[1 << 20];
+} arrow_batch_t;
+
+// Reads the store through a snapshot: safe on any thread while ingest runs
+int export_to_arrow(const char *filename) {
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) {
+        printf("Cannot create file %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    store_snapshot_t snap;
+    store_read_begin(&snap);
+    size_t max_blocks = (snap.end - snap.first) / ARROW_BATCH_ROWS + 1;
+    arrow_block_t *blocks = calloc(max_blocks, sizeof(*blocks));
+    arrow_batch_t *cols = malloc(sizeof(*cols));
+    fb_t b = { 0 };
+    if (!blocks || !cols) {
+        store_read_end(&snap);
+        free(blocks);
+        free(cols);
+        fclose(fp);
+        return -1;
+    }
+    setvbuf(fp, cols->iobuf, _IOFBF, sizeof(cols->iobuf));
+    const void *col_data[ARROW_COLUMNS] = { cols->ts, cols->id };
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        col_data[2 + f] = cols->field[f];
+    }
+    col_data[ARROW_COLUMNS - 1] = cols->quality;
+
+    int64_t pos = fwrite("ARROW1\0\0", 1, 8, fp);
+    put_message(&b, ARROW_HEADER_SCHEMA, 0, put_schema_header, NULL);
+    pos += write_message(fp, &b);
+
+    size_t nblocks = 0, total = 0;
+    size_t end = snap.end;
+    for (size_t first = snap.first; first < end; first += ARROW_BATCH_ROWS) {
+        // Transpose one batch of rows into the column arrays
+        size_t last = end - first > ARROW_BATCH_ROWS ? first + ARROW_BATCH_ROWS : end;
+        size_t rows = 0, n;
+        store_iter_t it;
+        const sensor_data_t *span;
+        store_iter_snapshot(&it, &snap, first, last);
+        while ((n = store_iter_span(&it, &span)) > 0) {
+            for (size_t i = 0; i < n; i++, rows++) {
+                cols->ts[rows] = (int64_t)span[i].timestamp;
+                cols->id[rows] = span[i].sensor_id;
+                for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+                    cols->field[f][rows] = span[i].values[f];
+                }
+                cols->quality[rows] = span[i].quality;
+            }
+        }
+
+        batch_meta_t meta = { .rows = (int64_t)rows };
+        int64_t body = 0;
+        for (int c = 0; c < ARROW_COLUMNS; c++) {
+            int64_t len = (int64_t)rows * (columns[c].bits / 8);
+            meta.buffers[2 * c][0] = body;          // validity: absent, no nulls
+            meta.buffers[2 * c][1] = 0;
+            meta.buffers[2 * c + 1][0] = body;
+            meta.buffers[2 * c + 1][1] = len;
+            body += (len + 63) & ~(int64_t)63;      // 64-byte aligned buffers
+        }
+
+        b.len = 0;
+        put_message(&b, ARROW_HEADER_RECORD_BATCH, body, put_batch_header, &meta);
+        blocks[nblocks].offset = pos;
+        blocks[nblocks].metadata_length = write_message(fp, &b);
+        blocks[nblocks].body_length = body;
+        pos += blocks[nblocks].metadata_length + body;
+        nblocks++;
+
+        for (int c = 0; c < ARROW_COLUMNS; c++) {
+            size_t len = (size_t)meta.buffers[2 * c + 1][1];
+            fwrite(col_data[c], 1, len, fp);
+            fwrite(zeros, 1, ((len + 63) & ~(size_t)63) - len, fp);
+        }
+        total += rows;
+    }
+    store_read_end(&snap);
+
+    // End-of-stream marker, then the footer for random access
+    uint32_t eos[2] = { 0xFFFFFFFFu, 0 };
+    fwrite(eos, sizeof(eos), 1, fp);
+
+    b.len = 0;
+    footer_ctx_t footer = { blocks, nblocks };
+    put_footer(&b, &footer);
+    fwrite(b.buf, 1, b.len, fp);
+    int32_t footer_len = (int32_t)b.len;
+    fwrite(&footer_len, sizeof(footer_len), 1, fp);
+    fwrite("ARROW1", 1, 6, fp);
+
+    int failed = b.failed || ferror(fp);
+    free(b.buf);
+    free(blocks);
+
+    int rc = (fclose(fp) == 0 && !failed) ? 0 : -1;
+    free(cols);     // holds the stream buffer: only after fclose
+    if (rc == 0) {
+        printf("Exported %zu records to %s\n", total, filename);
+    } else {
+        printf("Cannot write file %s\n", filename);
+    }
+    return rc;
+}
@@ -0,0 +1,713 @@
+#define _GNU_SOURCE
+#include "system.h"
+#include "metrics.h"
+
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+
+// ============================================================================
+// BACKUP / RESTORE
+// ============================================================================
+//
+// A backup is a directory holding copies of the persistent state (the
+// snapshot file, the journal segments after it and the tier files) and a
+// MANIFEST listing each copy with the byte count and CRC-32 it was taken
+// with. A snapshot file is never rewritten, and segments and tier files
+// are append-only, so backing up into a directory that already holds a
+// backup is incremental:
+//
+//   - a snapshot already in the manifest (same header CRC) is skipped,
+//   - a segment is copied from where the last backup stopped: nothing for
+//     a sealed segment, the frames appended since for the one still being
+//     written. The last frame copied before is checked first, so a segment
+//     rewritten after a crash is copied again in full. Tier files are
+//     copied the same way, checking their last row.
+//
+// Tier files are opened after the journal's extent is taken: a trim in the
+// copied journal was preceded by the rows it compacted, so those are in
+// the copy too. Rows newer than the raw records copied are harmless; the
+// restored store keeps being read from where its records start.
+//
+// Whole files are cloned (FICLONE) where the filesystem shares extents,
+// other ranges go through copy_file_range(), and plain read/write is the
+// fallback across filesystems. The CRC is taken by reading the source
+// just before each chunk is copied, which also leaves the chunk in the page
+// cache for the kernel copy. restore_data() checks every file against the
+// manifest while staging it, before anything live is touched.
+//
+// backup_data() only opens and reads files, never the store or the
+// journal's state, so it can run on any thread while ingest continues. The
+// files are opened first: a segment dropped or a snapshot replaced
+// afterwards stays readable through its descriptor. Copies run on a few
+// worker threads at low CPU and I/O priority.
+
+#define BACKUP_MANIFEST     "MANIFEST"
+#define BACKUP_FORMAT       "smart-station-backup 2"    // 2: tier files
+#define BACKUP_FORMAT_V1    "smart-station-backup 1"    // snapshot and journal only
+#define BACKUP_THREADS      4
+#define BACKUP_CHUNK        (1 << 20)
+#define BACKUP_PIN_ATTEMPTS 3
+#define RESTORE_SUFFIX      ".restore"      // staged next to the final name
+
+enum { BACKUP_SEGMENT, BACKUP_SNAPSHOT, BACKUP_TIER };
+
+static const char *const backup_kinds[] = { "segment", "snapshot", "tier" };
+
+typedef struct backup_file {
+    char name[48];          // inside the backup directory (tier: inside TIER_DIR too)
+    int kind;
+    uint64_t size;          // bytes covered by crc
+    uint32_t crc;
+    uint64_t lsn;           // snapshot: LSN it covers up to; segment: first LSN
+    uint32_t id;            // snapshot: header CRC
+    uint64_t tail;          // segment / tier: offset of the last frame or row copied
+    uint32_t tail_crc;      //   and its CRC
+} backup_file_t;
+
+typedef struct manifest {
+    backup_file_t *files;
+    int count, cap;
+} manifest_t;
+
+typedef struct copy_job {
+    backup_file_t *file;
+    int src_fd;
+    char dest[512];
+    uint64_t from, to;      // source bytes, copied to the same offsets
+    uint32_t crc;           // in: CRC of [0, from); out: CRC of [0, to)
+    int drop_src;           // evict the pages afterwards (not read again)
+    int drop_dest;
+    int rc;
+} copy_job_t;
+
+typedef struct job_queue {
+    copy_job_t *jobs;
+    int count;
+    int next;
+    int background;         // lower the workers' priority
+} job_queue_t;
+
+// The state a backup copies, held open so it cannot vanish mid-copy
+typedef struct pinned {
+    int snap_fd;            // -1 = no snapshot
+    uint64_t snap_lsn;
+    uint32_t snap_id;
+    int count;
+    uint64_t *lsns;         // segments after the snapshot, oldest first
+    int *fds;
+    off_t *sizes;           // their sizes when pinned: frames copied stop there
+    int tier_count;
+    tier_file_t *tiers;     // opened after the sizes were taken
+} pinned_t;
+
+// ============================================================================
+// MANIFEST
+// ============================================================================
+
+static backup_file_t* manifest_add(manifest_t *m) {
+    if (m->count == m->cap) {
+        int cap = m->cap ? m->cap * 2 : 16;
+        backup_file_t *p = realloc(m->files, (size_t)cap * sizeof(*p));
+        if (!p) return NULL;
+        m->files = p;
+        m->cap = cap;
+    }
+    backup_file_t *f = &m->files[m->count++];
+    memset(f, 0, sizeof(*f));
+    return f;
+}
+
+static const backup_file_t* manifest_find(const manifest_t *m, const char *name) {
+    for (int i = 0; i < m->count; i++) {
+        if (strcmp(m->files[i].name, name) == 0) return &m->files[i];
+    }
+    return NULL;
+}
+
+static void manifest_free(manifest_t *m) {
+    free(m->files);
+    memset(m, 0, sizeof(*m));
+}
+
+static int manifest_read(const char *dir, manifest_t *m) {
+    char path[512], line[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, BACKUP_MANIFEST);
+    memset(m, 0, sizeof(*m));
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    if (!fgets(line, sizeof(line), fp) ||
+        (strncmp(line, BACKUP_FORMAT, strlen(BACKUP_FORMAT)) != 0 &&
+         strncmp(line, BACKUP_FORMAT_V1, strlen(BACKUP_FORMAT_V1)) != 0)) {
+        fclose(fp);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        char kind[16], name[48];
+        unsigned long long size, lsn, tail;
+        unsigned crc, id, tail_crc;
+        backup_file_t *f;
+        int k = BACKUP_TIER;
+        if (sscanf(line, "%15s %47s %llu %x %llu %x %llu %x",
+                   kind, name, &size, &crc, &lsn, &id, &tail, &tail_crc) == 8) {
+            while (k >= 0 && strcmp(kind, backup_kinds[k]) != 0) k--;
+        }
+        if (k < 0 || strchr(name, '/') || (f = manifest_add(m)) == NULL) {
+            fclose(fp);
+            manifest_free(m);
+            return -1;
+        }
+        snprintf(f->name, sizeof(f->name), "%s", name);
+        f->kind = k;
+        f->size = size;
+        f->crc = crc;
+        f->lsn = lsn;
+        f->id = id;
+        f->tail = tail;
+        f->tail_crc = tail_crc;
+    }
+    fclose(fp);
+    return m->count;
+}
+
+static void sync_dir(const char *path) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// Written aside and renamed over the old one once durable: a crash leaves
+// either manifest, and both describe files that are in place
+static int manifest_write(const char *dir, const manifest_t *m) {
+    char path[512], tmp[520];
+    snprintf(path, sizeof(path), "%s/%s", dir, BACKUP_MANIFEST);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "%s\n", BACKUP_FORMAT);
+    for (int i = 0; i < m->count; i++) {
+        const backup_file_t *f = &m->files[i];
+        fprintf(fp, "%s %s %llu %08x %llu %08x %llu %08x\n",
+                backup_kinds[f->kind], f->name,
+                (unsigned long long)f->size, f->crc, (unsigned long long)f->lsn, f->id,
+                (unsigned long long)f->tail, f->tail_crc);
+    }
+    int ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    sync_dir(dir);
+    return 0;
+}
+
+// ============================================================================
+// COPY ENGINE
+// ============================================================================
+
+static int pread_full(int fd, void *buf, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t r = pread(fd, buf, n, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            if (r == 0) errno = EIO;        // shorter than the manifest says
+            return -1;
+        }
+        buf = (char *)buf + r;
+        n -= (size_t)r;
+        off += r;
+    }
+    return 0;
+}
+
+static int pwrite_full(int fd, const void *buf, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t w = pwrite(fd, buf, n, off);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) return -1;
+        buf = (const char *)buf + w;
+        n -= (size_t)w;
+        off += w;
+    }
+    return 0;
+}
+
+// In-kernel copy of [off, off + n) to the same offset
+static int kernel_copy(int in, int out, off_t off, size_t n) {
+    loff_t in_off = off, out_off = off;
+    while (n > 0) {
+        ssize_t r = copy_file_range(in, &in_off, out, &out_off, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            if (r == 0) errno = EIO;
+            return -1;
+        }
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+static void copy_job_run(copy_job_t *j) {
+    j->rc = -1;
+    int out = open(j->dest, O_WRONLY | O_CREAT | O_CLOEXEC | (j->from == 0 ? O_TRUNC : 0), 0644);
+    if (out < 0) {
+        log_error("backup_copy", strerror(errno));
+        return;
+    }
+
+    // A whole-file clone shares extents: nothing is copied, only checksummed
+    int cloned = j->from == 0 && j->to > 0 && ioctl(out, FICLONE, j->src_fd) == 0;
+    int kernel = !cloned;
+    char *buf = malloc(BACKUP_CHUNK);
+    uint32_t crc = j->crc;
+    if (!buf || ftruncate(out, (off_t)(cloned ? j->to : j->from)) != 0) {
+        goto out;
+    }
+    posix_fadvise(j->src_fd, (off_t)j->from, (off_t)(j->to - j->from), POSIX_FADV_SEQUENTIAL);
+
+    for (uint64_t off = j->from; off < j->to; ) {
+        size_t n = j->to - off < BACKUP_CHUNK ? (size_t)(j->to - off) : BACKUP_CHUNK;
+        if (pread_full(j->src_fd, buf, n, (off_t)off) != 0) {
+            goto out;
+        }
+        crc = crc32_update(crc, buf, n);
+        if (!cloned) {
+            if (kernel && kernel_copy(j->src_fd, out, (off_t)off, n) != 0) {
+                if (errno != EXDEV && errno != ENOSYS && errno != EOPNOTSUPP && errno != EINVAL) {
+                    goto out;
+                }
+                kernel = 0;     // not between these filesystems: write what we read
+            }
+            if (!kernel && pwrite_full(out, buf, n, (off_t)off) != 0) {
+                goto out;
+            }
+        }
+        off += n;
+    }
+    if (fdatasync(out) != 0) {
+        goto out;
+    }
+
+    if (j->drop_dest) posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+    if (j->drop_src) posix_fadvise(j->src_fd, (off_t)j->from, (off_t)(j->to - j->from), POSIX_FADV_DONTNEED);
+    metrics_add(METRIC_BACKUP_BYTES, j->to - j->from);
+    j->crc = crc;
+    j->rc = 0;
+
+out:
+    if (j->rc != 0) {
+        log_error("backup_copy", strerror(errno));
+    }
+    free(buf);
+    close(out);
+}
+
+// Linux applies nice and I/O priority per thread: the copy yields to the
+// ingest thread's writes and fsyncs without slowing the rest of the process
+static void lower_priority(void) {
+    const int ioprio_who_process = 1, ioprio_class_be = 2, ioprio_class_shift = 13;
+    syscall(SYS_ioprio_set, ioprio_who_process, 0, (ioprio_class_be << ioprio_class_shift) | 7);
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+}
+
+static void* copy_worker(void *arg) {
+    job_queue_t *q = arg;
+    if (q->background) {
+        lower_priority();
+    }
+    int i;
+    while ((i = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED)) < q->count) {
+        copy_job_run(&q->jobs[i]);
+    }
+    return NULL;
+}
+
+// Runs the jobs on up to BACKUP_THREADS threads; -1 if any failed
+static int run_jobs(copy_job_t *jobs, int count, int background) {
+    job_queue_t q = { jobs, count, 0, background };
+    pthread_t threads[BACKUP_THREADS];
+    int started = 0;
+    while (started < count && started < BACKUP_THREADS &&
+           pthread_create(&threads[started], NULL, copy_worker, &q) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        for (int i = 0; i < count; i++) copy_job_run(&jobs[i]);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].rc != 0) return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// BACKUP
+// ============================================================================
+
+static void unpin(pinned_t *p) {
+    if (p->snap_fd >= 0) close(p->snap_fd);
+    for (int i = 0; i < p->count; i++) close(p->fds[i]);
+    for (int i = 0; i < p->tier_count; i++) close(p->tiers[i].fd);
+    free(p->lsns);
+    free(p->fds);
+    free(p->sizes);
+    free(p->tiers);
+    memset(p, 0, sizeof(*p));
+    p->snap_fd = -1;
+}
+
+// Opens the snapshot and every segment it needs, then the tier files. A
+// snapshot completing in between drops segments: the set is then
+// incomplete and taken again.
+static int pin_state(pinned_t *p) {
+    for (int attempt = 0; attempt < BACKUP_PIN_ATTEMPTS; attempt++) {
+        memset(p, 0, sizeof(*p));
+        p->snap_fd = snapshot_open_file(&p->snap_lsn, &p->snap_id);
+
+        uint64_t *segs;
+        int n = journal_list_segments(&segs), start = 0;
+        if (p->snap_fd >= 0) {
+            while (start + 1 < n && segs[start + 1] <= p->snap_lsn) start++;
+        }
+        int ok = p->snap_fd < 0 || start >= n || segs[start] <= p->snap_lsn;
+        p->lsns = malloc((size_t)(n + 1) * sizeof(uint64_t));
+        p->fds = malloc((size_t)(n + 1) * sizeof(int));
+        p->sizes = malloc((size_t)(n + 1) * sizeof(off_t));
+        if (!p->lsns || !p->fds || !p->sizes) ok = 0;
+        for (int i = start; ok && i < n; i++) {
+            struct stat st;
+            int fd = journal_open_segment(segs[i]);
+            if (fd < 0 || fstat(fd, &st) != 0) {
+                if (fd >= 0) close(fd);
+                ok = 0;
+                break;
+            }
+            p->lsns[p->count] = segs[i];
+            p->sizes[p->count] = st.st_size;
+            p->fds[p->count++] = fd;
+        }
+        free(segs);
+        if (ok) {
+            p->tier_count = tier_open_files(&p->tiers);
+            ok = p->tier_count >= 0;
+            if (!ok) p->tier_count = 0;
+        }
+        if (ok) {
+            return 0;
+        }
+        unpin(p);
+    }
+    return -1;
+}
+
+static void add_job(copy_job_t *jobs, int *njobs, backup_file_t *f, const char *dir,
+                    int src_fd, uint64_t from, uint64_t to, uint32_t crc, int drop_src) {
+    copy_job_t *j = &jobs[(*njobs)++];
+    memset(j, 0, sizeof(*j));
+    j->file = f;
+    j->src_fd = src_fd;
+    snprintf(j->dest, sizeof(j->dest), "%s/%s", dir, f->name);
+    j->from = from;
+    j->to = to;
+    j->crc = crc;
+    j->drop_src = drop_src;
+    j->drop_dest = 1;
+}
+
+// Size of a file already in the backup, -1 if missing
+static long long backup_size(const char *dir, const char *name) {
+    char path[512];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    return stat(path, &st) == 0 ? (long long)st.st_size : -1;
+}
+
+// Backs up the snapshot and journal into directory `filename`, copying
+// only what changed since the backup already there. Any thread. Returns
+// the number of files in the backup, -1 on error.
+int backup_data(const char *filename) {
+    if (!filename || !*filename) {
+        return -1;
+    }
+    uint64_t t0 = metrics_now_ns();
+    if (create_directory(filename) != 0) {
+        log_error("backup_data", strerror(errno));
+        return -1;
+    }
+
+    manifest_t old, cur = { 0 };
+    manifest_read(filename, &old);      // none (or unreadable): full backup
+    pinned_t pin;
+    if (pin_state(&pin) != 0) {
+        log_error("backup_data", "journal kept changing, backup not taken");
+        manifest_free(&old);
+        return -1;
+    }
+
+    int rc = -1, njobs = 0;
+    copy_job_t *jobs = calloc((size_t)(pin.count + pin.tier_count) + 1, sizeof(*jobs));
+    cur.cap = pin.count + pin.tier_count + 1;
+    cur.files = calloc((size_t)cur.cap, sizeof(backup_file_t));     // job->file stays valid
+    if (!jobs || !cur.files) {
+        goto out;
+    }
+
+    if (pin.snap_fd >= 0) {
+        backup_file_t *f = manifest_add(&cur);
+        snprintf(f->name, sizeof(f->name), "snapshot-%016llx.bin", (unsigned long long)pin.snap_lsn);
+        f->kind = BACKUP_SNAPSHOT;
+        f->lsn = pin.snap_lsn;
+        f->id = pin.snap_id;
+        const backup_file_t *prev = manifest_find(&old, f->name);
+        struct stat st;
+        if (prev && prev->kind == BACKUP_SNAPSHOT && prev->id == f->id &&
+            backup_size(filename, f->name) >= (long long)prev->size) {
+            *f = *prev;
+        } else if (fstat(pin.snap_fd, &st) == 0) {
+            add_job(jobs, &njobs, f, filename, pin.snap_fd, 0, (uint64_t)st.st_size, 0, 1);
+        } else {
+            goto out;
+        }
+    }
+
+    for (int i = 0; i < pin.count; i++) {
+        backup_file_t *f = manifest_add(&cur);
+        snprintf(f->name, sizeof(f->name), "wal-%016llx.log", (unsigned long long)pin.lsns[i]);
+        f->lsn = pin.lsns[i];
+
+        // Continue from the previous copy if its last frame is still there
+        const backup_file_t *prev = manifest_find(&old, f->name);
+        uint32_t crc;
+        if (prev && prev->kind == BACKUP_SEGMENT &&
+            backup_size(filename, f->name) >= (long long)prev->size &&
+            (prev->size == 0 ||
+             (journal_frame_crc(pin.fds[i], (off_t)prev->tail, &crc) == 0 && crc == prev->tail_crc))) {
+            *f = *prev;
+        } else {
+            prev = NULL;
+        }
+
+        off_t tail = (off_t)f->tail;
+        off_t end = journal_segment_extent(pin.fds[i], (off_t)f->size, pin.sizes[i], &tail, &f->tail_crc);
+        if (end < 0) {
+            goto out;
+        }
+        f->tail = (uint64_t)tail;
+        if (!prev || (uint64_t)end > f->size) {
+            add_job(jobs, &njobs, f, filename, pin.fds[i], f->size, (uint64_t)end, f->crc,
+                    i + 1 < pin.count);     // only the last segment is still written to
+        }
+    }
+
+    // Tier files, continued like segments from their last row
+    for (int i = 0; i < pin.tier_count; i++) {
+        backup_file_t *f = manifest_add(&cur);
+        snprintf(f->name, sizeof(f->name), "%s", pin.tiers[i].name);
+        f->kind = BACKUP_TIER;
+
+        const backup_file_t *prev = manifest_find(&old, f->name);
+        uint32_t crc;
+        if (prev && prev->kind == BACKUP_TIER &&
+            backup_size(filename, f->name) >= (long long)prev->size &&
+            (prev->size == 0 ||
+             (tier_row_crc_at(pin.tiers[i].fd, (off_t)prev->tail, &crc) == 0 && crc == prev->tail_crc))) {
+            *f = *prev;
+        } else {
+            prev = NULL;
+        }
+
+        off_t tail = (off_t)f->tail;
+        off_t end = tier_file_extent(pin.tiers[i].fd, &tail, &f->tail_crc);
+        if (end < 0) {
+            goto out;
+        }
+        f->tail = (uint64_t)tail;
+        if (!prev || (uint64_t)end > f->size) {
+            add_job(jobs, &njobs, f, filename, pin.tiers[i].fd, f->size, (uint64_t)end, f->crc, 0);
+        }
+    }
+
+    if (run_jobs(jobs, njobs, 1) != 0) {
+        goto out;
+    }
+    uint64_t bytes = 0;
+    for (int i = 0; i < njobs; i++) {
+        jobs[i].file->size = jobs[i].to;
+        jobs[i].file->crc = jobs[i].crc;
+        bytes += jobs[i].to - jobs[i].from;
+    }
+    if (manifest_write(filename, &cur) != 0) {
+        log_error("backup_data", strerror(errno));
+        goto out;
+    }
+
+    // Files of the previous backup that are no longer needed
+    for (int i = 0; i < old.count; i++) {
+        if (!manifest_find(&cur, old.files[i].name)) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", filename, old.files[i].name);
+            unlink(path);
+        }
+    }
+    system_log_append("INFO", "backup: %s, %d files, %d copied (%llu bytes) in %.1f ms",
+                      filename, cur.count, njobs, (unsigned long long)bytes,
+                      (double)(metrics_now_ns() - t0) / 1e6);
+    rc = cur.count;
+
+out:
+    free(jobs);
+    manifest_free(&cur);
+    manifest_free(&old);
+    unpin(&pin);
+    return rc;
+}
+
+// ============================================================================
+// RESTORE
+// ============================================================================
+
+static void restore_target(char *buf, size_t size, const backup_file_t *f) {
+    if (f->kind == BACKUP_SNAPSHOT) {
+        snprintf(buf, size, "%s", SNAPSHOT_FILE);
+    } else if (f->kind == BACKUP_TIER) {
+        snprintf(buf, size, "%s/%s", TIER_DIR, f->name);
+    } else {
+        snprintf(buf, size, "%s/wal-%016llx.log", JOURNAL_DIR, (unsigned long long)f->lsn);
+    }
+}
+
+// Replaces the store, journal, snapshot and tiers with the backup in
+// directory `filename` (a backup from before tiers were copied leaves no
+// tiers). Every file is staged and checked against the manifest first
+// (in parallel); on any mismatch nothing changes. Ingest thread. Returns
+// the number of records restored, -1 on error.
+int restore_data(const char *filename) {
+    manifest_t m;
+    if (!filename || manifest_read(filename, &m) < 0) {
+        log_error("restore_data", "no valid backup manifest");
+        return -1;
+    }
+    if (create_directory(JOURNAL_DIR) != 0 || create_directory(TIER_DIR) != 0) {
+        log_error("restore_data", strerror(errno));
+        manifest_free(&m);
+        return -1;
+    }
+
+    int rc = -1, njobs = 0, snapshots = 0;
+    copy_job_t *jobs = calloc((size_t)m.count + 1, sizeof(*jobs));
+    if (!jobs) {
+        goto out;
+    }
+    for (int i = 0; i < m.count; i++) {
+        backup_file_t *f = &m.files[i];
+        char src[512], target[256];
+        snapshots += f->kind == BACKUP_SNAPSHOT;
+        snprintf(src, sizeof(src), "%s/%s", filename, f->name);
+        int fd = open(src, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || snapshots > 1) {
+            log_error("restore_data", fd < 0 ? strerror(errno) : "more than one snapshot");
+            if (fd >= 0) close(fd);
+            goto out;
+        }
+        restore_target(target, sizeof(target), f);
+        copy_job_t *j = &jobs[njobs++];
+        j->file = f;
+        j->src_fd = fd;
+        snprintf(j->dest, sizeof(j->dest), "%s%s", target, RESTORE_SUFFIX);
+        j->to = f->size;
+        j->drop_src = 1;        // the staged copy is what gets loaded
+    }
+
+    if (run_jobs(jobs, njobs, 0) != 0) {
+        goto out;
+    }
+    for (int i = 0; i < njobs; i++) {
+        if (jobs[i].crc != jobs[i].file->crc) {
+            system_log_append("ERROR", "restore: %s/%s fails its checksum, nothing restored",
+                              filename, jobs[i].file->name);
+            goto out;
+        }
+    }
+
+    // Everything is staged and verified: swap it in and load it like a
+    // startup would
+    snapshot_discard();
+    journal_discard();
+    tier_discard();
+    for (int i = 0; i < njobs; i++) {
+        char target[256];
+        restore_target(target, sizeof(target), jobs[i].file);
+        if (rename(jobs[i].dest, target) != 0) {
+            log_error("restore_data", strerror(errno));
+        }
+        jobs[i].dest[0] = '\0';
+    }
+    sync_dir(JOURNAL_DIR);
+    sync_dir(TIER_DIR);
+    sync_dir(".");
+
+    store_clear();
+    sensor_dir_reset();
+    cache_invalidate();
+    recent_data_count = 0;
+    uint64_t lsn = 0;
+    int loaded = snapshot_load(&lsn);
+    int replayed = journal_open(lsn);
+    if (loaded == SNAPSHOT_INCOMPATIBLE || replayed == JOURNAL_INCOMPATIBLE) {
+        // The backup itself is untouched and can be restored by the old build
+        printf("Warning: the backup was written with a different sensor schema and was not\n");
+        printf("fully loaded (see %s). Export it with the previous build.\n", SYSTEM_LOG_FILE);
+    } else if (replayed < 0) {
+        printf("Warning: journal unavailable, data will not survive a restart\n");
+    }
+    tier_open();            // the restored store decides where the tiers end
+    calculate_statistics();
+    query_reload();
+    rc = (int)store_size();
+    system_log_append("INFO", "restore: %d records from %s", rc, filename);
+
+out:
+    for (int i = 0; i < njobs; i++) {
+        close(jobs[i].src_fd);
+        if (rc < 0 && jobs[i].dest[0]) unlink(jobs[i].dest);
+    }
+    free(jobs);
+    manifest_free(&m);
+    return rc;
+}
+
+// ============================================================================
+// FILE OPERATIONS
+// ============================================================================
+
+int create_directory(const char *path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+// Copies src to dest with the same engine as backups (clone, in-kernel
+// copy or read/write, whichever the filesystems allow)
+int copy_file(const char *src, const char *dest) {
+    struct stat st;
+    int fd = open(src, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    copy_job_t j = { .src_fd = fd, .to = (uint64_t)st.st_size };
+    snprintf(j.dest, sizeof(j.dest), "%s", dest);
+    copy_job_run(&j);
+    close(fd);
+    return j.rc;
+}
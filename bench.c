@@ -0,0 +1,1113 @@
+/* bench.c — Benchmark cho các đường nóng của hệ thống
+ *
+ * Chương trình độc lập (giống loadgen.c):
+ *
+ *   gcc -O2 -pthread -o bench bench.c data.c store.c sensors.c sketch.c anomaly.c ui_report.c \
+ *       dashboard.c arrow.c journal.c snapshot.c query.c cache.c backup.c validate.c reorder.c trace.c tier.c \
+ *       frame.c metrics.c -x c sensor -x none -lm
+ *
+ *   ./bench [--reps R] [--max N] [--filter NAME] [-o results.json]
+ *
+ * Microbenchmark: parse_sensor_data, frame_decoder, write_full (qua pipe
+ * thật), validate_records (lô hợp lệ / 1% bị loại), reorder buffer (1 và 4
+ * nguồn xen kẽ, lệch thứ tự), calculate_statistics, ui_chart_temp_humid, export_to_csv, export_to_arrow,
+ * system_log_append, data_log_append, sensor_dir_assess (phát hiện bất thường),
+ * thống kê UI viết tay / qua UILayout / qua UIItemExtractor, journal_append
+ * (group commit mặc định so với fsync mỗi lô), khởi động lại: dựng lại
+ * thư mục sensor bằng quét store so với ghi/nạp snapshot, query server
+ * (quét khoảng chép từ store so với sendfile từ snapshot, tổng hợp, rollup,
+ * giá trị mới nhất với 1 và 16 client), cache kết quả biểu đồ 24 giờ (tính
+ * lại từ đầu / dùng lại nguyên vẹn / chỉ tính phần đuôi mới thêm), sao lưu
+ * (đầy đủ, gia tăng, ingest khi đang sao lưu) và khôi phục.
+ * File Arrow của export_to_arrow được đọc lại bằng một bộ đọc tối thiểu
+ * (arrow_check) và báo lỗi ra stderr nếu sai.
+ * Stress: ingest tốc độ tối đa (có xóa dữ liệu cũ) trong khi 0/2/4 luồng
+ * đọc snapshot và export Arrow song song; sai lệch dữ liệu được báo ra stderr.
+ * Macrobenchmark: ingest → thống kê → export CSV với 1K, 10K, ... tới --max
+ * bản ghi (mặc định 10M).
+ *
+ * Mỗi phép đo chạy R lần (mặc định 5) và ghi median/min/max ra JSON để so
+ * sánh giữa các phiên bản. Mọi file tạm được tạo trong một thư mục mkdtemp.
+ */
+
+#define _GNU_SOURCE
+#include "system.h"
+#include "frame.h"
+#include "query.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#define UI_HAVE_SYSTEM_SENSOR
+#include "ui_report.h"
+
+#define BENCH_MAX_RESULTS 128
+
+typedef struct {
+    char name[64];
+    const char* kind;       // "micro" / "macro"
+    size_t records;         // số phần tử mỗi lần chạy
+    double median, min, max;  // ns cho mỗi phần tử
+} bench_result_t;
+
+static bench_result_t results[BENCH_MAX_RESULTS];
+static int n_results;
+static int reps = 5;
+static size_t max_records = 10000000;
+static const char* filter;
+
+typedef void (*bench_fn)(size_t n, void* ctx);
+
+// journal.c / reorder.c đọc cấu hình từ đây (main.c không được link)
+config_t system_config = {
+    .journal_commit_ms = JOURNAL_COMMIT_MS,
+    .journal_commit_records = JOURNAL_COMMIT_RECORDS,
+    .reorder_window_s = REORDER_WINDOW_S,
+};
+
+
+/* =====================================
+ * KHUNG ĐO
+ * ===================================== */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int selected(const char* name) {
+    return !filter || strstr(name, filter) != NULL;
+}
+
+// stdout bị tắt trong lúc đo để printf của export_to_csv không lẫn vào JSON
+static int saved_stdout = -1;
+static void mute_stdout(int on) {
+    fflush(stdout);
+    if (on) {
+        int devnull = open("/dev/null", O_WRONLY);
+        saved_stdout = dup(STDOUT_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+    } else if (saved_stdout >= 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        saved_stdout = -1;
+    }
+}
+
+static void run_bench(const char* name, const char* kind, int runs,
+                      size_t n, bench_fn fn, void* ctx) {
+    if (!selected(name) || n_results >= BENCH_MAX_RESULTS) return;
+
+    double samples[64];
+    if (runs > 64) runs = 64;
+
+    mute_stdout(1);
+    fn(n < 1000 ? n : 1000, ctx);       // làm nóng cache / page fault
+    for (int r = 0; r < runs; r++) {
+        uint64_t t0 = now_ns();
+        fn(n, ctx);
+        samples[r] = (double)(now_ns() - t0) / (double)n;
+    }
+    mute_stdout(0);
+    qsort(samples, (size_t)runs, sizeof(double), cmp_double);
+
+    bench_result_t* res = &results[n_results++];
+    snprintf(res->name, sizeof(res->name), "%s", name);
+    res->kind = kind;
+    res->records = n;
+    res->median = samples[runs / 2];
+    res->min = samples[0];
+    res->max = samples[runs - 1];
+    fprintf(stderr, "%-32s %10zu  %10.1f ns/op  (%.0f ops/s)\n",
+            name, n, res->median, 1e9 / res->median);
+}
+
+
+/* =====================================
+ * DỮ LIỆU MẪU
+ * ===================================== */
+
+#define LINE_POOL 1024
+static char lines[LINE_POOL][32];
+
+static void init_line_pool(void) {
+    for (int i = 0; i < LINE_POOL; i++)
+        get_simulated_data(lines[i], sizeof(lines[i]));
+}
+
+static void fill_store(size_t n) {
+    store_clear();
+    time_t base = 1700000000;
+    for (size_t i = 0; i < n; i++) {
+        sensor_data_t d = { .timestamp = base + (time_t)i,
+                            .temperature = 20.0f + (float)(i % 200) * 0.1f,
+                            .humidity = 40.0f + (float)(i % 400) * 0.1f,
+                            .gas_level = 100.0f + (float)(i % 500),
+                            .sensor_id = 1 + (int)(i % MAX_SENSORS), .quality = 95 };
+        store_append(&d);
+    }
+}
+
+
+/* =====================================
+ * MICROBENCHMARK
+ * ===================================== */
+
+static void b_parse(size_t n, void* ctx) {
+    (void)ctx;
+    SensorData sd;
+    for (size_t i = 0; i < n; i++)
+        parse_sensor_data(lines[i % LINE_POOL], &sd);
+}
+
+/* validate_records theo lô 256 như supervisor; ctx = 1 bản ghi sai trên
+ * bao nhiêu (0 = tất cả hợp lệ). Lô bị nén được chép lại từ bản gốc, chi
+ * phí đó tính cả vào kết quả. */
+#define VALIDATE_BATCH 256
+static void b_validate(size_t n, void* ctx) {
+    int every = *(int*)ctx;
+    static sensor_data_t pristine[VALIDATE_BATCH], batch[VALIDATE_BATCH];
+    for (int i = 0; i < VALIDATE_BATCH; i++) {
+        pristine[i] = (sensor_data_t){ .timestamp = 1700000000 + i,
+                                       .temperature = 20.0f + (float)(i % 150) * 0.1f,
+                                       .humidity = 50.0f + (float)(i % 300) * 0.1f,
+                                       .gas_level = 200.0f + (float)(i % 100),
+                                       .sensor_id = 1 + i % MAX_SENSORS, .quality = 100 };
+        if (every > 0 && i % every == every - 1) pristine[i].humidity = 150.0f;
+    }
+    memcpy(batch, pristine, sizeof(batch));
+    validate_counts_t rejected = { { 0 } };
+    for (size_t i = 0; i < n; i += VALIDATE_BATCH) {
+        size_t k = n - i < VALIDATE_BATCH ? n - i : VALIDATE_BATCH;
+        if (validate_records(batch, k, &rejected) < k)
+            memcpy(batch, pristine, sizeof(batch));
+    }
+}
+
+/* Reorder buffer → ingest_records: ctx = số nguồn. Mỗi nguồn gửi lô 256 bản
+ * ghi lần lượt; nguồn s lệch s giây so với nguồn 0 và cứ 8 mẫu lại có một cặp
+ * đảo thứ tự. Store phải có thứ tự thời gian, sai lệch báo ra stderr. */
+static void b_reorder(size_t n, void* ctx) {
+    int sources = *(int*)ctx;
+    sensor_data_t batch[VALIDATE_BATCH];
+    store_clear();
+    time_t base = 1700000000;
+    size_t per_source = n / (size_t)sources;
+    for (size_t i = 0; i < per_source; i += VALIDATE_BATCH) {
+        size_t k = per_source - i < VALIDATE_BATCH ? per_source - i : VALIDATE_BATCH;
+        for (int s = 0; s < sources; s++) {
+            for (size_t j = 0; j < k; j++) {
+                size_t t = i + j;
+                if (t % 8 == 6) t++;
+                else if (t % 8 == 7) t--;
+                batch[j] = (sensor_data_t){ .timestamp = base + (time_t)t + s,
+                                            .temperature = 25.0f, .humidity = 60.0f,
+                                            .gas_level = 200.0f, .sensor_id = 1 + s,
+                                            .quality = 100 };
+            }
+            reorder_push(s, batch, NULL, k);
+        }
+        reorder_release(0);
+    }
+    reorder_release(1);
+    if (store_size() != per_source * (size_t)sources)
+        fprintf(stderr, "  [reorder: %zu of %zu records stored]\n", store_size(), per_source * (size_t)sources);
+    for (size_t i = store_first() + 1; i < store_end(); i++) {
+        if (store_at(i)->timestamp < store_at(i - 1)->timestamp) {
+            fprintf(stderr, "  [reorder: record %zu out of order]\n", i);
+            break;
+        }
+    }
+}
+
+// Cùng dữ liệu như b_reorder với 1 nguồn có thứ tự, gọi thẳng ingest_records
+static void b_ingest_direct(size_t n, void* ctx) {
+    (void)ctx;
+    sensor_data_t batch[VALIDATE_BATCH];
+    store_clear();
+    for (size_t i = 0; i < n; i += VALIDATE_BATCH) {
+        size_t k = n - i < VALIDATE_BATCH ? n - i : VALIDATE_BATCH;
+        for (size_t j = 0; j < k; j++) {
+            batch[j] = (sensor_data_t){ .timestamp = 1700000000 + (time_t)(i + j),
+                                        .temperature = 25.0f, .humidity = 60.0f,
+                                        .gas_level = 200.0f, .sensor_id = 1, .quality = 100 };
+        }
+        ingest_records(batch, k);
+    }
+}
+
+static void b_frame_decoder(size_t n, void* ctx) {
+    (void)ctx;
+    static uint8_t stream[LINE_POOL * FRAME_SIZE];
+    static int ready = 0;
+    if (!ready) {
+        for (int i = 0; i < LINE_POOL; i++)
+            get_simulated_frame(stream + i * FRAME_SIZE, FRAME_SIZE);
+        ready = 1;
+    }
+    frame_decoder_t dec;
+    frame_event_t ev;
+    frame_decoder_init(&dec, FRAME_MODE_AUTO);
+    size_t done = 0;
+    while (done < n) {
+        size_t off = (done % LINE_POOL) * FRAME_SIZE;
+        size_t chunk = 16 * FRAME_SIZE;
+        if (off + chunk > sizeof(stream)) chunk = sizeof(stream) - off;
+        frame_decoder_feed(&dec, stream + off, chunk);
+        while (frame_decoder_next(&dec, &ev)) done++;
+    }
+}
+
+// Tiến trình con đọc hết pipe; đo cả phía đọc vì đó là chi phí thật của IPC
+static void b_write_full(size_t n, void* ctx) {
+    (void)ctx;
+    int pfd[2];
+    if (pipe(pfd) != 0) return;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(pfd[1]);
+        char buf[PIPE_BUFFER_SIZE * 64];
+        while (read(pfd[0], buf, sizeof(buf)) > 0) {}
+        _exit(0);
+    }
+    close(pfd[0]);
+    SensorData sd = { .temperature = 25.0f, .humidity = 60.0f, .gas_ppm = 200, .sensor_id = 1 };
+    for (size_t i = 0; i < n; i++) {
+        sd.seq = (uint32_t)i;
+        write_full(pfd[1], &sd, sizeof(sd));
+    }
+    close(pfd[1]);
+    waitpid(pid, NULL, 0);
+}
+
+/* Một lần calculate_statistics() trên store có n bản ghi (macro) */
+static void b_stats(size_t n, void* ctx) {
+    (void)n; (void)ctx;
+    calculate_statistics();
+}
+
+/* calculate_statistics() đọc thư mục sensor, không quét store: đo n lần
+ * gọi khi store có 1M bản ghi (micro) */
+static void b_stats_calls(size_t n, void* ctx) {
+    (void)ctx;
+    for (size_t i = 0; i < n; i++)
+        calculate_statistics();
+}
+
+static SensorData* chart_data;
+static FILE* devnull_fp;
+static void b_chart(size_t n, void* ctx) {
+    size_t len = *(size_t*)ctx;
+    for (size_t i = 0; i < n; i++)
+        ui_chart_temp_humid(devnull_fp, chart_data, len);
+}
+
+// Cùng một phép min/max/avg: vòng lặp viết tay làm mốc cho đường UILayout
+static void b_ui_stats_hand(size_t n, void* ctx) {
+    size_t len = *(size_t*)ctx;
+    UIStats st;
+    for (size_t r = 0; r < n / len; r++) {
+        float t_min = 1e30f, t_max = -1e30f, h_min = 1e30f, h_max = -1e30f;
+        int g_min = 0x7fffffff, g_max = -0x7fffffff - 1;
+        double t_sum = 0, h_sum = 0, g_sum = 0;
+        for (size_t i = 0; i < len; i++) {
+            const SensorData* d = &chart_data[i];
+            if (d->temperature < t_min) t_min = d->temperature;
+            if (d->temperature > t_max) t_max = d->temperature;
+            if (d->humidity < h_min) h_min = d->humidity;
+            if (d->humidity > h_max) h_max = d->humidity;
+            if (d->gas_ppm < g_min) g_min = d->gas_ppm;
+            if (d->gas_ppm > g_max) g_max = d->gas_ppm;
+            t_sum += d->temperature;
+            h_sum += d->humidity;
+            g_sum += d->gas_ppm;
+        }
+        st.t_min = t_min; st.t_max = t_max; st.t_avg = (float)(t_sum / len);
+        st.h_min = h_min; st.h_max = h_max; st.h_avg = (float)(h_sum / len);
+        st.g_min = g_min; st.g_max = g_max; st.g_avg = g_sum / len;
+        __asm__ volatile("" : : "r"(&st) : "memory");
+    }
+}
+
+static void b_ui_stats_layout(size_t n, void* ctx) {
+    size_t len = *(size_t*)ctx;
+    UIStats st;
+    for (size_t r = 0; r < n / len; r++) {
+        ui_compute_stats_l(chart_data, len, &ui_layout_sensordata, &st);
+        __asm__ volatile("" : : "r"(&st) : "memory");
+    }
+}
+
+static int extract_sensordata(const void* buf, size_t i, UIItem* out) {
+    const SensorData* d = (const SensorData*)buf + i;
+    out->ts = d->ts;
+    out->temperature = d->temperature;
+    out->humidity = d->humidity;
+    out->gas_ppm = d->gas_ppm;
+    return 0;
+}
+
+static void b_ui_stats_extractor(size_t n, void* ctx) {
+    size_t len = *(size_t*)ctx;
+    UIStats st;
+    for (size_t r = 0; r < n / len; r++) {
+        ui_compute_stats_g(chart_data, len, extract_sensordata, &st);
+        __asm__ volatile("" : : "r"(&st) : "memory");
+    }
+}
+
+static void b_export_csv(size_t n, void* ctx) {
+    (void)n; (void)ctx;
+    export_to_csv("bench_export.csv");
+}
+
+static void b_export_arrow(size_t n, void* ctx) {
+    (void)n; (void)ctx;
+    export_to_arrow("bench_export.arrow");
+}
+
+/* Bộ đọc Arrow IPC tối thiểu để kiểm tra file export_to_arrow() ghi ra,
+ * độc lập với bộ ghi trong arrow.c: magic đầu/cuối, Footer (schema, danh
+ * sách block), message Schema ở đầu file và từng message RecordBatch (số
+ * dòng, số node, độ dài body) theo block của Footer. Mọi offset FlatBuffers
+ * đều được kiểm tra nằm trong file. Cùng kiểm tra bằng pyarrow:
+ *
+ *   python3 -c "import pyarrow.feather as f; t = f.read_table('x.arrow'); \
+ *               print(t.schema, t.num_rows)"
+ */
+typedef struct {
+    const uint8_t* buf;
+    size_t len;
+    const char* error;
+} fb_reader_t;
+
+static uint32_t fb_u32(fb_reader_t* r, size_t pos) {
+    uint32_t v = 0;
+    if (pos + 4 > r->len) r->error = "offset outside the file";
+    else memcpy(&v, r->buf + pos, 4);
+    return v;
+}
+
+// Vị trí trường i của bảng t, 0 nếu trường vắng mặt
+static size_t fb_field(fb_reader_t* r, size_t t, int i) {
+    size_t vt = t - (size_t)(int32_t)fb_u32(r, t);
+    if (r->error || vt + 4 > r->len) {
+        r->error = "bad vtable";
+        return 0;
+    }
+    uint16_t vt_size, off = 0;
+    memcpy(&vt_size, r->buf + vt, 2);
+    if (4 + 2 * (size_t)i + 2 <= vt_size && vt + 4 + 2 * (size_t)i + 2 <= r->len)
+        memcpy(&off, r->buf + vt + 4 + 2 * i, 2);
+    return off ? t + off : 0;
+}
+
+// Bảng / vector mà trường offset i của bảng t trỏ tới, 0 nếu vắng mặt
+static size_t fb_ref(fb_reader_t* r, size_t t, int i) {
+    size_t pos = fb_field(r, t, i);
+    return pos ? pos + fb_u32(r, pos) : 0;
+}
+
+static int64_t fb_scalar(fb_reader_t* r, size_t t, int i, int size) {
+    size_t pos = fb_field(r, t, i);
+    int64_t v = 0;
+    if (!pos) return 0;
+    if (pos + (size_t)size > r->len) r->error = "scalar outside the file";
+    else memcpy(&v, r->buf + pos, (size_t)size);      // little-endian
+    return v;
+}
+
+// Message ở offset `at` (continuation, độ dài, flatbuffer); trả về bảng header
+static size_t arrow_message(fb_reader_t* r, size_t at, int want_type, int64_t* body_length) {
+    if (fb_u32(r, at) != 0xFFFFFFFFu) {
+        r->error = "missing continuation marker";
+        return 0;
+    }
+    fb_reader_t m = { r->buf + at + 8, fb_u32(r, at + 4), NULL };
+    if (r->error || at + 8 + m.len > r->len) {
+        r->error = "message outside the file";
+        return 0;
+    }
+    size_t root = fb_u32(&m, 0);
+    int type = (int)fb_scalar(&m, root, 1, 1);
+    size_t header = fb_ref(&m, root, 2);
+    if (body_length) *body_length = fb_scalar(&m, root, 3, 8);
+    if (m.error || type != want_type || !header) {
+        r->error = m.error ? m.error : "unexpected message type";
+        return 0;
+    }
+    return at + 8 + header;
+}
+
+// Schema: số cột và tên từng cột theo thứ tự của bộ ghi
+static void arrow_check_schema(fb_reader_t* r, size_t schema) {
+    static const char* const names[] = {
+        "timestamp", "sensor_id",
+#define BENCH_ARROW_NAME_(field, ...) #field,
+        SENSOR_FIELDS(BENCH_ARROW_NAME_)
+#undef BENCH_ARROW_NAME_
+        "quality"
+    };
+    size_t fields = fb_ref(r, schema, 1);
+    size_t count = fields ? fb_u32(r, fields) : 0;
+    if (r->error || count != sizeof(names) / sizeof(names[0])) {
+        if (!r->error) r->error = "wrong column count";
+        return;
+    }
+    for (size_t i = 0; i < count && !r->error; i++) {
+        size_t slot = fields + 4 + 4 * i;
+        size_t field = slot + fb_u32(r, slot);
+        size_t name = fb_ref(r, field, 0);
+        size_t len = name ? fb_u32(r, name) : 0;
+        if (r->error || name + 4 + len > r->len || len != strlen(names[i]) ||
+            memcmp(r->buf + name + 4, names[i], len) != 0)
+            r->error = r->error ? r->error : "wrong column name";
+    }
+}
+
+// Trả về số dòng đọc được, -1 nếu file sai (lý do in ra stderr)
+static long arrow_check(const char* path, size_t expected) {
+    FILE* fp = fopen(path, "rb");
+    fb_reader_t r = { NULL, 0, NULL };
+    uint8_t* buf = NULL;
+    long size = -1;
+    if (fp && fseek(fp, 0, SEEK_END) == 0) size = ftell(fp);
+    if (size > 0 && (buf = malloc((size_t)size)) != NULL) {
+        rewind(fp);
+        if (fread(buf, 1, (size_t)size, fp) == (size_t)size) {
+            r.buf = buf;
+            r.len = (size_t)size;
+        }
+    }
+    if (fp) fclose(fp);
+
+    long rows = 0;
+    size_t batches = 0;
+    if (!r.buf || r.len < 8 + 10 || memcmp(r.buf, "ARROW1\0\0", 8) != 0 ||
+        memcmp(r.buf + r.len - 6, "ARROW1", 6) != 0) {
+        r.error = "missing ARROW1 magic";
+    } else {
+        // Footer: version, schema, dictionaries, recordBatches
+        size_t footer_len = fb_u32(&r, r.len - 10);
+        fb_reader_t f = { r.buf + r.len - 10 - footer_len, footer_len, NULL };
+        if (footer_len > r.len - 18) {
+            r.error = "bad footer length";
+        } else {
+            size_t root = fb_u32(&f, 0);
+            size_t schema = fb_ref(&f, root, 1);
+            size_t blocks = fb_ref(&f, root, 3);
+            if (!f.error && schema) arrow_check_schema(&f, schema);
+            batches = blocks && !f.error ? fb_u32(&f, blocks) : 0;
+            if (!f.error && (!schema || !blocks || blocks + 4 + 24 * batches > f.len))
+                f.error = "footer without schema or blocks";
+            r.error = f.error;
+
+            // Message Schema ngay sau magic đầu file
+            if (!r.error) arrow_check_schema(&r, arrow_message(&r, 8, 1, NULL));
+
+            for (size_t i = 0; i < batches && !r.error; i++) {
+                int64_t block[3], body;     // offset, metadataLength (+pad), bodyLength
+                memcpy(block, f.buf + blocks + 4 + 24 * i, sizeof(block));
+                if (block[0] < 0 || (uint64_t)block[0] + (uint32_t)block[1] + (uint64_t)block[2] > r.len) {
+                    r.error = "block outside the file";
+                    break;
+                }
+                size_t batch = arrow_message(&r, (size_t)block[0], 3, &body);
+                if (r.error) break;
+                int64_t length = fb_scalar(&r, batch, 0, 8);
+                size_t nodes = fb_ref(&r, batch, 1);
+                if (r.error || body != block[2] || !nodes ||
+                    fb_u32(&r, nodes) != 3 + SENSOR_FIELD_COUNT) {
+                    r.error = r.error ? r.error : "record batch does not match its block";
+                    break;
+                }
+                rows += length;
+            }
+        }
+    }
+    if (!r.error && (size_t)rows != expected) r.error = "wrong row count";
+    free(buf);
+    if (r.error) {
+        fprintf(stderr, "  ARROW CHECK FAILED: %s (%ld / %zu rows)\n", r.error, rows, expected);
+        return -1;
+    }
+    fprintf(stderr, "  [arrow: %ld rows in %zu batches, schema and footer read back]\n", rows, batches);
+    return rows;
+}
+
+static void b_system_log(size_t n, void* ctx) {
+    (void)ctx;
+    for (size_t i = 0; i < n; i++)
+        system_log_append("INFO", "Serial: T=%.1f H=%.1f G=%d", 25.0, 60.0, (int)i);
+}
+
+// Nhiễu nhỏ quanh baseline + thỉnh thoảng một spike, 10 sensor xen kẽ
+static void b_anomaly(size_t n, void* ctx) {
+    (void)ctx;
+    sensor_data_t d = { .timestamp = 1700000000, .temperature = 25.0f, .humidity = 60.0f,
+                        .gas_level = 200.0f, .sensor_id = 1, .quality = 100 };
+    for (size_t i = 0; i < n; i++) {
+        d.sensor_id = 1 + (int)(i % MAX_SENSORS);
+        d.temperature = 25.0f + (float)(i % 7) * 0.1f + ((i % 997) == 0 ? 15.0f : 0.0f);
+        d.humidity = 60.0f + (float)(i % 13) * 0.2f;
+        d.gas_level = 200.0f + (float)(i % 11);
+        d.quality = 100;
+        sensor_dir_assess(&d);
+    }
+}
+
+// Lô 100 bản ghi như một lần drain pipe; ctx = số bản ghi mỗi lần fsync
+static void b_journal(size_t n, void* ctx) {
+    int commit_records = *(int*)ctx;
+    system_config.journal_commit_records = commit_records;
+    system_config.journal_commit_ms = commit_records > 1 ? JOURNAL_COMMIT_MS : 0;
+    sensor_data_t batch[100];
+    for (int i = 0; i < 100; i++) {
+        batch[i] = (sensor_data_t){ .timestamp = 1700000000 + i, .temperature = 25.0f,
+                                    .humidity = 60.0f, .gas_level = 200.0f,
+                                    .sensor_id = 1 + i % MAX_SENSORS, .quality = 100 };
+    }
+    for (size_t i = 0; i < n; i += 100)
+        journal_append(batch, n - i < 100 ? n - i : 100);
+    journal_commit();
+}
+
+// Khởi động không có snapshot: quét lại toàn bộ store để dựng sketch/chỉ mục
+static void b_dir_rebuild(size_t n, void* ctx) {
+    (void)n; (void)ctx;
+    sensor_dir_rebuild();
+}
+
+static void b_snapshot_save(size_t n, void* ctx) {
+    (void)n; (void)ctx;
+    unlink(SNAPSHOT_FILE);      // snapshot_save bỏ qua nếu không có gì mới
+    snapshot_save();
+}
+
+// Khởi động có snapshot: map store, chép thư mục, rồi một truy vấn thống kê
+static void b_snapshot_load(size_t n, void* ctx) {
+    (void)n; (void)ctx;
+    uint64_t lsn;
+    snapshot_load(&lsn);
+    calculate_statistics();
+}
+
+/* Stress đọc song song: luồng chính ingest, mỗi luồng đọc lặp lại
+ *   - chụp snapshot, kiểm tra bản ghi liên tục (timestamp tăng đúng 1,
+ *     sensor_id khớp timestamp), nên đọc phải block đã giải phóng sẽ lộ ra;
+ *   - export_to_arrow ra file riêng của luồng. */
+#define STRESS_BASE     1700000000
+#define STRESS_WINDOW   200000      // số bản ghi giữ lại khi xóa dữ liệu cũ
+
+static int stress_stop;
+
+typedef struct {
+    pthread_t thread;
+    int id;
+    unsigned long snapshots, exports, errors;
+} stress_reader_t;
+
+static void* stress_reader(void* arg) {
+    stress_reader_t* r = arg;
+    char path[64];
+    snprintf(path, sizeof(path), "bench_stress_%d.arrow", r->id);
+    while (!__atomic_load_n(&stress_stop, __ATOMIC_RELAXED)) {
+        store_snapshot_t snap;
+        store_iter_t it;
+        const sensor_data_t* span;
+        size_t n, k = 0;
+        time_t expect = 0;
+        store_read_begin(&snap);
+        store_iter_snapshot(&it, &snap, snap.first, snap.end);
+        while ((n = store_iter_span(&it, &span)) > 0) {
+            for (size_t i = 0; i < n; i++, k++) {
+                if (k == 0) expect = span[i].timestamp;
+                if (span[i].timestamp != expect + (time_t)k ||
+                    span[i].sensor_id != 1 + (int)((span[i].timestamp - STRESS_BASE) % MAX_SENSORS))
+                    r->errors++;
+            }
+        }
+        if (k != snap.end - snap.first) r->errors++;
+        store_read_end(&snap);
+        r->snapshots++;
+
+        if (export_to_arrow(path) == 0) r->exports++;
+    }
+    unlink(path);
+    return NULL;
+}
+
+static void b_stress(size_t n, void* ctx) {
+    int nreaders = *(int*)ctx;
+    stress_reader_t readers[8];
+    clear_all_data();
+    __atomic_store_n(&stress_stop, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < nreaders; i++) {
+        readers[i] = (stress_reader_t){ .id = i };
+        pthread_create(&readers[i].thread, NULL, stress_reader, &readers[i]);
+    }
+
+    static size_t next;     // timestamp tiếp tục tăng giữa các lần chạy
+    sensor_data_t batch[100];
+    for (size_t i = 0; i < n; i += 100) {
+        size_t k = n - i < 100 ? n - i : 100;
+        for (size_t j = 0; j < k; j++, next++) {
+            batch[j] = (sensor_data_t){ .timestamp = STRESS_BASE + (time_t)next,
+                                        .temperature = 25.0f, .humidity = 60.0f, .gas_level = 200.0f,
+                                        .sensor_id = 1 + (int)(next % MAX_SENSORS), .quality = 100 };
+        }
+        ingest_records(batch, k);
+        if (next % 65536 < 100 && next > STRESS_WINDOW)
+            delete_data_before(STRESS_BASE + (time_t)(next - STRESS_WINDOW));
+    }
+
+    __atomic_store_n(&stress_stop, 1, __ATOMIC_RELAXED);
+    unsigned long snaps = 0, exports = 0, errors = 0;
+    for (int i = 0; i < nreaders; i++) {
+        pthread_join(readers[i].thread, NULL);
+        snaps += readers[i].snapshots;
+        exports += readers[i].exports;
+        errors += readers[i].errors;
+    }
+    if (nreaders > 0)
+        fprintf(stderr, "  [%d readers: %lu snapshots, %lu exports, %lu errors]\n",
+                nreaders, snaps, exports, errors);
+    if (errors > 0)
+        fprintf(stderr, "  STRESS FAILED: readers saw inconsistent data\n");
+}
+
+/* Client query server: gửi request, đọc hết các khung trả về (dữ liệu bỏ
+ * đi). Trả về số phần tử nhận được, -1 nếu lỗi. */
+#define BENCH_QUERY_SOCKET "bench_query.sock"
+
+static int query_connect(void) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", BENCH_QUERY_SOCKET);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static long query_call(int fd, const query_request_t* req) {
+    static __thread char sink[1 << 16];
+    if (write_full(fd, req, sizeof(*req)) != (ssize_t)sizeof(*req)) return -1;
+    long items = 0;
+    for (;;) {
+        query_response_t h;
+        if (recv(fd, &h, sizeof(h), MSG_WAITALL) != (ssize_t)sizeof(h) ||
+            h.magic != QUERY_MAGIC || h.status != QUERY_OK) return -1;
+        size_t left = h.count * h.item_size;
+        while (left > 0) {
+            ssize_t r = recv(fd, sink, left < sizeof(sink) ? left : sizeof(sink), 0);
+            if (r <= 0) return -1;
+            left -= (size_t)r;
+        }
+        items += (long)h.count;
+        if (!(h.flags & QUERY_MORE)) return items;
+    }
+}
+
+static int query_fd = -1;
+
+// ctx = request; n = số bản ghi store phải quét (RANGE: số bản ghi phải nhận)
+static void b_query_scan(size_t n, void* ctx) {
+    const query_request_t* req = ctx;
+    long got = query_call(query_fd, req);
+    if (got < 0 || (req->op == QUERY_RANGE && n > 1000 && got != (long)n))
+        fprintf(stderr, "  QUERY FAILED: op %u returned %ld items\n", req->op, got);
+}
+
+static void b_query_latest(size_t n, void* ctx) {
+    (void)ctx;
+    query_request_t req = { .magic = QUERY_MAGIC, .op = QUERY_LATEST, .sensor_id = 1 };
+    for (size_t i = 0; i < n; i++) {
+        if (query_call(query_fd, &req) != 1) {
+            fprintf(stderr, "  QUERY FAILED: latest\n");
+            return;
+        }
+    }
+}
+
+typedef struct {
+    pthread_t thread;
+    size_t requests;
+    long errors;
+} query_worker_t;
+
+static void* query_worker(void* arg) {
+    query_worker_t* w = arg;
+    int fd = query_connect();
+    query_request_t req = { .magic = QUERY_MAGIC, .op = QUERY_LATEST, .sensor_id = 1 };
+    for (size_t i = 0; i < w->requests; i++) {
+        if (fd < 0 || query_call(fd, &req) != 1) w->errors++;
+    }
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+// n request chia đều cho ctx client, mỗi client một kết nối và một luồng
+static void b_query_latest_clients(size_t n, void* ctx) {
+    int clients = *(int*)ctx;
+    query_worker_t workers[16];
+    for (int i = 0; i < clients; i++) {
+        workers[i] = (query_worker_t){ .requests = n / (size_t)clients };
+        pthread_create(&workers[i].thread, NULL, query_worker, &workers[i]);
+    }
+    long errors = 0;
+    for (int i = 0; i < clients; i++) {
+        pthread_join(workers[i].thread, NULL);
+        errors += workers[i].errors;
+    }
+    if (errors > 0)
+        fprintf(stderr, "  QUERY FAILED: %ld latest requests\n", errors);
+}
+
+/* Biểu đồ 24 giờ, 60 cột, kết thúc ở bản ghi mới nhất (như chart.c) */
+static int chart_24h(void) {
+    const cache_bucket_t* buckets;
+    time_t newest = store_at(store_end() - 1)->timestamp;
+    return cache_series(SENSOR_ID_ALL, newest + 1 - 86400, newest + 1, 1440, &buckets);
+}
+
+static void b_cache_cold(size_t n, void* ctx) {
+    (void)ctx;
+    for (size_t i = 0; i < n; i++) {
+        cache_invalidate();
+        chart_24h();
+    }
+}
+
+static void b_cache_hit(size_t n, void* ctx) {
+    (void)ctx;
+    for (size_t i = 0; i < n; i++)
+        chart_24h();
+}
+
+// Mỗi lần làm mới có thêm 10 bản ghi (1 giây dữ liệu của 10 sensor)
+static void b_cache_tail(size_t n, void* ctx) {
+    (void)ctx;
+    time_t next = store_at(store_end() - 1)->timestamp + 1;
+    for (size_t i = 0; i < n; i++, next++) {
+        for (int k = 0; k < 10; k++) {
+            sensor_data_t d = { .timestamp = next, .temperature = 25.0f, .humidity = 60.0f,
+                                .gas_level = 200.0f, .sensor_id = 1 + k, .quality = 100 };
+            store_append(&d);
+        }
+        chart_24h();
+    }
+}
+
+/* Sao lưu: journal + snapshot thật trên đĩa. Thư mục đích dùng lại giữa
+ * các lần chạy của bản gia tăng, bị xóa trước mỗi lần của bản đầy đủ. */
+#define BENCH_BACKUP_DIR "bench_backup"
+
+static void remove_dir(const char* dir) {
+    DIR* d = opendir(dir);
+    if (!d) return;
+    struct dirent* de;
+    char path[512];
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        unlink(path);
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+static time_t backup_next;
+
+static void ingest_journaled(size_t n) {
+    sensor_data_t batch[100];
+    for (size_t i = 0; i < n; i += 100) {
+        size_t k = n - i < 100 ? n - i : 100;
+        for (size_t j = 0; j < k; j++, backup_next++)
+            batch[j] = (sensor_data_t){ .timestamp = backup_next,
+                                        .temperature = 25.0f, .humidity = 60.0f, .gas_level = 200.0f,
+                                        .sensor_id = 1 + (int)(backup_next % MAX_SENSORS), .quality = 100 };
+        ingest_records(batch, k);
+    }
+    journal_commit();
+}
+
+static void b_backup_full(size_t n, void* ctx) {
+    (void)n; (void)ctx;
+    remove_dir(BENCH_BACKUP_DIR);
+    if (backup_data(BENCH_BACKUP_DIR) < 0)
+        fprintf(stderr, "  BACKUP FAILED\n");
+}
+
+// n bản ghi mới mỗi lần, rồi sao lưu vào thư mục đã có bản trước
+static void b_backup_incremental(size_t n, void* ctx) {
+    (void)ctx;
+    ingest_journaled(n);
+    if (backup_data(BENCH_BACKUP_DIR) < 0)
+        fprintf(stderr, "  BACKUP FAILED\n");
+}
+
+/* ctx = số bản ghi trong bản sao lưu. Lần làm nóng (n bị giới hạn 1000)
+ * vẫn khôi phục toàn bộ nên chỉ kiểm tra lỗi, không so số bản ghi. */
+static void b_restore(size_t n, void* ctx) {
+    size_t expected = *(size_t*)ctx;
+    int records = restore_data(BENCH_BACKUP_DIR);
+    if (records < 0 || (n == expected && records != (int)expected))
+        fprintf(stderr, "  RESTORE FAILED (%d / %zu)\n", records, expected);
+}
+
+/* Ingest có journal trong khi một luồng khác sao lưu gia tăng mỗi 10 ms
+ * (ctx = 1) hoặc không (ctx = 0): hai con số cho thấy ảnh hưởng của backup */
+static int backup_stop;
+
+static void* backup_loop(void* arg) {
+    unsigned long* count = arg;
+    while (!__atomic_load_n(&backup_stop, __ATOMIC_RELAXED)) {
+        if (backup_data(BENCH_BACKUP_DIR) >= 0) (*count)++;
+        usleep(10000);
+    }
+    return NULL;
+}
+
+static void b_ingest_backup(size_t n, void* ctx) {
+    int with_backup = *(int*)ctx;
+    pthread_t thread;
+    unsigned long backups = 0;
+    __atomic_store_n(&backup_stop, 0, __ATOMIC_RELAXED);
+    if (with_backup) pthread_create(&thread, NULL, backup_loop, &backups);
+    ingest_journaled(n);
+    if (with_backup) {
+        __atomic_store_n(&backup_stop, 1, __ATOMIC_RELAXED);
+        pthread_join(thread, NULL);
+        fprintf(stderr, "  [%lu backups during ingest]\n", backups);
+    }
+}
+
+static void b_data_log(size_t n, void* ctx) {
+    (void)ctx;
+    SensorData sd = { .ts = 1700000000, .temperature = 25.0f, .humidity = 60.0f, .gas_ppm = 200, .sensor_id = 1 };
+    for (size_t i = 0; i < n; i++) {
+        sd.ts++;
+        data_log_append(&sd);
+    }
+}
+
+
+/* =====================================
+ * MACROBENCHMARK: INGEST → THỐNG KÊ → EXPORT
+ * ===================================== */
+
+static void b_ingest(size_t n, void* ctx) {
+    (void)ctx;
+    store_clear();
+    time_t base = 1700000000;
+    for (size_t i = 0; i < n; i++) {
+        SensorData sd;
+        if (parse_sensor_data(lines[i % LINE_POOL], &sd) != 0) continue;
+        sensor_data_t d = { .timestamp = base + (time_t)i, .temperature = sd.temperature,
+                            .humidity = sd.humidity, .gas_level = (float)sd.gas_ppm,
+                            .sensor_id = 1 + (int)(i % MAX_SENSORS), .quality = 100 };
+        store_append(&d);
+    }
+}
+
+static void b_full_pipeline(size_t n, void* ctx) {
+    b_ingest(n, ctx);
+    calculate_statistics();
+    export_to_csv("bench_export.csv");
+}
+
+
+/* =====================================
+ * XUẤT JSON
+ * ===================================== */
+
+static void write_json(FILE* out) {
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+    fprintf(out, "{\n  \"suite\": \"smart-station-bench\",\n  \"schema\": 1,\n");
+    fprintf(out, "  \"date\": \"%s\",\n  \"reps\": %d,\n  \"results\": [\n", date, reps);
+    for (int i = 0; i < n_results; i++) {
+        const bench_result_t* r = &results[i];
+        fprintf(out,
+            "    {\"name\": \"%s\", \"kind\": \"%s\", \"records\": %zu, \"unit\": \"ns/op\", "
+            "\"median\": %.3f, \"min\": %.3f, \"max\": %.3f, \"ops_per_sec\": %.0f}%s\n",
+            r->name, r->kind, r->records, r->median, r->min, r->max,
+            r->median > 0 ? 1e9 / r->median : 0.0, i + 1 < n_results ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+    const char* out_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) max_records = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out_path = argv[++i];
+        else {
+            fprintf(stderr, "Usage: bench [--reps R] [--max N] [--filter NAME] [-o results.json]\n");
+            return 2;
+        }
+    }
+    if (reps < 1) reps = 1;
+
+    FILE* out = stdout;
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        perror(out_path);
+        return 1;
+    }
+
+    char tmpdir[] = "/tmp/ssbench.XXXXXX";
+    if (!mkdtemp(tmpdir) || chdir(tmpdir) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+    devnull_fp = fopen("/dev/null", "w");
+    init_line_pool();
+
+    /* ----- Micro ----- */
+    run_bench("parse_sensor_data", "micro", reps, 1000000, b_parse, NULL);
+    run_bench("frame_decoder", "micro", reps, 1000000, b_frame_decoder, NULL);
+    run_bench("write_full_pipe", "micro", reps, 200000, b_write_full, NULL);
+    int all_valid = 0, one_in_100 = 100;
+    run_bench("validate_records_1M", "micro", reps, 1000000, b_validate, &all_valid);
+    run_bench("validate_records_1M_1pct_invalid", "micro", reps, 1000000, b_validate, &one_in_100);
+    int one_source = 1, four_sources = 4;
+    run_bench("reorder_ingest_1_source_1M", "micro", reps, 1000000, b_reorder, &one_source);
+    run_bench("reorder_ingest_4_sources_1M", "micro", reps, 1000000, b_reorder, &four_sources);
+    run_bench("ingest_records_1M", "micro", reps, 1000000, b_ingest_direct, NULL);
+
+    fill_store(1000000);
+    run_bench("calculate_statistics_at_1M_records", "micro", reps, 100000, b_stats_calls, NULL);
+
+    size_t chart_len = 1000;
+    chart_data = calloc(chart_len, sizeof(SensorData));
+    for (size_t i = 0; i < chart_len; i++) {
+        chart_data[i].ts = 1700000000 + (time_t)i;
+        chart_data[i].temperature = 20.0f + (float)(i % 150) * 0.1f;
+        chart_data[i].humidity = 50.0f + (float)(i % 300) * 0.1f;
+        chart_data[i].gas_ppm = 200 + (int)(i % 100);
+    }
+    run_bench("ui_chart_temp_humid_1K", "micro", reps, 1000, b_chart, &chart_len);
+    run_bench("ui_stats_hand_1K", "micro", reps, 1000000, b_ui_stats_hand, &chart_len);
+    run_bench("ui_stats_layout_1K", "micro", reps, 1000000, b_ui_stats_layout, &chart_len);
+    run_bench("ui_stats_extractor_1K", "micro", reps, 1000000, b_ui_stats_extractor, &chart_len);
+
+    fill_store(100000);
+    run_bench("export_to_csv_100K", "micro", reps, 100000, b_export_csv, NULL);
+    run_bench("export_to_arrow_100K", "micro", reps, 100000, b_export_arrow, NULL);
+    if (selected("export_to_arrow_100K")) arrow_check("bench_export.arrow", store_size());
+    run_bench("system_log_append", "micro", reps, 20000, b_system_log, NULL);
+    run_bench("data_log_append", "micro", reps, 20000, b_data_log, NULL);
+    run_bench("sensor_dir_assess", "micro", reps, 1000000, b_anomaly, NULL);
+
+    if (journal_open(0) >= 0) {
+        int group = JOURNAL_COMMIT_RECORDS, each = 1;
+        run_bench("journal_append_group_commit", "micro", reps, 200000, b_journal, &group);
+        run_bench("journal_append_sync_each_batch", "micro", reps, 20000, b_journal, &each);
+        journal_close();
+        system_config.journal_commit_records = JOURNAL_COMMIT_RECORDS;
+        system_config.journal_commit_ms = JOURNAL_COMMIT_MS;
+    }
+
+    fill_store(1000000);
+    run_bench("startup_dir_rebuild_1M", "micro", reps, 1000000, b_dir_rebuild, NULL);
+    run_bench("snapshot_save_1M", "micro", reps, 1000000, b_snapshot_save, NULL);
+    run_bench("startup_snapshot_load_1M", "micro", reps, 1000000, b_snapshot_load, NULL);
+
+    if (query_serve(BENCH_QUERY_SOCKET) == 0 && (query_fd = query_connect()) >= 0) {
+        query_request_t range = { .magic = QUERY_MAGIC, .op = QUERY_RANGE, .sensor_id = SENSOR_ID_ALL };
+        query_request_t aggregate = { .magic = QUERY_MAGIC, .op = QUERY_AGGREGATE, .sensor_id = SENSOR_ID_ALL };
+        query_request_t rollup = { .magic = QUERY_MAGIC, .op = QUERY_ROLLUP, .sensor_id = SENSOR_ID_ALL,
+                                   .resolution = 3600 };
+        int one = 1, sixteen = 16;
+        snapshot_discard();
+        run_bench("query_range_copy_1M", "micro", reps, 1000000, b_query_scan, &range);
+        snapshot_save();
+        run_bench("query_range_sendfile_1M", "micro", reps, 1000000, b_query_scan, &range);
+        run_bench("query_aggregate_1M", "micro", reps, 1000000, b_query_scan, &aggregate);
+        run_bench("query_rollup_1h_1M", "micro", reps, 1000000, b_query_scan, &rollup);
+        run_bench("query_latest", "micro", reps, 100000, b_query_latest, NULL);
+        run_bench("query_latest_1_client", "micro", reps, 100000, b_query_latest_clients, &one);
+        run_bench("query_latest_16_clients", "micro", reps, 100000, b_query_latest_clients, &sixteen);
+        close(query_fd);
+        query_stop();
+    }
+
+    run_bench("cache_chart_24h_cold", "micro", reps, 100, b_cache_cold, NULL);
+    run_bench("cache_chart_24h_hit", "micro", reps, 1000000, b_cache_hit, NULL);
+    run_bench("cache_chart_24h_tail", "micro", reps, 100000, b_cache_tail, NULL);
+
+    clear_all_data();       // đồng thời mở một journal rỗng
+    {
+        int without = 0, with = 1;
+        backup_next = 1700000000;
+        ingest_journaled(1000000);
+        snapshot_save();
+        ingest_journaled(100000);
+        run_bench("backup_full_1M", "micro", reps, 1100000, b_backup_full, NULL);
+        run_bench("backup_incremental_10K", "micro", reps, 10000, b_backup_incremental, NULL);
+        run_bench("ingest_journal_200K", "micro", reps, 200000, b_ingest_backup, &without);
+        run_bench("ingest_journal_200K_during_backup", "micro", reps, 200000, b_ingest_backup, &with);
+        size_t restored = store_size();
+        backup_data(BENCH_BACKUP_DIR);
+        run_bench("restore_1M", "micro", reps, restored, b_restore, &restored);
+        remove_dir(BENCH_BACKUP_DIR);
+    }
+    fill_store(1000000);
+
+    int readers0 = 0, readers2 = 2, readers4 = 4;
+    run_bench("stress_ingest_0_readers", "macro", reps, 2000000, b_stress, &readers0);
+    run_bench("stress_ingest_2_readers", "macro", reps, 2000000, b_stress, &readers2);
+    run_bench("stress_ingest_4_readers", "macro", reps, 2000000, b_stress, &readers4);
+
+    /* ----- Macro ----- */
+    for (size_t n = 1000; n <= max_records; n *= 10) {
+        char name[64];
+        int runs = n <= 100000 ? reps : 1;
+        snprintf(name, sizeof(name), "e2e_ingest_%zu", n);
+        run_bench(name, "macro", runs, n, b_ingest, NULL);
+        snprintf(name, sizeof(name), "e2e_statistics_%zu", n);
+        run_bench(name, "macro", runs, n, b_stats, NULL);
+        snprintf(name, sizeof(name), "e2e_export_csv_%zu", n);
+        run_bench(name, "macro", runs, n, b_export_csv, NULL);
+        snprintf(name, sizeof(name), "e2e_pipeline_%zu", n);
+        run_bench(name, "macro", runs, n, b_full_pipeline, NULL);
+    }
+
+    write_json(out);
+    if (out != stdout) fclose(out);
+
+    store_clear();
+    unlink("bench_export.csv");
+    unlink("bench_export.arrow");
+    unlink(SNAPSHOT_FILE);
+    unlink(SYSTEM_LOG_FILE);
+    unlink(DATA_LOG_FILE);
+    DIR* jdir = opendir(JOURNAL_DIR);
+    if (jdir) {
+        struct dirent* de;
+        char path[512];
+        while ((de = readdir(jdir)) != NULL) {
+            if (de->d_name[0] == '.') continue;
+            snprintf(path, sizeof(path), "%s/%s", JOURNAL_DIR, de->d_name);
+            unlink(path);
+        }
+        closedir(jdir);
+        rmdir(JOURNAL_DIR);
+    }
+    if (chdir("/") == 0) rmdir(tmpdir);
+    free(chart_data);
+    return 0;
+}
@@ -0,0 +1,342 @@
+#include "system.h"
+#include "metrics.h"
+
+#include <math.h>
+
+// ============================================================================
+// RESULT CACHE
+// ============================================================================
+//
+// Charts and windowed statistics are asked for again and again with the
+// same window. Each result is kept as a series of fixed-width buckets
+// (count, min, max, sum per field) keyed by (kind, sensor, window,
+// resolution), together with the append watermark: the store_end() the
+// buckets include. A later lookup
+//
+//   - returns the stored result as is if nothing was appended (a hit),
+//   - adds only the records in [watermark, store_end()) otherwise,
+//   - starts from an entry for an earlier window of the same length when
+//     the window has slid by a few buckets: the overlap is kept, only the
+//     new buckets are filled,
+//   - recomputes from the store when records inside the window have been
+//     trimmed or cleared (store_first() moved past the window's first
+//     record), since min/max cannot be taken back.
+//
+// The part of a window before tier_floor() comes from the compacted tiers
+// (tier.c): each per-minute or per-hour row is merged into the bucket its
+// start falls in, so buckets narrower than a row are only as fine as the
+// tier.
+//
+// Windows are aligned to the resolution so a key stays the same for a
+// whole bucket. The store is read in place: the cache runs on the ingest
+// thread, like the sensor directory it takes percentiles from.
+
+#define CACHE_ENTRIES       16
+#define CACHE_MAX_BUCKETS   4096
+#define CACHE_FIELDS        SENSOR_FIELD_COUNT
+#define CACHE_TIER_ROWS     256     // tier rows read at a time
+
+typedef enum {
+    CACHE_SERIES = 1,
+    CACHE_STATS
+} cache_kind_t;
+
+typedef struct cache_entry {
+    int kind;                   // 0 = free
+    int sensor_id;
+    time_t from, to;            // aligned window [from, to)
+    int resolution;
+
+    size_t lo;                  // first record of the window when computed
+    size_t watermark;           // records below this are in the buckets
+    time_t first_ts, last_ts;   // oldest/newest timestamp in the window
+    unsigned long used;         // LRU clock
+    int nbuckets, cap;
+    cache_bucket_t *buckets;
+
+    int stats_valid;            // `stats` matches the buckets
+    statistics_t stats;
+} cache_entry_t;
+
+static cache_entry_t entries[CACHE_ENTRIES];
+static unsigned long use_clock = 0;
+
+// First index with timestamp >= ts (records are time-ordered)
+static size_t lower_bound(time_t ts) {
+    size_t lo = store_first(), hi = store_end();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (store_at(mid)->timestamp < ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void bucket_reset(cache_bucket_t *b, time_t start) {
+    b->start = start;
+    b->count = 0;
+    for (int f = 0; f < CACHE_FIELDS; f++) {
+        b->min[f] = INFINITY;
+        b->max[f] = -INFINITY;
+        b->sum[f] = 0;
+    }
+}
+
+// Adds records [from, to) that fall inside the window
+static void scan(cache_entry_t *e, size_t from, size_t to) {
+    store_iter_t it;
+    const sensor_data_t *span;
+    size_t n;
+    store_iter_init(&it, from, to);
+    while ((n = store_iter_span(&it, &span)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            const sensor_data_t *d = &span[i];
+            if (d->timestamp < e->from || d->timestamp >= e->to ||
+                (e->sensor_id != SENSOR_ID_ALL && d->sensor_id != e->sensor_id)) {
+                continue;
+            }
+            cache_bucket_t *b = &e->buckets[(d->timestamp - e->from) / e->resolution];
+            for (int f = 0; f < CACHE_FIELDS; f++) {
+                float v = d->values[f];
+                if (v < b->min[f]) b->min[f] = v;
+                if (v > b->max[f]) b->max[f] = v;
+                b->sum[f] += v;
+            }
+            b->count++;
+            if (e->first_ts == 0 || d->timestamp < e->first_ts) e->first_ts = d->timestamp;
+            if (d->timestamp > e->last_ts) e->last_ts = d->timestamp;
+        }
+    }
+    e->watermark = store_end();
+    e->stats_valid = 0;
+}
+
+// Adds the tier rows with start in [from, to), below the floor
+static void scan_tiers(cache_entry_t *e, time_t from, time_t to) {
+    if (from >= tier_floor()) {
+        return;
+    }
+    tier_cursor_t cur;
+    tier_row_t rows[CACHE_TIER_ROWS];
+    size_t n;
+    tier_cursor_open(&cur, e->sensor_id, from, to);
+    while ((n = tier_cursor_next(&cur, rows, CACHE_TIER_ROWS)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            const tier_row_t *r = &rows[i];
+            cache_bucket_t *b = &e->buckets[((time_t)r->start - e->from) / e->resolution];
+            for (int f = 0; f < CACHE_FIELDS; f++) {
+                if (r->min[f] < b->min[f]) b->min[f] = r->min[f];
+                if (r->max[f] > b->max[f]) b->max[f] = r->max[f];
+                b->sum[f] += (double)r->avg[f] * r->count;
+            }
+            b->count += r->count;
+            if (e->first_ts == 0 || r->start < e->first_ts) e->first_ts = (time_t)r->start;
+            if (r->start > e->last_ts) e->last_ts = (time_t)r->start;
+        }
+    }
+    tier_cursor_close(&cur);
+}
+
+// Fills e (key already set) from the tiers and the store
+static void compute(cache_entry_t *e) {
+    for (int k = 0; k < e->nbuckets; k++) {
+        bucket_reset(&e->buckets[k], e->from + (time_t)k * e->resolution);
+    }
+    e->first_ts = e->last_ts = 0;
+    scan_tiers(e, e->from, e->to);
+    e->lo = lower_bound(e->from);
+    scan(e, e->lo, lower_bound(e->to));     // the rest is past the window
+}
+
+// Moves entry `e` forward to window [from, to) of the same length, keeping
+// the buckets the two windows share. Only records that could not have been
+// counted before are scanned: those appended since, and those at or after
+// the old window's end.
+static void slide(cache_entry_t *e, time_t from, time_t to) {
+    int shift = (int)((from - e->from) / e->resolution);
+    memmove(e->buckets, e->buckets + shift, (size_t)(e->nbuckets - shift) * sizeof(cache_bucket_t));
+    for (int k = e->nbuckets - shift; k < e->nbuckets; k++) {
+        bucket_reset(&e->buckets[k], from + (time_t)k * e->resolution);
+    }
+    if (e->first_ts < from) {
+        e->first_ts = 0;
+        for (int k = 0; k < e->nbuckets - shift; k++) {
+            if (e->buckets[k].count > 0) {
+                e->first_ts = e->buckets[k].start;  // bucket precision from here on
+                break;
+            }
+        }
+    }
+    if (e->last_ts < from) e->last_ts = 0;
+    size_t old_end = lower_bound(e->to);
+    time_t old_to = e->to;
+    e->from = from;
+    e->to = to;
+    scan_tiers(e, old_to, to);
+    e->lo = lower_bound(from);
+    scan(e, old_end < e->watermark ? old_end : e->watermark, store_end());
+}
+
+static cache_entry_t* lookup(int kind, int sensor_id, time_t from, time_t to, int resolution) {
+    int nbuckets = (int)((to - from) / resolution);
+    cache_entry_t *hit = NULL, *older = NULL, *victim = &entries[0];
+    for (int i = 0; i < CACHE_ENTRIES; i++) {
+        cache_entry_t *e = &entries[i];
+        if (e->kind == kind && e->sensor_id == sensor_id && e->resolution == resolution &&
+            e->nbuckets == nbuckets) {
+            int fresh = store_first() <= e->lo;
+            if (e->from == from) {
+                if (fresh) {
+                    hit = e;
+                } else {
+                    victim = e;     // recompute in place
+                    older = NULL;
+                }
+                break;
+            }
+            if (fresh && e->from < from && from < e->to && (!older || e->from > older->from)) {
+                older = e;
+            }
+        }
+        if (!e->kind || (victim->kind && e->used < victim->used)) {
+            victim = e;
+        }
+    }
+    use_clock++;
+
+    if (hit) {
+        if (hit->watermark == store_end()) {
+            METRIC_INC(METRIC_CACHE_HITS);
+        } else {
+            METRIC_INC(METRIC_CACHE_TAIL_UPDATES);
+            scan(hit, hit->watermark, store_end());
+        }
+        hit->used = use_clock;
+        return hit;
+    }
+    if (older) {
+        METRIC_INC(METRIC_CACHE_TAIL_UPDATES);
+        slide(older, from, to);
+        older->used = use_clock;
+        return older;
+    }
+
+    METRIC_INC(METRIC_CACHE_MISSES);
+    cache_entry_t *e = victim;
+    if (e->cap < nbuckets) {
+        cache_bucket_t *b = realloc(e->buckets, (size_t)nbuckets * sizeof(cache_bucket_t));
+        if (!b) {
+            return NULL;
+        }
+        e->buckets = b;
+        e->cap = nbuckets;
+    }
+    e->kind = kind;
+    e->sensor_id = sensor_id;
+    e->from = from;
+    e->to = to;
+    e->resolution = resolution;
+    e->nbuckets = nbuckets;
+    e->used = use_clock;
+    compute(e);
+    return e;
+}
+
+// Aligns [from, to) outward to the resolution; -1 if the window is empty
+// or needs more than CACHE_MAX_BUCKETS buckets
+static int align_window(time_t *from, time_t *to, int resolution) {
+    if (resolution <= 0 || *to <= *from) {
+        return -1;
+    }
+    time_t r = resolution;
+    *from -= ((*from % r) + r) % r;
+    *to += (r - ((*to % r) + r) % r) % r;
+    return (*to - *from) / r <= CACHE_MAX_BUCKETS ? 0 : -1;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+// Buckets of `resolution` seconds covering [from, to), oldest first. The
+// array stays valid until the next cache call. Returns the bucket count,
+// -1 on a bad window or out of memory.
+int cache_series(int sensor_id, time_t from, time_t to, int resolution,
+                 const cache_bucket_t **buckets) {
+    if (align_window(&from, &to, resolution) != 0) {
+        return -1;
+    }
+    cache_entry_t *e = lookup(CACHE_SERIES, sensor_id, from, to, resolution);
+    if (!e) {
+        return -1;
+    }
+    *buckets = e->buckets;
+    return e->nbuckets;
+}
+
+// Statistics over [from, to), to `resolution` precision: a sliding window
+// drops whole buckets. Percentiles come from the directory's hourly
+// sketches overlapping the window. Returns the record count, -1 on error.
+int cache_statistics(int sensor_id, time_t from, time_t to, int resolution, statistics_t *out) {
+    if (align_window(&from, &to, resolution) != 0) {
+        return -1;
+    }
+    cache_entry_t *e = lookup(CACHE_STATS, sensor_id, from, to, resolution);
+    if (!e) {
+        return -1;
+    }
+    if (e->stats_valid) {
+        *out = e->stats;
+        return e->stats.total_records;
+    }
+
+    unsigned long count = 0;
+    float min[CACHE_FIELDS], max[CACHE_FIELDS];
+    double sum[CACHE_FIELDS];
+    for (int f = 0; f < CACHE_FIELDS; f++) {
+        min[f] = INFINITY;
+        max[f] = -INFINITY;
+        sum[f] = 0;
+    }
+    for (int k = 0; k < e->nbuckets; k++) {
+        const cache_bucket_t *b = &e->buckets[k];
+        if (b->count == 0) continue;
+        count += b->count;
+        for (int f = 0; f < CACHE_FIELDS; f++) {
+            if (b->min[f] < min[f]) min[f] = b->min[f];
+            if (b->max[f] > max[f]) max[f] = b->max[f];
+            sum[f] += b->sum[f];
+        }
+    }
+
+    statistics_t *st = &e->stats;
+    memset(st, 0, sizeof(*st));
+    st->total_records = (int)count;
+    if (count > 0) {
+        for (int f = 0; f < CACHE_FIELDS; f++) {
+            percentiles_t p;
+            get_percentiles(f + 1, sensor_id, e->from, e->to, &p);
+            st->min[f] = min[f];
+            st->max[f] = max[f];
+            st->avg[f] = (float)(sum[f] / (double)count);
+            st->p50[f] = p.p50;
+            st->p95[f] = p.p95;
+            st->p99[f] = p.p99;
+        }
+        st->first_record = e->first_ts;
+        st->last_record = e->last_ts;
+    }
+    e->stats_valid = 1;
+    *out = *st;
+    return (int)count;
+}
+
+// Drops every cached result (the store was replaced wholesale)
+void cache_invalidate(void) {
+    for (int i = 0; i < CACHE_ENTRIES; i++) {
+        entries[i].kind = 0;
+    }
+}
@@ -0,0 +1,137 @@
+#include "system.h"
+
+// ============================================================================
+// ASCII CHARTS
+// ============================================================================
+//
+// One column per time bucket, plotting the bucket average of one field for
+// all sensors. The buckets come from the result cache, so redrawing the
+// same chart only scans the records appended since the last draw.
+//
+// The window ends at the newest record (like the hourly section of the
+// report), so a station that has stopped reporting still shows its last
+// day of data.
+
+#define CHART_WIDTH         60      // buckets per chart
+#define CHART_HEIGHT        15
+#define CHART_MAX_WIDTH     200
+#define CHART_LABEL_WIDTH   9
+
+// Horizontal rule above and below a plot `width` columns wide
+void draw_chart_border(int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    printf("%*s +", CHART_LABEL_WIDTH, "");
+    for (int x = 0; x < width; x++) putchar('-');
+    printf("+\n");
+}
+
+// Plot rows, top to bottom. A point with quality 0 is a bucket without data
+// and leaves its column empty.
+void draw_data_line(chart_data_t *chart) {
+    float range = chart->max_value - chart->min_value;
+    int rows[CHART_MAX_WIDTH];
+    int n = chart->num_points < chart->width ? chart->num_points : chart->width;
+    int field = sensor_field_by_key(chart->data_type);
+    int f = field ? field - 1 : 0;
+
+    for (int i = 0; i < n; i++) {
+        const sensor_data_t *p = &chart->data_points[i];
+        if (p->quality == 0) {
+            rows[i] = -1;
+            continue;
+        }
+        float v = (p->values[f] - chart->min_value) / range;
+        rows[i] = (int)(v * (float)(chart->height - 1) + 0.5f);
+    }
+
+    for (int r = chart->height - 1; r >= 0; r--) {
+        if (r == chart->height - 1 || r == 0 || r == (chart->height - 1) / 2) {
+            float label = chart->min_value + range * (float)r / (float)(chart->height - 1);
+            printf("%*.1f |", CHART_LABEL_WIDTH, label);
+        } else {
+            printf("%*s |", CHART_LABEL_WIDTH, "");
+        }
+        for (int i = 0; i < chart->width; i++) {
+            putchar(i < n && rows[i] == r ? '*' : ' ');
+        }
+        printf("|\n");
+    }
+}
+
+int create_ascii_chart(chart_data_t *chart) {
+    if (!chart || !chart->data_points || chart->num_points <= 0 ||
+        chart->width <= 0 || chart->width > CHART_MAX_WIDTH || chart->height < 2) {
+        return -1;
+    }
+    if (chart->max_value <= chart->min_value) {
+        chart->min_value -= 1.0f;       // flat line: center it
+        chart->max_value += 1.0f;
+    }
+
+    draw_chart_border(chart->width, chart->height);
+    draw_data_line(chart);
+    draw_chart_border(chart->width, chart->height);
+
+    char first[32], last[32];
+    struct tm tm_ts;
+    time_t ts = chart->data_points[0].timestamp;
+    localtime_r(&ts, &tm_ts);
+    strftime(first, sizeof(first), "%m-%d %H:%M", &tm_ts);
+    ts = chart->data_points[chart->num_points - 1].timestamp;
+    localtime_r(&ts, &tm_ts);
+    strftime(last, sizeof(last), "%m-%d %H:%M", &tm_ts);
+    printf("%*s  %-*s%s\n", CHART_LABEL_WIDTH, "",
+           chart->width - (int)strlen(last) > 0 ? chart->width - (int)strlen(last) : 1, first, last);
+    return 0;
+}
+
+// Average of one field (TEMPERATURE_SENSOR, ... or index + 1) per bucket
+// over the last `hours` of data
+int display_field_chart(int field, int hours) {
+    if (field < 1 || field > SENSOR_FIELD_COUNT) {
+        return -1;
+    }
+    if (hours <= 0) hours = 24;
+    if (store_size() == 0) {
+        printf("No data to chart.\n");
+        return 0;
+    }
+
+    time_t span = (time_t)hours * 3600;
+    int resolution = (int)((span + CHART_WIDTH - 1) / CHART_WIDTH);
+    time_t newest = store_at(store_end() - 1)->timestamp;
+    const cache_bucket_t *buckets;
+    int n = cache_series(SENSOR_ID_ALL, newest + 1 - span, newest + 1, resolution, &buckets);
+    if (n <= 0) {
+        return -1;
+    }
+
+    int f = field - 1;
+    sensor_data_t points[CHART_WIDTH + 1];
+    if (n > CHART_WIDTH + 1) n = CHART_WIDTH + 1;
+    chart_data_t chart = { .width = n, .height = CHART_HEIGHT, .data_type = sensor_fields[f].key,
+                           .data_points = points, .num_points = n };
+    int have = 0;
+    for (int i = 0; i < n; i++) {
+        const cache_bucket_t *b = &buckets[i];
+        float avg = b->count ? (float)(b->sum[f] / (double)b->count) : 0.0f;
+        memset(&points[i], 0, sizeof(points[i]));
+        points[i].timestamp = b->start;
+        points[i].values[f] = avg;
+        points[i].quality = b->count ? 100 : 0;
+        if (!b->count) continue;
+        if (!have || avg < chart.min_value) chart.min_value = avg;
+        if (!have || avg > chart.max_value) chart.max_value = avg;
+        have = 1;
+    }
+
+    printf("%s (%s), last %d hours of data, average per %d min\n\n",
+           sensor_fields[f].label, sensor_fields[f].unit, hours, (resolution + 59) / 60);
+    if (!have) {
+        printf("No data in this window.\n");
+        return 0;
+    }
+    return create_ascii_chart(&chart);
+}
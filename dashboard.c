@@ -0,0 +1,582 @@
+#include "system.h"
+#include "anomaly.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+
+// ============================================================================
+// LIVE DASHBOARD
+// ============================================================================
+//
+// Two sides that never wait for each other:
+//
+//   ingest side   dashboard_ingest() is called by ingest_records() with each
+//                 batch. It updates a private staging view (latest values,
+//                 per-tick sums) and, once a refresh period has ended,
+//                 closes the sparkline bucket and copies the view to
+//                 `published` if pthread_mutex_trylock succeeds. A busy
+//                 renderer only delays the copy to the next batch; ingest
+//                 never blocks.
+//
+//   render thread wakes at fixed absolute deadlines, copies `published`
+//                 under the lock, draws into a cell grid and sends only the
+//                 cells that differ from the previous frame, in one write().
+//
+// Ticks are numbered from dashboard_start() on the monotonic clock, and the
+// view carries how many have been closed. Ingest closes ticks only when
+// records arrive, so when the collectors go quiet the renderer closes the
+// missed ticks itself, as empty, on its copy: the sparklines keep moving
+// and the rate drops to zero. The bucket open when ingest went quiet shows
+// as empty until records arrive again.
+
+#define DASH_MAX_SENSORS    128
+#define DASH_SPARK_MAX      32      // sparkline length (refresh ticks)
+#define DASH_MAX_ALERTS     6
+#define DASH_MAX_ROWS       80
+#define DASH_MAX_COLS       200
+#define DASH_FIELDS         SENSOR_FIELD_COUNT
+
+typedef struct dash_sensor {
+    int sensor_id;
+    unsigned long count;
+    sensor_data_t last;
+    int anomaly;                            // anomaly_kind_t of the last record
+    float spark[DASH_FIELDS][DASH_SPARK_MAX];   // per-tick averages, NAN = no data
+} dash_sensor_t;
+
+typedef struct dash_alert {
+    time_t ts;
+    int sensor_id;
+    int kind;
+    sensor_data_t record;
+} dash_alert_t;
+
+typedef struct dash_view {
+    int sensor_count;
+    int spark_head;                         // next bucket to write (= oldest)
+    unsigned long total;
+    float rate;                             // records per second, last tick
+    uint64_t tick;                          // ticks closed = the open tick
+    int alert_count;
+    int alert_head;
+    dash_alert_t alerts[DASH_MAX_ALERTS];
+    dash_sensor_t sensors[DASH_MAX_SENSORS];
+} dash_view_t;
+
+// Ingest side (only touched by the thread calling ingest_records)
+static dash_view_t staged;
+static double tick_sum[DASH_MAX_SENSORS][DASH_FIELDS];
+static unsigned tick_n[DASH_MAX_SENSORS];
+static int16_t slot_of_id[SENSOR_ID_LIMIT];
+static unsigned long total_at_tick;
+static int publish_pending;
+
+// Shared
+static dash_view_t published;
+static pthread_mutex_t published_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t period_ns = 250000000;
+static uint64_t epoch_ns;                   // dashboard_start(): tick 0
+
+// Render thread
+static pthread_t render_thread;
+static volatile int render_running = 0;
+static volatile int dashboard_active = 0;
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t current_tick(void) {
+    return (mono_ns() - epoch_ns) / period_ns;
+}
+
+// Closes `count` ticks without data: one empty bucket each
+static void push_empty(dash_view_t *v, uint64_t count) {
+    if (count > DASH_SPARK_MAX) count = DASH_SPARK_MAX;
+    for (uint64_t k = 0; k < count; k++) {
+        for (int s = 0; s < v->sensor_count; s++) {
+            for (int f = 0; f < DASH_FIELDS; f++) v->sensors[s].spark[f][v->spark_head] = NAN;
+        }
+        v->spark_head = (v->spark_head + 1) % DASH_SPARK_MAX;
+    }
+}
+
+// ============================================================================
+// INGEST SIDE
+// ============================================================================
+
+static int dash_slot(int sensor_id) {
+    if (sensor_id < 0 || sensor_id >= SENSOR_ID_LIMIT) sensor_id = 0;
+    int s = slot_of_id[sensor_id];
+    if (s > 0) {
+        return s - 1;       // table stores slot + 1 so zero means unseen
+    }
+    if (staged.sensor_count >= DASH_MAX_SENSORS) {
+        return -1;
+    }
+    s = staged.sensor_count++;
+    dash_sensor_t *ds = &staged.sensors[s];
+    memset(ds, 0, sizeof(*ds));
+    ds->sensor_id = sensor_id;
+    for (int f = 0; f < DASH_FIELDS; f++) {
+        for (int i = 0; i < DASH_SPARK_MAX; i++) ds->spark[f][i] = NAN;
+    }
+    slot_of_id[sensor_id] = (int16_t)(s + 1);
+    return s;
+}
+
+// Close the open sparkline bucket, and an empty one for every tick since
+// without records, up to `tick`
+static void dash_tick(uint64_t tick) {
+    int head = staged.spark_head;
+    for (int s = 0; s < staged.sensor_count; s++) {
+        for (int f = 0; f < DASH_FIELDS; f++) {
+            staged.sensors[s].spark[f][head] =
+                tick_n[s] ? (float)(tick_sum[s][f] / tick_n[s]) : NAN;
+            tick_sum[s][f] = 0;
+        }
+        tick_n[s] = 0;
+    }
+    staged.spark_head = (head + 1) % DASH_SPARK_MAX;
+    uint64_t gap = tick - staged.tick;
+    push_empty(&staged, gap - 1);
+
+    // The last closed tick is the one with the records only if none was missed
+    staged.rate = gap == 1 ? (float)((double)(staged.total - total_at_tick) * 1e9 / (double)period_ns)
+                           : 0.0f;
+    total_at_tick = staged.total;
+    staged.tick = tick;
+    publish_pending = 1;
+}
+
+// Offer the view to the renderer; retried on the next batch if it is busy
+static void dash_publish(void) {
+    if (pthread_mutex_trylock(&published_lock) == 0) {
+        memcpy(&published, &staged, sizeof(published));
+        pthread_mutex_unlock(&published_lock);
+        publish_pending = 0;
+    }
+}
+
+void dashboard_ingest(const sensor_data_t *records, size_t count) {
+    if (!dashboard_active) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const sensor_data_t *d = &records[i];
+        int s = dash_slot(d->sensor_id);
+        if (s < 0) {
+            continue;
+        }
+        dash_sensor_t *ds = &staged.sensors[s];
+        int kind = anomaly_from_quality(d->quality);
+        if (kind != ANOMALY_NONE && ds->anomaly == ANOMALY_NONE) {
+            dash_alert_t *a = &staged.alerts[staged.alert_head];
+            a->ts = d->timestamp;
+            a->sensor_id = ds->sensor_id;
+            a->kind = kind;
+            a->record = *d;
+            staged.alert_head = (staged.alert_head + 1) % DASH_MAX_ALERTS;
+            if (staged.alert_count < DASH_MAX_ALERTS) staged.alert_count++;
+        }
+        ds->anomaly = kind;
+        ds->last = *d;
+        ds->count++;
+        for (int f = 0; f < DASH_FIELDS; f++) {
+            tick_sum[s][f] += d->values[f];
+        }
+        tick_n[s]++;
+    }
+    staged.total += count;
+
+    uint64_t tick = current_tick();
+    if (tick > staged.tick) {
+        dash_tick(tick);
+    }
+    if (publish_pending) {
+        dash_publish();
+    }
+}
+
+// ============================================================================
+// SCREEN BUFFER
+// ============================================================================
+
+enum { ATTR_NORMAL = 0, ATTR_BOLD, ATTR_DIM, ATTR_GREEN, ATTR_YELLOW, ATTR_RED };
+
+typedef struct cell {
+    uint32_t ch;        // Unicode code point
+    uint8_t attr;
+} cell_t;
+
+static cell_t screen_next[DASH_MAX_ROWS][DASH_MAX_COLS];
+static cell_t screen_prev[DASH_MAX_ROWS][DASH_MAX_COLS];
+static int screen_rows = 24, screen_cols = 80;
+static int screen_valid = 0;            // screen_prev matches the terminal
+
+static char out_buf[DASH_MAX_ROWS * DASH_MAX_COLS * 8];
+static size_t out_len;
+
+static void out_bytes(const char *p, size_t n) {
+    if (out_len + n <= sizeof(out_buf)) {
+        memcpy(out_buf + out_len, p, n);
+        out_len += n;
+    }
+}
+
+static void out_fmt(const char *fmt, ...) {
+    char tmp[64];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n > 0) out_bytes(tmp, (size_t)n < sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+}
+
+static void out_utf8(uint32_t cp) {
+    char b[4];
+    if (cp < 0x80) {
+        b[0] = (char)cp;
+        out_bytes(b, 1);
+    } else if (cp < 0x800) {
+        b[0] = (char)(0xC0 | (cp >> 6));
+        b[1] = (char)(0x80 | (cp & 0x3F));
+        out_bytes(b, 2);
+    } else {
+        b[0] = (char)(0xE0 | (cp >> 12));
+        b[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        b[2] = (char)(0x80 | (cp & 0x3F));
+        out_bytes(b, 3);
+    }
+}
+
+static void out_attr(uint8_t attr) {
+    static const char *sgr[] = { "\033[0m", "\033[0;1m", "\033[0;2m",
+                                 "\033[0;32m", "\033[0;33m", "\033[0;31m" };
+    out_bytes(sgr[attr], strlen(sgr[attr]));
+}
+
+static void screen_clear(void) {
+    for (int r = 0; r < screen_rows; r++) {
+        for (int c = 0; c < screen_cols; c++) {
+            screen_next[r][c].ch = ' ';
+            screen_next[r][c].attr = ATTR_NORMAL;
+        }
+    }
+}
+
+static void put_text(int row, int col, uint8_t attr, const char *fmt, ...) {
+    char tmp[DASH_MAX_COLS + 1];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (row < 0 || row >= screen_rows) return;
+    for (int i = 0; tmp[i] && col + i < screen_cols; i++) {
+        screen_next[row][col + i].ch = (unsigned char)tmp[i];
+        screen_next[row][col + i].attr = attr;
+    }
+}
+
+static void put_cell(int row, int col, uint32_t ch, uint8_t attr) {
+    if (row >= 0 && row < screen_rows && col >= 0 && col < screen_cols) {
+        screen_next[row][col].ch = ch;
+        screen_next[row][col].attr = attr;
+    }
+}
+
+// Emit only the runs of cells that changed since the previous frame
+static void screen_flush(void) {
+    out_len = 0;
+    if (!screen_valid) {
+        out_bytes("\033[0m\033[H\033[2J", 11);
+        for (int r = 0; r < screen_rows; r++) {
+            for (int c = 0; c < screen_cols; c++) {
+                screen_prev[r][c].ch = ' ';
+                screen_prev[r][c].attr = ATTR_NORMAL;
+            }
+        }
+        screen_valid = 1;
+    }
+
+    int cur_attr = -1;
+    for (int r = 0; r < screen_rows; r++) {
+        int c = 0;
+        while (c < screen_cols) {
+            if (screen_next[r][c].ch == screen_prev[r][c].ch &&
+                screen_next[r][c].attr == screen_prev[r][c].attr) {
+                c++;
+                continue;
+            }
+            out_fmt("\033[%d;%dH", r + 1, c + 1);
+            while (c < screen_cols &&
+                   (screen_next[r][c].ch != screen_prev[r][c].ch ||
+                    screen_next[r][c].attr != screen_prev[r][c].attr)) {
+                if (screen_next[r][c].attr != cur_attr) {
+                    cur_attr = screen_next[r][c].attr;
+                    out_attr((uint8_t)cur_attr);
+                }
+                out_utf8(screen_next[r][c].ch);
+                screen_prev[r][c] = screen_next[r][c];
+                c++;
+            }
+        }
+    }
+    if (out_len == 0) {
+        return;
+    }
+    out_bytes("\033[0m", 4);
+
+    size_t off = 0;
+    while (off < out_len) {
+        ssize_t w = write(STDOUT_FILENO, out_buf + off, out_len - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        off += (size_t)w;
+    }
+}
+
+// ============================================================================
+// RENDERING
+// ============================================================================
+
+static uint8_t anomaly_attr(int kind) {
+    switch (kind) {
+        case ANOMALY_NONE:  return ATTR_GREEN;
+        case ANOMALY_DRIFT: return ATTR_YELLOW;
+        default:            return ATTR_RED;
+    }
+}
+
+// Sparkline scaled to the window's own min..max; gaps stay blank
+static void put_sparkline(int row, int col, int width, const float *ring, int head) {
+    static const uint32_t bars[8] = {
+        0x2581, 0x2582, 0x2583, 0x2584, 0x2585, 0x2586, 0x2587, 0x2588
+    };
+    int start = (head - width + DASH_SPARK_MAX) % DASH_SPARK_MAX;
+    float lo = INFINITY, hi = -INFINITY;
+    for (int i = 0; i < width; i++) {
+        float v = ring[(start + i) % DASH_SPARK_MAX];
+        if (v == v) {
+            if (v < lo) lo = v;
+            if (v > hi) hi = v;
+        }
+    }
+    for (int i = 0; i < width; i++) {
+        float v = ring[(start + i) % DASH_SPARK_MAX];
+        uint32_t ch = ' ';
+        if (v == v) {
+            int level = hi > lo ? (int)((v - lo) / (hi - lo) * 7.0f + 0.5f) : 3;
+            ch = bars[level];
+        }
+        put_cell(row, col + i, ch, ATTR_NORMAL);
+    }
+}
+
+// Rolling min/avg/max of the sparkline window
+static void window_stats(const float *ring, float *lo, float *avg, float *hi) {
+    double sum = 0;
+    int n = 0;
+    *lo = INFINITY;
+    *hi = -INFINITY;
+    for (int i = 0; i < DASH_SPARK_MAX; i++) {
+        float v = ring[i];
+        if (v == v) {
+            if (v < *lo) *lo = v;
+            if (v > *hi) *hi = v;
+            sum += v;
+            n++;
+        }
+    }
+    *avg = n ? (float)(sum / n) : NAN;
+    if (!n) *lo = *hi = NAN;
+}
+
+static void render_view(const dash_view_t *v, double hz) {
+    screen_clear();
+
+    char clock_str[16];
+    time_t now = time(NULL);
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    strftime(clock_str, sizeof(clock_str), "%H:%M:%S", &tm_now);
+
+    put_text(0, 0, ATTR_BOLD, "LIVE DASHBOARD  %s", clock_str);
+    put_text(0, 26, ATTR_NORMAL, "sensors %-4d records %-10lu %8.0f rec/s  refresh %.1f Hz",
+             v->sensor_count, v->total, v->rate, hz);
+    put_text(1, 0, ATTR_DIM, "Press any key to stop");
+
+    // Fixed columns (one latest value per field, headed by its key),
+    // sparklines share what is left of the width
+    const int values_at = 16, value_w = 9;
+    const int stats_at = values_at + DASH_FIELDS * value_w + 2;
+    const int status_at = stats_at + 18;
+    const int fixed = status_at + 10;
+    int spark_w = (screen_cols - fixed) / DASH_FIELDS - 1;
+    if (spark_w > DASH_SPARK_MAX) spark_w = DASH_SPARK_MAX;
+    if (spark_w < 0) spark_w = 0;
+
+    put_text(3, 0, ATTR_BOLD, "%6s %9s", "Sensor", "Samples");
+    for (int f = 0; f < DASH_FIELDS; f++) {
+        put_text(3, values_at + f * value_w, ATTR_BOLD, " %8c", sensor_fields[f].key);
+    }
+    put_text(3, stats_at, ATTR_BOLD, "%c min/avg/max", sensor_fields[0].key);
+    put_text(3, status_at, ATTR_BOLD, "Status");
+    if (spark_w >= 4) {
+        for (int f = 0; f < DASH_FIELDS; f++) {
+            put_text(3, fixed + f * (spark_w + 1), ATTR_BOLD, "%.*s",
+                     spark_w, sensor_fields[f].label);
+        }
+    }
+
+    int alert_rows = v->alert_count ? v->alert_count + 2 : 0;
+    int max_sensor_rows = screen_rows - 5 - alert_rows;
+    int shown = v->sensor_count < max_sensor_rows ? v->sensor_count : max_sensor_rows;
+    if (shown < 0) shown = 0;
+
+    for (int s = 0; s < shown; s++) {
+        const dash_sensor_t *ds = &v->sensors[s];
+        int row = 4 + s;
+        float lo, avg, hi;
+        window_stats(ds->spark[0], &lo, &avg, &hi);
+        put_text(row, 0, ATTR_NORMAL, "%6d %9lu", ds->sensor_id, ds->count);
+        for (int f = 0; f < DASH_FIELDS; f++) {
+            put_text(row, values_at + f * value_w, ATTR_NORMAL, " %8.1f", ds->last.values[f]);
+        }
+        put_text(row, stats_at, ATTR_NORMAL, "%5.1f/%5.1f/%5.1f", lo, avg, hi);
+        put_text(row, status_at, anomaly_attr(ds->anomaly), "%-8s", anomaly_name(ds->anomaly));
+        if (spark_w >= 4) {
+            for (int f = 0; f < DASH_FIELDS; f++) {
+                put_sparkline(row, fixed + f * (spark_w + 1), spark_w,
+                              ds->spark[f], v->spark_head);
+            }
+        }
+    }
+    if (shown < v->sensor_count) {
+        put_text(4 + shown, 0, ATTR_DIM, "... %d more sensor(s)", v->sensor_count - shown);
+    }
+
+    if (v->alert_count) {
+        int row = screen_rows - alert_rows;
+        put_text(row, 0, ATTR_BOLD, "Recent alerts");
+        for (int i = 0; i < v->alert_count; i++) {
+            // Newest first
+            const dash_alert_t *a = &v->alerts[(v->alert_head - 1 - i + 2 * DASH_MAX_ALERTS) % DASH_MAX_ALERTS];
+            char ts[16];
+            struct tm tm_a;
+            localtime_r(&a->ts, &tm_a);
+            strftime(ts, sizeof(ts), "%H:%M:%S", &tm_a);
+            char vals[16 * DASH_FIELDS] = "";
+            size_t len = 0;
+            for (int f = 0; f < DASH_FIELDS && len < sizeof(vals); f++) {
+                len += (size_t)snprintf(vals + len, sizeof(vals) - len, " %c=%.1f",
+                                        sensor_fields[f].key, a->record.values[f]);
+            }
+            put_text(row + 1 + i, 0, anomaly_attr(a->kind), "%s  sensor %-5d %-8s%s",
+                     ts, a->sensor_id, anomaly_name(a->kind), vals);
+        }
+    }
+
+    screen_flush();
+}
+
+static void update_screen_size(void) {
+    struct winsize ws;
+    int rows = 24, cols = 80;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+    }
+    if (rows > DASH_MAX_ROWS) rows = DASH_MAX_ROWS;
+    if (cols > DASH_MAX_COLS) cols = DASH_MAX_COLS;
+    if (rows != screen_rows || cols != screen_cols) {
+        screen_rows = rows;
+        screen_cols = cols;
+        screen_valid = 0;
+    }
+}
+
+static void* render_main(void *arg) {
+    (void)arg;
+    static dash_view_t view;
+    double hz = 1e9 / (double)period_ns;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    while (render_running) {
+        pthread_mutex_lock(&published_lock);
+        memcpy(&view, &published, sizeof(view));
+        pthread_mutex_unlock(&published_lock);
+
+        // Ingest closes a tick with its first batch after the tick ends; a
+        // whole tick without one means the collectors are quiet
+        uint64_t tick = current_tick();
+        if (tick > view.tick + 1) {
+            push_empty(&view, tick - view.tick);
+            view.rate = 0.0f;
+        }
+
+        update_screen_size();
+        render_view(&view, hz);
+
+        // Absolute deadlines: rendering time does not stretch the period
+        deadline.tv_nsec += (long)period_ns;
+        while (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {}
+    }
+    return NULL;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int dashboard_start(int refresh_hz) {
+    if (render_running) {
+        return -1;
+    }
+    if (refresh_hz < 1) refresh_hz = 1;
+    if (refresh_hz > 60) refresh_hz = 60;
+    period_ns = 1000000000ull / (uint64_t)refresh_hz;
+
+    memset(&staged, 0, sizeof(staged));
+    memset(slot_of_id, 0, sizeof(slot_of_id));
+    memset(tick_sum, 0, sizeof(tick_sum));
+    memset(tick_n, 0, sizeof(tick_n));
+    memcpy(&published, &staged, sizeof(published));
+    epoch_ns = mono_ns();
+    total_at_tick = 0;
+    publish_pending = 0;
+    screen_valid = 0;
+
+    fflush(stdout);
+    fputs("\033[?25l", stdout);     // hide cursor
+    fflush(stdout);
+
+    render_running = 1;
+    if (pthread_create(&render_thread, NULL, render_main, NULL) != 0) {
+        render_running = 0;
+        return -1;
+    }
+    dashboard_active = 1;
+    return 0;
+}
+
+void dashboard_stop(void) {
+    if (!render_running) {
+        return;
+    }
+    dashboard_active = 0;
+    render_running = 0;
+    pthread_join(render_thread, NULL);
+    printf("\033[0m\033[?25h\033[%d;1H\n", screen_rows);
+    fflush(stdout);
+}
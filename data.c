@@ -0,0 +1,441 @@
+#include "system.h"
+#include "anomaly.h"
+
+// ============================================================================
+// GLOBAL VARIABLES
+// ============================================================================
+
+int recent_data_count = 0;
+sensor_data_t recent_data[MAX_RECENT_RECORDS];
+
+int stats_updated = 0;
+
+// Whole-station statistics are computed by the ingest thread (they come
+// from the sensor directory) and published under a sequence lock, so any
+// thread can take a consistent copy without blocking the writer.
+static statistics_t stats_published;
+static unsigned stats_seq = 0;      // odd while a publish is in progress
+
+// "Temperature (°C)"
+static const char* field_title(int f, char *buf, size_t size) {
+    snprintf(buf, size, "%s (%s)", sensor_fields[f].label, sensor_fields[f].unit);
+    return buf;
+}
+
+// Column headings "<key> <what>" for every field, e.g. "T P50"
+static void print_field_heads(FILE *fp, const char *const *what, int n, int width) {
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        for (int k = 0; k < n; k++) {
+            char head[16];
+            snprintf(head, sizeof(head), "%c %s", sensor_fields[f].key, what[k]);
+            fprintf(fp, " %*s", width, head);
+        }
+    }
+    fprintf(fp, "\n");
+}
+
+// Percentile section shared by the statistics screen and text reports.
+// Samples and averages include the compacted tiers; percentiles only
+// cover the raw samples (tier rows keep no distribution).
+void print_report_statistics(FILE *fp) {
+    static const char *const avg_pct[] = { "Avg", "P50", "P95", "P99" };
+    percentiles_t p;
+    statistics_t st;
+    char title[64];
+
+    time_t floor = tier_floor();
+    if (floor > 0) {
+        char since[32];
+        struct tm tm_ts;
+        localtime_r(&floor, &tm_ts);
+        strftime(since, sizeof(since), "%Y-%m-%d %H:%M", &tm_ts);
+        fprintf(fp, "Percentiles (all sensors, raw samples since %s; older ones are\n", since);
+        fprintf(fp, "compacted and only counted in samples, min, max and averages):\n");
+    } else {
+        fprintf(fp, "Percentiles (all sensors, all time):\n");
+    }
+    fprintf(fp, "  %-16s %9s %9s %9s %9s %9s\n", "", "Min", "P50", "P95", "P99", "Max");
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        if (get_percentiles(f + 1, SENSOR_ID_ALL, 0, 0, &p) > 0) {
+            field_title(f, title, sizeof(title));
+            fprintf(fp, "  %-*s %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                    display_pad(title, 16), title, p.min, p.p50, p.p95, p.p99, p.max);
+        }
+    }
+
+    int ids[SENSOR_MAX_SLOTS];
+    int sensors = sensor_dir_ids(ids, SENSOR_MAX_SLOTS);
+    if (sensors > SENSOR_MAX_SLOTS) sensors = SENSOR_MAX_SLOTS;
+
+    fprintf(fp, "\nPer sensor:\n");
+    fprintf(fp, "  %-8s %10s", "Sensor", "Samples");
+    print_field_heads(fp, avg_pct, 4, 8);
+    for (int i = 0; i < sensors; i++) {
+        calculate_sensor_statistics(ids[i], &st);
+        fprintf(fp, "  %-8d %10d", ids[i], st.total_records);
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+            fprintf(fp, " %8.1f %8.1f %8.1f %8.1f", st.avg[f], st.p50[f], st.p95[f], st.p99[f]);
+        }
+        fprintf(fp, "\n");
+    }
+
+    if (store_size() == 0) {
+        return;
+    }
+
+    // Newest hours first, at most one day
+    time_t newest = store_at(store_end() - 1)->timestamp / 3600 * 3600;
+    fprintf(fp, "\nHourly (last 24 hours with data):\n");
+    fprintf(fp, "  %-16s %10s", "Hour", "Samples");
+    print_field_heads(fp, avg_pct + 1, 3, 8);
+    for (time_t start = newest; start > newest - 24 * 3600; start -= 3600) {
+        percentiles_t hp[SENSOR_FIELD_COUNT];
+        if (get_percentiles(1, SENSOR_ID_ALL, start, start + 3600, &hp[0]) == 0) {
+            continue;
+        }
+        for (int f = 1; f < SENSOR_FIELD_COUNT; f++) {
+            get_percentiles(f + 1, SENSOR_ID_ALL, start, start + 3600, &hp[f]);
+        }
+        char label[32];
+        struct tm tm_ts;
+        localtime_r(&start, &tm_ts);
+        strftime(label, sizeof(label), "%Y-%m-%d %H:00", &tm_ts);
+        fprintf(fp, "  %-16s %10lu", label, hp[0].count);
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+            fprintf(fp, " %8.1f %8.1f %8.1f", hp[f].p50, hp[f].p95, hp[f].p99);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+// Whole-station statistics, merged from the per-sensor running totals
+int calculate_statistics(void) {
+    statistics_t st;
+    calculate_sensor_statistics(SENSOR_ID_ALL, &st);
+
+    unsigned seq = __atomic_load_n(&stats_seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&stats_published, &st, sizeof(st));
+    __atomic_store_n(&stats_seq, seq + 2, __ATOMIC_RELEASE);
+
+    stats_updated = 1;
+    return 0;
+}
+
+// Copies the last published statistics; retries if a publish overlapped.
+// Returns 0 if nothing has been published yet.
+int get_statistics(statistics_t *out) {
+    unsigned before, after;
+    do {
+        before = __atomic_load_n(&stats_seq, __ATOMIC_ACQUIRE);
+        memcpy(out, &stats_published, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&stats_seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+    return before != 0;
+}
+
+sensor_data_t* get_latest_data(void) {
+    if (store_size() == 0) {
+        return NULL;
+    }
+    return (sensor_data_t *)store_at(store_end() - 1);
+}
+
+// ============================================================================
+// DATA COLLECTION
+// ============================================================================
+
+// Entry point for every batch of records arriving from the collectors: the
+// anomaly stage grades each record, the graded batch is written to the
+// journal, then it is stored and indexed.
+// Returns the number of records stored.
+int ingest_records(sensor_data_t *records, size_t count) {
+    int stored = 0;
+    sensor_dir_sync();
+    for (size_t i = 0; i < count; i++) {
+        sensor_dir_assess(&records[i]);
+    }
+    journal_append(records, count);
+    for (size_t i = 0; i < count; i++) {
+        if (store_append(&records[i]) == 0) {
+            sensor_dir_add(&records[i], store_end() - 1);
+            stored++;
+        }
+    }
+    dashboard_ingest(records, count);
+    query_ingest(records, count);
+    return stored;
+}
+
+// ============================================================================
+// DATA MANAGEMENT
+// ============================================================================
+
+int delete_old_data(int days) {
+    return delete_data_before(get_current_time() - (time_t)days * 24 * 3600);
+}
+
+// Journaled so that recovery does not bring the deleted records back
+int delete_data_before(time_t cutoff) {
+    size_t deleted = store_trim_before(cutoff);
+    if (deleted > 0) {
+        journal_log_trim(cutoff);
+        sensor_dir_rebuild();
+    }
+    return (int)deleted;
+}
+
+int clear_all_data(void) {
+    int count = (int)store_size();
+    store_clear();
+    sensor_dir_reset();
+    query_reset();
+    snapshot_discard();
+    journal_reset();
+    tier_reset();
+    recent_data_count = 0;
+    return count;
+}
+
+// Every stored record is already in the journal; make it durable now
+int save_data_to_file_all(void) {
+    return journal_commit();
+}
+
+// ============================================================================
+// REPORT EXPORT
+// ============================================================================
+
+// Exports read the store through a snapshot and keep their scratch on the
+// stack or heap, so they may run on any thread, concurrently with ingest
+// and with each other.
+
+// Formats "YYYY-mm-dd HH:MM:SS"; consecutive records usually share the same
+// second, so the last conversion is cached instead of calling localtime
+// for every row.
+typedef struct export_clock {
+    time_t ts;
+    char text[32];
+} export_clock_t;
+
+static const char* export_time(export_clock_t *clk, time_t ts) {
+    if (ts != clk->ts) {
+        struct tm tm_ts;
+        localtime_r(&ts, &tm_ts);
+        strftime(clk->text, sizeof(clk->text), "%Y-%m-%d %H:%M:%S", &tm_ts);
+        clk->ts = ts;
+    }
+    return clk->text;
+}
+
+#define EXPORT_IOBUF_SIZE   (1 << 16)
+
+int export_to_csv(const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        printf("Cannot create file %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+    char *iobuf = malloc(EXPORT_IOBUF_SIZE);
+    if (iobuf) setvbuf(fp, iobuf, _IOFBF, EXPORT_IOBUF_SIZE);
+
+    // Columns and row format come from SENSOR_FIELDS at compile time
+#define CSV_HEAD_(field, ...)   "," #field
+#define CSV_FMT_(field, ...)    ",%.1f"
+#define CSV_ARG_(field, ...)    , span[i].field
+    fprintf(fp, "timestamp" SENSOR_FIELDS(CSV_HEAD_) ",sensor_id,quality\n");
+
+    store_snapshot_t snap;
+    store_iter_t it;
+    const sensor_data_t *span;
+    size_t n;
+    export_clock_t clk = { (time_t)-1, "" };
+    store_read_begin(&snap);
+    store_iter_snapshot(&it, &snap, snap.first, snap.end);
+    while ((n = store_iter_span(&it, &span)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            fprintf(fp, "%s" SENSOR_FIELDS(CSV_FMT_) ",%d,%d\n",
+                    export_time(&clk, span[i].timestamp) SENSOR_FIELDS(CSV_ARG_),
+                    span[i].sensor_id, span[i].quality);
+        }
+    }
+    store_read_end(&snap);
+
+    int rc = (fclose(fp) == 0) ? 0 : -1;
+    free(iobuf);
+    if (rc == 0) {
+        printf("Exported %zu records to %s\n", snap.end - snap.first, filename);
+    }
+    return rc;
+}
+
+// ============================================================================
+// SINGLE-PASS REPORT
+// ============================================================================
+//
+// Rows are streamed from the store while the summary is accumulated in the
+// same pass. The summary belongs at the top of the report, so a fixed-size
+// region is reserved there and filled in by seeking back once the rows are
+// written; an output that cannot seek (pipe, terminal) gets it as a trailer.
+// The per-sensor tables come from the sensor directory, so unlike the CSV
+// and Arrow exports a report is generated on the ingest thread.
+
+#define REPORT_HEADER_SIZE  1024
+
+typedef struct report_acc {
+    sketch_t field[SENSOR_FIELD_COUNT];     // count/min/max/sum too
+    unsigned long anomalies;
+    time_t first, last;
+} report_acc_t;
+
+static int format_report_summary(const report_acc_t *acc, char *buf, size_t size) {
+    char first[32], last[32], title[64];
+    time_t now = get_current_time();
+    int len = 0;
+
+#define REPORT_PRINTF(...) \
+    if ((size_t)len < size) len += snprintf(buf + len, size - (size_t)len, __VA_ARGS__)
+
+    REPORT_PRINTF("=== SENSOR DATA REPORT ===\n");
+    REPORT_PRINTF("Generated: %s\n", format_timestamp(now));
+    REPORT_PRINTF("Records:   %llu\n", (unsigned long long)acc->field[0].count);
+    if (acc->field[0].count > 0) {
+        snprintf(first, sizeof(first), "%s", format_timestamp(acc->first));
+        snprintf(last, sizeof(last), "%s", format_timestamp(acc->last));
+        REPORT_PRINTF("Period:    %s .. %s\n", first, last);
+        REPORT_PRINTF("Anomalies: %lu\n\n", acc->anomalies);
+        REPORT_PRINTF("  %-16s %9s %9s %9s %9s %9s %9s\n",
+                      "", "Min", "Avg", "Max", "P50", "P95", "P99");
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+            const sketch_t *sk = &acc->field[f];
+            field_title(f, title, sizeof(title));
+            REPORT_PRINTF("  %-*s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                          display_pad(title, 16), title,
+                          sk->min, sk->sum / (double)sk->count, sk->max,
+                          sketch_quantile(sk, 0.50), sketch_quantile(sk, 0.95),
+                          sketch_quantile(sk, 0.99));
+        }
+    }
+#undef REPORT_PRINTF
+
+    if ((size_t)len >= size) len = (int)size - 1;
+    return len;
+}
+
+int generate_report(const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        printf("Cannot create file %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+    char *iobuf = malloc(EXPORT_IOBUF_SIZE);
+    if (iobuf) setvbuf(fp, iobuf, _IOFBF, EXPORT_IOBUF_SIZE);
+
+    struct stat st;
+    long header_pos = ftell(fp);
+    int seekable = header_pos >= 0 && fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode);
+    if (seekable) {
+        fprintf(fp, "%*s\n", REPORT_HEADER_SIZE - 1, "");
+    }
+
+    report_acc_t acc;
+    memset(&acc, 0, sizeof(acc));
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        sketch_init(&acc.field[f]);
+    }
+
+#define ROW_HEAD_(field, stat, wtype, wire, key, label, unit, ...) \
+    , display_pad(#key "(" unit ")", 8), #key "(" unit ")"
+#define ROW_FMT_S_(field, ...)  " %-*s"
+#define ROW_FMT_(field, ...)    " %-8.1f"
+#define ROW_ARG_(field, ...)    , d->field
+    fprintf(fp, "%-20s" SENSOR_FIELDS(ROW_FMT_S_) " %-6s %-7s\n",
+            "Timestamp" SENSOR_FIELDS(ROW_HEAD_), "Sensor", "Quality");
+
+    store_snapshot_t snap;
+    store_iter_t it;
+    const sensor_data_t *span;
+    size_t n;
+    export_clock_t clk = { (time_t)-1, "" };
+    store_read_begin(&snap);
+    store_iter_snapshot(&it, &snap, snap.first, snap.end);
+    while ((n = store_iter_span(&it, &span)) > 0) {
+        if (acc.field[0].count == 0) {
+            acc.first = span[0].timestamp;
+        }
+        for (size_t i = 0; i < n; i++) {
+            const sensor_data_t *d = &span[i];
+            fprintf(fp, "%-20s" SENSOR_FIELDS(ROW_FMT_) " %-6d %-7d\n",
+                    export_time(&clk, d->timestamp) SENSOR_FIELDS(ROW_ARG_),
+                    d->sensor_id, d->quality);
+            for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+                sketch_add(&acc.field[f], d->values[f]);
+            }
+            if (anomaly_from_quality(d->quality) != ANOMALY_NONE) acc.anomalies++;
+        }
+        acc.last = span[n - 1].timestamp;
+    }
+    store_read_end(&snap);
+
+    // Per-sensor and hourly tables come from the sensor directory, not the rows
+    fprintf(fp, "\n");
+    print_report_statistics(fp);
+
+    char summary[REPORT_HEADER_SIZE];
+    int len = format_report_summary(&acc, summary, sizeof(summary));
+    if (seekable && fseek(fp, header_pos, SEEK_SET) == 0) {
+        fwrite(summary, 1, (size_t)len, fp);    // rest of the region stays blank
+    } else {
+        fprintf(fp, "\n%s", summary);
+    }
+
+    unsigned long long records = acc.field[0].count;
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        sketch_free(&acc.field[f]);
+    }
+
+    int rc = (fclose(fp) == 0) ? 0 : -1;
+    free(iobuf);
+    if (rc == 0) {
+        printf("Exported %llu records to %s\n", records, filename);
+    }
+    return rc;
+}
+
+int export_to_txt(const char *filename) {
+    return generate_report(filename);
+}
+
+// ============================================================================
+// UTILITY FUNCTIONS
+// ============================================================================
+
+time_t get_current_time(void) {
+    return time(NULL);
+}
+
+char* format_timestamp(time_t timestamp) {
+    static char buf[32];
+    struct tm tm_ts;
+    localtime_r(&timestamp, &tm_ts);
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm_ts);
+    return buf;
+}
+
+// ============================================================================
+// ERROR HANDLING
+// ============================================================================
+
+void log_error(const char *function, const char *error) {
+    system_log_append("ERROR", "%s: %s", function, error);
+}
+
+void log_info(const char *message) {
+    system_log_append("INFO", "%s", message);
+}
@@ -0,0 +1,213 @@
+/* frame.c — Mã hóa / giải mã khung nhị phân và bộ tách dòng ASCII
+ *
+ * Xem mô tả định dạng khung trong frame.h.
+ */
+
+#include "frame.h"
+
+#include <string.h>
+
+/* Bảng CRC-8 (đa thức 0x07) — tra bảng thay vì dịch bit từng byte */
+static const uint8_t CRC8_TABLE[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+    0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65,
+    0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5,
+    0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85,
+    0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2,
+    0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2,
+    0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32,
+    0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42,
+    0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C,
+    0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC,
+    0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C,
+    0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C,
+    0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B,
+    0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B,
+    0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB,
+    0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB,
+    0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+uint8_t frame_crc8(const uint8_t* p, size_t n) {
+    uint8_t crc = 0;
+    while (n--) crc = CRC8_TABLE[crc ^ *p++];
+    return crc;
+}
+
+
+/* =====================================
+ * MÃ HÓA / GIẢI MÃ MỘT KHUNG
+ * ===================================== */
+
+// Làm tròn và kẹp giá trị fixed-point (không dùng libm để chạy được trên Arduino)
+static int32_t to_fixed(float v, float scale, int32_t lo, int32_t hi) {
+    float x = v * scale;
+    int32_t r = (int32_t)(x >= 0.0f ? x + 0.5f : x - 0.5f);
+    if (r < lo) r = lo;
+    if (r > hi) r = hi;
+    return r;
+}
+
+size_t frame_encode(uint8_t out[FRAME_SIZE], const frame_sample_t* s) {
+    int32_t t = to_fixed(s->temperature, 100.0f, -32768, 32767);
+    int32_t h = to_fixed(s->humidity, 100.0f, 0, 65535);
+    int32_t g = s->gas_ppm < 0 ? 0 : (s->gas_ppm > 65535 ? 65535 : s->gas_ppm);
+
+    out[0]  = FRAME_SYNC;
+    out[1]  = s->sensor_id;
+    out[2]  = (uint8_t)(s->seq & 0xFF);
+    out[3]  = (uint8_t)(s->seq >> 8);
+    out[4]  = (uint8_t)((uint16_t)t & 0xFF);
+    out[5]  = (uint8_t)((uint16_t)t >> 8);
+    out[6]  = (uint8_t)(h & 0xFF);
+    out[7]  = (uint8_t)(h >> 8);
+    out[8]  = (uint8_t)(g & 0xFF);
+    out[9]  = (uint8_t)(g >> 8);
+    out[10] = frame_crc8(out + 1, FRAME_SIZE - 2);
+    return FRAME_SIZE;
+}
+
+int frame_decode(const uint8_t in[FRAME_SIZE], frame_sample_t* s) {
+    if (in[0] != FRAME_SYNC) return -1;
+    if (frame_crc8(in + 1, FRAME_SIZE - 2) != in[10]) return -1;
+
+    s->sensor_id   = in[1];
+    s->seq         = (uint16_t)(in[2] | (in[3] << 8));
+    s->temperature = (float)(int16_t)(in[4] | (in[5] << 8)) / 100.0f;
+    s->humidity    = (float)(uint16_t)(in[6] | (in[7] << 8)) / 100.0f;
+    s->gas_ppm     = (int)(uint16_t)(in[8] | (in[9] << 8));
+    return 0;
+}
+
+
+/* =====================================
+ * BỘ GIẢI MÃ LUỒNG (TỰ NHẬN BIẾT + TỰ ĐỒNG BỘ)
+ * =====================================
+ * - AUTO:   byte 0xA5 → thử khung nhị phân, ký tự in được → gom dòng ASCII.
+ *           Sau FRAME_LOCK_STREAK mẫu liên tiếp cùng loại thì khóa chế độ.
+ * - BINARY: bỏ qua mọi byte cho tới 0xA5 kế tiếp; CRC sai → bỏ 1 byte rồi
+ *           tìm lại sync (không bao giờ "đoán" sai giá trị).
+ * - ASCII:  bỏ byte không in được.
+ * Nếu đã khóa mà gặp FRAME_UNLOCK_JUNK byte rác liên tiếp (ví dụ Arduino
+ * được nạp firmware khác) thì quay về AUTO.
+ */
+
+void frame_decoder_init(frame_decoder_t* d, frame_mode_t mode) {
+    memset(d, 0, sizeof(*d));
+    d->mode = mode;
+}
+
+size_t frame_decoder_feed(frame_decoder_t* d, const uint8_t* data, size_t n) {
+    if (d->head + d->len + n > FRAME_BUF_SIZE && d->head > 0) {
+        memmove(d->buf, d->buf + d->head, d->len);
+        d->head = 0;
+    }
+    size_t room = FRAME_BUF_SIZE - d->head - d->len;
+    if (n > room) n = room;
+    memcpy(d->buf + d->head + d->len, data, n);
+    d->len += n;
+    return n;
+}
+
+static void consume(frame_decoder_t* d, size_t n) {
+    d->head += n;
+    d->len -= n;
+    if (d->len == 0) d->head = 0;
+}
+
+static void drop(frame_decoder_t* d, size_t n) {
+    consume(d, n);
+    d->dropped_bytes += n;
+    d->junk_run += n;
+    if (d->mode != FRAME_MODE_AUTO && d->junk_run >= FRAME_UNLOCK_JUNK) {
+        d->mode = FRAME_MODE_AUTO;
+        d->ascii_streak = d->binary_streak = 0;
+    }
+}
+
+static int is_text(uint8_t c) {
+    return c == '\t' || c == '\r' || (c >= 0x20 && c < 0x7F);
+}
+
+int frame_decoder_next(frame_decoder_t* d, frame_event_t* ev) {
+    for (;;) {
+        if (d->len == 0) return 0;
+        const uint8_t* p = d->buf + d->head;
+
+        /* ===== KHUNG NHỊ PHÂN ===== */
+        if (d->mode != FRAME_MODE_ASCII) {
+            if (p[0] == FRAME_SYNC) {
+                if (d->len < FRAME_SIZE) return 0;
+                if (frame_decode(p, &ev->sample) == 0) {
+                    consume(d, FRAME_SIZE);
+                    ev->kind = FRAME_EV_BINARY;
+                    d->frames++;
+                    d->junk_run = 0;
+                    d->ascii_streak = 0;
+                    if (d->mode == FRAME_MODE_AUTO && ++d->binary_streak >= FRAME_LOCK_STREAK)
+                        d->mode = FRAME_MODE_BINARY;
+                    return 1;
+                }
+                d->crc_errors++;
+                drop(d, 1);
+                continue;
+            }
+            if (d->mode == FRAME_MODE_BINARY) {
+                const uint8_t* s = memchr(p, FRAME_SYNC, d->len);
+                drop(d, s ? (size_t)(s - p) : d->len);
+                continue;
+            }
+        }
+
+        /* ===== DÒNG ASCII ===== */
+        size_t i = 0;
+        while (i < d->len && is_text(p[i])) i++;
+
+        if (i < d->len && p[i] == '\n') {
+            if (i == 0) { consume(d, 1); continue; }    // dòng trống
+            if (i > FRAME_LINE_MAX) {
+                d->overflows++;
+                drop(d, i + 1);
+                continue;
+            }
+            memcpy(ev->line, p, i);
+            ev->line[i] = '\0';
+            consume(d, i + 1);
+            ev->kind = FRAME_EV_ASCII;
+            d->lines++;
+            d->junk_run = 0;
+            d->binary_streak = 0;
+            if (d->mode == FRAME_MODE_AUTO && ++d->ascii_streak >= FRAME_LOCK_STREAK)
+                d->mode = FRAME_MODE_ASCII;
+            return 1;
+        }
+
+        if (i == d->len) {
+            // Chưa đủ một dòng: chờ thêm, trừ khi đã quá dài
+            if (d->len > FRAME_LINE_MAX) {
+                d->overflows++;
+                drop(d, d->len);
+                continue;
+            }
+            return 0;
+        }
+
+        // p[i] là byte không in được (nhiễu, hoặc byte sync ở chế độ AUTO)
+        drop(d, i == 0 ? 1 : i);
+    }
+}
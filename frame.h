@@ -0,0 +1,97 @@
+/* frame.h — Giao thức khung nhị phân Arduino → host
+ *
+ * Bên cạnh dòng ASCII "T H G\n", Arduino có thể gửi khung nhị phân cố định
+ * 11 byte (không cần printf trên Arduino, không cần sscanf trên host):
+ *
+ *   [0]     0xA5        byte đồng bộ (không bao giờ xuất hiện trong ASCII)
+ *   [1]     sensor_id   u8
+ *   [2..3]  seq         u16 little-endian, tăng 1 mỗi khung
+ *   [4..5]  temp        i16, đơn vị 0.01 °C
+ *   [6..7]  humidity    u16, đơn vị 0.01 %
+ *   [8..9]  gas         u16, ppm
+ *   [10]    crc8        CRC-8 (đa thức 0x07) tính trên byte 1..9
+ *
+ * Bộ giải mã tự nhận biết ASCII hay nhị phân cho từng cổng và tự đồng bộ lại
+ * khi gặp nhiễu đường truyền (CRC sai, byte rác).
+ */
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_SYNC          0xA5
+#define FRAME_SIZE          11
+#define FRAME_LINE_MAX      128   /* dòng ASCII dài hơn → coi là rác */
+#define FRAME_BUF_SIZE      512
+#define FRAME_LOCK_STREAK   3     /* số mẫu liên tiếp để khóa chế độ */
+#define FRAME_UNLOCK_JUNK   64    /* số byte rác liên tiếp để quay về AUTO */
+
+typedef enum {
+    FRAME_MODE_AUTO = 0,
+    FRAME_MODE_ASCII,
+    FRAME_MODE_BINARY
+} frame_mode_t;
+
+/* Giá trị một khung nhị phân (đã đổi về đơn vị thật) */
+typedef struct {
+    uint8_t  sensor_id;
+    uint16_t seq;
+    float    temperature;
+    float    humidity;
+    int      gas_ppm;
+} frame_sample_t;
+
+typedef enum {
+    FRAME_EV_ASCII = 1,     /* ev.line chứa một dòng ASCII (không có '\n') */
+    FRAME_EV_BINARY         /* ev.sample chứa một khung nhị phân hợp lệ */
+} frame_event_kind_t;
+
+typedef struct {
+    frame_event_kind_t kind;
+    char line[FRAME_LINE_MAX + 1];
+    frame_sample_t sample;
+} frame_event_t;
+
+typedef struct {
+    frame_mode_t mode;
+    uint8_t buf[FRAME_BUF_SIZE];
+    size_t head, len;               /* dữ liệu hợp lệ: buf[head .. head+len) */
+
+    int ascii_streak, binary_streak;
+    size_t junk_run;                /* byte rác liên tiếp kể từ mẫu tốt cuối */
+
+    /* Bộ đếm để ghi log / theo dõi chất lượng đường truyền */
+    unsigned long frames, lines;
+    unsigned long crc_errors, dropped_bytes, overflows;
+} frame_decoder_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CRC-8 (đa thức 0x07, init 0x00) */
+uint8_t frame_crc8(const uint8_t* p, size_t n);
+
+/* Mã hóa một mẫu thành khung 11 byte (dùng được cả trên Arduino).
+ * Giá trị ngoài phạm vi kiểu dữ liệu được kẹp lại. Trả về FRAME_SIZE. */
+size_t frame_encode(uint8_t out[FRAME_SIZE], const frame_sample_t* s);
+
+/* Giải mã một khung 11 byte. Trả về 0 nếu hợp lệ, -1 nếu sai sync/CRC. */
+int frame_decode(const uint8_t in[FRAME_SIZE], frame_sample_t* s);
+
+/* Khởi tạo bộ giải mã. mode = FRAME_MODE_AUTO để tự nhận biết. */
+void frame_decoder_init(frame_decoder_t* d, frame_mode_t mode);
+
+/* Nạp thêm byte đọc được. Trả về số byte đã nhận (có thể < n nếu buffer đầy,
+ * khi đó cần gọi frame_decoder_next() rồi nạp tiếp phần còn lại). */
+size_t frame_decoder_feed(frame_decoder_t* d, const uint8_t* data, size_t n);
+
+/* Lấy sự kiện tiếp theo. Trả về 1 nếu có sự kiện, 0 nếu cần thêm dữ liệu. */
+int frame_decoder_next(frame_decoder_t* d, frame_event_t* ev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_H */
@@ -0,0 +1,613 @@
+#include "system.h"
+#include "metrics.h"
+
+#include <dirent.h>
+#include <sys/uio.h>
+
+// ============================================================================
+// WRITE-AHEAD JOURNAL
+// ============================================================================
+//
+// Every batch handed to ingest_records() is appended to the journal before
+// it reaches the store, as one frame:
+//
+//   journal_frame_t header | payload (count * sensor_data_t for DATA frames)
+//
+// Frames carry a sequence number (LSN, +1 per frame) and a CRC-32 over
+// header and payload, so recovery can tell a complete frame from one torn
+// by a crash. The journal is split into segment files named after the LSN
+// of their first frame (journal/wal-<lsn>.log) and rolled at
+// JOURNAL_SEGMENT_BYTES.
+//
+// Durability trade-off (group commit): each frame is written to the kernel
+// immediately, so a process crash loses nothing. fdatasync() runs once
+// journal_commit_records records are pending or journal_commit_ms has passed
+// since the first pending one, so a power loss loses at most that window.
+// Setting either limit to 0 syncs after every batch.
+//
+// A snapshot (snapshot.c) records the LSN it covers up to; journal_open()
+// then only applies frames from there on, and segments wholly before it
+// are dropped once the snapshot is durable.
+//
+// DATA frames record sizeof(sensor_data_t), which changes with the schema
+// (schema.h). A journal written by a build with another record size is
+// refused as a whole: journal_open() returns JOURNAL_INCOMPATIBLE without
+// replaying, truncating or deleting anything, and the segments stay on
+// disk until they are exported with the build that wrote them. Frames
+// from before the size was recorded carry 0 and must match by length.
+
+#define JOURNAL_MAGIC       0x4C415753u     // "SWAL"
+#define JOURNAL_DATA        1
+#define JOURNAL_TRIM        2               // arg = cutoff timestamp
+
+typedef struct journal_frame {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t record_size;   // DATA: sizeof(sensor_data_t) of the writer (0 = not recorded)
+    uint32_t count;         // records in the payload
+    uint32_t length;        // payload bytes
+    uint64_t lsn;
+    int64_t arg;
+    uint32_t crc;           // CRC-32 of header (with crc = 0) and payload
+    uint32_t pad;
+} journal_frame_t;
+
+static int seg_fd = -1;
+static uint64_t seg_bytes = 0;
+static uint64_t next_lsn = 1;
+static uint64_t pending_records = 0;
+static uint64_t pending_since_ms = 0;
+static int replaying = 0;
+static uint64_t replay_from = 0;        // frames below this are in the snapshot
+static int incompatible = 0;            // segments of another schema on disk: never delete them
+
+_Static_assert(sizeof(sensor_data_t) <= UINT16_MAX, "record size must fit journal_frame_t.record_size");
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+// Slicing-by-8: eight tables, eight bytes per step (little-endian loads)
+static uint32_t crc_table[8][256];
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t c = crc_table[t - 1][i];
+            crc_table[t][i] = crc_table[0][c & 0xFF] ^ (c >> 8);
+        }
+    }
+}
+
+// Shared with snapshot.c
+uint32_t crc32_update(uint32_t crc, const void *data, size_t n) {
+    const uint8_t *p = data;
+    if (crc_table[0][1] == 0) {
+        crc_init();
+    }
+    crc = ~crc;
+    while (n >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^
+              crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF] ^
+              crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+        p += 8;
+        n -= 8;
+    }
+    while (n--) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t frame_crc(const journal_frame_t *h, const void *payload) {
+    journal_frame_t tmp = *h;
+    tmp.crc = 0;
+    uint32_t crc = crc32_update(0, &tmp, sizeof(tmp));
+    return crc32_update(crc, payload, h->length);
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void segment_path(char *buf, size_t size, uint64_t first_lsn) {
+    snprintf(buf, size, "%s/wal-%016llx.log", JOURNAL_DIR, (unsigned long long)first_lsn);
+}
+
+// Segment names sort in LSN order; returns the count, *out is malloc'd
+static int list_segments(uint64_t **out) {
+    DIR *dir = opendir(JOURNAL_DIR);
+    *out = NULL;
+    if (!dir) {
+        return 0;
+    }
+    int count = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        unsigned long long lsn;
+        char tail[8];
+        if (sscanf(de->d_name, "wal-%16llx.%7s", &lsn, tail) != 2 || strcmp(tail, "log") != 0) {
+            continue;
+        }
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            uint64_t *p = realloc(*out, (size_t)cap * sizeof(uint64_t));
+            if (!p) break;
+            *out = p;
+        }
+        (*out)[count++] = lsn;
+    }
+    closedir(dir);
+
+    for (int i = 1; i < count; i++) {
+        uint64_t v = (*out)[i];
+        int j = i - 1;
+        while (j >= 0 && (*out)[j] > v) {
+            (*out)[j + 1] = (*out)[j];
+            j--;
+        }
+        (*out)[j + 1] = v;
+    }
+    return count;
+}
+
+static void sync_dir(void) {
+    int fd = open(JOURNAL_DIR, O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static int sync_segment(void) {
+    if (seg_fd < 0 || pending_records == 0) {
+        pending_records = 0;
+        return 0;
+    }
+    uint64_t t0 = metrics_now_ns();
+    int rc = fdatasync(seg_fd);
+    metrics_observe(METRIC_JOURNAL_SYNC_NS, metrics_now_ns() - t0);
+    METRIC_INC(METRIC_JOURNAL_SYNCS);
+    if (rc != 0) {
+        log_error("journal_commit", strerror(errno));
+        return -1;
+    }
+    pending_records = 0;
+    return 0;
+}
+
+static int open_segment(uint64_t first_lsn) {
+    char path[256];
+    segment_path(path, sizeof(path), first_lsn);
+    seg_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (seg_fd < 0) {
+        log_error("journal_open", strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    seg_bytes = fstat(seg_fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+    sync_dir();     // the new name must survive a crash too
+    return 0;
+}
+
+static int roll_segment(void) {
+    sync_segment();
+    close(seg_fd);
+    seg_fd = -1;
+    return open_segment(next_lsn);
+}
+
+static int write_frame(journal_frame_t *h, const void *payload) {
+    if (seg_fd < 0) {
+        return -1;
+    }
+    if (seg_bytes > 0 && seg_bytes + sizeof(*h) + h->length > JOURNAL_SEGMENT_BYTES) {
+        if (roll_segment() != 0) return -1;
+    }
+
+    h->magic = JOURNAL_MAGIC;
+    h->lsn = next_lsn;
+    h->crc = frame_crc(h, payload);
+
+    struct iovec iov[2] = {
+        { h, sizeof(*h) },
+        { (void *)payload, h->length },
+    };
+    size_t total = sizeof(*h) + h->length, done = 0;
+    while (done < total) {
+        ssize_t w = writev(seg_fd, iov, 2);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            log_error("journal_append", strerror(errno));
+            return -1;
+        }
+        done += (size_t)w;
+        // Partial write: skip what was written and retry the rest
+        for (int i = 0; i < 2; i++) {
+            size_t step = (size_t)w < iov[i].iov_len ? (size_t)w : iov[i].iov_len;
+            iov[i].iov_base = (char *)iov[i].iov_base + step;
+            iov[i].iov_len -= step;
+            w -= (ssize_t)step;
+        }
+    }
+
+    seg_bytes += total;
+    next_lsn++;
+    metrics_add(METRIC_JOURNAL_BYTES, total);
+    return 0;
+}
+
+static void commit_if_due(void) {
+    if (pending_records == 0) {
+        return;
+    }
+    uint64_t limit_ms = system_config.journal_commit_ms > 0 ? (uint64_t)system_config.journal_commit_ms : 0;
+    uint64_t limit_records = system_config.journal_commit_records > 0
+                             ? (uint64_t)system_config.journal_commit_records : 1;
+    if (pending_records >= limit_records || now_ms() - pending_since_ms >= limit_ms) {
+        sync_segment();
+    }
+}
+
+// ============================================================================
+// RECOVERY
+// ============================================================================
+
+// Record size of an intact DATA frame, 0 if it does not match this build
+static size_t frame_record_size(const journal_frame_t *h) {
+    if (h->record_size != 0) {
+        return h->record_size == sizeof(sensor_data_t) ? sizeof(sensor_data_t) : 0;
+    }
+    return (uint64_t)h->count * sizeof(sensor_data_t) == h->length ? sizeof(sensor_data_t) : 0;
+}
+
+// Replays one segment. Returns 0 if it ended cleanly, 1 after truncating
+// a torn/corrupt tail (nothing after it can be trusted), or 2 at an intact
+// frame of another record size (the file is left as it is).
+static int replay_segment(uint64_t first_lsn, int is_first, size_t *records) {
+    char path[256];
+    segment_path(path, sizeof(path), first_lsn);
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        log_error("journal_recover", strerror(errno));
+        return 1;
+    }
+    FILE *fp = fdopen(fd, "rb");
+    static char iobuf[1 << 16];
+    setvbuf(fp, iobuf, _IOFBF, sizeof(iobuf));
+
+    size_t cap = 0;
+    void *payload = NULL;
+    off_t good = 0;
+    int torn = 0;
+    journal_frame_t h;
+
+    while (fread(&h, sizeof(h), 1, fp) == 1) {
+        if (h.magic != JOURNAL_MAGIC || h.length > JOURNAL_SEGMENT_BYTES ||
+            (!(is_first && good == 0) && h.lsn != next_lsn)) {
+            torn = 1;
+            break;
+        }
+        if (h.length > cap) {
+            void *p = realloc(payload, h.length);
+            if (!p) { torn = 1; break; }
+            payload = p;
+            cap = h.length;
+        }
+        if (h.length && fread(payload, h.length, 1, fp) != 1) {
+            torn = 1;
+            break;
+        }
+        if (frame_crc(&h, payload) != h.crc) {
+            torn = 1;
+            break;
+        }
+        if (h.type == JOURNAL_DATA && frame_record_size(&h) == 0) {
+            // A complete frame, so not a crash: written with another schema
+            system_log_append("ERROR", "journal: %s has %u-byte records at LSN %llu, this build uses %zu",
+                              path, h.record_size ? h.record_size : (h.count ? h.length / h.count : 0),
+                              (unsigned long long)h.lsn, sizeof(sensor_data_t));
+            free(payload);
+            fclose(fp);
+            return 2;
+        }
+
+        if (h.lsn < replay_from) {
+            // already in the snapshot
+        } else if (h.type == JOURNAL_DATA) {
+            // Journals written before timestamp_ns have whatever was in the
+            // record padding there
+            sensor_data_t *rec = payload;
+            for (uint32_t i = 0; i < h.count; i++) {
+                if (rec[i].timestamp_ns < 0 || rec[i].timestamp_ns >= 1000000000) {
+                    rec[i].timestamp_ns = 0;
+                }
+            }
+            ingest_records(payload, h.count);
+            *records += h.count;
+        } else if (h.type == JOURNAL_TRIM) {
+            delete_data_before((time_t)h.arg);
+        }
+        next_lsn = h.lsn + 1;
+        good += (off_t)(sizeof(h) + h.length);
+    }
+    if (!torn && !feof(fp)) {
+        torn = 1;
+    }
+
+    if (torn) {
+        // Partial trailing frame from a crash (or corruption): cut it off
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > good) {
+            system_log_append("WARN", "journal: truncating %s at %lld (%lld bytes dropped)",
+                              path, (long long)good, (long long)(st.st_size - good));
+            if (ftruncate(fd, good) == 0) fsync(fd);
+        } else {
+            torn = 0;
+        }
+    }
+    free(payload);
+    fclose(fp);
+    return torn;
+}
+
+// Replays frames with LSN >= from_lsn (0 = everything) and opens the
+// journal for appending. Returns the number of records replayed, -1 on
+// error, JOURNAL_INCOMPATIBLE if the journal was written with another
+// record size (nothing is opened and no segment is touched).
+int journal_open(uint64_t from_lsn) {
+    if (mkdir(JOURNAL_DIR, 0755) != 0 && errno != EEXIST) {
+        log_error("journal_open", strerror(errno));
+        return -1;
+    }
+
+    uint64_t *segs;
+    int count = list_segments(&segs);
+    size_t records = 0;
+    int start = 0, last = -1;
+
+    // Skip segments that end before from_lsn without reading them
+    while (start + 1 < count && segs[start + 1] <= from_lsn) {
+        start++;
+    }
+    if (start < count && segs[start] > from_lsn && from_lsn > 0) {
+        system_log_append("ERROR", "journal: frames %llu..%llu missing after the snapshot",
+                          (unsigned long long)from_lsn, (unsigned long long)segs[start] - 1);
+    }
+
+    replaying = 1;
+    replay_from = from_lsn;
+    incompatible = 0;
+    for (int i = start; i < count; i++) {
+        if (!(i == start || segs[i] == next_lsn)) {
+            break;          // gap in the sequence: stop at the last good frame
+        }
+        if (i == start) next_lsn = segs[start];
+        last = i;
+        int rc = replay_segment(segs[i], i == start, &records);
+        if (rc == 2) {
+            incompatible = 1;
+            break;
+        }
+        if (rc != 0) {
+            break;
+        }
+    }
+    replaying = 0;
+    replay_from = 0;
+    if (incompatible) {
+        free(segs);
+        return JOURNAL_INCOMPATIBLE;
+    }
+
+    // Anything after the point where replay stopped is not trusted: keep it
+    // for inspection but out of the way of the next recovery.
+    for (int i = last + 1; i < count; i++) {
+        char from[256], to[272];
+        segment_path(from, sizeof(from), segs[i]);
+        snprintf(to, sizeof(to), "%s.corrupt", from);
+        rename(from, to);
+        system_log_append("ERROR", "journal: %s not replayed, kept as %s", from, to);
+    }
+
+    // The snapshot may be newer than the journal (segments lost): continue
+    // its numbering in a fresh segment, appending would break the sequence
+    int rc;
+    if (next_lsn < from_lsn || last < 0) {
+        if (next_lsn < from_lsn) next_lsn = from_lsn;
+        rc = open_segment(next_lsn);
+    } else {
+        rc = open_segment(segs[last]);
+    }
+    free(segs);
+    pending_records = 0;
+    return rc == 0 ? (int)records : -1;
+}
+
+void journal_close(void) {
+    if (seg_fd < 0) {
+        return;
+    }
+    sync_segment();
+    close(seg_fd);
+    seg_fd = -1;
+}
+
+// ============================================================================
+// APPEND / COMMIT
+// ============================================================================
+
+int journal_append(const sensor_data_t *records, size_t count) {
+    if (replaying || count == 0) {
+        return 0;
+    }
+    journal_frame_t h = { 0 };
+    h.type = JOURNAL_DATA;
+    h.record_size = (uint16_t)sizeof(sensor_data_t);
+    h.count = (uint32_t)count;
+    h.length = (uint32_t)(count * sizeof(sensor_data_t));
+    if (write_frame(&h, records) != 0) {
+        return -1;
+    }
+    if (pending_records == 0) {
+        pending_since_ms = now_ms();
+    }
+    pending_records += count;
+    commit_if_due();
+    return 0;
+}
+
+int journal_log_trim(time_t cutoff) {
+    if (replaying) {
+        return 0;
+    }
+    journal_frame_t h = { 0 };
+    h.type = JOURNAL_TRIM;
+    h.arg = (int64_t)cutoff;
+    if (write_frame(&h, NULL) != 0) {
+        return -1;
+    }
+    if (pending_records == 0) {
+        pending_since_ms = now_ms();
+    }
+    pending_records++;
+    return sync_segment();      // rare, and must not be undone by a crash
+}
+
+int journal_commit(void) {
+    return sync_segment();
+}
+
+// Called from the collection loop so a quiet period still commits on time
+void journal_tick(void) {
+    commit_if_due();
+}
+
+// Milliseconds until the pending window must be committed, -1 if nothing is pending
+int journal_commit_due_in(void) {
+    if (pending_records == 0) {
+        return -1;
+    }
+    uint64_t elapsed = now_ms() - pending_since_ms;
+    uint64_t limit = system_config.journal_commit_ms > 0 ? (uint64_t)system_config.journal_commit_ms : 0;
+    return elapsed >= limit ? 0 : (int)(limit - elapsed);
+}
+
+// LSN the next frame will get: a snapshot taken now covers everything before it
+uint64_t journal_next_lsn(void) {
+    return next_lsn;
+}
+
+// Deletes segments whose frames all precede lsn. The segment being
+// appended to is always kept. Returns the number of segments deleted.
+int journal_drop_before(uint64_t lsn) {
+    if (incompatible) {
+        return 0;
+    }
+    uint64_t *segs;
+    int count = list_segments(&segs);
+    int dropped = 0;
+    for (int i = 0; i + 1 < count && segs[i + 1] <= lsn; i++) {
+        char path[256];
+        segment_path(path, sizeof(path), segs[i]);
+        if (unlink(path) == 0) dropped++;
+    }
+    free(segs);
+    if (dropped > 0) sync_dir();
+    return dropped;
+}
+
+// Closes the journal and deletes every segment (restore_data). Segments of
+// another schema are kept.
+void journal_discard(void) {
+    journal_close();
+    if (incompatible) {
+        return;
+    }
+    uint64_t *segs;
+    int count = list_segments(&segs);
+    for (int i = 0; i < count; i++) {
+        char path[256];
+        segment_path(path, sizeof(path), segs[i]);
+        unlink(path);
+    }
+    free(segs);
+    sync_dir();
+    pending_records = 0;
+}
+
+// Drops every segment and starts an empty journal (clear_all_data)
+int journal_reset(void) {
+    if (replaying || incompatible) {
+        return 0;
+    }
+    journal_discard();
+    return open_segment(next_lsn);
+}
+
+// ============================================================================
+// SEGMENT ACCESS (backups)
+// ============================================================================
+
+// These only read files and may run on any thread. A segment can be
+// dropped by a snapshot at any time; an open descriptor keeps it readable.
+
+// First LSNs of the segments on disk, oldest first; *first_lsns is malloc'd
+int journal_list_segments(uint64_t **first_lsns) {
+    return list_segments(first_lsns);
+}
+
+// Read-only descriptor for a segment, -1 if it is gone
+int journal_open_segment(uint64_t first_lsn) {
+    char path[256];
+    segment_path(path, sizeof(path), first_lsn);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+// CRC of the frame at offset, -1 if there is no frame header there
+int journal_frame_crc(int fd, off_t offset, uint32_t *crc) {
+    journal_frame_t h;
+    if (pread(fd, &h, sizeof(h), offset) != (ssize_t)sizeof(h) || h.magic != JOURNAL_MAGIC) {
+        return -1;
+    }
+    *crc = h.crc;
+    return 0;
+}
+
+// Walks frame headers from `from` (a frame boundary) and returns the end of
+// the last frame wholly within the first `limit` bytes: the writer appends
+// with one writev, so a frame inside the file size is complete. *tail and
+// *tail_crc get the offset and CRC of that frame (unchanged if none follows
+// from). Payloads are not read; they are checksummed by whoever copies them.
+off_t journal_segment_extent(int fd, off_t from, off_t limit, off_t *tail, uint32_t *tail_crc) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    if (limit > st.st_size) limit = st.st_size;
+    off_t end = from;
+    journal_frame_t h;
+    while (end + (off_t)sizeof(h) <= limit &&
+           pread(fd, &h, sizeof(h), end) == (ssize_t)sizeof(h) &&
+           h.magic == JOURNAL_MAGIC && h.length <= JOURNAL_SEGMENT_BYTES &&
+           end + (off_t)(sizeof(h) + h.length) <= limit) {
+        *tail = end;
+        *tail_crc = h.crc;
+        end += (off_t)(sizeof(h) + h.length);
+    }
+    return end;
+}
@@ -0,0 +1,526 @@
+/* loadgen.c — Bộ phát tải & phát lại dữ liệu cảm biến để đo hiệu năng pipeline
+ *
+ * Chương trình độc lập (giống struct.c), dùng lại parser/collector trong
+ * module sensor:
+ *
+ *   gcc -O2 -pthread -o loadgen loadgen.c frame.c metrics.c validate.c -x c sensor -x none -lm
+ *
+ * Nguồn dữ liệu:
+ *   synth              sinh N cảm biến, mỗi cảm biến một dạng sóng + nhiễu
+ *   replay <file>      phát lại data_log.txt (dạng "YYYY-mm-dd HH:MM:SS T H G")
+ *                      hoặc file .bin chứa các khung nhị phân liên tiếp
+ *
+ * Đích:
+ *   --direct           đưa thẳng vào parse_sensor_data / frame_decoder, rồi
+ *                      validate_records theo lô như tiến trình cha
+ *   (mặc định)         qua cặp pty → start_collector() thật trong tiến trình con
+ *
+ * Tùy chọn:
+ *   -n N               số cảm biến (synth, mặc định 1)
+ *   -r HZ              tần số mẫu mỗi cảm biến (mặc định 10; replay .bin: tổng)
+ *   -d SEC             thời lượng (synth, mặc định 5)
+ *   -p P               số cổng pty / collector (mặc định 1)
+ *   --speed X|max      hệ số tốc độ so với thời gian thật (mặc định 1)
+ *   --binary           gửi khung nhị phân thay vì dòng ASCII
+ *   --seed S           seed cho bộ sinh nhiễu (kết quả lặp lại được)
+ *   --wave [ID:]M=BASE,AMP,PERIOD,NOISE
+ *                      dạng sóng cho metric M (temp|hum|gas), cho một cảm
+ *                      biến ID hoặc tất cả nếu bỏ ID
+ *
+ * Kết quả: số mẫu gửi/nhận, mẫu/giây và phân vị độ trễ đầu-cuối (µs).
+ * Chế độ pty ghi data_log.txt / system_log.txt như collector thật, nên hãy
+ * chạy trong thư mục tạm.
+ */
+
+#define _GNU_SOURCE
+#include "system.h"
+#include "frame.h"
+
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+
+#define LG_MAX_SENSORS  4096
+#define LG_MAX_PORTS    64
+#define LG_SEQ_RING     65536   /* seq nhị phân là 16 bit */
+
+typedef struct {
+    double base, amp, period, noise;
+} wave_t;
+
+typedef struct {
+    int sensor_id;
+    double t_offset;            // giây kể từ mẫu đầu tiên (thời gian "dữ liệu")
+    float temperature, humidity;
+    int gas_ppm;
+} gen_sample_t;
+
+typedef enum { SRC_SYNTH, SRC_REPLAY_TEXT, SRC_REPLAY_BIN } source_kind_t;
+
+static struct {
+    source_kind_t src;
+    const char* replay_path;
+    int n_sensors, n_ports, direct, binary;
+    double rate, duration, speed;     // speed = 0 → tối đa
+    uint64_t seed;
+    wave_t wave[LG_MAX_SENSORS][3];
+} opt = {
+    .src = SRC_SYNTH, .n_sensors = 1, .n_ports = 1,
+    .rate = 10.0, .duration = 5.0, .speed = 1.0, .seed = 1,
+};
+
+
+/* =====================================
+ * TIỆN ÍCH THỜI GIAN / NGẪU NHIÊN
+ * ===================================== */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t) {
+    struct timespec ts = { (time_t)(t / 1000000000ull), (long)(t % 1000000000ull) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+// xorshift64* — nhanh và lặp lại được theo seed
+static uint64_t rng_state;
+static double rng_uniform(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 2685821657736338717ull) >> 11) / 9007199254740992.0;
+}
+
+static double rng_gauss(void) {
+    double u = rng_uniform(), v = rng_uniform();
+    if (u < 1e-300) u = 1e-300;
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+
+/* =====================================
+ * NGUỒN DỮ LIỆU
+ * ===================================== */
+
+static FILE* replay_fp;
+static time_t replay_t0 = -1;
+static uint64_t gen_index;
+
+static float wave_value(const wave_t* w, double t, int sensor_id) {
+    double phase = w->period > 0 ? 2.0 * M_PI * (t / w->period + sensor_id * 0.137) : 0.0;
+    return (float)(w->base + w->amp * sin(phase) + w->noise * rng_gauss());
+}
+
+// Trả về 1 nếu có mẫu, 0 nếu hết nguồn
+static int next_sample(gen_sample_t* s) {
+    if (opt.src == SRC_SYNTH) {
+        uint64_t k = gen_index++;
+        int id = (int)(k % (uint64_t)opt.n_sensors);
+        s->t_offset = (double)(k / (uint64_t)opt.n_sensors) / opt.rate;
+        if (s->t_offset >= opt.duration) return 0;
+        s->sensor_id = id + 1;
+        s->temperature = wave_value(&opt.wave[id][0], s->t_offset, id);
+        s->humidity = wave_value(&opt.wave[id][1], s->t_offset, id);
+        s->gas_ppm = (int)lround(wave_value(&opt.wave[id][2], s->t_offset, id));
+        if (s->humidity < 0) s->humidity = 0;
+        if (s->gas_ppm < 0) s->gas_ppm = 0;
+        return 1;
+    }
+
+    if (opt.src == SRC_REPLAY_BIN) {
+        uint8_t fr[FRAME_SIZE];
+        frame_sample_t fs;
+        for (;;) {
+            int c = fgetc(replay_fp);
+            if (c == EOF) return 0;
+            if (c != FRAME_SYNC) continue;          // tự đồng bộ lại
+            fr[0] = (uint8_t)c;
+            if (fread(fr + 1, 1, FRAME_SIZE - 1, replay_fp) != FRAME_SIZE - 1) return 0;
+            if (frame_decode(fr, &fs) == 0) break;
+            fseek(replay_fp, -(long)(FRAME_SIZE - 1), SEEK_CUR);
+        }
+        s->sensor_id = fs.sensor_id;
+        s->temperature = fs.temperature;
+        s->humidity = fs.humidity;
+        s->gas_ppm = fs.gas_ppm;
+        s->t_offset = (double)gen_index++ / opt.rate;
+        return 1;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), replay_fp)) {
+        struct tm tmv;
+        memset(&tmv, 0, sizeof(tmv));
+        float t, h;
+        int g;
+        if (sscanf(line, "%d-%d-%d %d:%d:%d %f %f %d",
+                   &tmv.tm_year, &tmv.tm_mon, &tmv.tm_mday,
+                   &tmv.tm_hour, &tmv.tm_min, &tmv.tm_sec, &t, &h, &g) != 9)
+            continue;
+        tmv.tm_year -= 1900;
+        tmv.tm_mon -= 1;
+        tmv.tm_isdst = -1;
+        time_t ts = mktime(&tmv);
+        if (replay_t0 < 0) replay_t0 = ts;
+        s->sensor_id = 1;
+        s->temperature = t;
+        s->humidity = h;
+        s->gas_ppm = g;
+        s->t_offset = difftime(ts, replay_t0);
+        gen_index++;
+        return 1;
+    }
+    return 0;
+}
+
+// Mã hóa mẫu thành dòng ASCII hoặc khung nhị phân, trả về số byte
+static size_t encode_sample(const gen_sample_t* s, uint16_t seq, uint8_t* out, size_t cap) {
+    if (opt.binary) {
+        frame_sample_t fs = { (uint8_t)s->sensor_id, seq, s->temperature, s->humidity, s->gas_ppm };
+        return frame_encode(out, &fs);
+    }
+    int n = snprintf((char*)out, cap, "%.2f %.2f %d\n", s->temperature, s->humidity, s->gas_ppm);
+    return n > 0 ? (size_t)n : 0;
+}
+
+
+/* =====================================
+ * THU THẬP ĐỘ TRỄ
+ * ===================================== */
+
+static uint64_t* lat_ns;
+static size_t lat_count, lat_cap;
+static pthread_mutex_t lat_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void record_latency(uint64_t ns) {
+    if (lat_count == lat_cap) {
+        size_t ncap = lat_cap ? lat_cap * 2 : 65536;
+        uint64_t* p = realloc(lat_ns, ncap * sizeof(*p));
+        if (!p) return;
+        lat_ns = p;
+        lat_cap = ncap;
+    }
+    lat_ns[lat_count++] = ns;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(double p) {
+    if (lat_count == 0) return 0.0;
+    size_t idx = (size_t)(p / 100.0 * (double)(lat_count - 1) + 0.5);
+    return (double)lat_ns[idx] / 1000.0;
+}
+
+
+/* =====================================
+ * ĐÍCH 1: ĐƯA THẲNG VÀO PARSER
+ * ===================================== */
+
+/* Như tiến trình cha: mẫu gom thành lô rồi qua validate_records một lần.
+ * Thời gian parse/giải mã và validate được cộng riêng để so sánh. */
+#define LG_BATCH        256     /* = SUPERVISOR_READ_RECORDS */
+
+static uint64_t parse_ns, validate_ns, valid_count;
+
+static void validate_batch(sensor_data_t* batch, size_t* n) {
+    validate_counts_t rejected = { { 0 } };
+    uint64_t t0 = now_ns();
+    valid_count += validate_records(batch, *n, &rejected);
+    validate_ns += now_ns() - t0;
+    *n = 0;
+}
+
+static void batch_add(sensor_data_t* batch, size_t* n, float t, float h, int g, int id) {
+    batch[*n] = (sensor_data_t){ .temperature = t, .humidity = h, .gas_level = (float)g,
+                                 .sensor_id = id, .quality = 100 };
+    (*n)++;
+    if (*n == LG_BATCH) validate_batch(batch, n);
+}
+
+static uint64_t run_direct(void) {
+    frame_decoder_t dec;
+    frame_decoder_init(&dec, FRAME_MODE_AUTO);
+    frame_event_t ev;
+    uint8_t buf[256];
+    gen_sample_t s;
+    sensor_data_t batch[LG_BATCH];
+    size_t batched = 0;
+    uint64_t sent = 0, t_start = now_ns();
+
+    while (next_sample(&s)) {
+        if (opt.speed > 0) sleep_until_ns(t_start + (uint64_t)(s.t_offset / opt.speed * 1e9));
+
+        uint64_t t0 = now_ns();
+        size_t n = encode_sample(&s, (uint16_t)sent, buf, sizeof(buf));
+        SensorData sd;
+        uint64_t t1 = now_ns();
+        if (opt.binary) {
+            frame_decoder_feed(&dec, buf, n);
+            while (frame_decoder_next(&dec, &ev)) {
+                if (ev.kind == FRAME_EV_BINARY)
+                    batch_add(batch, &batched, ev.sample.temperature, ev.sample.humidity,
+                              ev.sample.gas_ppm, ev.sample.sensor_id);
+            }
+        } else {
+            buf[n - 1] = '\0';
+            if (parse_sensor_data((const char*)buf, &sd) == 0)
+                batch_add(batch, &batched, sd.temperature, sd.humidity, sd.gas_ppm, s.sensor_id);
+        }
+        uint64_t t2 = now_ns();
+        parse_ns += t2 - t1;    // gồm cả các lần validate_batch, trừ ra khi in
+        record_latency(t2 - t0);
+        sent++;
+    }
+    if (batched > 0) validate_batch(batch, &batched);
+    return sent;
+}
+
+
+/* =====================================
+ * ĐÍCH 2: QUA PTY → start_collector()
+ * =====================================
+ * Mỗi cổng: một cặp pty + một pipe + một tiến trình con chạy
+ * start_collector(pipe, "/dev/pts/N"). Luồng đọc nhận SensorData từ các pipe
+ * và ghép với thời điểm gửi theo seq để tính độ trễ.
+ */
+
+typedef struct {
+    int master_fd, pipe_rd;
+    pid_t pid;
+    uint32_t sent;              // luồng gửi ghi, luồng đọc đọc: chỉ qua __atomic
+    uint64_t* sent_at;          // [LG_SEQ_RING], cũng qua __atomic
+    uint8_t rxbuf[sizeof(SensorData)];
+    size_t rxlen;
+} port_t;
+
+static port_t ports[LG_MAX_PORTS];
+static int generator_done;         // __atomic
+static uint64_t received;
+
+static int open_port(port_t* p) {
+    p->master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (p->master_fd < 0 || grantpt(p->master_fd) != 0 || unlockpt(p->master_fd) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    struct termios tio;
+    if (tcgetattr(p->master_fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(p->master_fd, TCSANOW, &tio);
+    }
+    char slave[128];
+    if (ptsname_r(p->master_fd, slave, sizeof(slave)) != 0) return -1;
+
+    int pfd[2];
+    if (pipe(pfd) != 0) return -1;
+    p->pid = fork();
+    if (p->pid < 0) return -1;
+    if (p->pid == 0) {
+        close(pfd[0]);
+        close(p->master_fd);
+        start_collector(pfd[1], slave);
+        _exit(0);
+    }
+    close(pfd[1]);
+    p->pipe_rd = pfd[0];
+    p->sent_at = calloc(LG_SEQ_RING, sizeof(uint64_t));
+    return p->sent_at ? 0 : -1;
+}
+
+static void* reader_thread(void* arg) {
+    (void)arg;
+    struct pollfd pfds[LG_MAX_PORTS];
+    for (int i = 0; i < opt.n_ports; i++) {
+        pfds[i].fd = ports[i].pipe_rd;
+        pfds[i].events = POLLIN;
+    }
+
+    uint64_t idle_since = 0;
+    for (;;) {
+        int rc = poll(pfds, (nfds_t)opt.n_ports, 100);
+        uint64_t now = now_ns();
+        if (rc <= 0) {
+            if (!__atomic_load_n(&generator_done, __ATOMIC_ACQUIRE)) continue;
+            uint64_t total_sent = 0;
+            for (int i = 0; i < opt.n_ports; i++) total_sent += __atomic_load_n(&ports[i].sent, __ATOMIC_ACQUIRE);
+            if (received >= total_sent) break;
+            if (!idle_since) idle_since = now;
+            if (now - idle_since > 3000000000ull) break;     // 3s không nhận được gì
+            continue;
+        }
+        idle_since = 0;
+
+        for (int i = 0; i < opt.n_ports; i++) {
+            if (!(pfds[i].revents & (POLLIN | POLLHUP))) continue;
+            port_t* p = &ports[i];
+            ssize_t r = read(p->pipe_rd, p->rxbuf + p->rxlen, sizeof(p->rxbuf) - p->rxlen);
+            if (r <= 0) continue;
+            p->rxlen += (size_t)r;
+            if (p->rxlen < sizeof(SensorData)) continue;
+
+            SensorData sd;
+            memcpy(&sd, p->rxbuf, sizeof(sd));
+            p->rxlen = 0;
+            pthread_mutex_lock(&lat_lock);
+            record_latency(now - __atomic_load_n(&p->sent_at[sd.seq % LG_SEQ_RING], __ATOMIC_RELAXED));
+            received++;
+            pthread_mutex_unlock(&lat_lock);
+        }
+    }
+    return NULL;
+}
+
+static uint64_t run_pty(void) {
+    for (int i = 0; i < opt.n_ports; i++) {
+        if (open_port(&ports[i]) != 0) {
+            fprintf(stderr, "Không tạo được cổng pty %d\n", i);
+            return 0;
+        }
+    }
+    usleep(300000);     // chờ collector mở và cấu hình cổng
+
+    pthread_t th;
+    pthread_create(&th, NULL, reader_thread, NULL);
+
+    uint8_t buf[256];
+    gen_sample_t s;
+    uint64_t sent = 0, t_start = now_ns();
+    while (next_sample(&s)) {
+        if (opt.speed > 0) sleep_until_ns(t_start + (uint64_t)(s.t_offset / opt.speed * 1e9));
+        port_t* p = &ports[(s.sensor_id > 0 ? s.sensor_id - 1 : 0) % opt.n_ports];
+        uint32_t seq = __atomic_load_n(&p->sent, __ATOMIC_RELAXED);     // chỉ luồng này ghi
+        size_t n = encode_sample(&s, (uint16_t)seq, buf, sizeof(buf));
+        __atomic_store_n(&p->sent_at[seq % LG_SEQ_RING], now_ns(), __ATOMIC_RELAXED);
+        if (write(p->master_fd, buf, n) != (ssize_t)n) break;
+        __atomic_fetch_add(&p->sent, 1, __ATOMIC_RELEASE);
+        sent++;
+    }
+    __atomic_store_n(&generator_done, 1, __ATOMIC_RELEASE);
+    pthread_join(th, NULL);
+
+    for (int i = 0; i < opt.n_ports; i++) {
+        kill(ports[i].pid, SIGTERM);
+        waitpid(ports[i].pid, NULL, 0);
+        close(ports[i].master_fd);
+        close(ports[i].pipe_rd);
+        free(ports[i].sent_at);
+    }
+    return sent;
+}
+
+
+/* =====================================
+ * THAM SỐ DÒNG LỆNH
+ * ===================================== */
+
+static void usage(void) {
+    fprintf(stderr,
+        "Usage: loadgen synth|replay <file> [-n N] [-r HZ] [-d SEC] [-p PORTS]\n"
+        "               [--speed X|max] [--direct] [--binary] [--seed S]\n"
+        "               [--wave [ID:]temp|hum|gas=BASE,AMP,PERIOD,NOISE]\n");
+    exit(2);
+}
+
+static int parse_wave(const char* spec) {
+    int id = -1;
+    const char* colon = strchr(spec, ':');
+    if (colon) {
+        id = atoi(spec) - 1;
+        spec = colon + 1;
+        if (id < 0 || id >= LG_MAX_SENSORS) return -1;
+    }
+    int m;
+    if (strncmp(spec, "temp=", 5) == 0) m = 0;
+    else if (strncmp(spec, "hum=", 4) == 0) m = 1;
+    else if (strncmp(spec, "gas=", 4) == 0) m = 2;
+    else return -1;
+
+    wave_t w;
+    if (sscanf(strchr(spec, '=') + 1, "%lf,%lf,%lf,%lf", &w.base, &w.amp, &w.period, &w.noise) != 4)
+        return -1;
+    for (int i = 0; i < LG_MAX_SENSORS; i++)
+        if (id < 0 || i == id) opt.wave[i][m] = w;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const wave_t defaults[3] = { { 25.0, 5.0, 600.0, 0.2 }, { 60.0, 10.0, 900.0, 0.5 }, { 200.0, 50.0, 300.0, 5.0 } };
+    for (int i = 0; i < LG_MAX_SENSORS; i++)
+        memcpy(opt.wave[i], defaults, sizeof(defaults));
+
+    if (argc < 2) usage();
+    int a = 1;
+    if (strcmp(argv[a], "synth") == 0) {
+        a++;
+    } else if (strcmp(argv[a], "replay") == 0 && argc > 2) {
+        opt.replay_path = argv[a + 1];
+        size_t len = strlen(opt.replay_path);
+        opt.src = (len > 4 && strcmp(opt.replay_path + len - 4, ".bin") == 0) ? SRC_REPLAY_BIN : SRC_REPLAY_TEXT;
+        a += 2;
+    } else {
+        usage();
+    }
+
+    for (; a < argc; a++) {
+        const char* s = argv[a];
+        const char* v = (a + 1 < argc) ? argv[a + 1] : NULL;
+        if (strcmp(s, "--direct") == 0) opt.direct = 1;
+        else if (strcmp(s, "--binary") == 0) opt.binary = 1;
+        else if (!v) usage();
+        else if (strcmp(s, "-n") == 0) { opt.n_sensors = atoi(v); a++; }
+        else if (strcmp(s, "-r") == 0) { opt.rate = atof(v); a++; }
+        else if (strcmp(s, "-d") == 0) { opt.duration = atof(v); a++; }
+        else if (strcmp(s, "-p") == 0) { opt.n_ports = atoi(v); a++; }
+        else if (strcmp(s, "--seed") == 0) { opt.seed = strtoull(v, NULL, 10); a++; }
+        else if (strcmp(s, "--speed") == 0) { opt.speed = strcmp(v, "max") == 0 ? 0.0 : atof(v); a++; }
+        else if (strcmp(s, "--wave") == 0) { if (parse_wave(v) != 0) usage(); a++; }
+        else usage();
+    }
+    if (opt.n_sensors < 1 || opt.n_sensors > LG_MAX_SENSORS || opt.rate <= 0 ||
+        opt.n_ports < 1 || opt.n_ports > LG_MAX_PORTS || opt.speed < 0)
+        usage();
+
+    rng_state = opt.seed ? opt.seed : 1;
+    if (opt.replay_path) {
+        replay_fp = fopen(opt.replay_path, opt.src == SRC_REPLAY_BIN ? "rb" : "r");
+        if (!replay_fp) {
+            perror(opt.replay_path);
+            return 1;
+        }
+    }
+
+    uint64_t t0 = now_ns();
+    uint64_t sent = opt.direct ? run_direct() : run_pty();
+    double elapsed = (double)(now_ns() - t0) / 1e9;
+    uint64_t done = opt.direct ? sent : received;
+
+    qsort(lat_ns, lat_count, sizeof(uint64_t), cmp_u64);
+    printf("=== LOADGEN ===\n");
+    printf("Mode:        %s / %s / %s\n",
+           opt.src == SRC_SYNTH ? "synth" : "replay",
+           opt.direct ? "direct" : "pty",
+           opt.binary ? "binary" : "ascii");
+    printf("Sent:        %llu\n", (unsigned long long)sent);
+    printf("Received:    %llu\n", (unsigned long long)done);
+    printf("Elapsed:     %.3f s\n", elapsed);
+    printf("Throughput:  %.0f samples/s\n", elapsed > 0 ? (double)done / elapsed : 0.0);
+    printf("Latency(us): p50 %.1f | p90 %.1f | p99 %.1f | p99.9 %.1f | max %.1f\n",
+           percentile_us(50), percentile_us(90), percentile_us(99), percentile_us(99.9),
+           percentile_us(100));
+    if (opt.direct && sent > 0) {
+        printf("Valid:       %llu\n", (unsigned long long)valid_count);
+        printf("Stage(ns):   parse %.1f | validate %.1f per sample\n",
+               (double)(parse_ns - validate_ns) / (double)sent, (double)validate_ns / (double)sent);
+    }
+
+    if (replay_fp) fclose(replay_fp);
+    free(lat_ns);
+    return 0;
+}
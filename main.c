@@ -1,4 +1,10 @@
 #include "system.h"
+#include "metrics.h"
+#include "anomaly.h"
+#include "query.h"
+
+#include <poll.h>
+#include <signal.h>
 
 // ============================================================================
 // GLOBAL VARIABLES
@@ -7,16 +13,39 @@
 int current_mode = USER_MODE;
 int system_running = 1;
 
+config_t system_config = {
+    .auto_collect_interval = 2,
+    .data_retention_days = 30,
+    .arduino_device = ARDUINO_DEVICE,
+    .baud_rate = 9600,
+    .max_records = MAX_DATA_RECORDS,
+    .auto_mode_enabled = 1,
+    .collector_count = 0,
+    .dashboard_refresh_hz = DASHBOARD_DEFAULT_HZ,
+    .journal_commit_ms = JOURNAL_COMMIT_MS,
+    .journal_commit_records = JOURNAL_COMMIT_RECORDS,
+    .snapshot_interval_s = SNAPSHOT_INTERVAL_S,
+    .reorder_window_s = REORDER_WINDOW_S,
+    .trace_sample_every = TRACE_SAMPLE_EVERY,
+    .tier_raw_days = TIER_RAW_DAYS,
+    .tier_minute_days = TIER_MINUTE_DAYS,
+    .compact_kbps = TIER_COMPACT_KBPS,
+};
+
 // Mock data for demonstration
 sensor_data_t mock_data[] = {
-    {1640995200, 25.5, 60.2, 120.0, 1, 95},
-    {1640995260, 26.1, 58.9, 115.5, 1, 92},
-    {1640995320, 24.8, 62.1, 118.3, 1, 88},
-    {1640995380, 27.2, 55.4, 122.1, 1, 96},
-    {1640995440, 25.9, 59.8, 119.7, 1, 94}
+    { .timestamp = 1640995200, .temperature = 25.5, .humidity = 60.2, .gas_level = 120.0, .sensor_id = 1, .quality = 95 },
+    { .timestamp = 1640995260, .temperature = 26.1, .humidity = 58.9, .gas_level = 115.5, .sensor_id = 1, .quality = 92 },
+    { .timestamp = 1640995320, .temperature = 24.8, .humidity = 62.1, .gas_level = 118.3, .sensor_id = 1, .quality = 88 },
+    { .timestamp = 1640995380, .temperature = 27.2, .humidity = 55.4, .gas_level = 122.1, .sensor_id = 1, .quality = 96 },
+    { .timestamp = 1640995440, .temperature = 25.9, .humidity = 59.8, .gas_level = 119.7, .sensor_id = 1, .quality = 94 }
 };
 int mock_data_count = 5;
 
+static int read_line(char *buf, size_t size);
+static void set_trace_sampling(void);
+static void set_storage_tiers(void);
+
 // ============================================================================
 // MAIN PROGRAM
 // ============================================================================
@@ -46,7 +75,10 @@ int main() {
                 run_auto_mode();
                 break;
             case 4:
-                run_simulation_test();
+                run_process_test();
+                break;
+            case 5:
+                run_dashboard_mode();
                 break;
             case 0:
                 printf("Goodbye!\n");
@@ -70,30 +102,74 @@ int main() {
 void init_system(void) {
     printf("Initializing system...\n");
     
-    // Initialize simulation system first
-    init_simulation_system();
+    // Metrics shards must exist before any collector is forked
+    metrics_init();
+    metrics_thread_register("main");
+    if (metrics_serve(METRICS_SOCKET_PATH) != 0) {
+        printf("Warning: metrics socket %s unavailable\n", METRICS_SOCKET_PATH);
+    }
     
     // Initialize data structures
-    data_count = 0;
+    store_clear();
     recent_data_count = 0;
     stats_updated = 0;
     
-    // Load mock data for demonstration
-    for (int i = 0; i < mock_data_count; i++) {
-        sensor_data[data_count] = mock_data[i];
-        data_count++;
+    // Map the last snapshot, then replay the journal written after it;
+    // start from mock data on first run
+    uint64_t t0 = metrics_now_ns();
+    uint64_t lsn = 0;
+    int loaded = snapshot_load(&lsn);
+    if (loaded > 0) {
+        printf("Loaded %d records from snapshot\n", loaded);
+    }
+    int replayed = loaded == SNAPSHOT_INCOMPATIBLE ? 0 : journal_open(lsn);
+    if (loaded == SNAPSHOT_INCOMPATIBLE || replayed == JOURNAL_INCOMPATIBLE) {
+        // Starting would overwrite the old samples with new ones: stop here,
+        // nothing has been changed on disk
+        printf("Error: %s was written with a different sensor schema (see %s).\n",
+               loaded == SNAPSHOT_INCOMPATIBLE ? SNAPSHOT_FILE : JOURNAL_DIR "/", SYSTEM_LOG_FILE);
+        printf("Export the data with the previous build, then move %s and %s/ away.\n",
+               SNAPSHOT_FILE, JOURNAL_DIR);
+        metrics_stop();
+        exit(1);
+    }
+    if (replayed < 0) {
+        printf("Warning: journal unavailable, data will not survive a restart\n");
+    } else if (replayed > 0) {
+        printf("Recovered %d records from the journal\n", replayed);
+    }
+    if (loaded > 0 || replayed > 0) {
+        printf("Startup recovery took %.1f ms\n", (double)(metrics_now_ns() - t0) / 1e6);
+    }
+    if (store_size() == 0) {
+        ingest_records(mock_data, mock_data_count);
+    }
+    if (tier_open() != 0) {
+        printf("Warning: %s unavailable, old data will not be compacted\n", TIER_DIR);
     }
     
     // Calculate initial statistics
     calculate_statistics();
     
+    // Local tools query the loaded data from here on
+    if (query_serve(QUERY_SOCKET_PATH) != 0) {
+        printf("Warning: query socket %s unavailable\n", QUERY_SOCKET_PATH);
+    }
+    
     printf("System initialized successfully!\n");
-    printf("Loaded %d data records\n", data_count);
-    printf("Simulation system ready (fork() and pipe() available)\n\n");
+    printf("Loaded %d data records\n", get_data_count());
+    printf("Collector supervisor ready (fork() and pipe())\n\n");
 }
 
 void shutdown_system(void) {
     printf("\nShutting down system...\n");
+    query_stop();
+    if (snapshot_save() != 0) {
+        printf("Warning: snapshot failed, the journal will be replayed on next start\n");
+    }
+    journal_close();
+    tier_close();
+    metrics_stop();
     printf("System shutdown completed.\n");
 }
 
@@ -110,7 +186,8 @@ void show_main_menu(void) {
     printf("   - View recently data\n");
     printf("   - Statistics max/min/average\n");
     printf("   - Display ASCII chart\n");
-    printf("   - Export report\n\n");
+    printf("   - Export report\n");
+    printf("   - Sensor overview\n\n");
     
     printf("2. ADMIN MODE\n");
     printf("   - Delete old data\n");
@@ -120,8 +197,11 @@ void show_main_menu(void) {
     printf("3. AUTO MODE\n");
     printf("   - Collect data automatically\n\n");
     
-    printf("4. SIMULATION TEST\n");
-    printf("   - Test fork() and pipe() simulation\n\n");
+    printf("4. PROCESS TEST\n");
+    printf("   - Test fork() and pipe()\n\n");
+    
+    printf("5. LIVE DASHBOARD\n");
+    printf("   - Collect data with live per-sensor view\n\n");
     
     printf("0. Exit\n\n");
     printf("Enter your choice: ");
@@ -154,6 +234,9 @@ void run_user_mode(void) {
             case 4:
                 user_export_report();
                 break;
+            case 5:
+                user_view_sensors();
+                break;
             case 0:
                 return; // Back to main menu
             default:
@@ -170,34 +253,51 @@ void show_user_menu(void) {
     printf("2. Statistics max/min/average\n");
     printf("3. Display ASCII chart\n");
     printf("4. Export report\n");
+    printf("5. Sensor overview\n");
     printf("0. Back to main menu\n\n");
     printf("Enter your choice: ");
 }
 
 // USER MODE FUNCTIONS
 int user_view_recent_data(void) {
-    printf("\n=== RECENT DATA ===\n\n");
+    // Opens on the newest page; only the visible rows are formatted
+    view_store_table("RECENT DATA", store_first(), store_end());
+    return 0;
+}
+
+// Fixed-bucket histogram as horizontal bars, empty edge buckets skipped
+static void print_histogram(const char *title, int field, const char *unit) {
+    sketch_hist_t h;
+    if (get_histogram(field, SENSOR_ID_ALL, &h) <= 0) {
+        return;
+    }
     
-    printf("%-20s %-8s %-8s %-8s %-6s\n", 
-           "Timestamp", "Temp(°C)", "Humidity(%)", "Gas(ppm)", "Quality");
-    printf("------------------------------------------------------------\n");
+    int first = 0, last = h.nbins - 1;
+    while (first < last && h.bins[first] == 0) first++;
+    while (last > first && h.bins[last] == 0) last--;
     
-    int count = (data_count > 10) ? 10 : data_count;
-    for (int i = data_count - count; i < data_count; i++) {
-        char time_str[32];
-        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", 
-                localtime(&sensor_data[i].timestamp));
-        
-        printf("%-20s %-8.1f %-8.1f %-8.1f %-6d\n",
-               time_str,
-               sensor_data[i].temperature,
-               sensor_data[i].humidity,
-               sensor_data[i].gas_level,
-               sensor_data[i].quality);
+    uint64_t peak = 1;
+    for (int i = first; i <= last; i++) {
+        if (h.bins[i] > peak) peak = h.bins[i];
     }
     
-    wait_for_enter();
-    return 0;
+    printf("%s histogram:\n", title);
+    if (h.under > 0) {
+        printf("  %10s < %-7.0f %8llu\n", "", h.lo, (unsigned long long)h.under);
+    }
+    for (int i = first; i <= last; i++) {
+        float lo = h.lo + h.width * i;
+        int len = (int)(h.bins[i] * 40 / peak);
+        printf("  %7.0f..%-7.0f %-4s %8llu ", lo, lo + h.width, unit,
+               (unsigned long long)h.bins[i]);
+        for (int j = 0; j < len; j++) putchar('#');
+        putchar('\n');
+    }
+    if (h.over > 0) {
+        printf("  %10s >= %-6.0f %8llu\n", "", h.lo + h.width * h.nbins,
+               (unsigned long long)h.over);
+    }
+    printf("\n");
 }
 
 int user_show_statistics(void) {
@@ -206,23 +306,39 @@ int user_show_statistics(void) {
     if (!stats_updated) {
         calculate_statistics();
     }
+    statistics_t st;
+    get_statistics(&st);
+    
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        const char *unit = sensor_fields[f].unit;
+        printf("%s:\n", sensor_fields[f].label);
+        printf("  Max: %.1f %s\n", st.max[f], unit);
+        printf("  Min: %.1f %s\n", st.min[f], unit);
+        printf("  Average: %.1f %s\n", st.avg[f], unit);
+        printf("  P50/P95/P99: %.1f / %.1f / %.1f %s\n\n",
+               st.p50[f], st.p95[f], st.p99[f], unit);
+    }
     
-    printf("Temperature:\n");
-    printf("  Max: %.1f°C\n", global_stats.temp_max);
-    printf("  Min: %.1f°C\n", global_stats.temp_min);
-    printf("  Average: %.1f°C\n\n", global_stats.temp_avg);
-    
-    printf("Humidity:\n");
-    printf("  Max: %.1f%%\n", global_stats.humidity_max);
-    printf("  Min: %.1f%%\n", global_stats.humidity_min);
-    printf("  Average: %.1f%%\n\n", global_stats.humidity_avg);
+    printf("Total Records: %d\n\n", st.total_records);
+    
+    // Same window as is_recent_data(), to the minute; cached, so reopening
+    // this screen only scans what arrived since
+    statistics_t recent;
+    time_t now = get_current_time();
+    if (cache_statistics(SENSOR_ID_ALL, now - 3600, now + 1, 60, &recent) > 0) {
+        printf("Last hour: %d records (min/avg/max)\n", recent.total_records);
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+            printf("  %-12s %.1f / %.1f / %.1f %s\n", sensor_fields[f].label,
+                   recent.min[f], recent.avg[f], recent.max[f], sensor_fields[f].unit);
+        }
+        printf("\n");
+    }
     
-    printf("Gas Level:\n");
-    printf("  Max: %.1f ppm\n", global_stats.gas_max);
-    printf("  Min: %.1f ppm\n", global_stats.gas_min);
-    printf("  Average: %.1f ppm\n\n", global_stats.gas_avg);
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        print_histogram(sensor_fields[f].label, f + 1, sensor_fields[f].unit);
+    }
     
-    printf("Total Records: %d\n", global_stats.total_records);
+    print_report_statistics(stdout);
     
     wait_for_enter();
     return 0;
@@ -232,27 +348,17 @@ int user_display_ascii_chart(void) {
     printf("\n=== ASCII CHART ===\n\n");
     
     printf("Select chart type:\n");
-    printf("1. Temperature\n");
-    printf("2. Humidity\n");
-    printf("3. Gas Level\n");
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        printf("%d. %s\n", f + 1, sensor_fields[f].label);
+    }
     printf("0. Back\n\n");
     printf("Enter your choice: ");
     
     int choice = get_user_choice();
-    
-    switch (choice) {
-        case 1:
-            display_temperature_chart(24);
-            break;
-        case 2:
-            display_humidity_chart(24);
-            break;
-        case 3:
-            display_gas_chart(24);
-            break;
-        default:
-            return 0;
+    if (choice < 1 || choice > SENSOR_FIELD_COUNT) {
+        return 0;
     }
+    display_field_chart(choice, 24);
     
     wait_for_enter();
     return 0;
@@ -263,11 +369,14 @@ int user_export_report(void) {
     
     char filename[256];
     printf("Enter filename (without extension): ");
-    scanf("%s", filename);
+    if (read_line(filename, sizeof(filename) - 8) != 0 || filename[0] == '\0') {
+        return 0;
+    }
     
     printf("\nSelect format:\n");
     printf("1. Text file (.txt)\n");
     printf("2. CSV file (.csv)\n");
+    printf("3. Arrow/Feather file (.arrow) for pandas, pyarrow\n");
     printf("0. Back\n\n");
     printf("Enter your choice: ");
     
@@ -282,6 +391,10 @@ int user_export_report(void) {
             strcat(filename, ".csv");
             export_to_csv(filename);
             break;
+        case 3:
+            strcat(filename, ".arrow");
+            export_to_arrow(filename);
+            break;
         default:
             return 0;
     }
@@ -290,6 +403,78 @@ int user_export_report(void) {
     return 0;
 }
 
+int user_view_sensors(void) {
+    printf("\n=== SENSOR OVERVIEW ===\n\n");
+    
+    int ids[SENSOR_MAX_SLOTS];
+    int count = sensor_dir_ids(ids, SENSOR_MAX_SLOTS);
+    if (count == 0) {
+        printf("No sensor data available.\n");
+        wait_for_enter();
+        return 0;
+    }
+    if (count > SENSOR_MAX_SLOTS) count = SENSOR_MAX_SLOTS;
+    
+    // One column per field, headed by its key and unit ("T(°C)")
+    char heads[SENSOR_FIELD_COUNT][24];
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        snprintf(heads[f], sizeof(heads[f]), "%c(%s)", sensor_fields[f].key, sensor_fields[f].unit);
+    }
+
+    printf("%-7s %-9s %-20s", "Sensor", "Samples", "Last seen");
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) printf(" %-*s", display_pad(heads[f], 8), heads[f]);
+    printf(" %c Avg    %-9s\n", sensor_fields[0].key, "Anomalies");
+    printf("------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < count; i++) {
+        const sensor_info_t *info = sensor_dir_get(ids[i]);
+        char time_str[32];
+        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S",
+                 localtime(&info->last_seen));
+        printf("%-7d %-9lu %-20s", info->sensor_id, info->count, time_str);
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) printf(" %-8.1f", info->last.values[f]);
+        printf(" %-8.1f %-9lu\n", (float)(info->sum[0] / info->count), info->anomalies);
+    }
+    
+    printf("\nEnter sensor ID for details (-1 to go back): ");
+    int id = get_user_choice();
+    const sensor_info_t *info = sensor_dir_get(id);
+    if (!info) {
+        return 0;
+    }
+    
+    statistics_t st;
+    calculate_sensor_statistics(id, &st);
+    printf("\n=== SENSOR %d ===\n\n", id);
+    printf("%-12s %8s %8s %8s %8s %8s %8s\n", "", "Min", "Avg", "Max", "P50", "P95", "P99");
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        printf("%-*s %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", display_pad(heads[f], 12), heads[f],
+               st.min[f], st.avg[f], st.max[f], st.p50[f], st.p95[f], st.p99[f]);
+    }
+    printf("\n");
+    
+    // Last 10 records of this sensor straight from its index
+    printf("%-20s", "Timestamp");
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) printf(" %-*s", display_pad(heads[f], 8), heads[f]);
+    printf(" %-6s\n", "Quality");
+    printf("------------------------------------------------------------\n");
+    size_t n = sensor_record_count(id);
+    for (size_t k = (n > 10) ? n - 10 : 0; k < n; k++) {
+        const sensor_data_t *d = sensor_record_at(id, k);
+        char time_str[32];
+        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S",
+                 localtime(&d->timestamp));
+        printf("%-20s", time_str);
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) printf(" %-8.1f", d->values[f]);
+        printf(" %-3d %s\n", d->quality, anomaly_name(anomaly_from_quality(d->quality)));
+    }
+    
+    printf("\nBrowse all records of sensor %d? (1 = yes, 0 = no): ", id);
+    if (get_user_choice() == 1) {
+        view_sensor_table(id);
+    }
+    return 0;
+}
+
 // ============================================================================
 // ADMIN MODE
 // ============================================================================
@@ -314,6 +499,12 @@ void run_admin_mode(void) {
             case 3:
                 admin_arduino_control();
                 break;
+            case 4:
+                admin_backup_restore();
+                break;
+            case 5:
+                admin_import_stations();
+                break;
             case 0:
                 return; // Back to main menu
             default:
@@ -329,6 +520,8 @@ void show_admin_menu(void) {
     printf("1. Delete old data\n");
     printf("2. Configure system\n");
     printf("3. Arduino control\n");
+    printf("4. Backup / restore\n");
+    printf("5. Import station files\n");
     printf("0. Back to main menu\n\n");
     printf("Enter your choice: ");
 }
@@ -337,7 +530,7 @@ void show_admin_menu(void) {
 int admin_delete_old_data(void) {
     printf("\n=== DELETE OLD DATA ===\n\n");
     
-    printf("Current data records: %d\n\n", data_count);
+    printf("Current data records: %d\n\n", get_data_count());
     
     printf("Select action:\n");
     printf("1. Delete records older than 7 days\n");
@@ -374,6 +567,8 @@ int admin_configure_system(void) {
     printf("2. Set data retention period\n");
     printf("3. Set Arduino device path\n");
     printf("4. View current configuration\n");
+    printf("5. Set latency trace sampling\n");
+    printf("6. Set storage tiers\n");
     printf("0. Back\n\n");
     printf("Enter your choice: ");
     
@@ -392,6 +587,12 @@ int admin_configure_system(void) {
         case 4:
             show_configuration();
             break;
+        case 5:
+            set_trace_sampling();
+            break;
+        case 6:
+            set_storage_tiers();
+            break;
         default:
             return 0;
     }
@@ -400,6 +601,48 @@ int admin_configure_system(void) {
     return 0;
 }
 
+// Stage histograms are always kept; this only controls the per-sample dump
+static void set_trace_sampling(void) {
+    printf("Current: %s\n", system_config.trace_sample_every > 0 ? "on" : "off");
+    printf("Trace 1 in N samples to %s (0 = off): ", TRACE_FILE);
+    int n = get_user_choice();
+    if (n < 0) {
+        printf("Invalid value.\n");
+        return;
+    }
+    system_config.trace_sample_every = n;
+    if (n > 0) {
+        printf("Tracing 1 in %d samples.\n", n);
+    } else {
+        trace_close();
+        printf("Trace dump off.\n");
+    }
+}
+
+// Takes effect on the next compaction step; data already compacted stays so
+static void set_storage_tiers(void) {
+    tier_print_status();
+    printf("\nKeep raw samples for N days (0 = never compact): ");
+    int raw = get_user_choice();
+    printf("Keep per-minute rows for N days: ");
+    int minute = get_user_choice();
+    printf("Compaction I/O budget in KiB/s (0 = unlimited): ");
+    int kbps = get_user_choice();
+    if (raw < 0 || minute < 0 || kbps < 0) {
+        printf("Invalid value.\n");
+        return;
+    }
+    system_config.tier_raw_days = raw;
+    system_config.tier_minute_days = minute < raw ? raw : minute;
+    system_config.compact_kbps = kbps;
+    if (raw > 0) {
+        printf("Raw for %d days, per minute for %d days, per hour after that.\n",
+               raw, system_config.tier_minute_days);
+    } else {
+        printf("Compaction off.\n");
+    }
+}
+
 int admin_arduino_control(void) {
     printf("\n=== ARDUINO CONTROL ===\n\n");
     
@@ -447,41 +690,215 @@ int admin_arduino_control(void) {
     return 0;
 }
 
+int admin_backup_restore(void) {
+    printf("\n=== BACKUP / RESTORE ===\n\n");
+    
+    printf("1. Back up to a directory (only changes since the last backup there)\n");
+    printf("2. Restore from a backup directory\n");
+    printf("0. Back\n\n");
+    printf("Enter your choice: ");
+    
+    int choice = get_user_choice();
+    if (choice != 1 && choice != 2) {
+        return 0;
+    }
+    
+    char dir[256];
+    printf("Backup directory: ");
+    if (read_line(dir, sizeof(dir)) != 0 || dir[0] == '\0') {
+        return 0;
+    }
+    
+    if (choice == 1) {
+        int files = backup_data(dir);
+        if (files >= 0) {
+            printf("Backup in %s is up to date (%d files)\n", dir, files);
+        } else {
+            printf("Backup failed, see %s\n", SYSTEM_LOG_FILE);
+        }
+    } else {
+        printf("This replaces all %d current records. Continue? (y/n): ", get_data_count());
+        char answer[8];
+        if (read_line(answer, sizeof(answer)) != 0 || (answer[0] != 'y' && answer[0] != 'Y')) {
+            return 0;
+        }
+        int records = restore_data(dir);
+        if (records >= 0) {
+            printf("Restored %d records from %s\n", records, dir);
+        } else {
+            printf("Restore failed, current data kept; see %s\n", SYSTEM_LOG_FILE);
+        }
+    }
+    
+    wait_for_enter();
+    return 0;
+}
+
+int admin_import_stations(void) {
+    printf("\n=== IMPORT STATION FILES ===\n\n");
+    printf("Merges data_log.txt or CSV export files of several stations by time.\n");
+    printf("Each matching file is one station, numbered from 1 in name order.\n\n");
+
+    char pattern[256];
+    printf("Files (pattern, e.g. stations/*/data_log.txt): ");
+    if (read_line(pattern, sizeof(pattern)) != 0 || pattern[0] == '\0') {
+        return 0;
+    }
+
+    printf("1. Into the store\n");
+    printf("2. Into a CSV file\n");
+    printf("0. Back\n\n");
+    printf("Enter your choice: ");
+
+    int choice = get_user_choice();
+    if (choice == 1) {
+        merge_station_files(pattern, NULL);
+    } else if (choice == 2) {
+        char filename[256];
+        printf("CSV file: ");
+        if (read_line(filename, sizeof(filename)) != 0 || filename[0] == '\0') {
+            return 0;
+        }
+        merge_station_files(pattern, filename);
+    } else {
+        return 0;
+    }
+
+    wait_for_enter();
+    return 0;
+}
+
 // ============================================================================
 // AUTO MODE
 // ============================================================================
 
+static volatile sig_atomic_t auto_stop_requested = 0;
+
+static void auto_mode_sigint(int sig) {
+    (void)sig;
+    auto_stop_requested = 1;
+}
+
+// Enter on the terminal stops auto mode as well as Ctrl+C
+static int stdin_has_line(void) {
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&pfd, 1, 0) > 0;
+}
+
+// One collector process per configured port
+static int start_collectors(void) {
+    const char *ports[SUPERVISOR_MAX_COLLECTORS];
+    int port_count = 0;
+    for (int i = 0; i < system_config.collector_count && i < SUPERVISOR_MAX_COLLECTORS; i++) {
+        ports[port_count++] = system_config.collector_ports[i];
+    }
+    if (port_count == 0) {
+        ports[port_count++] = system_config.arduino_device;
+    }
+    
+    if (supervisor_start(ports, port_count) <= 0) {
+        show_error("Cannot start any collector process");
+        supervisor_stop();
+        wait_for_enter();
+        return 0;
+    }
+    return port_count;
+}
+
 void run_auto_mode(void) {
     current_mode = AUTO_MODE;
     
     printf("\n=== AUTO MODE ===\n\n");
-    printf("Collecting data automatically...\n");
-    printf("Press Ctrl+C to stop\n\n");
     
-    // Simulate auto data collection
-    for (int i = 0; i < 10; i++) {
-        printf("Collecting data... %d/10\n", i + 1);
-        
-        // Simulate data collection
-        sensor_data_t new_data;
-        new_data.timestamp = time(NULL);
-        new_data.temperature = 20 + (rand() % 20); // 20-40°C
-        new_data.humidity = 40 + (rand() % 40);    // 40-80%
-        new_data.gas_level = 100 + (rand() % 100); // 100-200 ppm
-        new_data.sensor_id = 1;
-        new_data.quality = 90 + (rand() % 10);     // 90-100%
+    int port_count = start_collectors();
+    if (port_count == 0) {
+        return;
+    }
+    
+    printf("Started %d collector process(es)\n", port_count);
+    printf("Press Enter or Ctrl+C to stop\n\n");
+    
+    struct sigaction sa, old_sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = auto_mode_sigint;
+    sigaction(SIGINT, &sa, &old_sa);
+    auto_stop_requested = 0;
+    
+    int start_count = get_data_count();
+    time_t last_report = 0;
+    while (!auto_stop_requested && !stdin_has_line()) {
+        supervisor_poll(200);
         
-        // Add to data array
-        if (data_count < MAX_DATA_RECORDS) {
-            sensor_data[data_count] = new_data;
-            data_count++;
+        time_t now = time(NULL);
+        if (now != last_report) {
+            printf("\rCollected %d new records", get_data_count() - start_count);
+            fflush(stdout);
+            last_report = now;
         }
-        
-        sleep(2); // Wait 2 seconds
     }
     
-    printf("\nAuto data collection completed!\n");
-    printf("Collected %d new data records\n", data_count);
+    sigaction(SIGINT, &old_sa, NULL);
+    supervisor_stop();
+    
+    printf("\n\nAuto data collection stopped!\n");
+    printf("Collected %d new data records\n", get_data_count() - start_count);
+    printf("Total data records: %d\n", get_data_count());
+    
+    wait_for_enter();
+}
+
+// Same collection loop as auto mode, but the screen belongs to the dashboard
+// renderer; this thread only drains the collector pipes.
+void run_dashboard_mode(void) {
+    current_mode = AUTO_MODE;
+    
+    printf("\n=== LIVE DASHBOARD ===\n\n");
+    
+    if (start_collectors() == 0) {
+        return;
+    }
+    
+    // Any key stops the dashboard: read keys without waiting for Enter
+    struct termios saved, raw;
+    int raw_mode = isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved) == 0;
+    if (raw_mode) {
+        raw = saved;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+    
+    struct sigaction sa, old_sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = auto_mode_sigint;
+    sigaction(SIGINT, &sa, &old_sa);
+    auto_stop_requested = 0;
+    
+    int start_count = get_data_count();
+    if (dashboard_start(system_config.dashboard_refresh_hz) != 0) {
+        show_error("Cannot start dashboard renderer");
+        auto_stop_requested = 1;
+    }
+    while (!auto_stop_requested && !stdin_has_line()) {
+        supervisor_poll(50);
+    }
+    dashboard_stop();
+    
+    sigaction(SIGINT, &old_sa, NULL);
+    supervisor_stop();
+    
+    // Drop the key (or line) that stopped the dashboard
+    if (raw_mode) {
+        tcflush(STDIN_FILENO, TCIFLUSH);
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    } else if (stdin_has_line()) {
+        char line[64];
+        read_line(line, sizeof(line));
+    }
+    
+    printf("\nCollected %d new data records\n", get_data_count() - start_count);
+    printf("Total data records: %d\n", get_data_count());
     
     wait_for_enter();
 }
@@ -500,10 +917,27 @@ void show_header(void) {
     printf("========================================\n\n");
 }
 
+// Reads one whole line so no newline is left behind for the next prompt
+static int read_line(char *buf, size_t size) {
+    if (!fgets(buf, (int)size, stdin)) {
+        buf[0] = '\0';
+        return -1;
+    }
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
 int get_user_choice(void) {
-    int choice;
-    scanf("%d", &choice);
-    return choice;
+    char line[64];
+    char *end;
+    if (read_line(line, sizeof(line)) != 0) {
+        return 0;   // EOF: behave like "back" / "exit"
+    }
+    long choice = strtol(line, &end, 10);
+    if (end == line) {
+        return -1;  // not a number: falls into "invalid choice"
+    }
+    return (int)choice;
 }
 
 void wait_for_enter(void) {
@@ -519,22 +953,22 @@ void show_error(const char *error) {
 }
 
 // ============================================================================
-// SIMULATION TEST MODE
+// PROCESS TEST MODE
 // ============================================================================
 
-void run_simulation_test(void) {
-    current_mode = 4; // SIMULATION_TEST_MODE
+void run_process_test(void) {
+    current_mode = 4; // PROCESS_TEST_MODE
     
     while (1) {
         clear_screen();
         show_header();
         
-        printf("=== SIMULATION TEST MODE ===\n\n");
-        printf("Test fork() and pipe() simulation:\n\n");
+        printf("=== PROCESS TEST MODE ===\n\n");
+        printf("Test real fork() and pipe():\n\n");
         printf("1. Test fork() - Process creation\n");
         printf("2. Test pipe() - Inter-process communication\n");
         printf("3. Test fork() + pipe() combined\n");
-        printf("4. Show simulation status\n");
+        printf("4. Show collector status\n");
         printf("5. Run comprehensive test\n");
         printf("0. Back to main menu\n\n");
         printf("Enter your choice: ");
@@ -543,20 +977,20 @@ void run_simulation_test(void) {
         
         switch (choice) {
             case 1:
-                test_fork_simulation();
+                test_fork();
                 break;
             case 2:
-                test_pipe_simulation();
+                test_pipe();
                 break;
             case 3:
                 test_fork_and_pipe_combined();
                 break;
             case 4:
-                print_simulation_status();
+                supervisor_print_status();
                 wait_for_enter();
                 break;
             case 5:
-                run_comprehensive_simulation_test();
+                run_comprehensive_process_test();
                 break;
             case 0:
                 return; // Back to main menu
@@ -568,49 +1002,52 @@ void run_simulation_test(void) {
     }
 }
 
-void test_fork_simulation(void) {
-    printf("\n=== TEST FORK() SIMULATION ===\n\n");
+void test_fork(void) {
+    printf("\n=== TEST FORK() ===\n\n");
     
     printf("Testing process creation with fork()...\n\n");
     
     // Test 1: Simple fork
     printf("Test 1: Simple fork()\n");
-    int child_pid = simulated_fork();
+    fflush(stdout);
+    pid_t child_pid = fork();
     if (child_pid > 0) {
-        printf("✓ Parent process created child PID %d\n", child_pid);
+        printf("✓ Parent process created child PID %d\n", (int)child_pid);
         
         // Wait for child
         int status;
-        simulated_wait(&status);
-        printf("✓ Parent waited for child, exit code: %d\n", status);
+        waitpid(child_pid, &status, 0);
+        printf("✓ Parent waited for child, exit code: %d\n", WEXITSTATUS(status));
     } else if (child_pid == 0) {
         printf("✓ Child process executed successfully\n");
+        fflush(stdout);
+        _exit(7);
     } else {
-        printf("✗ Fork failed\n");
+        printf("✗ Fork failed: %s\n", strerror(errno));
     }
     
     wait_for_enter();
 }
 
-void test_pipe_simulation(void) {
-    printf("\n=== TEST PIPE() SIMULATION ===\n\n");
+void test_pipe(void) {
+    printf("\n=== TEST PIPE() ===\n\n");
     
     printf("Testing inter-process communication with pipe()...\n\n");
     
     // Create pipe
     int pipefd[2];
-    if (simulated_pipe(pipefd) == 0) {
+    if (pipe(pipefd) == 0) {
         printf("✓ Pipe created successfully (read=%d, write=%d)\n", pipefd[0], pipefd[1]);
         
         // Write data to pipe
-        const char *test_message = "Hello from pipe simulation!";
-        ssize_t written = simulated_write(pipefd[1], test_message, strlen(test_message));
+        const char *test_message = "Hello from pipe!";
+        ssize_t written = write_full(pipefd[1], test_message, strlen(test_message));
         if (written > 0) {
             printf("✓ Wrote %zd bytes to pipe\n", written);
             
             // Read data from pipe
             char buffer[256];
-            ssize_t read_bytes = simulated_read(pipefd[0], buffer, sizeof(buffer));
+            ssize_t read_bytes = read(pipefd[0], buffer, sizeof(buffer) - 1);
             if (read_bytes > 0) {
                 buffer[read_bytes] = '\0';
                 printf("✓ Read %zd bytes from pipe: %s\n", read_bytes, buffer);
@@ -622,12 +1059,12 @@ void test_pipe_simulation(void) {
         }
         
         // Close pipe
-        simulated_close(pipefd[0]);
-        simulated_close(pipefd[1]);
+        close(pipefd[0]);
+        close(pipefd[1]);
         printf("✓ Pipe closed successfully\n");
         
     } else {
-        printf("✗ Failed to create pipe\n");
+        printf("✗ Failed to create pipe: %s\n", strerror(errno));
     }
     
     wait_for_enter();
@@ -640,61 +1077,71 @@ void test_fork_and_pipe_combined(void) {
     
     // Create pipe first
     int pipefd[2];
-    if (simulated_pipe(pipefd) != 0) {
+    if (pipe(pipefd) != 0) {
         printf("✗ Failed to create pipe\n");
         wait_for_enter();
         return;
     }
     
     printf("✓ Pipe created (read=%d, write=%d)\n", pipefd[0], pipefd[1]);
+    fflush(stdout);
     
     // Fork process
-    int child_pid = simulated_fork();
+    pid_t child_pid = fork();
     if (child_pid > 0) {
         // Parent process
+        close(pipefd[0]);
         printf("✓ Parent process (PID %d) created child (PID %d)\n", 
-               current_simulated_process, child_pid);
+               (int)getpid(), (int)child_pid);
         
         // Parent writes to pipe
         const char *parent_message = "Message from parent process";
-        ssize_t written = simulated_write(pipefd[1], parent_message, strlen(parent_message));
+        ssize_t written = write_full(pipefd[1], parent_message, strlen(parent_message));
         if (written > 0) {
             printf("✓ Parent wrote %zd bytes to pipe\n", written);
         }
+        close(pipefd[1]);
+        fflush(stdout);
         
         // Wait for child
         int status;
-        simulated_wait(&status);
-        printf("✓ Parent waited for child, exit code: %d\n", status);
+        waitpid(child_pid, &status, 0);
+        printf("✓ Parent waited for child, exit code: %d\n", WEXITSTATUS(status));
         
     } else if (child_pid == 0) {
         // Child process
-        printf("✓ Child process (PID %d) started\n", current_simulated_process);
+        close(pipefd[1]);
+        printf("✓ Child process (PID %d) started\n", (int)getpid());
         
-        // Child reads from pipe
+        // Child reads from pipe until the parent closes its end
         char buffer[256];
-        ssize_t read_bytes = simulated_read(pipefd[0], buffer, sizeof(buffer));
-        if (read_bytes > 0) {
-            buffer[read_bytes] = '\0';
-            printf("✓ Child read %zd bytes from pipe: %s\n", read_bytes, buffer);
+        size_t total = 0;
+        ssize_t r;
+        while (total < sizeof(buffer) - 1 &&
+               (r = read(pipefd[0], buffer + total, sizeof(buffer) - 1 - total)) > 0) {
+            total += (size_t)r;
         }
+        buffer[total] = '\0';
+        printf("✓ Child read %zu bytes from pipe: %s\n", total, buffer);
         
         // Child exits
-        simulated_exit(0);
+        fflush(stdout);
+        _exit(0);
+    } else {
+        printf("✗ Fork failed: %s\n", strerror(errno));
+        close(pipefd[0]);
+        close(pipefd[1]);
     }
     
-    // Close pipe
-    simulated_close(pipefd[0]);
-    simulated_close(pipefd[1]);
     printf("✓ Pipe communication test completed\n");
     
     wait_for_enter();
 }
 
-void run_comprehensive_simulation_test(void) {
-    printf("\n=== COMPREHENSIVE SIMULATION TEST ===\n\n");
+void run_comprehensive_process_test(void) {
+    printf("\n=== COMPREHENSIVE PROCESS TEST ===\n\n");
     
-    printf("Running comprehensive test of fork() and pipe() simulation...\n\n");
+    printf("Running comprehensive test of fork() and pipe()...\n\n");
     
     int tests_passed = 0;
     int total_tests = 0;
@@ -702,11 +1149,18 @@ void run_comprehensive_simulation_test(void) {
     // Test 1: Multiple fork()
     printf("Test 1: Multiple fork() calls\n");
     total_tests++;
-    
-    int child1 = simulated_fork();
-    int child2 = simulated_fork();
-    
-    if (child1 > 0 && child2 > 0) {
+    fflush(stdout);
+    
+    pid_t child1 = fork();
+    if (child1 == 0) _exit(1);
+    pid_t child2 = fork();
+    if (child2 == 0) _exit(2);
+    
+    int status1 = 0, status2 = 0;
+    if (child1 > 0) waitpid(child1, &status1, 0);
+    if (child2 > 0) waitpid(child2, &status2, 0);
+    if (child1 > 0 && child2 > 0 &&
+        WEXITSTATUS(status1) == 1 && WEXITSTATUS(status2) == 2) {
         printf("✓ Multiple fork() calls successful\n");
         tests_passed++;
     } else {
@@ -718,61 +1172,95 @@ void run_comprehensive_simulation_test(void) {
     total_tests++;
     
     int pipe1[2], pipe2[2];
-    if (simulated_pipe(pipe1) == 0 && simulated_pipe(pipe2) == 0) {
+    if (pipe(pipe1) == 0 && pipe(pipe2) == 0) {
         printf("✓ Multiple pipe() calls successful\n");
         tests_passed++;
         
         // Clean up
-        simulated_close(pipe1[0]);
-        simulated_close(pipe1[1]);
-        simulated_close(pipe2[0]);
-        simulated_close(pipe2[1]);
+        close(pipe1[0]);
+        close(pipe1[1]);
+        close(pipe2[0]);
+        close(pipe2[1]);
     } else {
         printf("✗ Multiple pipe() calls failed\n");
     }
     
-    // Test 3: Large data transfer
+    // Test 3: Large data transfer (larger than the kernel pipe buffer, so
+    // the writer must block until the child drains it)
     printf("\nTest 3: Large data transfer through pipe\n");
     total_tests++;
+    fflush(stdout);
     
     int pipefd[2];
-    if (simulated_pipe(pipefd) == 0) {
-        // Write large data
-        char large_data[512];
-        memset(large_data, 'A', sizeof(large_data) - 1);
-        large_data[sizeof(large_data) - 1] = '\0';
+    if (pipe(pipefd) == 0) {
+        static char large_data[256 * 1024];
+        memset(large_data, 'A', sizeof(large_data));
         
-        ssize_t written = simulated_write(pipefd[1], large_data, sizeof(large_data) - 1);
-        if (written > 0) {
-            // Read data back
-            char buffer[512];
-            ssize_t read_bytes = simulated_read(pipefd[0], buffer, sizeof(buffer));
-            if (read_bytes == written) {
-                printf("✓ Large data transfer successful (%zd bytes)\n", written);
-                tests_passed++;
-            } else {
-                printf("✗ Data corruption detected\n");
+        pid_t reader = fork();
+        if (reader == 0) {
+            close(pipefd[1]);
+            char buffer[4096];
+            size_t total = 0;
+            ssize_t r;
+            while ((r = read(pipefd[0], buffer, sizeof(buffer))) > 0) {
+                for (ssize_t i = 0; i < r; i++) {
+                    if (buffer[i] != 'A') _exit(1);
+                }
+                total += (size_t)r;
             }
-        } else {
-            printf("✗ Failed to write large data\n");
+            _exit(total == sizeof(large_data) ? 0 : 1);
         }
+        close(pipefd[0]);
+        
+        ssize_t written = write_full(pipefd[1], large_data, sizeof(large_data));
+        close(pipefd[1]);
         
-        simulated_close(pipefd[0]);
-        simulated_close(pipefd[1]);
+        int status = 1;
+        if (reader > 0) waitpid(reader, &status, 0);
+        if (written == (ssize_t)sizeof(large_data) && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            printf("✓ Large data transfer successful (%zd bytes)\n", written);
+            tests_passed++;
+        } else {
+            printf("✗ Data corruption detected\n");
+        }
     } else {
         printf("✗ Failed to create pipe for large data test\n");
     }
     
+    // Test 4: Real collector process through the supervisor
+    printf("\nTest 4: Collector process (SIM) through supervisor\n");
+    total_tests++;
+    
+    if (!supervisor_running()) {
+        const char *ports[] = { "SIM" };
+        int before = get_data_count();
+        if (supervisor_start(ports, 1) == 1) {
+            for (int i = 0; i < 25 && get_data_count() == before; i++) {
+                supervisor_poll(200);
+            }
+            supervisor_stop();
+        }
+        if (get_data_count() > before) {
+            printf("✓ Collector delivered %d record(s) through its pipe\n",
+                   get_data_count() - before);
+            tests_passed++;
+        } else {
+            printf("✗ No data received from collector\n");
+        }
+    } else {
+        printf("✗ Supervisor already running\n");
+    }
+    
     // Print results
     printf("\n=== TEST RESULTS ===\n");
     printf("Tests passed: %d/%d\n", tests_passed, total_tests);
     printf("Success rate: %.1f%%\n", (float)tests_passed / total_tests * 100);
     
     if (tests_passed == total_tests) {
-        printf("🎉 All simulation tests passed!\n");
+        printf("🎉 All process tests passed!\n");
     } else {
         printf("⚠️  Some tests failed. Please check implementation.\n");
     }
     
     wait_for_enter();
-}
\ No newline at end of file
+}
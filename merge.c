@@ -0,0 +1,572 @@
+#define _GNU_SOURCE
+#include "system.h"
+
+#include <glob.h>
+#include <pthread.h>
+
+// ============================================================================
+// STATION FILE MERGE
+// ============================================================================
+//
+// Builds one time-ordered data set out of the text files of many stations:
+// every file matching a glob pattern is one station, numbered from 1 in
+// name order. Two line formats are read, and may be mixed:
+//
+//   2025-10-14 20:00:00 T H G                     data_log.txt (collector)
+//   2025-10-14 20:00:00,T,H,G,sensor_id,quality   export_to_csv()
+//
+// Each station gets its own block of MERGE_STATION_IDS sensor IDs, from
+// station * MERGE_STATION_IDS, so stations never share a sensor and every
+// ID stays below SENSOR_ID_LIMIT. The sensors of a file are numbered in
+// that block in order of first appearance: data_log lines (which do not
+// know their sensor) count as one sensor, each CSV sensor_id as another.
+// The mapping is written to the system log; rows of a sensor past the
+// block are counted and skipped, like other lines (headers, garbage).
+//
+// Each file is parsed by one of MERGE_THREADS workers into two chunks of
+// MERGE_CHUNK_RECORDS records, validated there (validate.c), and handed to
+// the merging thread, which takes the smallest head from a min-heap keyed
+// by (timestamp, station) like the reorder buffer. While one chunk is
+// merged the worker fills the other, so memory stays at two chunks and a
+// read buffer per file whatever the file sizes.
+//
+// The files are expected to be in time order, as collectors write them. A
+// record older than the last one merged (the file goes back in time, or
+// the store already holds newer data) is counted as out of order and
+// dropped: the store must stay time-ordered.
+//
+// Output goes to the store through ingest_records(), so it must run on the
+// ingest thread, or streams to a CSV file in the export_to_csv() format.
+
+#define MERGE_MAX_FILES         1000
+#define MERGE_STATION_IDS       64          // sensors per station
+#define MERGE_THREADS           8
+#define MERGE_CHUNK_RECORDS     1024
+#define MERGE_BATCH_RECORDS     256         // records per ingest_records() call
+#define MERGE_IOBUF_SIZE        (1 << 16)
+#define MERGE_LINE_MAX          512
+#define MERGE_PROGRESS_RECORDS  1000000
+
+_Static_assert((MERGE_MAX_FILES + 1) * MERGE_STATION_IDS <= SENSOR_ID_LIMIT,
+               "station sensor IDs must stay below SENSOR_ID_LIMIT");
+
+typedef struct merge_source {
+    FILE *fp;
+    int station;
+    // Local time of the last "YYYY-mm-dd HH" seen, and its text
+    char hour_text[14];
+    time_t hour_start;
+
+    // Two chunks: the worker fills chunk[tail], the merger reads chunk[head]
+    sensor_data_t chunk[2][MERGE_CHUNK_RECORDS];
+    size_t len[2];
+    int head, tail, full;
+    int busy;               // queued for or being filled by a worker
+    int eof;
+    size_t pos;             // merger: next record in chunk[head]
+
+    // Source IDs in order of first appearance (MERGE_LOG_LINES: data_log)
+    int local_ids[MERGE_STATION_IDS];
+    int local_count, last_local;
+
+    unsigned long skipped;  // lines that did not parse
+    unsigned long unmapped; // rows of sensors past the station's block
+    validate_counts_t rejected;
+    int error;
+} merge_source_t;
+
+typedef struct merge_state {
+    merge_source_t **src;
+    int count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work, ready;
+    int *queue;             // sources waiting for a worker, FIFO
+    int q_head, q_len;
+    int stop;
+} merge_state_t;
+
+// ============================================================================
+// PARSING
+// ============================================================================
+
+static int digits(const char *p, int n) {
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        if (p[i] < '0' || p[i] > '9') return -1;
+        v = v * 10 + (p[i] - '0');
+    }
+    return v;
+}
+
+// "YYYY-mm-dd HH:MM:SS" in local time. mktime() runs once per hour of data.
+static const char* parse_time(merge_source_t *s, const char *p, time_t *ts) {
+    if (strlen(p) < 19 || p[4] != '-' || p[7] != '-' || p[10] != ' ' || p[13] != ':' || p[16] != ':') {
+        return NULL;
+    }
+    int min = digits(p + 14, 2), sec = digits(p + 17, 2);
+    if (min < 0 || min > 59 || sec < 0 || sec > 60) {
+        return NULL;
+    }
+    if (memcmp(p, s->hour_text, 13) != 0) {
+        int y = digits(p, 4), mon = digits(p + 5, 2), d = digits(p + 8, 2), h = digits(p + 11, 2);
+        if (y < 1970 || mon < 1 || mon > 12 || d < 1 || d > 31 || h < 0 || h > 23) {
+            return NULL;
+        }
+        struct tm tm_ts = { .tm_year = y - 1900, .tm_mon = mon - 1, .tm_mday = d,
+                            .tm_hour = h, .tm_isdst = -1 };
+        time_t t = mktime(&tm_ts);
+        if (t == (time_t)-1) {
+            return NULL;
+        }
+        memcpy(s->hour_text, p, 13);
+        s->hour_start = t;
+    }
+    *ts = s->hour_start + min * 60 + sec;
+    return p + 19;
+}
+
+#define MERGE_LOG_LINES     (-1)
+
+// Sensor ID in the station's block for source ID `id`; -1 once the block
+// is full
+static int station_id(merge_source_t *s, int id) {
+    int k = s->last_local;
+    if (k >= s->local_count || s->local_ids[k] != id) {
+        for (k = 0; k < s->local_count && s->local_ids[k] != id; k++) {}
+        if (k == s->local_count) {
+            if (k == MERGE_STATION_IDS) {
+                return -1;
+            }
+            s->local_ids[s->local_count++] = id;
+        }
+        s->last_local = k;
+    }
+    return s->station * MERGE_STATION_IDS + k;
+}
+
+static const char* csv_float(const char *p, float *out) {
+    char *end;
+    *out = strtof(p, &end);
+    return end != p && *end == ',' ? end + 1 : NULL;
+}
+
+// One line into rec; -1 if it is not a sample
+static int parse_line(merge_source_t *s, const char *line, sensor_data_t *rec) {
+    memset(rec, 0, sizeof(*rec));
+    const char *p = parse_time(s, line, &rec->timestamp);
+    if (!p) {
+        return -1;
+    }
+    if (*p == ',') {
+        p++;
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+            if (!(p = csv_float(p, &rec->values[f]))) return -1;
+        }
+        char *end;
+        long id = strtol(p, &end, 10);
+        if (end == p || *end != ',' || id < 0 || id > INT32_MAX) {
+            return -1;
+        }
+        long quality = strtol(end + 1, &end, 10);
+        rec->sensor_id = station_id(s, (int)id);
+        rec->quality = quality < 0 ? 0 : (quality > 100 ? 100 : (int)quality);
+        return 0;
+    }
+    SensorData sd = { 0 };
+    if (parse_sensor_data(p, &sd) != 0) {
+        return -1;
+    }
+#define FROM_WIRE_(field, stat, wtype, wire, ...) rec->field = (float)sd.wire;
+    SENSOR_FIELDS(FROM_WIRE_)
+#undef FROM_WIRE_
+    rec->sensor_id = station_id(s, MERGE_LOG_LINES);
+    rec->quality = 100;
+    return 0;
+}
+
+// Fills chunk[tail] with the next valid records of the file
+static size_t fill_chunk(merge_source_t *s, int *eof) {
+    sensor_data_t *out = s->chunk[s->tail];
+    char line[MERGE_LINE_MAX];
+    size_t n = 0, checked = 0;
+    *eof = 0;
+    while (n < MERGE_CHUNK_RECORDS) {
+        if (!fgets(line, sizeof(line), s->fp)) {
+            if (ferror(s->fp)) s->error = errno ? errno : EIO;
+            *eof = 1;
+            break;
+        }
+        size_t len = strlen(line);
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            int c;
+            while ((c = fgetc(s->fp)) != EOF && c != '\n') {}     // too long: not ours
+            s->skipped++;
+            continue;
+        }
+        if (parse_line(s, line, &out[n]) == 0) {
+            if (out[n].sensor_id >= 0) {
+                n++;
+            } else {
+                s->unmapped++;
+            }
+        } else if (len > 1 && strncmp(line, "timestamp,", 10) != 0) {
+            s->skipped++;
+        }
+        if (n == MERGE_CHUNK_RECORDS) {
+            // Drops the invalid ones and reads on until the chunk is full
+            n = checked + validate_records(out + checked, n - checked, &s->rejected);
+            checked = n;
+        }
+    }
+    return checked + validate_records(out + checked, n - checked, &s->rejected);
+}
+
+// ============================================================================
+// WORKERS
+// ============================================================================
+
+static void enqueue(merge_state_t *m, int i) {
+    m->src[i]->busy = 1;
+    m->queue[(m->q_head + m->q_len++) % m->count] = i;
+    pthread_cond_signal(&m->work);
+}
+
+static void* merge_worker(void *arg) {
+    merge_state_t *m = arg;
+    pthread_mutex_lock(&m->lock);
+    while (!m->stop) {
+        if (m->q_len == 0) {
+            pthread_cond_wait(&m->work, &m->lock);
+            continue;
+        }
+        int i = m->queue[m->q_head];
+        m->q_head = (m->q_head + 1) % m->count;
+        m->q_len--;
+        merge_source_t *s = m->src[i];
+        pthread_mutex_unlock(&m->lock);
+
+        int eof;
+        size_t n = fill_chunk(s, &eof);
+
+        pthread_mutex_lock(&m->lock);
+        s->len[s->tail] = n;
+        if (n > 0) {
+            s->tail ^= 1;
+            s->full++;
+        }
+        s->eof = eof;
+        s->busy = 0;
+        if (!s->eof && s->full < 2) {
+            enqueue(m, i);
+        }
+        pthread_cond_broadcast(&m->ready);
+    }
+    pthread_mutex_unlock(&m->lock);
+    return NULL;
+}
+
+// Waits until source i has a chunk to merge; 0 once the file is done
+static int wait_chunk(merge_state_t *m, int i) {
+    merge_source_t *s = m->src[i];
+    pthread_mutex_lock(&m->lock);
+    while (s->full == 0 && (s->busy || !s->eof)) {
+        pthread_cond_wait(&m->ready, &m->lock);
+    }
+    int have = s->full > 0;
+    pthread_mutex_unlock(&m->lock);
+    s->pos = 0;
+    return have;
+}
+
+// Hands chunk[head] back to the worker and waits for the next one
+static int next_chunk(merge_state_t *m, int i) {
+    merge_source_t *s = m->src[i];
+    pthread_mutex_lock(&m->lock);
+    s->head ^= 1;
+    s->full--;
+    if (!s->busy && !s->eof) {
+        enqueue(m, i);
+    }
+    pthread_mutex_unlock(&m->lock);
+    return wait_chunk(m, i);
+}
+
+// ============================================================================
+// MERGE
+// ============================================================================
+
+// The key of a source's head record is copied into its heap entry, so
+// sifting does not touch the chunks
+typedef struct merge_head {
+    time_t ts;
+    int32_t ns;
+    int src;
+} merge_head_t;
+
+static inline void set_head(merge_head_t *h, const merge_state_t *m, int i) {
+    const merge_source_t *s = m->src[i];
+    const sensor_data_t *rec = &s->chunk[s->head][s->pos];
+    h->ts = rec->timestamp;
+    h->ns = rec->timestamp_ns;
+    h->src = i;
+}
+
+static inline int head_less(const merge_head_t *a, const merge_head_t *b) {
+    if (a->ts != b->ts) return a->ts < b->ts;
+    if (a->ns != b->ns) return a->ns < b->ns;
+    return a->src < b->src;
+}
+
+static void sift_down(merge_head_t *heap, int n, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, k = i;
+        if (l < n && head_less(&heap[l], &heap[k])) k = l;
+        if (r < n && head_less(&heap[r], &heap[k])) k = r;
+        if (k == i) return;
+        merge_head_t t = heap[i];
+        heap[i] = heap[k];
+        heap[k] = t;
+        i = k;
+    }
+}
+
+typedef struct merge_out {
+    FILE *csv;
+    sensor_data_t batch[MERGE_BATCH_RECORDS];
+    size_t len;
+    unsigned long written;
+    time_t clock_ts;        // CSV: last timestamp formatted
+    char clock_text[32];
+} merge_out_t;
+
+static void flush_out(merge_out_t *o) {
+    if (o->len && !o->csv) {
+        o->written += (unsigned long)ingest_records(o->batch, o->len);
+    }
+    o->len = 0;
+}
+
+static void put_record(merge_out_t *o, const sensor_data_t *rec) {
+    if (!o->csv) {
+        o->batch[o->len++] = *rec;
+        if (o->len == MERGE_BATCH_RECORDS) flush_out(o);
+        return;
+    }
+    if (rec->timestamp != o->clock_ts) {
+        struct tm tm_ts;
+        localtime_r(&rec->timestamp, &tm_ts);
+        strftime(o->clock_text, sizeof(o->clock_text), "%Y-%m-%d %H:%M:%S", &tm_ts);
+        o->clock_ts = rec->timestamp;
+    }
+#define CSV_FMT_(field, ...)    ",%.1f"
+#define CSV_ARG_(field, ...)    , rec->field
+    fprintf(o->csv, "%s" SENSOR_FIELDS(CSV_FMT_) ",%d,%d\n",
+            o->clock_text SENSOR_FIELDS(CSV_ARG_), rec->sensor_id, rec->quality);
+#undef CSV_FMT_
+#undef CSV_ARG_
+    o->written++;
+}
+
+// "Station 3 (st/c.csv): sensors 192-194 = data_log, 1001, 1002"
+static void log_station_ids(const merge_source_t *s, const char *path) {
+    if (s->local_count == 0) {
+        return;
+    }
+    char msg[512];
+    int base = s->station * MERGE_STATION_IDS;
+    int len = snprintf(msg, sizeof(msg), "Station %d (%s): sensors %d-%d =", s->station, path,
+                       base, base + s->local_count - 1);
+    for (int k = 0; k < s->local_count && len > 0 && (size_t)len < sizeof(msg); k++) {
+        len += s->local_ids[k] == MERGE_LOG_LINES
+               ? snprintf(msg + len, sizeof(msg) - (size_t)len, "%s data_log", k ? "," : "")
+               : snprintf(msg + len, sizeof(msg) - (size_t)len, "%s %d", k ? "," : "", s->local_ids[k]);
+    }
+    log_info(msg);
+}
+
+static void free_sources(merge_state_t *m) {
+    for (int i = 0; i < m->count; i++) {
+        if (m->src[i]->fp) fclose(m->src[i]->fp);
+        free(m->src[i]);
+    }
+    free(m->src);
+    free(m->queue);
+}
+
+long merge_station_files(const char *pattern, const char *csv_file) {
+    glob_t g;
+    int grc = glob(pattern, 0, NULL, &g);
+    if (grc != 0 || g.gl_pathc == 0) {
+        printf("No file matches %s\n", pattern);
+        if (grc == 0) globfree(&g);
+        return -1;
+    }
+    if (g.gl_pathc > MERGE_MAX_FILES) {
+        printf("%zu files match, at most %d can be merged at once\n", g.gl_pathc, MERGE_MAX_FILES);
+        globfree(&g);
+        return -1;
+    }
+
+    merge_state_t m = { .count = (int)g.gl_pathc };
+    m.src = calloc((size_t)m.count, sizeof(*m.src));
+    m.queue = calloc((size_t)m.count, sizeof(*m.queue));
+    merge_head_t *heap = malloc((size_t)m.count * sizeof(*heap));
+    int ok = m.src && m.queue && heap;
+    if (!ok) {
+        printf("Out of memory\n");
+        m.count = 0;
+    }
+    for (int i = 0; ok && i < m.count; i++) {
+        merge_source_t *s = calloc(1, sizeof(*s));
+        m.src[i] = s;
+        if (!s) {
+            printf("Out of memory\n");
+            ok = 0;
+            m.count = i;
+            break;
+        }
+        s->station = i + 1;
+        s->fp = fopen(g.gl_pathv[i], "r");
+        if (!s->fp) {
+            printf("Cannot open %s: %s\n", g.gl_pathv[i], strerror(errno));
+            ok = 0;
+            m.count = i + 1;
+            break;
+        }
+        setvbuf(s->fp, NULL, _IOFBF, MERGE_IOBUF_SIZE);
+    }
+    merge_out_t *o = ok ? calloc(1, sizeof(*o)) : NULL;
+    if (ok && !o) {
+        printf("Out of memory\n");
+    }
+    if (o && csv_file) {
+        o->csv = fopen(csv_file, "w");
+        if (!o->csv) {
+            printf("Cannot create file %s: %s\n", csv_file, strerror(errno));
+        } else {
+            setvbuf(o->csv, NULL, _IOFBF, MERGE_IOBUF_SIZE);
+#define CSV_HEAD_(field, ...)   "," #field
+            fprintf(o->csv, "timestamp" SENSOR_FIELDS(CSV_HEAD_) ",sensor_id,quality\n");
+#undef CSV_HEAD_
+        }
+    }
+    if (!o || (csv_file && !o->csv)) {
+        free(o);
+        free(heap);
+        free_sources(&m);
+        globfree(&g);
+        return -1;
+    }
+    o->clock_ts = (time_t)-1;
+
+    pthread_mutex_init(&m.lock, NULL);
+    pthread_cond_init(&m.work, NULL);
+    pthread_cond_init(&m.ready, NULL);
+    pthread_mutex_lock(&m.lock);
+    for (int i = 0; i < m.count; i++) enqueue(&m, i);
+    pthread_mutex_unlock(&m.lock);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int want = cpus > 1 ? (int)cpus : 1;
+    if (want > MERGE_THREADS) want = MERGE_THREADS;
+    if (want > m.count) want = m.count;
+    pthread_t threads[MERGE_THREADS];
+    int started = 0;
+    while (started < want && pthread_create(&threads[started], NULL, merge_worker, &m) == 0) {
+        started++;
+    }
+
+    unsigned long merged = 0, late = 0;
+    if (started == 0) {
+        printf("Cannot start parser threads: %s\n", strerror(errno));
+    } else {
+        int n = 0;
+        for (int i = 0; i < m.count; i++) {
+            if (wait_chunk(&m, i)) set_head(&heap[n++], &m, i);
+        }
+        for (int i = n / 2 - 1; i >= 0; i--) {
+            sift_down(heap, n, i);
+        }
+
+        // Nothing may go before what the store already ends with
+        sensor_data_t last = { .timestamp = 0 };
+        if (!o->csv && store_size() > 0) last = *store_at(store_end() - 1);
+        while (n > 0) {
+            int i = heap[0].src;
+            merge_source_t *s = m.src[i];
+            const sensor_data_t *rec = &s->chunk[s->head][s->pos];
+            if (rec->timestamp < last.timestamp ||
+                (rec->timestamp == last.timestamp && rec->timestamp_ns < last.timestamp_ns)) {
+                late++;
+            } else {
+                put_record(o, rec);
+                last = *rec;
+            }
+            if (++merged % MERGE_PROGRESS_RECORDS == 0) {
+                printf("\rMerged %lu records", merged);
+                fflush(stdout);
+            }
+            if (++s->pos < s->len[s->head] || next_chunk(&m, i)) {
+                set_head(&heap[0], &m, i);
+            } else {
+                heap[0] = heap[--n];
+            }
+            sift_down(heap, n, 0);
+        }
+        flush_out(o);
+    }
+
+    pthread_mutex_lock(&m.lock);
+    m.stop = 1;
+    pthread_cond_broadcast(&m.work);
+    pthread_mutex_unlock(&m.lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    unsigned long skipped = 0, unmapped = 0, rejected = 0;
+    int rc = started > 0 ? 0 : -1;
+    for (int i = 0; i < m.count; i++) {
+        merge_source_t *s = m.src[i];
+        log_station_ids(s, g.gl_pathv[i]);
+        skipped += s->skipped;
+        unmapped += s->unmapped;
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) rejected += s->rejected.field[f];
+        if (s->error) {
+            printf("Read error in %s: %s\n", g.gl_pathv[i], strerror(s->error));
+            rc = -1;
+        }
+    }
+    if (o->csv && fclose(o->csv) != 0) {
+        printf("Cannot write %s: %s\n", csv_file, strerror(errno));
+        rc = -1;
+    }
+
+    if (merged >= MERGE_PROGRESS_RECORDS) printf("\n");
+    printf("Merged %d station files: %lu records written to %s\n",
+           m.count, o->written, csv_file ? csv_file : "the store");
+    printf("Station N has sensor IDs from N * %d; see %s for the mapping\n",
+           MERGE_STATION_IDS, SYSTEM_LOG_FILE);
+    if (late || skipped || rejected) {
+        printf("Dropped %lu out of order, %lu unreadable lines, %lu out-of-range readings\n",
+               late, skipped, rejected);
+    }
+    if (unmapped) {
+        printf("Dropped %lu rows of sensors past %d in one station\n", unmapped, MERGE_STATION_IDS);
+    }
+    char msg[256];
+    snprintf(msg, sizeof(msg), "Merged %d station files (%s): %lu records, %lu out of order",
+             m.count, pattern, o->written, late);
+    log_info(msg);
+
+    long written = (long)o->written;
+    pthread_cond_destroy(&m.ready);
+    pthread_cond_destroy(&m.work);
+    pthread_mutex_destroy(&m.lock);
+    free(o);
+    free(heap);
+    free_sources(&m);
+    globfree(&g);
+    return rc == 0 ? written : -1;
+}
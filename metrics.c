@@ -0,0 +1,354 @@
+/* metrics.c — Shard số liệu trong bộ nhớ chia sẻ + xuất Prometheus qua Unix socket
+ *
+ * Xem mô tả trong metrics.h.
+ */
+
+#define _GNU_SOURCE
+#include "metrics.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+__thread metrics_shard_t* metrics_tls_shard;
+
+static metrics_shard_t* shards;             // [METRICS_MAX_SHARDS], MAP_SHARED
+static metrics_shard_t overflow_shard;      // khi hết shard: dùng chung, không chính xác tuyệt đối
+
+static const struct { const char* name; const char* help; } COUNTER_INFO[METRIC_COUNTER_COUNT] = {
+    { "bytes_read_total",      "Bytes read from serial or simulator" },
+    { "lines_read_total",      "ASCII lines split from the input stream" },
+    { "frames_read_total",     "Binary frames with a valid CRC" },
+    { "parse_failures_total",  "Malformed lines" },
+    { "crc_errors_total",      "Binary frames rejected by CRC" },
+    { "samples_sent_total",    "Samples written to the collector pipe" },
+    { "pipe_errors_total",     "Failed pipe writes" },
+    { "log_writes_total",      "Lines appended to system_log.txt / data_log.txt" },
+    { "store_appends_total",   "Records appended to the in-memory store" },
+    { "journal_bytes_total",   "Bytes written to the write-ahead journal" },
+    { "journal_syncs_total",   "Journal group commits (fdatasync calls)" },
+    { "query_requests_total",  "Requests answered by the query server" },
+    { "cache_hits_total",      "Result cache lookups answered unchanged" },
+    { "cache_tail_updates_total", "Result cache lookups that scanned only new records" },
+    { "cache_misses_total",    "Result cache lookups computed from the store" },
+    { "backup_bytes_total",    "Bytes copied into backups (restores included)" },
+    { "samples_late_total",    "Samples that arrived too late to store in time order" },
+    { "compact_records_total", "Raw records folded into the per-minute tier" },
+    { "compact_bytes_total",   "Bytes read and written by tier compaction" },
+#define REJECTED_INFO_(field, stat, wtype, wire, key, label, ...) \
+    { "rejected_" #field "_total", "Samples dropped on ingest: " label " out of range" },
+    SENSOR_FIELDS(REJECTED_INFO_)
+#undef REJECTED_INFO_
+};
+
+static const struct { const char* name; const char* help; } GAUGE_INFO[METRIC_GAUGE_COUNT] = {
+    { "pipe_queue_bytes",      "Bytes waiting in the collector pipe (sampled)" },
+    { "store_records",         "Records currently held in the store" },
+    { "query_clients",         "Open query server connections" },
+    { "reorder_pending",       "Samples held in the reorder buffer" },
+    { "tier_bytes",            "Bytes held in the per-minute and per-hour tier files" },
+};
+
+static const struct { const char* name; const char* help; } HIST_INFO[METRIC_HIST_COUNT] = {
+    { "parse_seconds",         "parse_sensor_data latency" },
+    { "pipe_write_seconds",    "write_full latency on the collector pipe" },
+    { "system_log_seconds",    "system_log_append latency" },
+    { "data_log_seconds",      "data_log_append latency" },
+    { "journal_sync_seconds",  "Journal fdatasync latency" },
+    { "query_seconds",         "Query request latency, receipt to last frame" },
+    { "stage_parse_seconds",   "Sample stage: serial read to decoded (collector)" },
+    { "stage_write_seconds",   "Sample stage: decoded to pipe write (collector)" },
+    { "stage_pipe_seconds",    "Sample stage: pipe write to read by the supervisor" },
+    { "stage_ingest_seconds",  "Sample stage: received to stored (validation, reorder wait, journal)" },
+    { "stage_total_seconds",   "Sample latency end to end: serial read to stored" },
+};
+
+
+/* =====================================
+ * HISTOGRAM LOG-LINEAR
+ * ===================================== */
+
+static inline size_t hist_index(uint64_t v) {
+    if (v < METRICS_HIST_SUB) return (size_t)v;
+    unsigned e = 63u - (unsigned)__builtin_clzll(v);       // e >= 4
+    if (e >= METRICS_HIST_MAX_EXP) return METRICS_HIST_BUCKETS - 1;
+    unsigned sub = (unsigned)(v >> (e - 4)) & (METRICS_HIST_SUB - 1);
+    return (size_t)(e - 3) * METRICS_HIST_SUB + sub;
+}
+
+// Cận trên (không bao gồm) của bucket i, đơn vị ns
+static uint64_t hist_upper(size_t i) {
+    if (i < METRICS_HIST_SUB) return i + 1;
+    unsigned e = (unsigned)(i / METRICS_HIST_SUB) + 3;
+    uint64_t sub = i % METRICS_HIST_SUB;
+    return (METRICS_HIST_SUB + sub + 1) << (e - 4);
+}
+
+static inline void relaxed_add(uint64_t* p, uint64_t v) {
+    __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+void metrics_hist_record(metrics_hist_t* h, uint64_t ns) {
+    relaxed_add(&h->buckets[hist_index(ns)], 1);
+    relaxed_add(&h->sum, ns);
+    relaxed_add(&h->count, 1);
+    if (ns > __atomic_load_n(&h->max, __ATOMIC_RELAXED))
+        __atomic_store_n(&h->max, ns, __ATOMIC_RELAXED);
+}
+
+uint64_t metrics_hist_quantile(const metrics_hist_t* h, double q) {
+    uint64_t total = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)total);
+    if (rank >= total) rank = total - 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < METRICS_HIST_BUCKETS; i++) {
+        seen += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        if (seen > rank) return hist_upper(i);
+    }
+    return __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+}
+
+
+/* =====================================
+ * QUẢN LÝ SHARD
+ * ===================================== */
+
+// Sau fork(), tiến trình con không được ghi vào shard của cha
+static void atfork_child(void) {
+    metrics_tls_shard = NULL;
+}
+
+int metrics_init(void) {
+    if (shards) return 0;
+    void* p = mmap(NULL, sizeof(metrics_shard_t) * METRICS_MAX_SHARDS,
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return -1;
+    shards = p;
+    pthread_atfork(NULL, NULL, atfork_child);
+    return 0;
+}
+
+static int pid_alive(int pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+metrics_shard_t* metrics_thread_register(const char* label) {
+    char def[METRICS_LABEL_LEN];
+    if (!label) {
+        snprintf(def, sizeof(def), "pid:%d", (int)getpid());
+        label = def;
+    }
+    if (metrics_init() != 0) {
+        metrics_tls_shard = &overflow_shard;
+        return metrics_tls_shard;
+    }
+
+    int me = (int)getpid();
+
+    // Ưu tiên shard cùng nhãn của tiến trình đã chết (collector được khởi động lại)
+    for (int i = 0; i < METRICS_MAX_SHARDS; i++) {
+        metrics_shard_t* s = &shards[i];
+        int pid = __atomic_load_n(&s->pid, __ATOMIC_ACQUIRE);
+        if (!__atomic_load_n(&s->in_use, __ATOMIC_ACQUIRE) || strcmp(s->label, label) != 0 ||
+            pid_alive(pid))
+            continue;
+        if (__atomic_compare_exchange_n(&s->pid, &pid, me, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            metrics_tls_shard = s;
+            return s;
+        }
+    }
+
+    for (int i = 0; i < METRICS_MAX_SHARDS; i++) {
+        metrics_shard_t* s = &shards[i];
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&s->in_use, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            memset(s->counters, 0, sizeof(s->counters));
+            memset(s->gauges, 0, sizeof(s->gauges));
+            memset(s->hists, 0, sizeof(s->hists));
+            snprintf(s->label, sizeof(s->label), "%s", label);
+            __atomic_store_n(&s->pid, me, __ATOMIC_RELEASE);
+            metrics_tls_shard = s;
+            return s;
+        }
+    }
+
+    metrics_tls_shard = &overflow_shard;
+    return metrics_tls_shard;
+}
+
+
+/* =====================================
+ * XUẤT PROMETHEUS TEXT
+ * ===================================== */
+
+static const double LE_SECONDS[] = {
+    1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4,
+    1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 0.1, 1.0,
+};
+
+#define FOR_EACH_SHARD(s) \
+    for (metrics_shard_t* s = shards; shards && s < shards + METRICS_MAX_SHARDS; s++) \
+        if (__atomic_load_n(&s->in_use, __ATOMIC_ACQUIRE))
+
+void metrics_write_prometheus(FILE* out) {
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+        fprintf(out, "# HELP smart_station_%s %s\n# TYPE smart_station_%s counter\n",
+                COUNTER_INFO[c].name, COUNTER_INFO[c].help, COUNTER_INFO[c].name);
+        FOR_EACH_SHARD(s)
+            fprintf(out, "smart_station_%s{shard=\"%s\"} %llu\n", COUNTER_INFO[c].name, s->label,
+                    (unsigned long long)__atomic_load_n(&s->counters[c], __ATOMIC_RELAXED));
+    }
+
+    for (int g = 0; g < METRIC_GAUGE_COUNT; g++) {
+        fprintf(out, "# HELP smart_station_%s %s\n# TYPE smart_station_%s gauge\n",
+                GAUGE_INFO[g].name, GAUGE_INFO[g].help, GAUGE_INFO[g].name);
+        FOR_EACH_SHARD(s)
+            fprintf(out, "smart_station_%s{shard=\"%s\"} %lld\n", GAUGE_INFO[g].name, s->label,
+                    (long long)__atomic_load_n(&s->gauges[g], __ATOMIC_RELAXED));
+    }
+
+    for (int h = 0; h < METRIC_HIST_COUNT; h++) {
+        const char* name = HIST_INFO[h].name;
+        fprintf(out, "# HELP smart_station_%s %s\n# TYPE smart_station_%s histogram\n",
+                name, HIST_INFO[h].help, name);
+        FOR_EACH_SHARD(s) {
+            const metrics_hist_t* hist = &s->hists[h];
+            uint64_t cum = 0;
+            size_t b = 0;
+            for (size_t k = 0; k < sizeof(LE_SECONDS) / sizeof(LE_SECONDS[0]); k++) {
+                uint64_t le_ns = (uint64_t)(LE_SECONDS[k] * 1e9);
+                while (b < METRICS_HIST_BUCKETS && hist_upper(b) <= le_ns)
+                    cum += __atomic_load_n(&hist->buckets[b++], __ATOMIC_RELAXED);
+                fprintf(out, "smart_station_%s_bucket{shard=\"%s\",le=\"%g\"} %llu\n",
+                        name, s->label, LE_SECONDS[k], (unsigned long long)cum);
+            }
+            uint64_t count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+            fprintf(out, "smart_station_%s_bucket{shard=\"%s\",le=\"+Inf\"} %llu\n",
+                    name, s->label, (unsigned long long)count);
+            fprintf(out, "smart_station_%s_sum{shard=\"%s\"} %.9f\n", name, s->label,
+                    (double)__atomic_load_n(&hist->sum, __ATOMIC_RELAXED) / 1e9);
+            fprintf(out, "smart_station_%s_count{shard=\"%s\"} %llu\n",
+                    name, s->label, (unsigned long long)count);
+        }
+    }
+
+    // Phân vị tính sẵn, tiện xem nhanh bằng curl mà không cần PromQL
+    fprintf(out, "# HELP smart_station_latency_quantile_seconds Precomputed latency quantiles\n"
+                 "# TYPE smart_station_latency_quantile_seconds gauge\n");
+    static const double QS[] = { 0.5, 0.99, 0.999 };
+    for (int h = 0; h < METRIC_HIST_COUNT; h++) {
+        FOR_EACH_SHARD(s) {
+            if (__atomic_load_n(&s->hists[h].count, __ATOMIC_RELAXED) == 0) continue;
+            for (size_t k = 0; k < sizeof(QS) / sizeof(QS[0]); k++)
+                fprintf(out, "smart_station_latency_quantile_seconds{stage=\"%s\",shard=\"%s\",quantile=\"%g\"} %.9f\n",
+                        HIST_INFO[h].name, s->label, QS[k],
+                        (double)metrics_hist_quantile(&s->hists[h], QS[k]) / 1e9);
+        }
+    }
+}
+
+
+/* =====================================
+ * PHỤC VỤ QUA UNIX SOCKET
+ * =====================================
+ * Mỗi kết nối: đọc (và bỏ qua) request, trả về "HTTP/1.0 200" + text rồi
+ * đóng. Chạy trong luồng nền, chỉ đọc shard nên không làm chậm ingest.
+ */
+
+static int listen_fd = -1;
+static pthread_t serve_thread;
+static char serve_path[108];
+
+static void send_all(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+static void* serve_main(void* arg) {
+    (void)arg;
+    metrics_thread_register("metrics-server");
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;      // metrics_stop() đã shutdown socket
+        }
+
+        struct timeval tv = { 0, 200000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        char req[1024];
+        (void)recv(fd, req, sizeof(req), 0);
+
+        char* body = NULL;
+        size_t len = 0;
+        FILE* mem = open_memstream(&body, &len);
+        if (mem) {
+            metrics_write_prometheus(mem);
+            fclose(mem);
+            char hdr[160];
+            int hn = snprintf(hdr, sizeof(hdr),
+                              "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %zu\r\n\r\n", len);
+            send_all(fd, hdr, (size_t)hn);
+            send_all(fd, body, len);
+            free(body);
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+int metrics_serve(const char* path) {
+    if (listen_fd >= 0) return 0;
+    if (metrics_init() != 0) return -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    listen_fd = fd;
+    snprintf(serve_path, sizeof(serve_path), "%s", path);
+
+    if (pthread_create(&serve_thread, NULL, serve_main, NULL) != 0) {
+        close(fd);
+        listen_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (listen_fd < 0) return;
+    shutdown(listen_fd, SHUT_RDWR);
+    pthread_join(serve_thread, NULL);
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(serve_path);
+}
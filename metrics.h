@@ -0,0 +1,163 @@
+/* metrics.h — Bộ đếm & histogram độ trễ cho các đường nóng
+ *
+ * Mỗi luồng (hoặc tiến trình collector) ghi vào một "shard" riêng nên không
+ * cần khóa hay lệnh atomic read-modify-write: chỉ một luồng ghi, luồng xuất
+ * số liệu chỉ đọc. Các shard nằm trong một vùng nhớ chia sẻ (mmap MAP_SHARED)
+ * được tạo bởi metrics_init() trước khi fork(), nên tiến trình cha nhìn thấy
+ * số liệu của mọi collector con.
+ *
+ * Histogram kiểu HDR (log-linear): mỗi khoảng [2^e, 2^(e+1)) chia thành
+ * 16 bucket đều nhau → sai số tương đối ≤ 6.25%, bộ nhớ cố định.
+ *
+ * Xuất số liệu dạng Prometheus text qua Unix socket (metrics_serve), ví dụ:
+ *   curl --unix-socket metrics.sock http://localhost/metrics
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "schema.h"
+
+#define METRICS_MAX_SHARDS   64
+#define METRICS_LABEL_LEN    48
+#define METRICS_SOCKET_PATH  "metrics.sock"
+
+/* Histogram: giá trị < 16 ns có bucket riêng, sau đó 16 bucket mỗi lũy thừa 2,
+ * tới 2^40 ns (~18 phút); lớn hơn thì dồn vào bucket cuối. */
+#define METRICS_HIST_SUB     16
+#define METRICS_HIST_MAX_EXP 40
+#define METRICS_HIST_BUCKETS ((METRICS_HIST_MAX_EXP - 3) * METRICS_HIST_SUB)
+
+typedef enum {
+    METRIC_BYTES_READ = 0,      // byte đọc từ serial / giả lập
+    METRIC_LINES_READ,          // dòng ASCII tách được
+    METRIC_FRAMES_READ,         // khung nhị phân hợp lệ
+    METRIC_PARSE_FAILURES,      // dòng sai định dạng
+    METRIC_CRC_ERRORS,          // khung nhị phân sai CRC
+    METRIC_SAMPLES_SENT,        // mẫu đã ghi vào pipe
+    METRIC_PIPE_ERRORS,         // lỗi ghi pipe
+    METRIC_LOG_WRITES,          // dòng ghi vào system_log / data_log
+    METRIC_STORE_APPENDS,       // bản ghi thêm vào store
+    METRIC_JOURNAL_BYTES,       // byte ghi vào write-ahead journal
+    METRIC_JOURNAL_SYNCS,       // số lần fdatasync (group commit)
+    METRIC_QUERY_REQUESTS,      // request đã xử lý bởi query server
+    METRIC_CACHE_HITS,          // kết quả cache dùng lại nguyên vẹn
+    METRIC_CACHE_TAIL_UPDATES,  // kết quả cache chỉ tính thêm phần đuôi
+    METRIC_CACHE_MISSES,        // kết quả tính lại từ store
+    METRIC_BACKUP_BYTES,        // byte sao chép vào bản sao lưu
+    METRIC_SAMPLES_LATE,        // mẫu đến quá trễ để sắp xếp lại, bị bỏ
+    METRIC_COMPACT_RECORDS,     // bản ghi thô đã gộp vào tầng theo phút
+    METRIC_COMPACT_BYTES,       // byte đọc + ghi bởi việc gộp tầng (tính vào ngân sách I/O)
+    METRIC_REJECTED,            // mẫu bị loại: trường ngoài phạm vi, một bộ đếm mỗi
+    METRIC_REJECTED_LAST = METRIC_REJECTED + SENSOR_FIELD_COUNT - 1,  // trường (schema.h)
+    METRIC_COUNTER_COUNT
+} metric_counter_t;
+
+typedef enum {
+    METRIC_PIPE_QUEUE_BYTES = 0,    // byte đang nằm trong pipe (lấy mẫu)
+    METRIC_STORE_RECORDS,           // số bản ghi trong store
+    METRIC_QUERY_CLIENTS,           // kết nối đang mở tới query server
+    METRIC_REORDER_PENDING,         // mẫu đang chờ trong reorder buffer
+    METRIC_TIER_BYTES,              // byte trong các file tầng (theo phút + theo giờ)
+    METRIC_GAUGE_COUNT
+} metric_gauge_t;
+
+typedef enum {
+    METRIC_PARSE_NS = 0,        // parse_sensor_data
+    METRIC_PIPE_WRITE_NS,       // write_full ra pipe
+    METRIC_SYSTEM_LOG_NS,       // system_log_append
+    METRIC_DATA_LOG_NS,         // data_log_append
+    METRIC_JOURNAL_SYNC_NS,     // fdatasync của journal
+    METRIC_QUERY_NS,            // một request, từ lúc nhận tới khung cuối
+    METRIC_STAGE_PARSE_NS,      // chặng: collector đọc byte → giải mã xong mẫu
+    METRIC_STAGE_WRITE_NS,      // chặng: giải mã xong → bắt đầu ghi pipe
+    METRIC_STAGE_PIPE_NS,       // chặng: ghi pipe → tiến trình cha đọc được
+    METRIC_STAGE_INGEST_NS,     // chặng: cha nhận → lưu vào store (kiểm tra, sắp xếp lại, journal)
+    METRIC_STAGE_TOTAL_NS,      // trọn đường: collector đọc byte → lưu vào store
+    METRIC_HIST_COUNT
+} metric_hist_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[METRICS_HIST_BUCKETS];
+} metrics_hist_t;
+
+typedef struct {
+    int in_use;
+    int pid;
+    char label[METRICS_LABEL_LEN];
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    int64_t gauges[METRIC_GAUGE_COUNT];
+    metrics_hist_t hists[METRIC_HIST_COUNT];
+} metrics_shard_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Tạo vùng nhớ chia sẻ cho các shard. Gọi một lần ở tiến trình cha trước
+ * khi fork collector. Nếu chưa gọi, shard đầu tiên sẽ tự khởi tạo (riêng
+ * tiến trình). Trả về 0 nếu thành công. */
+int metrics_init(void);
+
+/* Gắn luồng hiện tại với một shard mang nhãn label (ví dụ "collector:SIM").
+ * Shard của tiến trình đã chết cùng nhãn được dùng lại để bộ đếm liên tục. */
+metrics_shard_t* metrics_thread_register(const char* label);
+
+/* Ghi toàn bộ số liệu dạng Prometheus text vào out */
+void metrics_write_prometheus(FILE* out);
+
+/* Mở Unix socket tại path và phục vụ trong một luồng nền.
+ * Trả về 0 nếu thành công, -1 nếu lỗi. */
+int metrics_serve(const char* path);
+
+/* Dừng luồng phục vụ và xóa file socket */
+void metrics_stop(void);
+
+void metrics_hist_record(metrics_hist_t* h, uint64_t ns);
+
+/* Giá trị xấp xỉ tại phân vị q (0..1) */
+uint64_t metrics_hist_quantile(const metrics_hist_t* h, double q);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* ===== Đường nóng: inline, không khóa ===== */
+
+extern __thread metrics_shard_t* metrics_tls_shard;
+
+static inline metrics_shard_t* metrics_local(void) {
+    metrics_shard_t* s = metrics_tls_shard;
+    return s ? s : metrics_thread_register(NULL);
+}
+
+static inline uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Một luồng ghi duy nhất: load/store relaxed đủ để luồng đọc không thấy giá trị rách
+static inline void metrics_add(metric_counter_t c, uint64_t v) {
+    uint64_t* p = &metrics_local()->counters[c];
+    __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_set(metric_gauge_t g, int64_t v) {
+    __atomic_store_n(&metrics_local()->gauges[g], v, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_observe(metric_hist_t h, uint64_t ns) {
+    metrics_hist_record(&metrics_local()->hists[h], ns);
+}
+
+#define METRIC_INC(c)   metrics_add((c), 1)
+
+#endif /* METRICS_H */
@@ -0,0 +1,802 @@
+#define _GNU_SOURCE
+#include "system.h"
+#include "metrics.h"
+#include "query.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// ============================================================================
+// QUERY SERVER
+// ============================================================================
+//
+// One thread runs an epoll loop over the listening socket and every client
+// (protocol in query.h). Sockets are non-blocking and level-triggered: an
+// idle client is watched for EPOLLIN, a client with a request in progress
+// for EPOLLOUT. Each wakeup advances one client by one step (at most
+// QUERY_STEP_RECORDS records scanned, or one sendfile frame), so a large
+// scan never holds up the small requests of other clients, and a slow
+// reader only stalls itself.
+//
+// The store is read through store_read_begin/end, pinned for one step at a
+// time, never for a whole request: a long transfer does not keep trimmed
+// blocks alive. The record range is fixed when the request arrives; records
+// trimmed while it is being sent are skipped.
+//
+// Range scans over all sensors stream the part held by the current snapshot
+// file with sendfile(), straight from the page cache to the socket. Newer
+// records (and per-sensor scans, which filter) are copied from the store.
+// Each sendfile frame is bounded by the store as it is when the frame is
+// built, so the file never sends a record the copy path would skip.
+//
+// Aggregates and rollups start with the compacted history before
+// tier_floor() (tier.c), QUERY_STEP_TIER_ROWS rows per step, then go on
+// with the store. Range scans return stored records only.
+//
+// Latest values come from a per-sensor table kept up to date by
+// query_ingest() on the ingest thread and read under a per-entry sequence
+// lock, so the server never touches the sensor directory.
+
+#define QUERY_MAX_CLIENTS       256
+#define QUERY_STEP_RECORDS      STORE_BLOCK_RECORDS         // records scanned per step
+#define QUERY_SENDFILE_RECORDS  (16 * STORE_BLOCK_RECORDS)  // records per sendfile frame
+#define QUERY_STEP_TIER_ROWS    256                         // tier rows read per step
+#define QUERY_OUT_BYTES         (sizeof(query_response_t) + (QUERY_STEP_RECORDS + 1) * sizeof(query_bucket_t))
+#define QUERY_DEFAULT_ROLLUP_S  3600
+
+_Static_assert(sizeof(query_record_t) == sizeof(sensor_data_t) &&
+               offsetof(query_record_t, values) == offsetof(sensor_data_t, values) &&
+               offsetof(query_record_t, sensor_id) == offsetof(sensor_data_t, sensor_id) &&
+               offsetof(query_record_t, quality) == offsetof(sensor_data_t, quality) &&
+               offsetof(query_record_t, timestamp_ns) == offsetof(sensor_data_t, timestamp_ns),
+               "query_record_t must match the store record layout");
+
+// Running min/max/sum of every field
+typedef struct query_acc {
+    uint64_t count;
+    float min[SENSOR_FIELD_COUNT], max[SENSOR_FIELD_COUNT];
+    double sum[SENSOR_FIELD_COUNT];
+} query_acc_t;
+
+typedef struct query_client {
+    int fd;
+    int slot;                   // index in clients[]
+    uint32_t events;            // current epoll interest
+    int closing;                // close once the output is sent
+
+    query_request_t req;
+    size_t req_len;             // bytes of req received so far
+    int busy;                   // req is being answered
+    uint64_t started_ns;
+
+    size_t pos, end;            // cursor: record indices (LATEST: id list positions)
+    uint64_t left;              // RANGE: records still allowed by limit
+    query_acc_t acc;            // AGGREGATE total / ROLLUP current bucket
+    int64_t bucket_start;
+    sketch_t sketch[SENSOR_FIELD_COUNT];    // AGGREGATE percentiles
+    tier_cursor_t tier;         // AGGREGATE / ROLLUP: compacted rows, read first
+    int in_tier;
+
+    char *out;                  // frames waiting to be sent
+    size_t out_len, out_off;
+    snapshot_records_t file;    // RANGE: snapshot file, fd -1 if none
+    off_t file_off;             // pending sendfile region
+    size_t file_left;
+} query_client_t;
+
+// Latest record per sensor ID (ingest side writes, server reads)
+typedef struct latest_entry {
+    unsigned seq;               // odd while being updated
+    int valid;
+    sensor_data_t rec;
+} latest_entry_t;
+
+static latest_entry_t *latest = NULL;   // SENSOR_ID_LIMIT entries while serving
+static int *latest_ids = NULL;          // IDs with an entry, in arrival order
+static int latest_id_count = 0;
+
+static int listen_fd = -1;
+static int stop_fd = -1;
+static int epoll_fd = -1;
+static pthread_t serve_thread;
+static char serve_path[108];
+static query_client_t *clients[QUERY_MAX_CLIENTS];
+static int client_count = 0;
+
+static inline int fold_id(int id) {
+    return (id >= 0 && id < SENSOR_ID_LIMIT) ? id : 0;
+}
+
+// ============================================================================
+// LATEST VALUES (ingest side)
+// ============================================================================
+
+static void latest_put(const sensor_data_t *rec) {
+    int id = fold_id(rec->sensor_id);
+    latest_entry_t *e = &latest[id];
+    if (e->valid && rec->timestamp < e->rec.timestamp) {
+        return;     // a late record is not the latest
+    }
+    int was_valid = e->valid;
+    unsigned seq = e->seq;
+    __atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->rec = *rec;
+    e->valid = 1;
+    __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+    if (!was_valid) {
+        latest_ids[latest_id_count] = id;
+        __atomic_store_n(&latest_id_count, latest_id_count + 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Called by ingest_records() with every batch; nothing to do unless serving
+void query_ingest(const sensor_data_t *records, size_t count) {
+    if (!latest) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        latest_put(&records[i]);
+    }
+}
+
+// Forgets every latest value (clear_all_data)
+void query_reset(void) {
+    if (!latest) {
+        return;
+    }
+    for (int i = 0; i < latest_id_count; i++) {
+        latest_entry_t *e = &latest[latest_ids[i]];
+        unsigned seq = e->seq;
+        __atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        e->valid = 0;
+        __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&latest_id_count, 0, __ATOMIC_RELEASE);
+}
+
+// Seeds the latest-value table from the sensor directory, after the store
+// was loaded or replaced (restore_data). Ingest thread.
+void query_reload(void) {
+    if (!latest) {
+        return;
+    }
+    query_reset();
+    int ids[SENSOR_MAX_SLOTS];
+    int n = sensor_dir_ids(ids, SENSOR_MAX_SLOTS);
+    if (n > SENSOR_MAX_SLOTS) n = SENSOR_MAX_SLOTS;
+    for (int i = 0; i < n; i++) {
+        latest_put(&sensor_dir_get(ids[i])->last);
+    }
+}
+
+static int latest_get(int id, sensor_data_t *out) {
+    latest_entry_t *e = &latest[id];
+    unsigned before, after;
+    int valid;
+    do {
+        before = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+        valid = e->valid;
+        memcpy(out, &e->rec, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&e->seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+    return valid;
+}
+
+// ============================================================================
+// OUTPUT FRAMES
+// ============================================================================
+
+static query_response_t* frame_begin(query_client_t *c, uint32_t item_size) {
+    query_response_t *h = (query_response_t *)(c->out + c->out_len);
+    h->magic = QUERY_MAGIC;
+    h->op = c->req.op;
+    h->status = QUERY_OK;
+    h->flags = 0;
+    h->item_size = item_size;
+    h->count = 0;
+    c->out_len += sizeof(*h);
+    return h;
+}
+
+static void* frame_item(query_client_t *c, query_response_t *h) {
+    void *item = c->out + c->out_len;
+    c->out_len += h->item_size;
+    h->count++;
+    return item;
+}
+
+static void finish_request(query_client_t *c) {
+    c->busy = 0;
+    tier_cursor_close(&c->tier);
+    metrics_observe(METRIC_QUERY_NS, metrics_now_ns() - c->started_ns);
+}
+
+// Closes the frame: an empty intermediate frame is dropped, the last one
+// (done) is always sent and ends the request
+static void frame_end(query_client_t *c, query_response_t *h, int done) {
+    if (!done) {
+        if (h->count == 0) {
+            c->out_len -= sizeof(*h);
+        } else {
+            h->flags = QUERY_MORE;
+        }
+        return;
+    }
+    finish_request(c);
+}
+
+static void send_error(query_client_t *c, query_status_t status) {
+    query_response_t *h = frame_begin(c, 0);
+    h->status = (uint16_t)status;
+    c->busy = 0;
+}
+
+// ============================================================================
+// REQUESTS
+// ============================================================================
+
+// First index in the snapshot with timestamp >= ts
+static size_t lower_bound(const store_snapshot_t *snap, time_t ts) {
+    size_t lo = snap->first, hi = snap->end;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (store_snapshot_at(snap, mid)->timestamp < ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static inline int wanted(const query_client_t *c, const sensor_data_t *rec) {
+    return c->req.sensor_id == SENSOR_ID_ALL || rec->sensor_id == c->req.sensor_id;
+}
+
+static void acc_reset(query_acc_t *a) {
+    a->count = 0;
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        a->min[f] = INFINITY;
+        a->max[f] = -INFINITY;
+        a->sum[f] = 0;
+    }
+}
+
+static inline void acc_add(query_acc_t *a, const sensor_data_t *rec) {
+    const float *v = rec->values;
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        if (v[f] < a->min[f]) a->min[f] = v[f];
+        if (v[f] > a->max[f]) a->max[f] = v[f];
+        a->sum[f] += v[f];
+    }
+    a->count++;
+}
+
+static inline void acc_add_row(query_acc_t *a, const tier_row_t *row) {
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        if (row->min[f] < a->min[f]) a->min[f] = row->min[f];
+        if (row->max[f] > a->max[f]) a->max[f] = row->max[f];
+        a->sum[f] += (double)row->avg[f] * row->count;
+    }
+    a->count += row->count;
+}
+
+static void start_request(query_client_t *c) {
+    const query_request_t *r = &c->req;
+    if (r->magic != QUERY_MAGIC) {
+        send_error(c, QUERY_ERR_BAD_REQUEST);
+        c->closing = 1;     // out of sync with the stream, cannot recover
+        return;
+    }
+    METRIC_INC(METRIC_QUERY_REQUESTS);
+    c->started_ns = metrics_now_ns();
+
+    switch (r->op) {
+    case QUERY_LATEST:
+        c->pos = 0;
+        c->end = (r->sensor_id == SENSOR_ID_ALL)
+                 ? (size_t)__atomic_load_n(&latest_id_count, __ATOMIC_ACQUIRE) : 1;
+        break;
+    case QUERY_RANGE:
+    case QUERY_AGGREGATE:
+    case QUERY_ROLLUP: {
+        if (r->to != 0 && r->to <= r->from) {
+            c->pos = c->end = 0;
+            break;
+        }
+        store_snapshot_t snap;
+        store_read_begin(&snap);
+        c->pos = lower_bound(&snap, (time_t)r->from);
+        c->end = (r->to != 0) ? lower_bound(&snap, (time_t)r->to) : snap.end;
+        store_read_end(&snap);
+        break;
+    }
+    default:
+        send_error(c, QUERY_ERR_BAD_OP);
+        return;
+    }
+
+    c->left = r->limit ? r->limit : UINT64_MAX;
+    acc_reset(&c->acc);
+    c->bucket_start = 0;
+    if (r->op == QUERY_AGGREGATE) {
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) sketch_reset(&c->sketch[f]);
+    }
+    // The store starts at tier_floor(), the tiers cover what is before it
+    c->in_tier = (r->op == QUERY_AGGREGATE || r->op == QUERY_ROLLUP) &&
+                 (r->to == 0 || r->to > r->from) && (time_t)r->from < tier_floor();
+    if (c->in_tier) {
+        tier_cursor_open(&c->tier, r->sensor_id, (time_t)r->from, r->to ? (time_t)r->to : (time_t)INT64_MAX);
+    }
+    if (r->op == QUERY_RANGE && r->sensor_id == SENSOR_ID_ALL &&
+        snapshot_open_records(&c->file) != 0) {
+        c->file.fd = -1;
+    }
+    c->busy = 1;
+}
+
+static void step_latest(query_client_t *c) {
+    store_snapshot_t snap;
+    store_read_begin(&snap);
+    // A latest value older than the oldest stored record has been trimmed
+    int empty = snap.first == snap.end;
+    time_t oldest = empty ? 0 : store_snapshot_at(&snap, snap.first)->timestamp;
+    store_read_end(&snap);
+
+    query_response_t *h = frame_begin(c, sizeof(query_record_t));
+    size_t stop = c->pos + QUERY_STEP_RECORDS < c->end ? c->pos + QUERY_STEP_RECORDS : c->end;
+    for (; c->pos < stop; c->pos++) {
+        int id = (c->req.sensor_id == SENSOR_ID_ALL) ? latest_ids[c->pos] : fold_id(c->req.sensor_id);
+        sensor_data_t rec;
+        if (latest_get(id, &rec) && !empty && rec.timestamp >= oldest) {
+            memcpy(frame_item(c, h), &rec, sizeof(rec));
+        }
+    }
+    frame_end(c, h, c->pos >= c->end);
+}
+
+static void step_range(query_client_t *c) {
+    query_response_t *h = frame_begin(c, sizeof(query_record_t));
+
+    // Records inside the snapshot file: one frame header, then sendfile.
+    // The file does not follow trims, so every chunk is bounded by what the
+    // store holds now, as on the copy path below.
+    size_t held = 0;
+    if (c->file.fd >= 0 && c->pos < c->file.end) {
+        store_snapshot_t snap;
+        store_read_begin(&snap);
+        if (c->pos < snap.first) {
+            c->pos = snap.first;
+        }
+        held = snap.end;
+        store_read_end(&snap);
+    }
+    if (c->file.fd >= 0 && c->pos >= c->file.first && c->pos < c->file.end &&
+        c->pos < held && c->pos < c->end) {
+        size_t n = (c->end < c->file.end ? c->end : c->file.end) - c->pos;
+        if (n > held - c->pos) n = held - c->pos;
+        if (n > QUERY_SENDFILE_RECORDS) n = QUERY_SENDFILE_RECORDS;
+        if (n > c->left) n = (size_t)c->left;
+        h->count = n;
+        c->file_off = c->file.offset + (off_t)((c->pos - c->file.first) * sizeof(sensor_data_t));
+        c->file_left = n * sizeof(sensor_data_t);
+        c->pos += n;
+        c->left -= n;
+        frame_end(c, h, c->pos >= c->end || c->left == 0);
+        return;
+    }
+
+    store_snapshot_t snap;
+    store_read_begin(&snap);
+    if (c->pos < snap.first) {
+        c->pos = snap.first;
+    }
+    size_t stop = c->pos + QUERY_STEP_RECORDS < c->end ? c->pos + QUERY_STEP_RECORDS : c->end;
+    if (c->file.fd >= 0 && c->pos < c->file.first && stop > c->file.first) {
+        stop = c->file.first;   // switch to the file from there on
+    }
+    store_iter_t it;
+    const sensor_data_t *span;
+    size_t n;
+    store_iter_snapshot(&it, &snap, c->pos, stop);
+    c->pos = stop > c->pos ? stop : c->pos;
+    while ((n = store_iter_span(&it, &span)) > 0) {
+        if (c->req.sensor_id == SENSOR_ID_ALL) {
+            if (n > c->left) n = (size_t)c->left;
+            memcpy(c->out + c->out_len, span, n * sizeof(sensor_data_t));
+            c->out_len += n * sizeof(sensor_data_t);
+            h->count += n;
+            c->left -= n;
+        } else {
+            for (size_t i = 0; i < n && c->left > 0; i++) {
+                if (wanted(c, &span[i])) {
+                    memcpy(frame_item(c, h), &span[i], sizeof(sensor_data_t));
+                    c->left--;
+                }
+            }
+        }
+        if (c->left == 0) break;
+    }
+    store_read_end(&snap);
+    frame_end(c, h, c->pos >= c->end || c->left == 0);
+}
+
+static void fill_summary(const query_acc_t *a, int f, float *min, float *max, float *avg) {
+    *min = a->count ? a->min[f] : NAN;
+    *max = a->count ? a->max[f] : NAN;
+    *avg = a->count ? (float)(a->sum[f] / (double)a->count) : NAN;
+}
+
+// One step of the compacted history: 0 once it is done
+static size_t step_tier(query_client_t *c, tier_row_t *rows) {
+    size_t n = tier_cursor_next(&c->tier, rows, QUERY_STEP_TIER_ROWS);
+    if (n == 0) {
+        tier_cursor_close(&c->tier);
+        c->in_tier = 0;
+    }
+    return n;
+}
+
+static void step_aggregate(query_client_t *c) {
+    if (c->in_tier) {
+        // Percentiles of the compacted part are those of the row averages
+        tier_row_t rows[QUERY_STEP_TIER_ROWS];
+        size_t n = step_tier(c, rows);
+        for (size_t i = 0; i < n; i++) {
+            acc_add_row(&c->acc, &rows[i]);
+            for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+                sketch_add(&c->sketch[f], rows[i].avg[f]);
+            }
+        }
+        return;
+    }
+
+    store_snapshot_t snap;
+    store_read_begin(&snap);
+    if (c->pos < snap.first) {
+        c->pos = snap.first;
+    }
+    size_t stop = c->pos + QUERY_STEP_RECORDS < c->end ? c->pos + QUERY_STEP_RECORDS : c->end;
+    store_iter_t it;
+    const sensor_data_t *span;
+    size_t n;
+    store_iter_snapshot(&it, &snap, c->pos, stop);
+    while ((n = store_iter_span(&it, &span)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (wanted(c, &span[i])) {
+                acc_add(&c->acc, &span[i]);
+                for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+                    sketch_add(&c->sketch[f], span[i].values[f]);
+                }
+            }
+        }
+    }
+    store_read_end(&snap);
+    if (stop > c->pos) c->pos = stop;
+    if (c->pos < c->end) {
+        return;
+    }
+
+    query_response_t *h = frame_begin(c, sizeof(query_aggregate_t));
+    query_aggregate_t *a = frame_item(c, h);
+    a->count = c->acc.count;
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        query_field_t *q = &a->field[f];
+        fill_summary(&c->acc, f, &q->min, &q->max, &q->avg);
+        q->p50 = (float)sketch_quantile(&c->sketch[f], 0.50);
+        q->p95 = (float)sketch_quantile(&c->sketch[f], 0.95);
+        q->p99 = (float)sketch_quantile(&c->sketch[f], 0.99);
+    }
+    frame_end(c, h, 1);
+}
+
+static void emit_bucket(query_client_t *c, query_response_t *h) {
+    query_bucket_t *b = frame_item(c, h);
+    memset(b, 0, sizeof(*b));
+    b->start = c->bucket_start;
+    b->count = c->acc.count;
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        fill_summary(&c->acc, f, &b->field[f].min, &b->field[f].max, &b->field[f].avg);
+    }
+    acc_reset(&c->acc);
+}
+
+static void step_rollup(query_client_t *c) {
+    int64_t res = c->req.resolution ? (int64_t)c->req.resolution : QUERY_DEFAULT_ROLLUP_S;
+    query_response_t *h = frame_begin(c, sizeof(query_bucket_t));
+
+    if (c->in_tier) {
+        tier_row_t rows[QUERY_STEP_TIER_ROWS];
+        size_t n = step_tier(c, rows);
+        for (size_t i = 0; i < n; i++) {
+            int64_t start = rows[i].start - ((rows[i].start % res) + res) % res;
+            if (c->acc.count > 0 && start != c->bucket_start) {
+                emit_bucket(c, h);
+            }
+            c->bucket_start = start;
+            acc_add_row(&c->acc, &rows[i]);
+        }
+        frame_end(c, h, 0);
+        return;
+    }
+
+    store_snapshot_t snap;
+    store_read_begin(&snap);
+    if (c->pos < snap.first) {
+        c->pos = snap.first;
+    }
+    size_t stop = c->pos + QUERY_STEP_RECORDS < c->end ? c->pos + QUERY_STEP_RECORDS : c->end;
+    store_iter_t it;
+    const sensor_data_t *span;
+    size_t n;
+    store_iter_snapshot(&it, &snap, c->pos, stop);
+    while ((n = store_iter_span(&it, &span)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (!wanted(c, &span[i])) {
+                continue;
+            }
+            int64_t ts = (int64_t)span[i].timestamp;
+            int64_t start = ts - ((ts % res) + res) % res;
+            if (c->acc.count > 0 && start != c->bucket_start) {
+                emit_bucket(c, h);
+            }
+            c->bucket_start = start;
+            acc_add(&c->acc, &span[i]);
+        }
+    }
+    store_read_end(&snap);
+    if (stop > c->pos) c->pos = stop;
+
+    int done = c->pos >= c->end;
+    if (done && c->acc.count > 0) {
+        emit_bucket(c, h);
+    }
+    frame_end(c, h, done);
+}
+
+static void step(query_client_t *c) {
+    switch (c->req.op) {
+    case QUERY_LATEST:    step_latest(c); break;
+    case QUERY_RANGE:     step_range(c); break;
+    case QUERY_AGGREGATE: step_aggregate(c); break;
+    case QUERY_ROLLUP:    step_rollup(c); break;
+    }
+}
+
+// ============================================================================
+// CONNECTIONS
+// ============================================================================
+
+static void client_close(query_client_t *c) {
+    close(c->fd);           // also removes it from the epoll set
+    if (c->file.fd >= 0) close(c->file.fd);
+    tier_cursor_close(&c->tier);
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) sketch_free(&c->sketch[f]);
+    clients[c->slot] = clients[--client_count];
+    clients[c->slot]->slot = c->slot;
+    free(c->out);
+    free(c);
+    metrics_set(METRIC_QUERY_CLIENTS, client_count);
+}
+
+static void client_accept(void) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;     // EAGAIN: backlog drained
+        }
+        query_client_t *c = client_count < QUERY_MAX_CLIENTS ? calloc(1, sizeof(*c)) : NULL;
+        char *out = c ? malloc(QUERY_OUT_BYTES) : NULL;
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (!out || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            free(out);
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        c->out = out;
+        c->file.fd = -1;
+        c->tier.fd = -1;
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) sketch_init(&c->sketch[f]);
+        c->slot = client_count;
+        clients[client_count++] = c;
+        metrics_set(METRIC_QUERY_CLIENTS, client_count);
+    }
+}
+
+// Sends pending frames, then the pending file region. Returns 1 when
+// everything is out, 0 if the socket is full, -1 if the client is gone.
+static int client_flush(query_client_t *c) {
+    while (c->out_off < c->out_len) {
+        ssize_t w = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        c->out_off += (size_t)w;
+    }
+    c->out_off = c->out_len = 0;
+    while (c->file_left > 0) {
+        ssize_t w = sendfile(c->fd, c->file.fd, &c->file_off, c->file_left);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        if (w == 0) {
+            return -1;      // file shorter than its header says
+        }
+        c->file_left -= (size_t)w;
+    }
+    return 1;
+}
+
+// Reads (part of) the next request. Returns 1 when one is complete.
+static int client_read(query_client_t *c) {
+    for (;;) {
+        ssize_t r = recv(c->fd, (char *)&c->req + c->req_len, sizeof(c->req) - c->req_len, 0);
+        if (r > 0) {
+            c->req_len += (size_t)r;
+            if (c->req_len < sizeof(c->req)) continue;
+            c->req_len = 0;
+            return 1;
+        }
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && errno == EAGAIN) return 0;
+        return -1;      // EOF or error
+    }
+}
+
+static void client_event(query_client_t *c, uint32_t events) {
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        client_close(c);
+        return;
+    }
+
+    int rc = client_flush(c);
+    if (rc == 1 && c->busy) {
+        step(c);
+        rc = client_flush(c);
+    } else if (rc == 1 && !c->closing) {
+        int got = client_read(c);
+        if (got == 1) {
+            start_request(c);
+            if (c->busy) step(c);
+            rc = client_flush(c);
+        } else if (got < 0) {
+            rc = -1;
+        }
+    }
+    if (rc < 0 || (rc == 1 && c->closing)) {
+        client_close(c);
+        return;
+    }
+    if (rc == 1 && !c->busy && c->file.fd >= 0) {
+        close(c->file.fd);      // do not keep a replaced snapshot alive
+        c->file.fd = -1;
+    }
+
+    uint32_t want = (rc == 0 || c->busy) ? EPOLLOUT : EPOLLIN;
+    if (want != c->events) {
+        struct epoll_event ev = { .events = want, .data.ptr = c };
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->events = want;
+    }
+}
+
+static void* serve_main(void *arg) {
+    (void)arg;
+    metrics_thread_register("query-server");
+    struct epoll_event events[64];
+    for (;;) {
+        int n = epoll_wait(epoll_fd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            void *p = events[i].data.ptr;
+            if (p == &stop_fd) {
+                return NULL;
+            } else if (p == &listen_fd) {
+                client_accept();
+            } else {
+                client_event(p, events[i].events);
+            }
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+// Starts serving on path. Call from the ingest thread after the store has
+// been loaded: the latest-value table is seeded from the sensor directory.
+int query_serve(const char *path) {
+    if (listen_fd >= 0) {
+        return 0;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    latest = calloc(SENSOR_ID_LIMIT, sizeof(*latest));
+    latest_ids = malloc(SENSOR_ID_LIMIT * sizeof(*latest_ids));
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    stop_fd = eventfd(0, EFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event lev = { .events = EPOLLIN, .data.ptr = &listen_fd };
+    struct epoll_event sev = { .events = EPOLLIN, .data.ptr = &stop_fd };
+    if (!latest || !latest_ids || fd < 0 || stop_fd < 0 || epoll_fd < 0 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &lev) != 0 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &sev) != 0) {
+        goto fail;
+    }
+    listen_fd = fd;
+    snprintf(serve_path, sizeof(serve_path), "%s", path);
+
+    latest_id_count = 0;
+    query_reload();
+
+    if (pthread_create(&serve_thread, NULL, serve_main, NULL) != 0) {
+        listen_fd = -1;
+        unlink(path);
+        goto fail;
+    }
+    return 0;
+
+fail:
+    if (fd >= 0) close(fd);
+    if (stop_fd >= 0) close(stop_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+    stop_fd = epoll_fd = -1;
+    free(latest);
+    free(latest_ids);
+    latest = NULL;
+    latest_ids = NULL;
+    return -1;
+}
+
+void query_stop(void) {
+    if (listen_fd < 0) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) != sizeof(one)) {
+        log_error("query_stop", strerror(errno));
+    }
+    pthread_join(serve_thread, NULL);
+    while (client_count > 0) {
+        client_close(clients[client_count - 1]);
+    }
+    close(listen_fd);
+    close(stop_fd);
+    close(epoll_fd);
+    listen_fd = stop_fd = epoll_fd = -1;
+    unlink(serve_path);
+    free(latest);
+    free(latest_ids);
+    latest = NULL;
+    latest_ids = NULL;
+    latest_id_count = 0;
+}
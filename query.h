@@ -0,0 +1,111 @@
+/* query.h — Giao thức truy vấn nhị phân qua Unix socket
+ *
+ * Công cụ cục bộ (sidecar Grafana, cron export...) kết nối tới QUERY_SOCKET_PATH
+ * và gửi các request cố định 40 byte; mỗi kết nối gửi lần lượt nhiều request,
+ * request sau chỉ được đọc khi kết quả của request trước đã gửi xong.
+ *
+ * Kết quả là một chuỗi khung:
+ *
+ *   query_response_t (24 byte) | count * item_size byte dữ liệu
+ *
+ * Mọi khung trừ khung cuối có cờ QUERY_MORE; khung cuối có thể rỗng. Lỗi
+ * được báo bằng một khung duy nhất có status != QUERY_OK.
+ *
+ *   QUERY_LATEST     bản ghi mới nhất của sensor_id, hoặc của từng sensor
+ *                    nếu sensor_id = SENSOR_ID_ALL (-1)
+ *   QUERY_RANGE      các bản ghi có timestamp trong [from, to), theo thứ tự
+ *                    thời gian, tối đa limit bản ghi (0 = không giới hạn)
+ *   QUERY_AGGREGATE  một query_aggregate_t trên [from, to)
+ *   QUERY_ROLLUP     các query_bucket_t rộng resolution giây (0 = 1 giờ),
+ *                    căn theo bội số của resolution, chỉ bucket có dữ liệu
+ *
+ * to = 0 nghĩa là tới bản ghi mới nhất. Kết quả là ảnh chụp của store tại
+ * lúc nhận request: bản ghi đến sau không được thêm vào giữa chừng. Số
+ * nguyên theo thứ tự byte của máy (socket chỉ dùng cục bộ).
+ *
+ * Dữ liệu cũ đã được nén thành các dòng min/max/avg theo phút rồi theo giờ
+ * (tier.c). QUERY_AGGREGATE và QUERY_ROLLUP đọc cả phần đã nén: bucket hẹp
+ * hơn một dòng chỉ mịn bằng dòng đó, và phân vị của phần đã nén tính trên
+ * giá trị trung bình của từng dòng. QUERY_LATEST và QUERY_RANGE chỉ trả về
+ * bản ghi gốc còn trong store.
+ */
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "schema.h"
+
+#define QUERY_SOCKET_PATH   "query.sock"
+#define QUERY_MAGIC         0x59525153u     /* "SQRY" */
+
+typedef enum {
+    QUERY_LATEST = 1,
+    QUERY_RANGE,
+    QUERY_AGGREGATE,
+    QUERY_ROLLUP
+} query_op_t;
+
+typedef enum {
+    QUERY_OK = 0,
+    QUERY_ERR_BAD_REQUEST,      /* sai magic → server đóng kết nối */
+    QUERY_ERR_BAD_OP,           /* op không hỗ trợ / tham số sai */
+    QUERY_ERR_INTERNAL          /* hết bộ nhớ... */
+} query_status_t;
+
+#define QUERY_MORE          0x1     /* còn khung tiếp theo */
+
+typedef struct {
+    uint32_t magic;             /* QUERY_MAGIC */
+    uint16_t op;                /* query_op_t */
+    uint16_t flags;             /* dự phòng, = 0 */
+    int32_t  sensor_id;         /* SENSOR_ID_ALL = mọi sensor */
+    uint32_t resolution;        /* QUERY_ROLLUP: độ rộng bucket (giây) */
+    int64_t  from;
+    int64_t  to;
+    uint64_t limit;             /* QUERY_RANGE: số bản ghi tối đa */
+} query_request_t;
+
+typedef struct {
+    uint32_t magic;             /* QUERY_MAGIC */
+    uint16_t op;                /* op của request */
+    uint16_t status;            /* query_status_t */
+    uint32_t flags;             /* QUERY_MORE */
+    uint32_t item_size;         /* kích thước một phần tử dữ liệu */
+    uint64_t count;             /* số phần tử theo sau */
+} query_response_t;
+
+/* Bản ghi của QUERY_LATEST / QUERY_RANGE: cùng bố cục với sensor_data_t nên
+ * server gửi thẳng từ file snapshot bằng sendfile. Các giá trị theo thứ tự
+ * SENSOR_FIELDS (schema.h); phần đệm cuối (nếu có) không xác định. */
+typedef struct {
+    int64_t  timestamp;
+    SENSOR_FIELD_VALUES;
+    int32_t  sensor_id;
+    int32_t  quality;
+    int32_t  timestamp_ns;      /* phần nano giây của timestamp, 0..999999999 */
+} query_record_t;
+
+/* Thống kê một trường, theo thứ tự SENSOR_FIELDS */
+typedef struct {
+    float min, max, avg;
+    float p50, p95, p99;        /* sketch, sai số tương đối ≤ 1% */
+} query_field_t;
+
+typedef struct {
+    uint64_t count;
+    query_field_t field[SENSOR_FIELD_COUNT];
+} query_aggregate_t;
+
+typedef struct {
+    float min, max, avg;
+} query_summary_t;
+
+typedef struct {
+    int64_t  start;             /* đầu bucket */
+    uint64_t count;
+    query_summary_t field[SENSOR_FIELD_COUNT];     /* phần đệm cuối bằng 0 */
+} query_bucket_t;
+
+#endif /* QUERY_H */
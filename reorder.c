@@ -0,0 +1,250 @@
+#include "system.h"
+#include "metrics.h"
+
+// ============================================================================
+// REORDER BUFFER
+// ============================================================================
+//
+// Collectors deliver their samples interleaved and a little out of
+// timestamp order, but everything past ingest_records() relies on the
+// store being time-ordered: binary searches in trims, caches and queries,
+// hour windows, "last N" views. Samples are therefore held here for up to
+// reorder_window_s seconds and released in timestamp order.
+//
+// Samples are ordered by (timestamp, timestamp_ns), so collectors that
+// stamp with sub-second resolution are ordered within the second too.
+//
+// Each source (collector) has its own queue, kept sorted on insert; a
+// sample usually lands at the tail, a late one is moved back a few slots.
+// A release is a k-way merge: the queue heads go into a min-heap keyed by
+// (timestamp, source) and the smallest head is taken until it is newer
+// than the watermark,
+//
+//   newest timestamp seen from any source - reorder_window_s
+//
+// Once no sample has arrived for the window itself (a quiet or stopped
+// station) everything is released, so nothing waits for traffic.
+//
+// A sample older than the newest stored record can no longer be put in
+// order: it is counted as late (samples_late_total) and dropped, and the
+// caller logs it. A full queue releases its oldest samples early, which
+// keeps memory bounded at the cost of more late samples.
+//
+// The stage stamps of each sample travel alongside it; the commit stamp is
+// taken when its batch has been stored (trace.c).
+//
+// Single-threaded, on the ingest thread like the rest of the write path.
+
+#define REORDER_MAX_SOURCES     SUPERVISOR_MAX_COLLECTORS
+#define REORDER_QUEUE_RECORDS   4096    // per source, a power of two
+#define REORDER_BATCH_RECORDS   256     // records per ingest_records() call
+
+typedef struct reorder_queue {
+    sensor_data_t rec[REORDER_QUEUE_RECORDS];
+    sample_trace_t trace[REORDER_QUEUE_RECORDS];
+    size_t head, count;
+} reorder_queue_t;
+
+static reorder_queue_t queues[REORDER_MAX_SOURCES];
+static size_t pending = 0;
+static time_t newest_seen = 0;         // newest timestamp queued since the buffer was last empty
+static uint64_t last_push_ms = 0;
+
+static sensor_data_t out[REORDER_BATCH_RECORDS];
+static sample_trace_t out_trace[REORDER_BATCH_RECORDS];
+static size_t out_len = 0;
+static int released = 0;          // records stored, for reorder_release()
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static inline size_t slot(const reorder_queue_t *q, size_t i) {
+    return (q->head + i) & (REORDER_QUEUE_RECORDS - 1);
+}
+
+static inline sensor_data_t *queue_at(reorder_queue_t *q, size_t i) {
+    return &q->rec[slot(q, i)];
+}
+
+static inline int before(const sensor_data_t *a, const sensor_data_t *b) {
+    return a->timestamp < b->timestamp ||
+           (a->timestamp == b->timestamp && a->timestamp_ns < b->timestamp_ns);
+}
+
+// Every released record must be at or after the newest one stored
+static const sensor_data_t *stored_until(void) {
+    static const sensor_data_t none = { .timestamp = 0 };
+    return store_size() ? store_at(store_end() - 1) : &none;
+}
+
+static void flush_out(void) {
+    if (out_len) {
+        released += ingest_records(out, out_len);
+        uint64_t commit_ns = metrics_now_ns();
+        for (size_t i = 0; i < out_len; i++) {
+            out_trace[i].commit_ns = commit_ns;
+            trace_committed(&out[i], &out_trace[i]);
+        }
+        out_len = 0;
+    }
+}
+
+// ============================================================================
+// K-WAY MERGE
+// ============================================================================
+
+typedef struct reorder_heap {
+    int src[REORDER_MAX_SOURCES];
+    int n;
+} reorder_heap_t;
+
+static inline int head_less(int a, int b) {
+    const sensor_data_t *ra = queue_at(&queues[a], 0);
+    const sensor_data_t *rb = queue_at(&queues[b], 0);
+    return before(ra, rb) || (!before(rb, ra) && a < b);
+}
+
+static void sift_down(reorder_heap_t *h, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < h->n && head_less(h->src[l], h->src[m])) m = l;
+        if (r < h->n && head_less(h->src[r], h->src[m])) m = r;
+        if (m == i) return;
+        int t = h->src[i];
+        h->src[i] = h->src[m];
+        h->src[m] = t;
+        i = m;
+    }
+}
+
+// Moves queue heads to the store in timestamp order while the smallest is
+// at or before `watermark`, or for the first `force` records regardless
+static void release(time_t watermark, size_t force) {
+    reorder_heap_t h = { .n = 0 };
+    for (int s = 0; s < REORDER_MAX_SOURCES; s++) {
+        if (queues[s].count) h.src[h.n++] = s;
+    }
+    for (int i = h.n / 2 - 1; i >= 0; i--) {
+        sift_down(&h, i);
+    }
+
+    sensor_data_t floor = *stored_until();
+    while (h.n) {
+        reorder_queue_t *q = &queues[h.src[0]];
+        const sensor_data_t *rec = queue_at(q, 0);
+        if (rec->timestamp > watermark && force == 0) {
+            break;
+        }
+        if (force) force--;
+
+        if (before(rec, &floor)) {
+            METRIC_INC(METRIC_SAMPLES_LATE);    // overtaken by another path into the store
+        } else {
+            out_trace[out_len] = q->trace[q->head];
+            out[out_len++] = *rec;
+            floor = *rec;
+            if (out_len == REORDER_BATCH_RECORDS) flush_out();
+        }
+        q->head = (q->head + 1) & (REORDER_QUEUE_RECORDS - 1);
+        q->count--;
+        pending--;
+
+        if (q->count == 0) {
+            h.src[0] = h.src[--h.n];
+        }
+        sift_down(&h, 0);
+    }
+    flush_out();
+    if (pending == 0) {
+        newest_seen = 0;    // the watermark follows what is queued, not a cleared store
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+// Queues a batch from one source; traces[i] (if not NULL) holds the stage
+// stamps of records[i]. Returns the number of samples that were too late
+// to be put in order; they are dropped.
+size_t reorder_push(int source, const sensor_data_t *records, const sample_trace_t *traces,
+                    size_t count) {
+    if (source < 0 || source >= REORDER_MAX_SOURCES) {
+        source = 0;
+    }
+    reorder_queue_t *q = &queues[source];
+    sensor_data_t floor = *stored_until();
+    size_t late = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const sensor_data_t *rec = &records[i];
+        if (before(rec, &floor)) {
+            late++;
+            continue;
+        }
+        if (q->count == REORDER_QUEUE_RECORDS) {
+            do {
+                release(0, REORDER_BATCH_RECORDS);  // the oldest overall, until q has room
+            } while (q->count == REORDER_QUEUE_RECORDS);
+            floor = *stored_until();
+            if (before(rec, &floor)) {
+                late++;
+                continue;
+            }
+        }
+        // Insertion from the tail: in-order samples do not move anything
+        size_t pos = q->count;
+        while (pos > 0 && before(rec, queue_at(q, pos - 1))) {
+            q->rec[slot(q, pos)] = q->rec[slot(q, pos - 1)];
+            q->trace[slot(q, pos)] = q->trace[slot(q, pos - 1)];
+            pos--;
+        }
+        q->rec[slot(q, pos)] = *rec;
+        if (traces) {
+            q->trace[slot(q, pos)] = traces[i];
+        } else {
+            memset(&q->trace[slot(q, pos)], 0, sizeof(sample_trace_t));
+        }
+        q->count++;
+        pending++;
+        if (rec->timestamp > newest_seen) newest_seen = rec->timestamp;
+    }
+
+    if (count > late) last_push_ms = now_ms();
+    if (late) metrics_add(METRIC_SAMPLES_LATE, late);
+    metrics_set(METRIC_REORDER_PENDING, (int64_t)pending);
+    return late;
+}
+
+// Stores every queued sample that can no longer be overtaken (all of them
+// if `flush`, or once the sources have been quiet for the window).
+// Returns the number of records stored since the last call, including
+// those a full queue pushed out early.
+int reorder_release(int flush) {
+    if (pending) {
+        int window = system_config.reorder_window_s > 0 ? system_config.reorder_window_s : 0;
+        release(flush || reorder_due_in() == 0 ? newest_seen : newest_seen - window, 0);
+        metrics_set(METRIC_REORDER_PENDING, (int64_t)pending);
+    }
+    int n = released;
+    released = 0;
+    return n;
+}
+
+// Milliseconds until reorder_release() would release everything because
+// the sources went quiet, -1 if nothing is queued
+int reorder_due_in(void) {
+    if (pending == 0) {
+        return -1;
+    }
+    uint64_t elapsed = now_ms() - last_push_ms;
+    uint64_t limit = system_config.reorder_window_s > 0 ? (uint64_t)system_config.reorder_window_s * 1000 : 0;
+    return elapsed >= limit ? 0 : (int)(limit - elapsed);
+}
+
+size_t reorder_pending(void) {
+    return pending;
+}
@@ -0,0 +1,109 @@
+/* schema.h — Danh sách đại lượng đo của trạm (X-macro)
+ *
+ * Mỗi đại lượng được khai báo đúng một lần trong SENSOR_FIELDS. Từ bảng này
+ * compiler sinh ra:
+ *
+ *   - trường của sensor_data_t, SensorData (pipe collector), query_record_t
+ *   - statistics_t / sensor_info_t (min, max, avg, sum, p50, p95, p99)
+ *   - bộ phân tích dòng ASCII, log dữ liệu và bộ giả lập trong collector
+ *   - giới hạn kiểm tra (validate.c) và bộ đếm mẫu bị loại
+ *   - ngưỡng sd của anomaly, histogram tổng quan, menu biểu đồ
+ *   - cột CSV / Arrow, các bảng thống kê và báo cáo
+ *
+ * Mọi vòng lặp theo đại lượng có số lần lặp là hằng lúc biên dịch (hoặc là
+ * một X-macro được mở ra tại chỗ), nên đường nóng không tra bảng hay rẽ
+ * nhánh theo trường.
+ *
+ * Thêm một đại lượng (ví dụ CO2): thêm một dòng X(...) vào cuối bảng, rồi
+ * biên dịch lại. Lưu ý:
+ *   - dòng ASCII từ Arduino phải có đủ các giá trị, theo thứ tự của bảng;
+ *   - khung nhị phân (frame.h) có định dạng cố định, chỉ mang ba đại lượng
+ *     đầu; các đại lượng khác bằng 0 trên đường nhị phân;
+ *   - sizeof(sensor_data_t) thay đổi. Journal và snapshot ghi kích thước
+ *     bản ghi; bản build mới từ chối file cũ (không cắt, không xóa) và dừng
+ *     ngay khi khởi động. Xuất CSV bằng bản build cũ trước khi nâng cấp.
+ *
+ * Các cột:
+ *   field    tên trường trong sensor_data_t, cũng là tên cột CSV / Arrow
+ *   stat     tiền tố trong statistics_t / sensor_info_t (temp → temp_min...)
+ *   wtype    kiểu trên pipe collector: float hoặc int
+ *   wire     tên trường trong SensorData
+ *   key      một chữ cái: phím biểu đồ, nhãn trong log và bảng hẹp
+ *   label    tên hiển thị
+ *   unit     đơn vị
+ *   lo, hi   khoảng hợp lệ; mẫu ngoài khoảng bị loại khi ingest
+ *   min_sd   độ lệch chuẩn tối thiểu của anomaly (tín hiệu phẳng)
+ *   h_lo, h_width, h_bins   histogram tổng quan
+ *   s_lo, s_hi, s_step      giả lập: tăng s_step mỗi mẫu, quá s_hi thì về s_lo
+ */
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*  field        stat      wtype  wire         key  label          unit
+ *  lo       hi        min_sd   h_lo     h_width  h_bins   s_lo     s_hi     s_step */
+#define SENSOR_FIELDS(X) \
+    X(temperature, temp,     float, temperature, T,   "Temperature", "°C",  \
+      -50.0f,  100.0f,   0.2f,    -40.0f,  5.0f,    25,      22.0f,   40.0f,   0.1f) \
+    X(humidity,    humidity, float, humidity,    H,   "Humidity",    "%",   \
+      0.0f,    120.0f,   0.5f,    0.0f,    10.0f,   10,      40.0f,   90.0f,   0.2f) \
+    X(gas_level,   gas,      int,   gas_ppm,     G,   "Gas level",   "ppm", \
+      0.0f,    1e6f,     3.0f,    0.0f,    100.0f,  20,      150.0f,  600.0f,  3.0f)
+
+#define SCHEMA_COUNT_(field, ...)   + 1
+#define SENSOR_FIELD_COUNT          (0 SENSOR_FIELDS(SCHEMA_COUNT_))
+
+/* Một mảng theo trường kèm tên riêng cho từng phần tử, ví dụ
+ * SENSOR_FIELD_ARRAY(float, min) cho phép viết cả st.min[f] lẫn st.temp_min.
+ * Hậu tố phải có SCHEMA_NAMED_<hậu tố> bên dưới, cùng kiểu. */
+#define SENSOR_FIELD_ARRAY(type, sfx) \
+    union { struct { SENSOR_FIELDS(SCHEMA_NAMED_##sfx) }; type sfx[SENSOR_FIELD_COUNT]; }
+
+#define SCHEMA_NAMED_min(field, stat, ...)  float  stat##_min;
+#define SCHEMA_NAMED_max(field, stat, ...)  float  stat##_max;
+#define SCHEMA_NAMED_avg(field, stat, ...)  float  stat##_avg;
+#define SCHEMA_NAMED_p50(field, stat, ...)  float  stat##_p50;
+#define SCHEMA_NAMED_p95(field, stat, ...)  float  stat##_p95;
+#define SCHEMA_NAMED_p99(field, stat, ...)  float  stat##_p99;
+#define SCHEMA_NAMED_sum(field, stat, ...)  double stat##_sum;
+
+/* Giá trị của bản ghi: tên riêng (d->humidity) và mảng (d->values[f]) */
+#define SCHEMA_VALUE_(field, ...)           float field;
+#define SENSOR_FIELD_VALUES \
+    union { struct { SENSOR_FIELDS(SCHEMA_VALUE_) }; float values[SENSOR_FIELD_COUNT]; }
+
+/* Trường của bản ghi trên pipe collector */
+#define SCHEMA_WIRE_(field, stat, wtype, wire, ...)     wtype wire;
+
+/* Bản ghi collector gửi qua pipe cho tiến trình cha (start_collector →
+ * supervisor.c). Chỉ định nghĩa ở đây, cho cả module sensor lẫn phần còn
+ * lại của hệ thống:
+ *    - ts, ts_nsec: thời điểm đọc byte từ cổng (CLOCK_REALTIME, giây epoch
+ *                   và phần nano giây)
+ *    - các đại lượng đo theo SENSOR_FIELDS, cột wire:
+ *      temperature (°C), humidity (%), gas_ppm (ppm)...
+ *    - sensor_id:   ID cảm biến gửi mẫu
+ *    - seq:         số thứ tự mẫu (phát hiện mất mẫu)
+ *    - t_read, t_parse, t_write: mốc CLOCK_MONOTONIC (ns) của từng chặng
+ *      trong collector. Đồng hồ monotonic dùng chung cho mọi tiến trình
+ *      trên máy nên tiến trình cha nối tiếp được các mốc này với mốc nhận
+ *      và mốc lưu của mình (trace.c).
+ */
+typedef struct {
+    time_t ts;
+    SENSOR_FIELDS(SCHEMA_WIRE_)
+    int sensor_id;      /* ID cảm biến (khung nhị phân), 0 nếu dòng ASCII */
+    uint32_t seq;       /* Số thứ tự mẫu trên cổng này */
+    int32_t ts_nsec;    /* Phần nano giây của ts */
+    uint64_t t_read;    /* read() trên cổng trả về byte chứa mẫu */
+    uint64_t t_parse;   /* giải mã xong dòng / khung */
+    uint64_t t_write;   /* ngay trước khi ghi vào pipe */
+} SensorData;
+
+/* Định dạng printf theo kiểu wire */
+#define SCHEMA_FMT_float    "%.1f"
+#define SCHEMA_FMT_int      "%d"
+
+#endif /* SCHEMA_H */
@@ -0,0 +1,602 @@
+#include "system.h"
+#include "anomaly.h"
+
+// ============================================================================
+// SENSOR DIRECTORY
+// ============================================================================
+//
+// Every sensor ID seen on ingest owns a slot. slot_by_id is a dense table
+// indexed directly by ID and grown to the largest ID seen, so finding a
+// sensor is one array read however many sensors exist. A slot holds the
+// sensor's running statistics, its percentile sketches and the store
+// indices of its records, so per-sensor queries never scan other sensors'
+// data.
+//
+// Sketches are kept for all time and per hour for the last STATS_HOURS
+// hours (ring indexed by hour % STATS_HOURS, cells allocated on first use).
+// A second hourly ring merges every sensor for whole-station queries.
+// Sketches cannot subtract, so deleting old data rebuilds the directory
+// from the store.
+
+#define STATS_FIELDS    SENSOR_FIELD_COUNT
+
+#define FIELD_INFO_(field, stat, wtype, wire, key, label, unit, lo, hi, ...) \
+    { #field, label, unit, #key[0], lo, hi },
+const sensor_field_t sensor_fields[SENSOR_FIELD_COUNT] = { SENSOR_FIELDS(FIELD_INFO_) };
+#undef FIELD_INFO_
+
+typedef struct stats_cell {
+    sketch_t field[STATS_FIELDS];
+} stats_cell_t;
+
+typedef struct stats_hours {
+    long tag[STATS_HOURS];                  // timestamp / 3600, -1 if unused
+    stats_cell_t *cell[STATS_HOURS];
+} stats_hours_t;
+
+typedef struct sensor_slot {
+    sensor_info_t info;
+    anomaly_t anomaly;                      // live-stream baseline, survives rebuilds
+    anomaly_kind_t anomaly_state;           // last verdict, for alert edges
+    stats_cell_t all;
+    sketch_hist_t hist[STATS_FIELDS];
+    stats_hours_t hours;
+    size_t *index;                          // absolute store indices, oldest first
+    size_t index_len;
+    size_t index_cap;
+} sensor_slot_t;
+
+static int32_t *slot_by_id = NULL;          // -1 = sensor not seen
+static size_t slot_table_size = 0;
+static sensor_slot_t *slots[SENSOR_MAX_SLOTS];
+static int slot_count = 0;
+
+static stats_hours_t station_hours;         // all sensors merged
+static size_t indexed_records = 0;
+static int directory_ready = 0;
+
+static inline int field_index(int field) {
+    return (field >= 1 && field <= STATS_FIELDS) ? field - 1 : -1;
+}
+
+int sensor_field_by_key(char key) {
+    for (int f = 0; f < STATS_FIELDS; f++) {
+        if (sensor_fields[f].key == key) {
+            return f + 1;
+        }
+    }
+    return 0;
+}
+
+// printf width that pads s to `cols` terminal columns: units such as "°C"
+// are UTF-8, and %-*s counts bytes
+int display_pad(const char *s, int cols) {
+    int extra = 0;
+    for (; *s; s++) {
+        extra += ((unsigned char)*s & 0xC0) == 0x80;
+    }
+    return cols + extra;
+}
+
+// Overview histograms: h_lo, h_width, h_bins columns of SENSOR_FIELDS
+#define HIST_SHAPE_(field, stat, wtype, wire, key, label, unit, lo, hi, sd, h_lo, h_width, h_bins, ...) \
+    { h_lo, h_width, h_bins },
+static const struct { float lo, width; int nbins; } hist_shape[STATS_FIELDS] = {
+    SENSOR_FIELDS(HIST_SHAPE_)
+};
+#undef HIST_SHAPE_
+
+// IDs outside [0, SENSOR_ID_LIMIT) are kept under sensor 0 (unknown)
+static inline int normalize_id(int sensor_id) {
+    return (sensor_id >= 0 && sensor_id < SENSOR_ID_LIMIT) ? sensor_id : 0;
+}
+
+static sensor_slot_t* slot_lookup(int sensor_id) {
+    if (sensor_id < 0 || (size_t)sensor_id >= slot_table_size) {
+        return NULL;
+    }
+    int32_t s = slot_by_id[sensor_id];
+    return s >= 0 ? slots[s] : NULL;
+}
+
+static void cell_reset(stats_cell_t *cell) {
+    for (int f = 0; f < STATS_FIELDS; f++) {
+        sketch_reset(&cell->field[f]);
+    }
+}
+
+static void hours_reset(stats_hours_t *hr) {
+    for (int h = 0; h < STATS_HOURS; h++) {
+        hr->tag[h] = -1;
+    }
+}
+
+static void slot_reset(sensor_slot_t *slot) {
+    int id = slot->info.sensor_id;
+    memset(&slot->info, 0, sizeof(slot->info));
+    slot->info.sensor_id = id;
+    cell_reset(&slot->all);
+    for (int f = 0; f < STATS_FIELDS; f++) {
+        sketch_hist_init(&slot->hist[f], hist_shape[f].lo, hist_shape[f].width, hist_shape[f].nbins);
+    }
+    hours_reset(&slot->hours);
+    slot->index_len = 0;
+}
+
+// Lookup, creating the slot on first sight. NULL when the table is full.
+static sensor_slot_t* slot_get(int sensor_id) {
+    sensor_slot_t *slot = slot_lookup(sensor_id);
+    if (slot) {
+        return slot;
+    }
+    if (slot_count >= SENSOR_MAX_SLOTS) {
+        return NULL;
+    }
+
+    if ((size_t)sensor_id >= slot_table_size) {
+        size_t size = slot_table_size ? slot_table_size : 64;
+        while (size <= (size_t)sensor_id) size *= 2;
+        int32_t *table = realloc(slot_by_id, size * sizeof(int32_t));
+        if (!table) {
+            return NULL;
+        }
+        for (size_t i = slot_table_size; i < size; i++) {
+            table[i] = -1;
+        }
+        slot_by_id = table;
+        slot_table_size = size;
+    }
+
+    slot = calloc(1, sizeof(*slot));
+    if (!slot) {
+        return NULL;
+    }
+    slot->info.sensor_id = sensor_id;
+    slot_reset(slot);
+    anomaly_init(&slot->anomaly);
+
+    slots[slot_count] = slot;
+    slot_by_id[sensor_id] = slot_count;
+    slot_count++;
+    return slot;
+}
+
+static void hours_add(stats_hours_t *hr, long hour, const float v[STATS_FIELDS]) {
+    int h = (int)(hour % STATS_HOURS);
+    if (hour > hr->tag[h]) {
+        // Slot held an hour that has fallen out of the window
+        if (!hr->cell[h]) {
+            hr->cell[h] = calloc(1, sizeof(stats_cell_t));
+            if (!hr->cell[h]) {
+                return;
+            }
+        } else {
+            cell_reset(hr->cell[h]);
+        }
+        hr->tag[h] = hour;
+    }
+    if (hour == hr->tag[h]) {
+        for (int f = 0; f < STATS_FIELDS; f++) {
+            sketch_add(&hr->cell[h]->field[f], v[f]);
+        }
+    }
+}
+
+static void info_add(sensor_info_t *info, const sensor_data_t *d) {
+    if (info->count == 0) {
+        for (int f = 0; f < STATS_FIELDS; f++) {
+            info->min[f] = info->max[f] = d->values[f];
+        }
+        info->first_seen = d->timestamp;
+    }
+    for (int f = 0; f < STATS_FIELDS; f++) {
+        if (d->values[f] < info->min[f]) info->min[f] = d->values[f];
+        if (d->values[f] > info->max[f]) info->max[f] = d->values[f];
+        info->sum[f] += d->values[f];
+    }
+    if (anomaly_from_quality(d->quality) != ANOMALY_NONE) info->anomalies++;
+    info->last_seen = d->timestamp;
+    info->last = *d;
+    info->count++;
+}
+
+// ============================================================================
+// MAINTENANCE
+// ============================================================================
+
+// Anomaly stage: scores d against its sensor's running baseline and lowers
+// d->quality to the verdict. Runs once per live record, before it is stored.
+// An ALERT is logged only when a sensor enters an anomalous state.
+void sensor_dir_assess(sensor_data_t *d) {
+    sensor_slot_t *slot = slot_get(normalize_id(d->sensor_id));
+    if (!slot) {
+        return;
+    }
+
+    const float *x = d->values;
+    int metric;
+    float z;
+    anomaly_kind_t kind = anomaly_update(&slot->anomaly, x, &metric, &z);
+
+    int quality = anomaly_quality(kind);
+    if (quality < d->quality) {
+        d->quality = quality;
+    }
+
+    if (kind != ANOMALY_NONE && slot->anomaly_state == ANOMALY_NONE) {
+        system_log_append("ALERT", "sensor %d: %s %s (%.1f, z=%.1f)",
+                          slot->info.sensor_id, sensor_fields[metric].name, anomaly_name(kind),
+                          (double)x[metric], (double)z);
+    }
+    slot->anomaly_state = kind;
+}
+
+// Record d was just stored at absolute store index `index`
+void sensor_dir_add(const sensor_data_t *d, size_t index) {
+    sensor_slot_t *slot = slot_get(normalize_id(d->sensor_id));
+    if (!slot) {
+        slot = slot_get(0);     // directory full: account under "unknown"
+    }
+    indexed_records++;
+    if (!slot) {
+        return;
+    }
+
+    if (slot->index_len == slot->index_cap) {
+        size_t cap = slot->index_cap ? slot->index_cap * 2 : 1024;
+        size_t *p = realloc(slot->index, cap * sizeof(size_t));
+        if (p) {
+            slot->index = p;
+            slot->index_cap = cap;
+        }
+    }
+    if (slot->index_len < slot->index_cap) {
+        slot->index[slot->index_len++] = index;
+    }
+
+    const float *v = d->values;
+    for (int f = 0; f < STATS_FIELDS; f++) {
+        sketch_add(&slot->all.field[f], v[f]);
+        sketch_hist_add(&slot->hist[f], v[f]);
+    }
+    long hour = (long)(d->timestamp / 3600);
+    hours_add(&slot->hours, hour, v);
+    hours_add(&station_hours, hour, v);
+    info_add(&slot->info, d);
+}
+
+// Forget every record; slots and their buffers are kept for reuse
+void sensor_dir_reset(void) {
+    for (int s = 0; s < slot_count; s++) {
+        slot_reset(slots[s]);
+    }
+    hours_reset(&station_hours);
+    indexed_records = 0;
+    directory_ready = 1;
+}
+
+void sensor_dir_rebuild(void) {
+    sensor_dir_reset();
+
+    store_iter_t it;
+    const sensor_data_t *span;
+    size_t n;
+    store_iter_init(&it, store_first(), store_end());
+    while ((n = store_iter_span(&it, &span)) > 0) {
+        size_t base = it.pos - n;
+        for (size_t i = 0; i < n; i++) {
+            sensor_dir_add(&span[i], base + i);
+        }
+    }
+}
+
+// Records may also enter the store directly (store_append); resync then
+void sensor_dir_sync(void) {
+    if (!directory_ready || indexed_records != store_size()) {
+        sensor_dir_rebuild();
+    }
+}
+
+// ============================================================================
+// SNAPSHOT
+// ============================================================================
+//
+// The directory is written in native layout (snapshot.c checks record and
+// struct sizes) so loading is a sequence of copies, not a rescan:
+//
+//   int64 slot_count | station_hours | per slot: info, anomaly, state,
+//   STATS_FIELDS all-time sketches, STATS_FIELDS histograms, hours,
+//   int64 index_len, index[]
+//
+// where hours is STATS_HOURS x (int64 tag, STATS_FIELDS sketches if tag >= 0).
+
+static int hours_write(const stats_hours_t *hr, FILE *fp) {
+    for (int h = 0; h < STATS_HOURS; h++) {
+        int64_t tag = hr->tag[h];
+        if (fwrite(&tag, sizeof(tag), 1, fp) != 1) return -1;
+        for (int f = 0; tag >= 0 && f < STATS_FIELDS; f++) {
+            if (sketch_write(&hr->cell[h]->field[f], fp) < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+int sensor_dir_write(FILE *fp) {
+    sensor_dir_sync();
+    int64_t n = slot_count;
+    if (fwrite(&n, sizeof(n), 1, fp) != 1 || hours_write(&station_hours, fp) != 0) {
+        return -1;
+    }
+    for (int s = 0; s < slot_count; s++) {
+        const sensor_slot_t *slot = slots[s];
+        int64_t state = slot->anomaly_state;
+        int64_t len = (int64_t)slot->index_len;
+        if (fwrite(&slot->info, sizeof(slot->info), 1, fp) != 1 ||
+            fwrite(&slot->anomaly, sizeof(slot->anomaly), 1, fp) != 1 ||
+            fwrite(&state, sizeof(state), 1, fp) != 1) {
+            return -1;
+        }
+        for (int f = 0; f < STATS_FIELDS; f++) {
+            if (sketch_write(&slot->all.field[f], fp) < 0) return -1;
+        }
+        if (fwrite(slot->hist, sizeof(slot->hist), 1, fp) != 1 ||
+            hours_write(&slot->hours, fp) != 0 ||
+            fwrite(&len, sizeof(len), 1, fp) != 1 ||
+            (len && fwrite(slot->index, sizeof(size_t), slot->index_len, fp) != slot->index_len)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+typedef struct dir_reader {
+    const char *p;
+    size_t left;
+} dir_reader_t;
+
+static int take(dir_reader_t *r, void *dst, size_t n) {
+    if (n > r->left) return -1;
+    memcpy(dst, r->p, n);
+    r->p += n;
+    r->left -= n;
+    return 0;
+}
+
+static int take_sketch(dir_reader_t *r, sketch_t *sk) {
+    size_t used = sketch_read(sk, r->p, r->left);
+    if (used == 0) return -1;
+    r->p += used;
+    r->left -= used;
+    return 0;
+}
+
+static int hours_read(dir_reader_t *r, stats_hours_t *hr) {
+    for (int h = 0; h < STATS_HOURS; h++) {
+        int64_t tag;
+        if (take(r, &tag, sizeof(tag)) != 0) return -1;
+        hr->tag[h] = -1;
+        if (tag < 0) continue;
+        if (!hr->cell[h] && !(hr->cell[h] = calloc(1, sizeof(stats_cell_t)))) return -1;
+        for (int f = 0; f < STATS_FIELDS; f++) {
+            if (take_sketch(r, &hr->cell[h]->field[f]) != 0) return -1;
+        }
+        hr->tag[h] = (long)tag;
+    }
+    return 0;
+}
+
+static int dir_read(dir_reader_t *r) {
+    int64_t n;
+    if (take(r, &n, sizeof(n)) != 0 || n < 0 || n > SENSOR_MAX_SLOTS ||
+        hours_read(r, &station_hours) != 0) {
+        return -1;
+    }
+    for (int64_t s = 0; s < n; s++) {
+        sensor_info_t info;
+        int64_t state, len;
+        if (take(r, &info, sizeof(info)) != 0) return -1;
+        sensor_slot_t *slot = slot_get(normalize_id(info.sensor_id));
+        if (!slot || slot->info.count != 0) return -1;     // duplicate slot
+
+        slot->info = info;
+        if (take(r, &slot->anomaly, sizeof(slot->anomaly)) != 0 ||
+            take(r, &state, sizeof(state)) != 0) {
+            return -1;
+        }
+        slot->anomaly_state = (anomaly_kind_t)state;
+        for (int f = 0; f < STATS_FIELDS; f++) {
+            if (take_sketch(r, &slot->all.field[f]) != 0) return -1;
+        }
+        if (take(r, slot->hist, sizeof(slot->hist)) != 0 ||
+            hours_read(r, &slot->hours) != 0 ||
+            take(r, &len, sizeof(len)) != 0 ||
+            len < 0 || (uint64_t)len > r->left / sizeof(size_t)) {
+            return -1;
+        }
+        if ((size_t)len > slot->index_cap) {
+            size_t *p = realloc(slot->index, (size_t)len * sizeof(size_t));
+            if (!p) return -1;
+            slot->index = p;
+            slot->index_cap = (size_t)len;
+        }
+        take(r, slot->index, (size_t)len * sizeof(size_t));
+        slot->index_len = (size_t)len;
+        indexed_records += (size_t)len;
+    }
+    return r->left == 0 ? 0 : -1;
+}
+
+// Loads a directory written by sensor_dir_write over the store it was
+// taken with. On error the directory is left empty (the next query
+// rebuilds it from the store).
+int sensor_dir_read(const void *buf, size_t len) {
+    sensor_dir_reset();
+    dir_reader_t r = { buf, len };
+    if (dir_read(&r) != 0 || indexed_records != store_size()) {
+        sensor_dir_reset();
+        directory_ready = 0;
+        return -1;
+    }
+    directory_ready = 1;
+    return 0;
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+// IDs of sensors that currently have records, ascending. Returns how many
+// exist (may exceed max).
+int sensor_dir_ids(int *ids, int max) {
+    sensor_dir_sync();
+    int n = 0;
+    for (size_t id = 0; id < slot_table_size; id++) {
+        int32_t s = slot_by_id[id];
+        if (s >= 0 && slots[s]->info.count > 0) {
+            if (n < max) ids[n] = (int)id;
+            n++;
+        }
+    }
+    return n;
+}
+
+const sensor_info_t* sensor_dir_get(int sensor_id) {
+    sensor_dir_sync();
+    sensor_slot_t *slot = slot_lookup(sensor_id);
+    return (slot && slot->info.count > 0) ? &slot->info : NULL;
+}
+
+size_t sensor_record_count(int sensor_id) {
+    sensor_dir_sync();
+    sensor_slot_t *slot = slot_lookup(sensor_id);
+    return slot ? slot->index_len : 0;
+}
+
+// k-th record (0 = oldest) of one sensor
+const sensor_data_t* sensor_record_at(int sensor_id, size_t k) {
+    sensor_slot_t *slot = slot_lookup(sensor_id);
+    if (!slot || k >= slot->index_len) {
+        return NULL;
+    }
+    return store_at(slot->index[k]);
+}
+
+// Merge the cells of one field selected by sensor and time range into dst
+static void merge_field(sketch_t *dst, int f, int sensor_id, time_t from, time_t to) {
+    int all_time = (from == 0 && to == 0);
+
+    if (sensor_id == SENSOR_ID_ALL && all_time) {
+        for (int s = 0; s < slot_count; s++) {
+            sketch_merge(dst, &slots[s]->all.field[f]);
+        }
+        return;
+    }
+
+    const stats_hours_t *hr;
+    if (sensor_id == SENSOR_ID_ALL) {
+        hr = &station_hours;
+    } else {
+        sensor_slot_t *slot = slot_lookup(sensor_id);
+        if (!slot) {
+            return;
+        }
+        if (all_time) {
+            sketch_merge(dst, &slot->all.field[f]);
+            return;
+        }
+        hr = &slot->hours;
+    }
+
+    for (int h = 0; h < STATS_HOURS; h++) {
+        time_t start = (time_t)hr->tag[h] * 3600;
+        if (hr->tag[h] < 0 || start + 3600 <= from || start >= to) {
+            continue;
+        }
+        sketch_merge(dst, &hr->cell[h]->field[f]);
+    }
+}
+
+int get_percentiles(int field, int sensor_id, time_t from, time_t to, percentiles_t *out) {
+    static sketch_t merged;     // scratch, keeps its bins between calls
+    int f = field_index(field);
+    if (f < 0 || !out) {
+        return -1;
+    }
+    sensor_dir_sync();
+    sketch_reset(&merged);
+    merge_field(&merged, f, sensor_id, from, to);
+
+    memset(out, 0, sizeof(*out));
+    out->count = (unsigned long)merged.count;
+    if (merged.count > 0) {
+        out->p50 = (float)sketch_quantile(&merged, 0.50);
+        out->p95 = (float)sketch_quantile(&merged, 0.95);
+        out->p99 = (float)sketch_quantile(&merged, 0.99);
+        out->min = (float)merged.min;
+        out->max = (float)merged.max;
+        out->avg = (float)(merged.sum / (double)merged.count);
+    }
+    return (int)out->count;
+}
+
+int get_histogram(int field, int sensor_id, sketch_hist_t *out) {
+    int f = field_index(field);
+    if (f < 0 || !out) {
+        return -1;
+    }
+    sensor_dir_sync();
+
+    sketch_hist_init(out, hist_shape[f].lo, hist_shape[f].width, hist_shape[f].nbins);
+
+    for (int s = 0; s < slot_count; s++) {
+        if (sensor_id == SENSOR_ID_ALL || slots[s]->info.sensor_id == sensor_id) {
+            sketch_hist_merge(out, &slots[s]->hist[f]);
+        }
+    }
+    return (int)out->count;
+}
+
+// Statistics of one sensor (or SENSOR_ID_ALL) from the running totals and
+// sketches: O(number of sensors), no record scan. Count, min, max and
+// average include the history compacted into the tiers; percentiles come
+// from the sketches, which hold the raw records only.
+int calculate_sensor_statistics(int sensor_id, statistics_t *out) {
+    sensor_dir_sync();
+    memset(out, 0, sizeof(*out));
+
+    sensor_info_t sum, compacted;
+    memset(&sum, 0, sizeof(sum));
+    tier_totals(sensor_id, &compacted);
+    for (int s = -1; s < slot_count; s++) {
+        const sensor_info_t *info = s < 0 ? &compacted : &slots[s]->info;
+        if (info->count == 0 || (sensor_id != SENSOR_ID_ALL && info->sensor_id != sensor_id)) {
+            continue;
+        }
+        for (int f = 0; f < STATS_FIELDS; f++) {
+            if (sum.count == 0 || info->min[f] < sum.min[f]) sum.min[f] = info->min[f];
+            if (sum.count == 0 || info->max[f] > sum.max[f]) sum.max[f] = info->max[f];
+            sum.sum[f] += info->sum[f];
+        }
+        if (sum.count == 0 || info->first_seen < sum.first_seen) sum.first_seen = info->first_seen;
+        if (sum.count == 0 || info->last_seen > sum.last_seen) sum.last_seen = info->last_seen;
+        sum.count += info->count;
+    }
+    if (sum.count == 0) {
+        return 0;
+    }
+
+    for (int f = 0; f < STATS_FIELDS; f++) {
+        percentiles_t p;
+        get_percentiles(f + 1, sensor_id, 0, 0, &p);
+        out->min[f] = sum.min[f];
+        out->max[f] = sum.max[f];
+        out->avg[f] = (float)(sum.sum[f] / sum.count);
+        out->p50[f] = p.p50;
+        out->p95[f] = p.p95;
+        out->p99[f] = p.p99;
+    }
+    out->total_records = (int)sum.count;
+    out->first_record = sum.first_seen;
+    out->last_record = sum.last_seen;
+    return (int)sum.count;
+}
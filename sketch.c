@@ -0,0 +1,291 @@
+/* sketch.c — Sketch phân vị (DDSketch) và histogram bucket cố định
+ *
+ * Xem mô tả thuật toán và giới hạn bộ nhớ trong sketch.h.
+ */
+
+#include "sketch.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static double log_gamma = 0.0;  // log((1 + a) / (1 - a)), tính lần đầu dùng
+
+static inline double sketch_log_gamma(void) {
+    if (log_gamma == 0.0) {
+        log_gamma = log((1.0 + SKETCH_ALPHA) / (1.0 - SKETCH_ALPHA));
+    }
+    return log_gamma;
+}
+
+static inline int32_t key_of(double x) {
+    return (int32_t)ceil(log(x) / sketch_log_gamma());
+}
+
+// Giá trị đại diện của bucket: trung điểm theo sai số tương đối
+static inline double value_of(int32_t key) {
+    double lg = sketch_log_gamma();
+    return 2.0 * exp(key * lg) / (1.0 + exp(lg));
+}
+
+
+/* =====================================
+ * DÃY BUCKET LIỀN NHAU
+ * ===================================== */
+
+static int store_reserve(sketch_store_t *st, uint32_t need) {
+    if (need <= st->cap) return 0;
+    uint32_t cap = st->cap ? st->cap : 16;
+    while (cap < need) cap *= 2;
+    if (cap > SKETCH_MAX_BINS) cap = SKETCH_MAX_BINS;
+
+    uint64_t *p = realloc(st->counts, cap * sizeof(uint64_t));
+    if (!p) return -1;
+    st->counts = p;
+    st->cap = cap;
+    return 0;
+}
+
+// Cộng n vào bucket key; mở rộng dãy nếu cần, gộp bucket thấp nhất khi
+// vượt SKETCH_MAX_BINS. n = 0 chỉ mở rộng dãy (dùng khi gộp sketch).
+static int store_add(sketch_store_t *st, int32_t key, uint64_t n) {
+    if (st->len == 0) {
+        if (store_reserve(st, 1) != 0) return -1;
+        st->offset = key;
+        st->counts[0] = 0;
+        st->len = 1;
+    } else if (key < st->offset) {
+        uint32_t grow = (uint32_t)(st->offset - key);
+        if (st->len + grow > SKETCH_MAX_BINS) {
+            grow = SKETCH_MAX_BINS - st->len;   // phần thấp hơn dồn vào bucket đầu
+        }
+        if (grow > 0) {
+            if (store_reserve(st, st->len + grow) != 0) return -1;
+            memmove(st->counts + grow, st->counts, st->len * sizeof(uint64_t));
+            memset(st->counts, 0, grow * sizeof(uint64_t));
+            st->offset -= (int32_t)grow;
+            st->len += grow;
+        }
+        key = st->offset;
+    } else if ((uint32_t)(key - st->offset) >= st->len) {
+        uint32_t need = (uint32_t)(key - st->offset) + 1;
+        if (need > SKETCH_MAX_BINS) {
+            // Bỏ bớt bucket thấp nhất: cộng dồn vào bucket thấp nhất còn giữ
+            uint32_t drop = need - SKETCH_MAX_BINS;
+            if (drop >= st->len) {
+                uint64_t total = 0;
+                for (uint32_t i = 0; i < st->len; i++) total += st->counts[i];
+                st->counts[0] = total;
+                st->len = 1;
+                st->offset = key - (SKETCH_MAX_BINS - 1);
+            } else {
+                for (uint32_t i = 0; i < drop; i++) st->counts[drop] += st->counts[i];
+                memmove(st->counts, st->counts + drop, (st->len - drop) * sizeof(uint64_t));
+                st->len -= drop;
+                st->offset += (int32_t)drop;
+            }
+            need = SKETCH_MAX_BINS;
+        }
+        if (store_reserve(st, need) != 0) return -1;
+        memset(st->counts + st->len, 0, (need - st->len) * sizeof(uint64_t));
+        st->len = need;
+    }
+
+    st->counts[key - st->offset] += n;
+    return 0;
+}
+
+static int store_merge(sketch_store_t *dst, const sketch_store_t *src) {
+    if (src->len == 0) return 0;
+    // Mở rộng theo hai đầu trước để không phải dịch dãy nhiều lần
+    if (store_add(dst, src->offset, 0) != 0) return -1;
+    if (store_add(dst, src->offset + (int32_t)src->len - 1, 0) != 0) return -1;
+    for (uint32_t i = 0; i < src->len; i++) {
+        if (src->counts[i] && store_add(dst, src->offset + (int32_t)i, src->counts[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/* =====================================
+ * SKETCH
+ * ===================================== */
+
+void sketch_init(sketch_t *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+void sketch_reset(sketch_t *s) {
+    s->count = s->zero = 0;
+    s->sum = s->min = s->max = 0.0;
+    s->pos.len = s->neg.len = 0;
+}
+
+void sketch_free(sketch_t *s) {
+    free(s->pos.counts);
+    free(s->neg.counts);
+    sketch_init(s);
+}
+
+void sketch_add(sketch_t *s, double x) {
+    int rc;
+    if (x >= SKETCH_MIN_VALUE) {
+        rc = store_add(&s->pos, key_of(x), 1);
+    } else if (x <= -SKETCH_MIN_VALUE) {
+        rc = store_add(&s->neg, key_of(-x), 1);
+    } else if (x == x) {
+        s->zero++;
+        rc = 0;
+    } else {
+        rc = -1;    // NaN
+    }
+    if (rc != 0) return;
+
+    if (s->count == 0 || x < s->min) s->min = x;
+    if (s->count == 0 || x > s->max) s->max = x;
+    s->count++;
+    s->sum += x;
+}
+
+int sketch_merge(sketch_t *dst, const sketch_t *src) {
+    if (src->count == 0) return 0;
+    if (store_merge(&dst->pos, &src->pos) != 0) return -1;
+    if (store_merge(&dst->neg, &src->neg) != 0) return -1;
+
+    if (dst->count == 0 || src->min < dst->min) dst->min = src->min;
+    if (dst->count == 0 || src->max > dst->max) dst->max = src->max;
+    dst->count += src->count;
+    dst->zero += src->zero;
+    dst->sum += src->sum;
+    return 0;
+}
+
+double sketch_quantile(const sketch_t *s, double q) {
+    if (s->count == 0) return NAN;
+    if (q < 0.0) q = 0.0;
+    if (q > 1.0) q = 1.0;
+
+    double rank = q * (double)(s->count - 1);
+    double v = s->max;
+    uint64_t seen = 0;
+
+    // Thứ tự tăng dần: âm (|x| lớn → nhỏ), zero, dương (nhỏ → lớn)
+    for (uint32_t i = s->neg.len; i-- > 0; ) {
+        seen += s->neg.counts[i];
+        if ((double)seen > rank) {
+            v = -value_of(s->neg.offset + (int32_t)i);
+            goto done;
+        }
+    }
+    seen += s->zero;
+    if ((double)seen > rank) {
+        v = 0.0;
+        goto done;
+    }
+    for (uint32_t i = 0; i < s->pos.len; i++) {
+        seen += s->pos.counts[i];
+        if ((double)seen > rank) {
+            v = value_of(s->pos.offset + (int32_t)i);
+            goto done;
+        }
+    }
+
+done:
+    if (v < s->min) v = s->min;
+    if (v > s->max) v = s->max;
+    return v;
+}
+
+
+/* =====================================
+ * TUẦN TỰ HÓA
+ * ===================================== */
+
+typedef struct {
+    uint64_t count, zero;
+    double   sum, min, max;
+    int32_t  pos_offset;
+    uint32_t pos_len;
+    int32_t  neg_offset;
+    uint32_t neg_len;
+} sketch_disk_t;
+
+long sketch_write(const sketch_t *s, FILE *fp) {
+    sketch_disk_t d = {
+        s->count, s->zero, s->sum, s->min, s->max,
+        s->pos.offset, s->pos.len, s->neg.offset, s->neg.len
+    };
+    if (fwrite(&d, sizeof(d), 1, fp) != 1) return -1;
+    if (s->pos.len && fwrite(s->pos.counts, sizeof(uint64_t), s->pos.len, fp) != s->pos.len) return -1;
+    if (s->neg.len && fwrite(s->neg.counts, sizeof(uint64_t), s->neg.len, fp) != s->neg.len) return -1;
+    return (long)(sizeof(d) + (s->pos.len + s->neg.len) * sizeof(uint64_t));
+}
+
+static int store_load(sketch_store_t *st, int32_t offset, uint32_t len, const char *src) {
+    if (len > SKETCH_MAX_BINS) return -1;
+    st->len = 0;
+    if (len == 0) return 0;
+    if (store_reserve(st, len) != 0) return -1;
+    memcpy(st->counts, src, len * sizeof(uint64_t));
+    st->offset = offset;
+    st->len = len;
+    return 0;
+}
+
+size_t sketch_read(sketch_t *s, const void *buf, size_t len) {
+    sketch_disk_t d;
+    if (len < sizeof(d)) return 0;
+    memcpy(&d, buf, sizeof(d));
+    size_t need = sizeof(d) + ((size_t)d.pos_len + d.neg_len) * sizeof(uint64_t);
+    if (d.pos_len > SKETCH_MAX_BINS || d.neg_len > SKETCH_MAX_BINS || need > len) return 0;
+
+    const char *counts = (const char *)buf + sizeof(d);
+    if (store_load(&s->pos, d.pos_offset, d.pos_len, counts) != 0 ||
+        store_load(&s->neg, d.neg_offset, d.neg_len, counts + d.pos_len * sizeof(uint64_t)) != 0) {
+        return 0;
+    }
+    s->count = d.count;
+    s->zero = d.zero;
+    s->sum = d.sum;
+    s->min = d.min;
+    s->max = d.max;
+    return need;
+}
+
+/* =====================================
+ * HISTOGRAM BUCKET CỐ ĐỊNH
+ * ===================================== */
+
+void sketch_hist_init(sketch_hist_t *h, float lo, float width, int nbins) {
+    memset(h, 0, sizeof(*h));
+    if (nbins < 1) nbins = 1;
+    if (nbins > SKETCH_HIST_MAX) nbins = SKETCH_HIST_MAX;
+    h->lo = lo;
+    h->width = width > 0.0f ? width : 1.0f;
+    h->nbins = nbins;
+}
+
+void sketch_hist_add(sketch_hist_t *h, float x) {
+    if (x != x) return;     // NaN
+    float pos = (x - h->lo) / h->width;
+    if (pos < 0.0f) {
+        h->under++;
+    } else if (pos >= (float)h->nbins) {
+        h->over++;
+    } else {
+        h->bins[(int)pos]++;
+    }
+    h->count++;
+}
+
+// Chỉ gộp được hai histogram cùng lo/width/nbins
+void sketch_hist_merge(sketch_hist_t *dst, const sketch_hist_t *src) {
+    for (int i = 0; i < dst->nbins && i < src->nbins; i++) {
+        dst->bins[i] += src->bins[i];
+    }
+    dst->under += src->under;
+    dst->over += src->over;
+    dst->count += src->count;
+}
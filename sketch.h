@@ -0,0 +1,86 @@
+/* sketch.h — Sketch phân vị dạng DDSketch & histogram bucket cố định
+ *
+ * Tính p50/p95/p99 chính xác trên hàng tháng dữ liệu sẽ phải sắp xếp toàn
+ * bộ. Thay vào đó mỗi giá trị được đếm vào một bucket logarit:
+ *
+ *   key(x) = ceil(log(x) / log(gamma)),  gamma = (1 + a) / (1 - a)
+ *
+ * nên mọi phân vị trả về có sai số tương đối ≤ a (SKETCH_ALPHA = 1%).
+ * Hai sketch gộp được bằng cách cộng bucket cùng key → gộp theo giờ, theo
+ * sensor mà không mất độ chính xác.
+ *
+ * Bộ nhớ bị chặn: mỗi dấu (+/-) giữ tối đa SKETCH_MAX_BINS bucket liền nhau,
+ * cấp phát dần theo khoảng giá trị thực tế (nhiệt độ 20..35 °C chỉ cần
+ * ~20 bucket). Vượt quá thì gộp các bucket thấp nhất (collapsing lowest).
+ */
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SKETCH_ALPHA        0.01    /* sai số tương đối của phân vị */
+#define SKETCH_MAX_BINS     512     /* bucket tối đa mỗi dấu (4 KB) */
+#define SKETCH_MIN_VALUE    1e-3    /* |x| nhỏ hơn → bucket zero */
+#define SKETCH_HIST_MAX     64      /* số bucket tối đa của histogram cố định */
+
+/* Dãy bucket liền nhau: counts[i] ứng với key = offset + i */
+typedef struct {
+    int32_t   offset;
+    uint32_t  len;
+    uint32_t  cap;
+    uint64_t *counts;
+} sketch_store_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t zero;          /* |x| < SKETCH_MIN_VALUE */
+    double   sum;
+    double   min, max;
+    sketch_store_t pos;     /* x > 0 */
+    sketch_store_t neg;     /* x < 0, lưu theo |x| */
+} sketch_t;
+
+/* Histogram bucket đều [lo, lo + width * nbins), có đếm dưới/ trên khoảng */
+typedef struct {
+    float    lo;
+    float    width;
+    int      nbins;
+    uint64_t under;
+    uint64_t over;
+    uint64_t count;
+    uint64_t bins[SKETCH_HIST_MAX];
+} sketch_hist_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sketch_init(sketch_t *s);
+void sketch_reset(sketch_t *s);     /* xóa số liệu, giữ bộ nhớ để dùng lại */
+void sketch_free(sketch_t *s);
+
+void sketch_add(sketch_t *s, double x);
+
+/* dst += src. Trả về 0 nếu thành công, -1 nếu hết bộ nhớ */
+int sketch_merge(sketch_t *dst, const sketch_t *src);
+
+/* Giá trị tại phân vị q (0..1); NAN nếu sketch rỗng */
+double sketch_quantile(const sketch_t *s, double q);
+
+/* Tuần tự hóa cho snapshot. sketch_write trả về số byte đã ghi (luôn là
+ * bội của 8), âm nếu lỗi. sketch_read đọc lại vào s (đã init, bucket cũ
+ * được tái sử dụng) và trả về số byte đã dùng, 0 nếu dữ liệu hỏng. */
+long sketch_write(const sketch_t *s, FILE *fp);
+size_t sketch_read(sketch_t *s, const void *buf, size_t len);
+
+void sketch_hist_init(sketch_hist_t *h, float lo, float width, int nbins);
+void sketch_hist_add(sketch_hist_t *h, float x);
+void sketch_hist_merge(sketch_hist_t *dst, const sketch_hist_t *src);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SKETCH_H */
@@ -0,0 +1,444 @@
+#include "system.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+
+// ============================================================================
+// SNAPSHOTS
+// ============================================================================
+//
+// A snapshot is the in-memory state written out so that startup does not
+// have to replay (or rescan) the whole history:
+//
+//   header | directory (sensor_dir_write) | pad to SNAPSHOT_ALIGN | blocks
+//
+// The blocks are the store's blocks, byte for byte, from the one holding
+// store_first() to the one holding the newest record (padded with zeros).
+// On startup they are mapped MAP_PRIVATE and handed to the store as is, so
+// loading costs a page-table setup, not a read; pages fault in when first
+// touched. The directory (sketches, rollups, per-sensor index) is copied
+// back, checked by CRC. Records are not checksummed: they are mapped, not
+// read, and a snapshot only replaces the previous one after it is synced.
+//
+// The header stores the journal LSN the snapshot covers up to; journal
+// segments before it are dropped once the snapshot is durable and
+// journal_open() replays only the frames after it.
+//
+// Periodic snapshots are written by a forked child from its copy-on-write
+// view of memory, so ingest never waits for the disk. The write goes to
+// SNAPSHOT_FILE.tmp and is renamed into place after fsync.
+//
+// The header of the snapshot known to match the store is kept in `current`
+// so that the query server can stream records straight from the file
+// (snapshot_open_records); a file that failed to load is never served.
+
+#define SNAPSHOT_MAGIC      0x50414E53u     // "SNAP"
+#define SNAPSHOT_VERSION    3               // 2: sensor_info_t grouped by statistic (schema.h)
+                                            // 3: sensor_data_t.timestamp_ns
+#define SNAPSHOT_ALIGN      65536           // records offset, a multiple of any page size
+#define SNAPSHOT_TMP        SNAPSHOT_FILE ".tmp"
+
+typedef struct snapshot_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;       // sizeof(sensor_data_t)
+    uint32_t block_records;     // STORE_BLOCK_RECORDS
+    uint32_t info_size;         // sizeof(sensor_info_t)
+    uint64_t journal_lsn;       // covers every journal frame below this
+    uint64_t store_head;
+    uint64_t store_count;
+    uint64_t dir_offset;
+    uint64_t dir_len;
+    uint64_t records_offset;
+    uint64_t records_len;
+    uint32_t dir_crc;
+    uint32_t header_crc;        // CRC-32 of the header with header_crc = 0
+} snapshot_header_t;
+
+static pid_t snap_pid = -1;             // background writer, -1 if none
+static uint64_t snap_pid_lsn = 0;       // LSN it is writing
+static uint64_t last_lsn = 0;           // LSN of the newest durable snapshot
+static time_t last_time = 0;
+
+static snapshot_header_t current;       // magic 0 = no usable snapshot
+static pthread_mutex_t current_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t header_crc(const snapshot_header_t *h) {
+    snapshot_header_t tmp = *h;
+    tmp.header_crc = 0;
+    return crc32_update(0, &tmp, sizeof(tmp));
+}
+
+static int write_zeros(FILE *fp, size_t n) {
+    static const char zeros[4096];
+    while (n > 0) {
+        size_t k = n < sizeof(zeros) ? n : sizeof(zeros);
+        if (fwrite(zeros, 1, k, fp) != k) return -1;
+        n -= k;
+    }
+    return 0;
+}
+
+static void sync_parent_dir(void) {
+    int fd = open(".", O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// ============================================================================
+// WRITE
+// ============================================================================
+
+static int write_snapshot(uint64_t lsn) {
+    char *dir = NULL;
+    size_t dir_len = 0;
+    FILE *mem = open_memstream(&dir, &dir_len);
+    if (!mem) {
+        return -1;
+    }
+    int rc = sensor_dir_write(mem);
+    if (fclose(mem) != 0 || rc != 0) {
+        free(dir);
+        return -1;
+    }
+
+    size_t head = store_first(), count = store_end();
+    size_t first_block = head / STORE_BLOCK_RECORDS;
+    size_t end_block = (count + STORE_BLOCK_RECORDS - 1) / STORE_BLOCK_RECORDS;
+    if (end_block < first_block) end_block = first_block;
+
+    snapshot_header_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = SNAPSHOT_VERSION;
+    h.record_size = sizeof(sensor_data_t);
+    h.block_records = STORE_BLOCK_RECORDS;
+    h.info_size = sizeof(sensor_info_t);
+    h.journal_lsn = lsn;
+    h.store_head = head;
+    h.store_count = count;
+    h.dir_offset = sizeof(h);
+    h.dir_len = dir_len;
+    h.records_offset = (sizeof(h) + dir_len + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+    h.records_len = (uint64_t)(end_block - first_block) * STORE_BLOCK_RECORDS * sizeof(sensor_data_t);
+    h.dir_crc = crc32_update(0, dir, dir_len);
+    h.header_crc = header_crc(&h);
+
+    FILE *fp = fopen(SNAPSHOT_TMP, "wb");
+    if (!fp) {
+        free(dir);
+        return -1;
+    }
+    static char iobuf[1 << 20];
+    setvbuf(fp, iobuf, _IOFBF, sizeof(iobuf));
+
+    rc = -1;
+    if (fwrite(&h, sizeof(h), 1, fp) != 1 ||
+        (dir_len && fwrite(dir, dir_len, 1, fp) != 1) ||
+        write_zeros(fp, h.records_offset - sizeof(h) - dir_len) != 0) {
+        goto out;
+    }
+    if (h.records_len > 0) {
+        // Whole blocks: the part of the first block below store_first() and
+        // the tail after the newest record are zeros
+        if (write_zeros(fp, (head - first_block * STORE_BLOCK_RECORDS) * sizeof(sensor_data_t)) != 0) {
+            goto out;
+        }
+        store_iter_t it;
+        const sensor_data_t *span;
+        size_t n;
+        store_iter_init(&it, head, count);
+        while ((n = store_iter_span(&it, &span)) > 0) {
+            if (fwrite(span, sizeof(sensor_data_t), n, fp) != n) goto out;
+        }
+        if (write_zeros(fp, (end_block * STORE_BLOCK_RECORDS - count) * sizeof(sensor_data_t)) != 0) {
+            goto out;
+        }
+    }
+    if (fflush(fp) == 0 && fsync(fileno(fp)) == 0) {
+        rc = 0;
+    }
+
+out:
+    if (fclose(fp) != 0) rc = -1;
+    free(dir);
+    if (rc == 0 && rename(SNAPSHOT_TMP, SNAPSHOT_FILE) == 0) {
+        sync_parent_dir();
+        return 0;
+    }
+    unlink(SNAPSHOT_TMP);
+    return -1;
+}
+
+static int check_header(const snapshot_header_t *h, off_t file_size);
+
+static void set_current(const snapshot_header_t *h) {
+    pthread_mutex_lock(&current_lock);
+    if (h) {
+        current = *h;
+    } else {
+        memset(&current, 0, sizeof(current));
+    }
+    pthread_mutex_unlock(&current_lock);
+}
+
+// Reads back the header of the file just written (by us or by the child)
+static void remember_current(void) {
+    snapshot_header_t h;
+    struct stat st;
+    int fd = open(SNAPSHOT_FILE, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0 && fstat(fd, &st) == 0 &&
+        pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) && check_header(&h, st.st_size)) {
+        set_current(&h);
+    } else {
+        set_current(NULL);
+    }
+    if (fd >= 0) close(fd);
+}
+
+// A snapshot at lsn is durable: the journal before it is no longer needed
+static void snapshot_done(uint64_t lsn) {
+    last_lsn = lsn;
+    remember_current();
+    int dropped = journal_drop_before(lsn);
+    system_log_append("INFO", "snapshot: %zu records up to journal LSN %llu, %d segments dropped",
+                      store_size(), (unsigned long long)lsn, dropped);
+}
+
+static void wait_writer(int options) {
+    if (snap_pid <= 0) {
+        return;
+    }
+    int status;
+    pid_t r = waitpid(snap_pid, &status, options);
+    if (r == 0 || (r < 0 && errno == EINTR)) {
+        return;     // still running
+    }
+    if (r == snap_pid && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        snapshot_done(snap_pid_lsn);
+    } else {
+        system_log_append("ERROR", "snapshot: background writer failed");
+        unlink(SNAPSHOT_TMP);
+    }
+    snap_pid = -1;
+}
+
+// Synchronous snapshot (shutdown). Skipped if nothing changed since the
+// last one.
+int snapshot_save(void) {
+    wait_writer(0);
+    uint64_t lsn = journal_next_lsn();
+    if (lsn == last_lsn && access(SNAPSHOT_FILE, F_OK) == 0) {
+        return 0;
+    }
+    if (write_snapshot(lsn) != 0) {
+        log_error("snapshot_save", strerror(errno));
+        return -1;
+    }
+    snapshot_done(lsn);
+    last_time = time(NULL);
+    return 0;
+}
+
+// Called from the collection loop: reaps a finished background writer and
+// forks a new one every snapshot_interval_s while data keeps arriving.
+void snapshot_tick(void) {
+    if (snap_pid > 0) {
+        wait_writer(WNOHANG);
+        return;
+    }
+    time_t now = time(NULL);
+    if (system_config.snapshot_interval_s <= 0 ||
+        now - last_time < (time_t)system_config.snapshot_interval_s) {
+        return;
+    }
+    last_time = now;
+    uint64_t lsn = journal_next_lsn();
+    if (lsn == last_lsn) {
+        return;
+    }
+
+    sensor_dir_sync();      // serialize a clean directory, not a half rebuild
+    fflush(NULL);           // the child must not flush our buffered output again
+    pid_t pid = fork();
+    if (pid < 0) {
+        log_error("snapshot_tick", strerror(errno));
+        return;
+    }
+    if (pid == 0) {
+        _exit(write_snapshot(lsn) == 0 ? 0 : 1);
+    }
+    snap_pid = pid;
+    snap_pid_lsn = lsn;
+}
+
+// Removes the snapshot (clear_all_data); a writer still running is stopped
+// first so it cannot put stale data back.
+void snapshot_discard(void) {
+    if (snap_pid > 0) {
+        kill(snap_pid, SIGKILL);
+        waitpid(snap_pid, NULL, 0);
+        snap_pid = -1;
+    }
+    set_current(NULL);
+    unlink(SNAPSHOT_TMP);
+    unlink(SNAPSHOT_FILE);
+    sync_parent_dir();
+    last_lsn = 0;
+}
+
+// ============================================================================
+// LOAD
+// ============================================================================
+
+static int check_header(const snapshot_header_t *h, off_t file_size) {
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t blocks = (h->store_count + STORE_BLOCK_RECORDS - 1) / STORE_BLOCK_RECORDS
+                      - h->store_head / STORE_BLOCK_RECORDS;
+    return h->magic == SNAPSHOT_MAGIC && h->version == SNAPSHOT_VERSION &&
+           h->header_crc == header_crc(h) &&
+           h->record_size == sizeof(sensor_data_t) &&
+           h->block_records == STORE_BLOCK_RECORDS &&
+           h->info_size == sizeof(sensor_info_t) &&
+           h->store_head <= h->store_count &&
+           h->dir_offset == sizeof(*h) &&
+           h->dir_offset + h->dir_len <= h->records_offset &&
+           h->records_offset % (uint64_t)page == 0 &&
+           h->records_len == blocks * STORE_BLOCK_RECORDS * sizeof(sensor_data_t) &&
+           h->records_offset + h->records_len <= (uint64_t)file_size;
+}
+
+// Intact header of a build with another schema (record or directory entry size)
+static int other_schema(const snapshot_header_t *h) {
+    return h->magic == SNAPSHOT_MAGIC && h->version == SNAPSHOT_VERSION &&
+           h->header_crc == header_crc(h) &&
+           (h->record_size != sizeof(sensor_data_t) || h->info_size != sizeof(sensor_info_t));
+}
+
+// Replaces the (empty) store and directory with the snapshot. Returns the
+// number of records loaded and the journal LSN to replay from, 0 if there
+// is no snapshot, -1 if it is unusable (the store is left empty),
+// SNAPSHOT_INCOMPATIBLE if it was written with another schema (the file is
+// left as it is).
+int snapshot_load(uint64_t *journal_lsn) {
+    *journal_lsn = 0;
+    int fd = open(SNAPSHOT_FILE, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    snapshot_header_t h;
+    struct stat st;
+    void *dir = MAP_FAILED, *records = MAP_FAILED;
+    int rc = -1;
+    if (fstat(fd, &st) != 0 || pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) {
+        goto out;
+    }
+    if (other_schema(&h)) {
+        system_log_append("ERROR", "snapshot: %s has %u-byte records, this build uses %zu",
+                          SNAPSHOT_FILE, h.record_size, sizeof(sensor_data_t));
+        close(fd);
+        return SNAPSHOT_INCOMPATIBLE;
+    }
+    if (!check_header(&h, st.st_size)) {
+        goto out;
+    }
+
+    size_t dir_map = (size_t)(h.dir_offset + h.dir_len);
+    dir = mmap(NULL, dir_map, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (dir == MAP_FAILED) {
+        goto out;
+    }
+    const char *dir_data = (const char *)dir + h.dir_offset;
+    if (crc32_update(0, dir_data, h.dir_len) != h.dir_crc) {
+        goto out;
+    }
+
+    if (h.records_len > 0) {
+        records = mmap(NULL, h.records_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                       (off_t)h.records_offset);
+        if (records == MAP_FAILED) {
+            goto out;
+        }
+    }
+
+    store_clear();
+    if (h.records_len > 0 && store_adopt(records, h.store_head, h.store_count) != 0) {
+        goto out;
+    }
+    records = MAP_FAILED;       // the store owns it now
+    if (sensor_dir_read(dir_data, h.dir_len) != 0) {
+        store_clear();
+        goto out;
+    }
+
+    *journal_lsn = h.journal_lsn;
+    last_lsn = h.journal_lsn;
+    set_current(&h);
+    last_time = time(NULL);
+    rc = (int)store_size();
+
+out:
+    if (rc < 0) {
+        system_log_append("ERROR", "snapshot: %s unusable, replaying the journal", SNAPSHOT_FILE);
+    }
+    if (records != MAP_FAILED) munmap(records, h.records_len);
+    if (dir != MAP_FAILED) munmap(dir, (size_t)(h.dir_offset + h.dir_len));
+    close(fd);
+    return rc;
+}
+
+// Opens the current snapshot for reading its records (any thread). Record
+// i of [out->first, out->end) is at out->offset + (i - first) * record size;
+// indices are never reused, so they match the store's copy of the record.
+// The caller closes out->fd. Returns -1 if there is no usable snapshot.
+int snapshot_open_records(snapshot_records_t *out) {
+    snapshot_header_t want, h;
+    pthread_mutex_lock(&current_lock);
+    want = current;
+    pthread_mutex_unlock(&current_lock);
+    if (want.magic != SNAPSHOT_MAGIC || want.records_len == 0) {
+        return -1;
+    }
+
+    int fd = open(SNAPSHOT_FILE, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    // The file may have been replaced since: serve it only if it is the
+    // one we know
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(&h, &want, sizeof(h)) != 0) {
+        close(fd);
+        return -1;
+    }
+    out->fd = fd;
+    out->first = (size_t)h.store_head;
+    out->end = (size_t)h.store_count;
+    out->offset = (off_t)(h.records_offset +
+                          (h.store_head % STORE_BLOCK_RECORDS) * sizeof(sensor_data_t));
+    return 0;
+}
+
+// Opens the durable snapshot file as a whole (backups, any thread): the
+// descriptor keeps this version readable after a newer one replaces it.
+// *id is the header CRC, which tells two snapshot files apart. Returns -1
+// if there is no valid snapshot.
+int snapshot_open_file(uint64_t *journal_lsn, uint32_t *id) {
+    int fd = open(SNAPSHOT_FILE, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    snapshot_header_t h;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+        !check_header(&h, st.st_size)) {
+        close(fd);
+        return -1;
+    }
+    *journal_lsn = h.journal_lsn;
+    *id = h.header_crc;
+    return fd;
+}
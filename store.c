@@ -0,0 +1,301 @@
+#include "system.h"
+#include "metrics.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+
+// ============================================================================
+// APPEND-ONLY BLOCK STORE
+// ============================================================================
+//
+// Records are appended in time order into blocks of STORE_BLOCK_RECORDS.
+// Block k holds absolute indices [k * STORE_BLOCK_RECORDS, (k+1) * ...) and
+// lives in slot (k % STORE_MAX_BLOCKS) of the directory, so the directory
+// works as a ring and indices never have to be renumbered.
+//
+//   store_head  - absolute index of the oldest live record
+//   store_count - absolute index one past the newest record
+//
+// Blocks are malloc'd, except those adopted from a snapshot: those point
+// into a private file mapping and are unmapped, not freed, when released.
+//
+// The ingest thread is the only writer. Any other thread reads through a
+// snapshot (store_read_begin/end): a record below store_count is never
+// modified again, and the count is published with release semantics after
+// the record is written, so the range [first, end) captured at begin stays
+// valid while appends continue. Trimming retires blocks instead of freeing
+// them; a retired block is freed once no reader that started before the
+// trim is still active (epoch-based reclamation). Readers take no lock and
+// the writer never waits for them.
+
+#define STORE_BLOCK_BYTES   (STORE_BLOCK_RECORDS * sizeof(sensor_data_t))
+#define STORE_MAX_READERS   64
+
+static sensor_data_t *store_blocks[STORE_MAX_BLOCKS];
+static size_t store_head = 0;
+static size_t store_count = 0;
+static size_t mapped_first = 0;     // absolute block numbers [first, end) that are mapped
+static size_t mapped_end = 0;
+
+// Active readers: the epoch each one started in, 0 = slot free. One cache
+// line per slot so readers on different cores do not contend.
+typedef struct store_reader {
+    uint64_t epoch;
+    char pad[56];
+} store_reader_t;
+
+static store_reader_t readers[STORE_MAX_READERS];
+static uint64_t store_epoch = 1;
+
+// Blocks released by trimming, oldest first, waiting for their readers
+typedef struct retired_block {
+    sensor_data_t *blk;
+    size_t number;              // absolute block number
+    uint64_t epoch;             // freed once every active reader is newer
+    int mapped;
+} retired_block_t;
+
+static retired_block_t retired[STORE_MAX_BLOCKS];
+static size_t retired_head = 0, retired_tail = 0;
+
+static inline sensor_data_t* block_of(size_t index) {
+    return store_blocks[(index / STORE_BLOCK_RECORDS) % STORE_MAX_BLOCKS];
+}
+
+// Frees retired blocks that no active reader can still see
+static void reclaim_blocks(void) {
+    if (retired_head == retired_tail) {
+        return;
+    }
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < STORE_MAX_READERS; i++) {
+        uint64_t e = __atomic_load_n(&readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (e != 0 && e < oldest) oldest = e;
+    }
+    while (retired_head != retired_tail) {
+        retired_block_t *r = &retired[retired_head % STORE_MAX_BLOCKS];
+        if (r->epoch >= oldest) {
+            break;
+        }
+        if (r->mapped) {
+            munmap(r->blk, STORE_BLOCK_BYTES);
+        } else {
+            free(r->blk);
+        }
+        retired_head++;
+    }
+}
+
+int store_append(const sensor_data_t *rec) {
+    size_t slot = store_count % STORE_BLOCK_RECORDS;
+    if (slot == 0) {
+        // Capacity is counted in blocks, not records: with the head in the
+        // middle of its block, the new block's ring slot may still be the
+        // head block
+        size_t number = store_count / STORE_BLOCK_RECORDS;
+        if (number - store_head / STORE_BLOCK_RECORDS >= STORE_MAX_BLOCKS) {
+            return -1;  // all live blocks in use
+        }
+        // The ring slot's previous block must be gone: a reader pinning
+        // a full ring of appends ago makes the store full, not unsafe
+        if (retired_head != retired_tail && retired[retired_head % STORE_MAX_BLOCKS].number + STORE_MAX_BLOCKS <= number) {
+            reclaim_blocks();
+            if (retired_head != retired_tail && retired[retired_head % STORE_MAX_BLOCKS].number + STORE_MAX_BLOCKS <= number) {
+                return -1;
+            }
+        }
+        sensor_data_t *blk = malloc(STORE_BLOCK_BYTES);
+        if (!blk) {
+            return -1;
+        }
+        store_blocks[number % STORE_MAX_BLOCKS] = blk;
+    }
+
+    block_of(store_count)[slot] = *rec;
+    __atomic_store_n(&store_count, store_count + 1, __ATOMIC_RELEASE);
+    stats_updated = 0;
+
+    METRIC_INC(METRIC_STORE_APPENDS);
+    metrics_set(METRIC_STORE_RECORDS, (int64_t)(store_count - store_head));
+    return 0;
+}
+
+size_t store_size(void) {
+    return store_end() - store_first();
+}
+
+size_t store_first(void) {
+    return __atomic_load_n(&store_head, __ATOMIC_ACQUIRE);
+}
+
+size_t store_end(void) {
+    return __atomic_load_n(&store_count, __ATOMIC_ACQUIRE);
+}
+
+const sensor_data_t* store_at(size_t index) {
+    if (index < store_head || index >= store_count) {
+        return NULL;
+    }
+    return &block_of(index)[index % STORE_BLOCK_RECORDS];
+}
+
+// Retire every block that lies entirely below the new head. The ring keeps
+// pointing at them so readers that started earlier can finish.
+static void release_blocks(size_t old_head, size_t new_head) {
+    for (size_t b = old_head / STORE_BLOCK_RECORDS; b < new_head / STORE_BLOCK_RECORDS; b++) {
+        retired_block_t *r = &retired[retired_tail % STORE_MAX_BLOCKS];
+        r->blk = store_blocks[b % STORE_MAX_BLOCKS];
+        r->number = b;
+        r->epoch = store_epoch;
+        r->mapped = b >= mapped_first && b < mapped_end;
+        retired_tail++;
+    }
+    __atomic_store_n(&store_epoch, store_epoch + 1, __ATOMIC_SEQ_CST);
+    reclaim_blocks();
+}
+
+// Delete every record with timestamp < cutoff. Records are time-ordered,
+// so the boundary is found by binary search. Returns the number deleted.
+size_t store_trim_before(time_t cutoff) {
+    size_t lo = store_head, hi = store_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (store_at(mid)->timestamp < cutoff) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    size_t deleted = lo - store_head;
+    if (deleted > 0) {
+        size_t old_head = store_head;
+        __atomic_store_n(&store_head, lo, __ATOMIC_SEQ_CST);
+        release_blocks(old_head, lo);
+        stats_updated = 0;
+    }
+    return deleted;
+}
+
+// Indices stay absolute across a clear: numbering continues at the next
+// block, so a reader still holding old indices keeps seeing old blocks.
+void store_clear(void) {
+    size_t old_head = store_head;
+    size_t end = (store_count + STORE_BLOCK_RECORDS - 1) / STORE_BLOCK_RECORDS * STORE_BLOCK_RECORDS;
+    __atomic_store_n(&store_head, end, __ATOMIC_SEQ_CST);   // head first: see store_read_begin
+    __atomic_store_n(&store_count, end, __ATOMIC_RELEASE);
+    release_blocks(old_head, end);      // includes the partly filled tail block
+    mapped_first = mapped_end = 0;
+    stats_updated = 0;
+}
+
+// Replaces the (empty) store with records [head, count) from a snapshot.
+// `base` is a page-aligned MAP_PRIVATE mapping of whole blocks, starting
+// with the block that holds `head`; the store takes it over and unmaps it
+// block by block as records are trimmed. The last block may be partly
+// filled: appends write into it copy-on-write.
+int store_adopt(sensor_data_t *base, size_t head, size_t count) {
+    size_t first = head / STORE_BLOCK_RECORDS;
+    size_t end = (count + STORE_BLOCK_RECORDS - 1) / STORE_BLOCK_RECORDS;
+    // Readers still pinning the old contents (restore_data at runtime)
+    // only hold a snapshot for one short step: wait for them
+    reclaim_blocks();
+    while (retired_head != retired_tail) {
+        sched_yield();
+        reclaim_blocks();
+    }
+    if (store_count != store_head || retired_head != retired_tail ||
+        count < head || end - first > STORE_MAX_BLOCKS ||
+        STORE_BLOCK_BYTES % (size_t)sysconf(_SC_PAGESIZE) != 0) {
+        return -1;
+    }
+    for (size_t b = first; b < end; b++) {
+        store_blocks[b % STORE_MAX_BLOCKS] = base + (b - first) * STORE_BLOCK_RECORDS;
+    }
+    mapped_first = first;
+    mapped_end = end;
+    store_head = head;
+    __atomic_store_n(&store_count, count, __ATOMIC_RELEASE);
+    stats_updated = 0;
+    metrics_set(METRIC_STORE_RECORDS, (int64_t)(store_count - store_head));
+    return 0;
+}
+
+// ============================================================================
+// SNAPSHOT READS
+// ============================================================================
+
+// Pins the current contents: records [snap->first, snap->end) stay readable
+// until store_read_end(), whatever the writer appends or trims meanwhile.
+void store_read_begin(store_snapshot_t *snap) {
+    for (;;) {
+        uint64_t epoch = __atomic_load_n(&store_epoch, __ATOMIC_SEQ_CST);
+        for (int i = 0; i < STORE_MAX_READERS; i++) {
+            uint64_t idle = 0;
+            if (__atomic_compare_exchange_n(&readers[i].epoch, &idle, epoch, 0,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                // Announced before loading head: a trim the writer has
+                // not yet reclaimed cannot free what we are about to see.
+                // Count before head: a concurrent clear moves head first,
+                // so an old head is never paired with the new count.
+                snap->reader = i;
+                snap->end = __atomic_load_n(&store_count, __ATOMIC_ACQUIRE);
+                snap->first = __atomic_load_n(&store_head, __ATOMIC_SEQ_CST);
+                if (snap->end < snap->first) snap->end = snap->first;
+                return;
+            }
+        }
+        sched_yield();      // every slot busy: wait for a reader, never the writer
+    }
+}
+
+void store_read_end(store_snapshot_t *snap) {
+    if (snap->reader >= 0) {
+        __atomic_store_n(&readers[snap->reader].epoch, 0, __ATOMIC_RELEASE);
+        snap->reader = -1;
+    }
+}
+
+// Record at an absolute index inside a snapshot, NULL outside it
+const sensor_data_t* store_snapshot_at(const store_snapshot_t *snap, size_t index) {
+    if (index < snap->first || index >= snap->end) {
+        return NULL;
+    }
+    return &block_of(index)[index % STORE_BLOCK_RECORDS];
+}
+
+// ============================================================================
+// ITERATION
+// ============================================================================
+
+void store_iter_init(store_iter_t *it, size_t from, size_t to) {
+    size_t head = store_first(), count = store_end();
+    if (from < head) from = head;
+    if (to > count) to = count;
+    it->pos = from;
+    it->end = (from < to) ? to : from;
+}
+
+// Same, bounded by a snapshot instead of the live store
+void store_iter_snapshot(store_iter_t *it, const store_snapshot_t *snap, size_t from, size_t to) {
+    if (from < snap->first) from = snap->first;
+    if (to > snap->end) to = snap->end;
+    it->pos = from;
+    it->end = (from < to) ? to : from;
+}
+
+// Returns the next contiguous run of records (never crossing a block
+// boundary) and advances the iterator. Returns 0 when exhausted.
+size_t store_iter_span(store_iter_t *it, const sensor_data_t **span) {
+    if (it->pos >= it->end) {
+        return 0;
+    }
+    size_t offset = it->pos % STORE_BLOCK_RECORDS;
+    size_t n = STORE_BLOCK_RECORDS - offset;
+    if (n > it->end - it->pos) {
+        n = it->end - it->pos;
+    }
+    *span = &block_of(it->pos)[offset];
+    it->pos += n;
+    return n;
+}
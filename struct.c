@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "ui_report.h"
+
+// Biên dịch: gcc -o struct struct.c ui_report.c
 
 // Định nghĩa struct SensorData
 struct SensorData {
@@ -11,6 +14,13 @@ struct SensorData {
     int errorCode;
 };
 
+// Mô tả struct cho UI: timestamp dạng chuỗi ctime(), không có cảm biến gas
+static const UILayout sensor_layout = UI_LAYOUT(struct SensorData,
+    UI_FIELD(struct SensorData, timestamp, UI_FIELD_CTIME),
+    UI_FIELD(struct SensorData, temperature, UI_FIELD_FLOAT),
+    UI_FIELD(struct SensorData, humidity, UI_FIELD_FLOAT),
+    UI_NO_FIELD);
+
 // Hàm khởi tạo mảng động với tối ưu
 struct SensorData* initDynamicArray(int initialSize) {
     struct SensorData* arr = (struct SensorData*)calloc(initialSize, sizeof(struct SensorData));
@@ -82,6 +92,10 @@ int main() {
                        sensorArray[i].temperature, sensorArray[i].humidity);
             }
 
+            // Cùng dữ liệu qua UI generic, không cần chép sang SensorData của system.h
+            ui_init(0);
+            ui_print_table_l(stdout, sensorArray, (size_t)currentSize, &sensor_layout);
+
             free(sensorArray);
         }
     }
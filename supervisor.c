@@ -0,0 +1,365 @@
+#define _GNU_SOURCE
+#include "system.h"
+#include "metrics.h"
+
+#include <signal.h>
+#include <sys/epoll.h>
+
+// ============================================================================
+// COLLECTOR SUPERVISOR
+// ============================================================================
+//
+// One real collector process per port: fork() + pipe(), the child runs
+// start_collector(write_end, port). The parent waits on every read end with
+// a single epoll instance, converts SensorData records into sensor_data_t,
+// drops out-of-range samples in one validate_records() pass per read and
+// queues the rest in the reorder buffer, which merges the collectors'
+// streams into timestamp order for ingest_records().
+//
+// Sensor IDs are namespaced per port, so two ports never share a sensor
+// directory slot (and its anomaly baseline):
+//
+//   ASCII line (the device sends no ID)   port + 1               1, 2, ...
+//   binary frame with device ID d         (port + 1) * 1000 + d  1001..1255, 2001..
+//
+// Port numbers count from 0 in collector_ports order.
+//
+// A collector that exits (EOF on its pipe) is reaped and restarted after a
+// backoff that doubles on every quick crash and resets once it has run for
+// SUPERVISOR_STABLE_MS.
+
+#define SUPERVISOR_BACKOFF_MIN_MS   500
+#define SUPERVISOR_BACKOFF_MAX_MS   30000
+#define SUPERVISOR_STABLE_MS        10000
+#define SUPERVISOR_READ_RECORDS     256     // records drained per read()
+
+_Static_assert((SUPERVISOR_MAX_COLLECTORS + 1) * SUPERVISOR_PORT_IDS <= SENSOR_ID_LIMIT,
+               "per-port sensor IDs must stay below SENSOR_ID_LIMIT");
+_Static_assert(SUPERVISOR_MAX_COLLECTORS < SUPERVISOR_PORT_IDS,
+               "ASCII port IDs must stay below the first framed ID");
+
+typedef struct collector {
+    char port[64];
+    pid_t pid;                  // -1 while waiting for restart
+    int fd;                     // pipe read end, -1 when stopped
+    uint8_t rx[sizeof(SensorData) * SUPERVISOR_READ_RECORDS];
+    size_t rxlen;
+    uint64_t started_ms;
+    uint64_t restart_at_ms;
+    int backoff_ms;
+    int restarts;
+    uint64_t samples;           // ingested
+    uint64_t dropped;           // out of range
+    uint64_t late;              // too late to store in time order
+    validate_counts_t rejected; // ... by failed check
+} collector_t;
+
+static collector_t collectors[SUPERVISOR_MAX_COLLECTORS];
+static int collector_count = 0;
+static int epoll_fd = -1;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// ============================================================================
+// PROCESS MANAGEMENT
+// ============================================================================
+
+static int spawn_collector(int index) {
+    collector_t *c = &collectors[index];
+    int pipefd[2];
+
+    if (pipe(pipefd) != 0) {
+        log_error("spawn_collector", strerror(errno));
+        return -1;
+    }
+
+    fflush(stdout);     // do not let the child inherit pending output
+    pid_t pid = fork();
+    if (pid < 0) {
+        log_error("spawn_collector", strerror(errno));
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        // Child: keep only our own write end
+        close(pipefd[0]);
+        close(epoll_fd);
+        for (int i = 0; i < collector_count; i++) {
+            if (collectors[i].fd >= 0) close(collectors[i].fd);
+        }
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_IGN);    // Ctrl+C is handled by the parent
+        start_collector(pipefd[1], c->port);
+        _exit(0);
+    }
+
+    close(pipefd[1]);
+    c->pid = pid;
+    c->fd = pipefd[0];
+    c->rxlen = 0;
+    c->started_ms = now_ms();
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32_t)index;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev);
+
+    DEBUG_PRINT("collector %d (%s) started, pid %d", index, c->port, (int)pid);
+    return 0;
+}
+
+// Collector closed its pipe: reap it and schedule a restart
+static void collector_exited(int index) {
+    collector_t *c = &collectors[index];
+    int status = 0;
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    if (c->pid > 0) {
+        waitpid(c->pid, &status, 0);
+    }
+    c->pid = -1;
+
+    uint64_t now = now_ms();
+    if (now - c->started_ms >= SUPERVISOR_STABLE_MS) {
+        c->backoff_ms = SUPERVISOR_BACKOFF_MIN_MS;
+    }
+    c->restart_at_ms = now + (uint64_t)c->backoff_ms;
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "collector %s exited (status %d), restart in %d ms",
+             c->port, WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status),
+             c->backoff_ms);
+    log_info(msg);
+
+    c->backoff_ms *= 2;
+    if (c->backoff_ms > SUPERVISOR_BACKOFF_MAX_MS) {
+        c->backoff_ms = SUPERVISOR_BACKOFF_MAX_MS;
+    }
+}
+
+static void restart_due_collectors(void) {
+    uint64_t now = now_ms();
+    for (int i = 0; i < collector_count; i++) {
+        collector_t *c = &collectors[i];
+        if (c->pid < 0 && now >= c->restart_at_ms) {
+            if (spawn_collector(i) == 0) {
+                c->restarts++;
+            } else {
+                c->restart_at_ms = now + (uint64_t)c->backoff_ms;
+            }
+        }
+    }
+}
+
+// ============================================================================
+// STREAM MERGING
+// ============================================================================
+
+static int drain_collector(int index) {
+    collector_t *c = &collectors[index];
+    ssize_t r = read(c->fd, c->rx + c->rxlen, sizeof(c->rx) - c->rxlen);
+    uint64_t rx_ns = metrics_now_ns();
+    if (r < 0) {
+        return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+    }
+    if (r == 0) {
+        collector_exited(index);
+        return 0;
+    }
+    c->rxlen += (size_t)r;
+
+    size_t n = c->rxlen / sizeof(SensorData);
+    sensor_data_t batch[SUPERVISOR_READ_RECORDS];
+    sample_trace_t traces[SUPERVISOR_READ_RECORDS];
+    for (size_t i = 0; i < n; i++) {
+        SensorData sd;
+        memcpy(&sd, c->rx + i * sizeof(SensorData), sizeof(sd));
+        batch[i].timestamp = sd.ts;
+        batch[i].timestamp_ns = sd.ts_nsec;
+#define FROM_WIRE_(field, stat, wtype, wire, ...) batch[i].field = (float)sd.wire;
+        SENSOR_FIELDS(FROM_WIRE_)
+#undef FROM_WIRE_
+        // ASCII collectors do not know their sensor ID: use the port number
+        batch[i].sensor_id = sd.sensor_id > 0 ? (index + 1) * SUPERVISOR_PORT_IDS + sd.sensor_id
+                                              : index + 1;
+        batch[i].quality = 100;
+
+        traces[i] = (sample_trace_t){ .read_ns = sd.t_read, .parse_ns = sd.t_parse,
+                                      .write_ns = sd.t_write, .receive_ns = rx_ns };
+        trace_received(&traces[i]);
+    }
+
+    // Keep a partial record for the next read
+    size_t used = n * sizeof(SensorData);
+    if (used < c->rxlen) {
+        memmove(c->rx, c->rx + used, c->rxlen - used);
+    }
+    c->rxlen -= used;
+
+    validate_counts_t before = c->rejected;
+    size_t valid = validate_records_traced(batch, traces, n, &c->rejected);
+    if (valid < n) {
+        char why[32 * SENSOR_FIELD_COUNT];
+        int len = 0;
+        for (int f = 0; f < SENSOR_FIELD_COUNT && len < (int)sizeof(why); f++) {
+            len += snprintf(why + len, sizeof(why) - (size_t)len, "%s%c %lu", f ? ", " : "",
+                            sensor_fields[f].key, c->rejected.field[f] - before.field[f]);
+        }
+        system_log_append("WARN", "collector %s: %zu samples out of range dropped (%s)",
+                          c->port, n - valid, why);
+    }
+
+    size_t late = reorder_push(index, batch, traces, valid);
+    if (late) {
+        system_log_append("WARN", "collector %s: %zu samples older than stored data dropped",
+                          c->port, late);
+    }
+
+    c->samples += valid - late;
+    c->dropped += n - valid;
+    c->late += late;
+    return 0;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int supervisor_start(const char *const *ports, int count) {
+    if (epoll_fd >= 0) {
+        return -1;  // already running
+    }
+    if (count < 1 || count > SUPERVISOR_MAX_COLLECTORS) {
+        return -1;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        log_error("supervisor_start", strerror(errno));
+        return -1;
+    }
+
+    collector_count = count;
+    for (int i = 0; i < count; i++) {
+        collector_t *c = &collectors[i];
+        memset(c, 0, sizeof(*c));
+        snprintf(c->port, sizeof(c->port), "%s", ports[i]);
+        c->pid = -1;
+        c->fd = -1;
+        c->backoff_ms = SUPERVISOR_BACKOFF_MIN_MS;
+    }
+
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        if (spawn_collector(i) == 0) {
+            started++;
+        } else {
+            collectors[i].restart_at_ms = now_ms() + SUPERVISOR_BACKOFF_MIN_MS;
+        }
+    }
+    return started;
+}
+
+// Waits up to timeout_ms for collector output, ingests everything the
+// reorder buffer releases and restarts collectors whose backoff expired.
+// Returns the number of records ingested.
+int supervisor_poll(int timeout_ms) {
+    if (epoll_fd < 0) {
+        return 0;
+    }
+
+    // Wake up in time for the next scheduled restart
+    uint64_t now = now_ms();
+    for (int i = 0; i < collector_count; i++) {
+        if (collectors[i].pid < 0) {
+            int wait = collectors[i].restart_at_ms > now ? (int)(collectors[i].restart_at_ms - now) : 0;
+            if (wait < timeout_ms) timeout_ms = wait;
+        }
+    }
+    // ... and for the journal's group commit deadline
+    int commit_in = journal_commit_due_in();
+    if (commit_in >= 0 && commit_in < timeout_ms) {
+        timeout_ms = commit_in;
+    }
+    // ... and for the reorder buffer to release a quiet station's samples
+    int release_in = reorder_due_in();
+    if (release_in >= 0 && release_in < timeout_ms) {
+        timeout_ms = release_in;
+    }
+
+    struct epoll_event events[SUPERVISOR_MAX_COLLECTORS];
+    int n = epoll_wait(epoll_fd, events, SUPERVISOR_MAX_COLLECTORS, timeout_ms);
+
+    for (int i = 0; i < n; i++) {
+        int index = (int)events[i].data.u32;
+        if (collectors[index].fd >= 0 && drain_collector(index) < 0) {
+            log_error("supervisor_poll", strerror(errno));
+        }
+    }
+    int ingested = reorder_release(0);
+
+    restart_due_collectors();
+    journal_tick();
+    snapshot_tick();
+    tier_tick();
+    return ingested;
+}
+
+void supervisor_stop(void) {
+    if (epoll_fd < 0) {
+        return;
+    }
+
+    reorder_release(1);     // what the collectors already delivered is kept
+    for (int i = 0; i < collector_count; i++) {
+        if (collectors[i].pid > 0) {
+            kill(collectors[i].pid, SIGTERM);
+        }
+    }
+    for (int i = 0; i < collector_count; i++) {
+        collector_t *c = &collectors[i];
+        if (c->pid > 0) {
+            waitpid(c->pid, NULL, 0);
+            c->pid = -1;
+        }
+        if (c->fd >= 0) {
+            close(c->fd);
+            c->fd = -1;
+        }
+    }
+
+    close(epoll_fd);
+    epoll_fd = -1;
+}
+
+int supervisor_running(void) {
+    return epoll_fd >= 0;
+}
+
+void supervisor_print_status(void) {
+    printf("%-3s %-20s %-8s %-9s %-10s %-8s %-8s\n", "#", "Port", "PID", "Restarts", "Samples", "Rejected", "Late");
+    printf("------------------------------------------------------------------------\n");
+    for (int i = 0; i < collector_count; i++) {
+        const collector_t *c = &collectors[i];
+        char pid[16];
+        if (c->pid > 0) {
+            snprintf(pid, sizeof(pid), "%d", (int)c->pid);
+        } else {
+            snprintf(pid, sizeof(pid), "restart");
+        }
+        printf("%-3d %-20s %-8s %-9d %-10llu %-8llu %-8llu\n", i + 1, c->port, pid, c->restarts,
+               (unsigned long long)c->samples, (unsigned long long)c->dropped,
+               (unsigned long long)c->late);
+    }
+    if (reorder_pending()) {
+        printf("%zu samples waiting in the reorder buffer\n", reorder_pending());
+    }
+}
@@ -15,9 +15,13 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <time.h>
+#include <stdint.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include "sketch.h"
+#include "schema.h"
+
 // ============================================================================
 // CONSTANTS AND DEFINITIONS
 // ============================================================================
@@ -32,35 +36,71 @@
 #define STATISTICS          2
 #define ASCII_CHART         3
 #define EXPORT_REPORT       4
+#define SENSOR_OVERVIEW     5
 #define DELETE_OLD_DATA     1
 #define CONFIGURE           2
 #define ARDUINO_CONTROL     3
 
-// Sensor Data Types
+// Sensor Data Types (field numbers: index in SENSOR_FIELDS + 1, see schema.h)
 #define TEMPERATURE_SENSOR  1
 #define HUMIDITY_SENSOR     2
 #define GAS_SENSOR          3
 #define MAX_SENSORS         10
 
 // Data Limits
-#define MAX_DATA_RECORDS    1000
+#define STORE_BLOCK_RECORDS 4096    // Số bản ghi mỗi block lưu trữ
+#define STORE_MAX_BLOCKS    16384   // Số block tối đa còn sống (~67M bản ghi)
+#define MAX_DATA_RECORDS    (STORE_BLOCK_RECORDS * STORE_MAX_BLOCKS)
 #define MAX_RECENT_RECORDS  100
 #define MAX_FILENAME_LEN    256
 #define MAX_STRING_LEN      128
+#define STATS_HOURS         168     // Số giờ giữ sketch theo giờ (7 ngày)
+#define SENSOR_MAX_SLOTS    4096    // Số sensor tối đa trong danh bạ
+#define SENSOR_ID_LIMIT     65536   // ID ngoài [0, limit) được gộp vào sensor 0
+#define SENSOR_ID_ALL       (-1)    // Truy vấn toàn trạm
 
 // Arduino Communication
 #define ARDUINO_DEVICE      "/dev/ttyUSB0"
 #define BAUD_RATE           B9600
 #define READ_TIMEOUT        5000  // 5 seconds
 
-// Simulation Limits
-#define MAX_PIPES           20
+// Collector Processes
+#define SUPERVISOR_MAX_COLLECTORS   MAX_SENSORS
+#define SUPERVISOR_PORT_IDS         1000    // Sensor ID khung nhị phân: (cổng + 1) * 1000 + ID thiết bị
 #define PIPE_BUFFER_SIZE    1024
 
+// Live Dashboard
+#define DASHBOARD_DEFAULT_HZ    4
+
+// Write-ahead Journal
+#define JOURNAL_DIR             "journal"
+#define JOURNAL_SEGMENT_BYTES   (64u << 20)
+#define JOURNAL_COMMIT_MS       50      // fdatasync at least this often while records are pending
+#define JOURNAL_COMMIT_RECORDS  4096    // ... or as soon as this many are pending
+
+// Reorder Buffer
+#define REORDER_WINDOW_S        2       // lateness tolerated between collectors
+
+// Latency Tracing
+#define TRACE_SAMPLE_EVERY      0       // trace dump off by default
+
+// Snapshots
+#define SNAPSHOT_FILE           "snapshot.bin"
+#define SNAPSHOT_INTERVAL_S     600     // background snapshot at most this often
+
+// Storage Tiers
+#define TIER_DIR                "tiers"
+#define TIER_RAW_DAYS           2       // raw samples older than this become per-minute rows
+#define TIER_MINUTE_DAYS        30      // per-minute rows older than this become per-hour rows
+#define TIER_COMPACT_KBPS       1024    // compaction I/O budget (KiB/s)
+
 // File Paths
 #define DATA_FILE           "sensor_data.txt"
 #define CONFIG_FILE         "config.txt"
 #define REPORT_DIR          "reports/"
+#define SYSTEM_LOG_FILE     "system_log.txt"   // Log của collector (INFO/WARN/ERROR/ALERT)
+#define DATA_LOG_FILE       "data_log.txt"     // Dữ liệu thô dạng text từ collector
+#define TRACE_FILE          "trace_log.txt"    // Trace theo chặng của các mẫu được lấy mẫu
 
 // ============================================================================
 // DATA STRUCTURES
@@ -68,23 +108,68 @@
 
 // Sensor Data Structure
 typedef struct sensor_data {
-    time_t timestamp;           // Thời gian đo
-    float temperature;          // Nhiệt độ (°C)
-    float humidity;             // Độ ẩm (%)
-    float gas_level;            // Nồng độ khí (ppm)
+    time_t timestamp;           // Thời gian đo (giây epoch)
+    SENSOR_FIELD_VALUES;        // temperature (°C), humidity (%), gas_level (ppm)... xem schema.h
     int sensor_id;              // ID của sensor
-    int quality;                // Chất lượng dữ liệu (0-100)
+    int quality;                // Chất lượng dữ liệu (0-100), hạ bởi bộ phát hiện bất thường
+    int timestamp_ns;           // Phần nano giây của timestamp (0 nếu nguồn chỉ có giây)
 } sensor_data_t;
 
+// CLOCK_MONOTONIC stamps (ns) of one sample through the pipeline, see trace.c
+typedef struct sample_trace {
+    uint64_t read_ns;           // collector read the bytes carrying it
+    uint64_t parse_ns;          // line or frame decoded
+    uint64_t write_ns;          // about to be written to the pipe
+    uint64_t receive_ns;        // read from the pipe by the supervisor
+    uint64_t commit_ns;         // appended to the store
+} sample_trace_t;
+
+// Samples rejected by validation, per failed field
+typedef struct validate_counts {
+    unsigned long field[SENSOR_FIELD_COUNT];
+} validate_counts_t;
+
 // Statistics Structure
 typedef struct statistics {
-    float temp_max, temp_min, temp_avg;
-    float humidity_max, humidity_min, humidity_avg;
-    float gas_max, gas_min, gas_avg;
+    SENSOR_FIELD_ARRAY(float, max);             // max[f] hoặc temp_max, humidity_max...
+    SENSOR_FIELD_ARRAY(float, min);
+    SENSOR_FIELD_ARRAY(float, avg);
+    SENSOR_FIELD_ARRAY(float, p50);             // Phân vị (sketch, sai số ≤ 1%)
+    SENSOR_FIELD_ARRAY(float, p95);
+    SENSOR_FIELD_ARRAY(float, p99);
     int total_records;
     time_t first_record, last_record;
 } statistics_t;
 
+// Percentiles of one field (TEMPERATURE_SENSOR, ... or index + 1)
+typedef struct percentiles {
+    float p50, p95, p99;
+    float min, max, avg;
+    unsigned long count;
+} percentiles_t;
+
+// One measured field as declared in SENSOR_FIELDS (schema.h). sensor_fields[]
+// (sensors.c) is indexed like sensor_data_t.values.
+typedef struct sensor_field {
+    const char *name;           // sensor_data_t member, CSV / Arrow column
+    const char *label;
+    const char *unit;
+    char key;                   // chart key, short label
+    float lo, hi;               // valid range
+} sensor_field_t;
+
+// Per-sensor running totals kept by the sensor directory (sensors.c)
+typedef struct sensor_info {
+    int sensor_id;
+    unsigned long count;
+    SENSOR_FIELD_ARRAY(float, min);
+    SENSOR_FIELD_ARRAY(float, max);
+    SENSOR_FIELD_ARRAY(double, sum);
+    unsigned long anomalies;    // Bản ghi bị anomaly.c đánh dấu (anomaly_from_quality)
+    time_t first_seen, last_seen;
+    sensor_data_t last;         // Bản ghi mới nhất
+} sensor_info_t;
+
 // Configuration Structure
 typedef struct config {
     int auto_collect_interval;  // Thời gian tự động thu thập (giây)
@@ -93,6 +178,17 @@ typedef struct config {
     int baud_rate;              // Tốc độ baud
     int max_records;            // Số bản ghi tối đa
     int auto_mode_enabled;      // Bật/tắt chế độ tự động
+    int collector_count;        // Số collector (0 = chỉ dùng arduino_device)
+    char collector_ports[SUPERVISOR_MAX_COLLECTORS][64]; // Cổng của từng collector ("SIM" = mô phỏng)
+    int dashboard_refresh_hz;   // Tần số làm mới dashboard (lần/giây)
+    int journal_commit_ms;      // Group commit: fsync journal sau tối đa N ms
+    int journal_commit_records; // ... hoặc khi có M bản ghi chưa fsync (0/0 = fsync mỗi lô)
+    int snapshot_interval_s;    // Chu kỳ chụp snapshot nền (giây, 0 = chỉ khi tắt)
+    int reorder_window_s;       // Thời gian chờ mẫu đến trễ trước khi sắp xếp và lưu (giây)
+    int trace_sample_every;     // Ghi trace của 1 trên N mẫu vào TRACE_FILE (0 = tắt)
+    int tier_raw_days;          // Giữ mẫu thô N ngày, sau đó gộp theo phút (0 = không gộp)
+    int tier_minute_days;       // Giữ dòng theo phút N ngày, sau đó gộp theo giờ
+    int compact_kbps;           // Ngân sách I/O của việc gộp (KiB/s, 0 = không giới hạn)
 } config_t;
 
 // Menu Item Structure
@@ -107,12 +203,66 @@ typedef struct menu_item {
 typedef struct chart_data {
     int width;                  // Chiều rộng chart
     int height;                 // Chiều cao chart
-    char data_type;             // 'T'=temperature, 'H'=humidity, 'G'=gas
+    char data_type;             // Phím của trường (key trong schema.h): 'T', 'H', 'G'...
     float min_value, max_value; // Giá trị min/max
     sensor_data_t *data_points; // Dữ liệu để vẽ
     int num_points;             // Số điểm dữ liệu
 } chart_data_t;
 
+// One time bucket of a cached series (cache.c); fields in schema order
+typedef struct cache_bucket {
+    time_t start;
+    unsigned long count;
+    float min[SENSOR_FIELD_COUNT], max[SENSOR_FIELD_COUNT];
+    double sum[SENSOR_FIELD_COUNT];
+} cache_bucket_t;
+
+// One row of a compacted tier (tier.c): a minute or an hour of one sensor
+typedef struct tier_row {
+    int64_t start;              // đầu khoảng (giây epoch)
+    int32_t sensor_id;
+    uint32_t count;             // số mẫu thô đã gộp
+    float min[SENSOR_FIELD_COUNT], max[SENSOR_FIELD_COUNT], avg[SENSOR_FIELD_COUNT];
+    uint32_t crc;               // CRC-32 của dòng với crc = 0
+} tier_row_t;
+
+// Reads tier rows in time order (tier_cursor_open); any thread
+typedef struct tier_cursor {
+    int sensor_id;
+    time_t next, to;            // rows not yet read: start in [next, to)
+    int fd;                     // file being read, -1 between files
+    off_t pos, end;             // rows left in it
+    time_t limit;               // and the start they stop at
+} tier_cursor_t;
+
+// A tier file opened for a backup (tier_open_files)
+typedef struct tier_file {
+    char name[32];              // tên file trong TIER_DIR
+    int fd;
+} tier_file_t;
+
+// Store iterator: walks absolute record indices [pos, end)
+typedef struct store_iter {
+    size_t pos;
+    size_t end;
+} store_iter_t;
+
+// Consistent view of the store for threads other than the ingest thread
+typedef struct store_snapshot {
+    size_t first;
+    size_t end;
+    int reader;                 // reader slot, -1 after store_read_end
+} store_snapshot_t;
+
+// Records held by the current snapshot file (snapshot_open_records)
+typedef struct snapshot_records {
+    int fd;
+    size_t first, end;          // absolute record indices in the file
+    off_t offset;               // file offset of record `first`
+} snapshot_records_t;
+
+// Collector wire record SensorData: defined once, in schema.h
+
 // ============================================================================
 // GLOBAL VARIABLES
 // ============================================================================
@@ -122,14 +272,11 @@ extern int current_mode;
 extern int system_running;
 extern config_t system_config;
 
-// Data Storage
-extern sensor_data_t sensor_data[MAX_DATA_RECORDS];
-extern int data_count;
+// Data Storage (records live in the append-only block store, see store.c)
 extern int recent_data_count;
 extern sensor_data_t recent_data[MAX_RECENT_RECORDS];
 
 // Statistics
-extern statistics_t global_stats;
 extern int stats_updated;
 
 // Arduino Communication
@@ -148,6 +295,7 @@ int save_config(void);
 
 // Main Program Flow
 void run_auto_mode(void);
+void run_dashboard_mode(void);
 void run_user_mode(void);
 void run_admin_mode(void);
 void show_main_menu(void);
@@ -158,23 +306,104 @@ int disconnect_arduino(void);
 int collect_sensor_data(void);
 int read_arduino_data(sensor_data_t *data);
 int validate_sensor_data(sensor_data_t *data);
+uint64_t validate_mask(sensor_data_t *records, size_t count, validate_counts_t *rejected);
+size_t validate_records(sensor_data_t *records, size_t count, validate_counts_t *rejected);
+size_t validate_records_traced(sensor_data_t *records, sample_trace_t *traces, size_t count,
+                               validate_counts_t *rejected);
 void save_data_to_file(sensor_data_t *data);
 void update_recent_data(sensor_data_t *data);
+int ingest_records(sensor_data_t *records, size_t count);
+
+// Collector Supervisor (one forked collector per port, see supervisor.c)
+int supervisor_start(const char *const *ports, int count);
+int supervisor_poll(int timeout_ms);
+void supervisor_stop(void);
+int supervisor_running(void);
+void supervisor_print_status(void);
+
+// Reorder buffer (reorder.c): collector samples are released to
+// ingest_records() in timestamp order, REORDER_WINDOW_S behind the newest.
+// traces may be NULL (no stage stamps).
+size_t reorder_push(int source, const sensor_data_t *records, const sample_trace_t *traces,
+                    size_t count);
+int reorder_release(int flush);
+int reorder_due_in(void);
+size_t reorder_pending(void);
+
+// Stage latency tracing (trace.c): histograms per pipeline stage and a
+// sampled per-sample dump to TRACE_FILE
+void trace_received(const sample_trace_t *t);
+void trace_committed(const sensor_data_t *rec, const sample_trace_t *t);
+void trace_close(void);
+
+// Data Storage (append-only block store)
+// Records are kept in time order in fixed-size blocks that never move.
+// Indices are absolute: deleting old data advances store_first() instead of
+// shifting records, so an index stays valid until its record is trimmed.
+// Only the ingest thread appends/trims/clears; other threads read between
+// store_read_begin() and store_read_end() and never block it.
+int store_append(const sensor_data_t *rec);
+size_t store_size(void);
+size_t store_first(void);
+size_t store_end(void);
+const sensor_data_t* store_at(size_t index);
+size_t store_trim_before(time_t cutoff);
+void store_clear(void);
+int store_adopt(sensor_data_t *base, size_t head, size_t count);
+void store_iter_init(store_iter_t *it, size_t from, size_t to);
+void store_read_begin(store_snapshot_t *snap);
+void store_read_end(store_snapshot_t *snap);
+void store_iter_snapshot(store_iter_t *it, const store_snapshot_t *snap, size_t from, size_t to);
+const sensor_data_t* store_snapshot_at(const store_snapshot_t *snap, size_t index);
+size_t store_iter_span(store_iter_t *it, const sensor_data_t **span);
 
 // Data Management
 int load_data_from_file(void);
 int save_data_to_file_all(void);
 int delete_old_data(int days);
+int delete_data_before(time_t cutoff);
 int clear_all_data(void);
-int backup_data(const char *filename);
+int backup_data(const char *filename);     // filename: backup directory (backup.c)
 int restore_data(const char *filename);
+long merge_station_files(const char *pattern, const char *csv_file);   // merge.c; csv_file NULL: into the store
 
 // Statistics
 int calculate_statistics(void);
+int get_statistics(statistics_t *out);     // any thread: last published copy
 void print_statistics(void);
 void print_recent_data(int count);
 sensor_data_t* get_latest_data(void);
 
+
+// Sensor directory (sensors.c): dense sensor ID -> slot table holding each
+// sensor's running totals, percentile sketches and record indices.
+// Maintained by ingest_records(); rebuilt from the store when out of sync.
+void sensor_dir_assess(sensor_data_t *d);
+void sensor_dir_add(const sensor_data_t *d, size_t index);
+void sensor_dir_reset(void);
+void sensor_dir_rebuild(void);
+void sensor_dir_sync(void);
+int sensor_dir_ids(int *ids, int max);
+const sensor_info_t* sensor_dir_get(int sensor_id);
+int sensor_dir_write(FILE *fp);
+int sensor_dir_read(const void *buf, size_t len);
+size_t sensor_record_count(int sensor_id);
+const sensor_data_t* sensor_record_at(int sensor_id, size_t k);
+int calculate_sensor_statistics(int sensor_id, statistics_t *out);
+
+// Percentile statistics from the streaming sketches. sensor_id may be
+// SENSOR_ID_ALL; from = to = 0 means all time, otherwise the hourly
+// sketches overlapping [from, to) are merged. Returns the sample count.
+int get_percentiles(int field, int sensor_id, time_t from, time_t to, percentiles_t *out);
+int get_histogram(int field, int sensor_id, sketch_hist_t *out);
+
+// Field table (sensors.c); sensor_field_by_key returns the field number
+// (index + 1) of a chart key, 0 if there is none. display_pad gives the
+// %-*s width that fills `cols` terminal columns with a UTF-8 label.
+extern const sensor_field_t sensor_fields[SENSOR_FIELD_COUNT];
+int sensor_field_by_key(char key);
+int display_pad(const char *s, int cols);
+
 // User Interface
 void clear_screen(void);
 void show_header(void);
@@ -185,20 +414,91 @@ void wait_for_enter(void);
 void show_message(const char *message);
 void show_error(const char *error);
 
-// ASCII Chart
+// Result cache (cache.c): windowed series and statistics keyed by
+// (kind, sensor, window, resolution); a repeated lookup only scans the
+// records appended since the last one. Ingest thread only.
+int cache_series(int sensor_id, time_t from, time_t to, int resolution,
+                 const cache_bucket_t **buckets);
+int cache_statistics(int sensor_id, time_t from, time_t to, int resolution, statistics_t *out);
+void cache_invalidate(void);
+
+// ASCII Chart (chart.c)
 int create_ascii_chart(chart_data_t *chart);
-int display_temperature_chart(int hours);
-int display_humidity_chart(int hours);
-int display_gas_chart(int hours);
+int display_field_chart(int field, int hours);
 void draw_chart_border(int width, int height);
 void draw_data_line(chart_data_t *chart);
 
+// Paged table views (view.c): only the visible window is formatted
+int view_store_table(const char *title, size_t first, size_t end);
+int view_sensor_table(int sensor_id);
+
+// Live dashboard (dashboard.c): fed by ingest_records, redraws changed cells only
+int dashboard_start(int refresh_hz);
+void dashboard_stop(void);
+void dashboard_ingest(const sensor_data_t *records, size_t count);
+
+// Write-ahead journal (journal.c): every ingested batch is logged before it
+// is stored; journal_open() replays the journal into the store on startup
+#define JOURNAL_INCOMPATIBLE    (-2)    // journal_open(): written with another sensor_data_t
+int journal_open(uint64_t from_lsn);
+void journal_close(void);
+int journal_append(const sensor_data_t *records, size_t count);
+int journal_log_trim(time_t cutoff);
+int journal_commit(void);
+void journal_tick(void);
+int journal_commit_due_in(void);
+int journal_reset(void);
+void journal_discard(void);
+uint64_t journal_next_lsn(void);
+int journal_drop_before(uint64_t lsn);
+int journal_list_segments(uint64_t **first_lsns);
+int journal_open_segment(uint64_t first_lsn);
+int journal_frame_crc(int fd, off_t offset, uint32_t *crc);
+off_t journal_segment_extent(int fd, off_t from, off_t limit, off_t *tail, uint32_t *tail_crc);
+uint32_t crc32_update(uint32_t crc, const void *data, size_t n);
+
+// Snapshots (snapshot.c): store + directory image, mapped on startup so only
+// the journal tail has to be replayed
+#define SNAPSHOT_INCOMPATIBLE   (-2)    // snapshot_load(): written with another schema
+int snapshot_load(uint64_t *journal_lsn);
+int snapshot_save(void);
+void snapshot_tick(void);
+void snapshot_discard(void);
+int snapshot_open_records(snapshot_records_t *out);
+int snapshot_open_file(uint64_t *journal_lsn, uint32_t *id);
+
+// Storage tiers (tier.c): raw samples older than tier_raw_days are folded
+// into per-minute rows, those older than tier_minute_days into per-hour
+// rows, by tier_tick() within the compact_kbps I/O budget. Records below
+// tier_floor() are only in the tiers; tier_totals() sums them per sensor.
+int tier_open(void);
+void tier_close(void);
+void tier_tick(void);
+int tier_reset(void);
+void tier_discard(void);
+time_t tier_floor(void);
+void tier_print_status(void);
+int tier_cursor_open(tier_cursor_t *c, int sensor_id, time_t from, time_t to);
+size_t tier_cursor_next(tier_cursor_t *c, tier_row_t *rows, size_t max);
+void tier_cursor_close(tier_cursor_t *c);
+unsigned long tier_totals(int sensor_id, sensor_info_t *out);
+int tier_open_files(tier_file_t **files);
+int tier_row_crc_at(int fd, off_t offset, uint32_t *crc);
+off_t tier_file_extent(int fd, off_t *tail, uint32_t *tail_crc);
+
+// Query server (query.c): binary protocol of query.h on a Unix socket,
+// served by one event-loop thread reading the store through snapshots
+int query_serve(const char *path);
+void query_stop(void);
+void query_ingest(const sensor_data_t *records, size_t count);
+void query_reset(void);
+void query_reload(void);
+
 // Report Generation
 int generate_report(const char *filename);
 int export_to_csv(const char *filename);
 int export_to_txt(const char *filename);
-void print_report_header(FILE *fp);
-void print_report_data(FILE *fp);
+int export_to_arrow(const char *filename);      // Arrow IPC / Feather v2 (arrow.c)
 void print_report_statistics(FILE *fp);
 
 // Configuration Management
@@ -222,9 +522,9 @@ char* format_timestamp(time_t timestamp);
 float calculate_average(float *values, int count);
 float find_maximum(float *values, int count);
 float find_minimum(float *values, int count);
-int is_valid_temperature(float temp);
-int is_valid_humidity(float humidity);
-int is_valid_gas_level(float gas);
+#define SCHEMA_IS_VALID_(field, ...)    int is_valid_##field(float value);
+SENSOR_FIELDS(SCHEMA_IS_VALID_)         // is_valid_temperature(), ... (validate.c)
+#undef SCHEMA_IS_VALID_
 
 // File Operations
 int create_directory(const char *path);
@@ -237,34 +537,36 @@ int user_view_recent_data(void);
 int user_show_statistics(void);
 int user_display_ascii_chart(void);
 int user_export_report(void);
+int user_view_sensors(void);
 
 // Menu Functions (ADMIN MODE)
 int admin_delete_old_data(void);
 int admin_configure_system(void);
 int admin_arduino_control(void);
+int admin_backup_restore(void);
+int admin_import_stations(void);
 
 // Error Handling
 void handle_system_error(int error_code);
 void log_error(const char *function, const char *error);
 void log_info(const char *message);
 
-// Process and Pipe Simulation
-void init_simulation_system(void);
-void print_simulation_status(void);
-int simulated_fork(void);
-int simulated_exit(int exit_code);
-int simulated_wait(int *status);
-int simulated_pipe(int pipefd[2]);
-ssize_t simulated_read(int fd, void *buf, size_t count);
-ssize_t simulated_write(int fd, const void *buf, size_t count);
-int simulated_close(int fd);
-
-// Simulation Test Functions
-void run_simulation_test(void);
-void test_fork_simulation(void);
-void test_pipe_simulation(void);
+// Process and Pipe Test Functions (real fork()/pipe())
+void run_process_test(void);
+void test_fork(void);
+void test_pipe(void);
 void test_fork_and_pipe_combined(void);
-void run_comprehensive_simulation_test(void);
+void run_comprehensive_process_test(void);
+
+// Collector (sensor module)
+int setup_serial_port(const char *port_name);
+int parse_sensor_data(const char *line, SensorData *data);
+void start_collector(int write_pipe_fd, const char *port_name);
+void get_simulated_data(char *buffer, size_t buflen);
+size_t get_simulated_frame(uint8_t *buffer, size_t buflen);
+ssize_t write_full(int fd, const void *buf, size_t count);
+void system_log_append(const char *level, const char *fmt, ...);
+void data_log_append(const SensorData *sd);
 
 // ============================================================================
 // MACROS
@@ -286,8 +588,12 @@ void run_comprehensive_simulation_test(void);
         } \
     } while(0)
 
-// Clear screen macro
-#define CLEAR_SCREEN() system("clear")
+// Clear screen macro (ANSI: cursor home + erase display, no shell spawned)
+#define CLEAR_SCREEN() \
+    do { \
+        fputs("\033[H\033[2J", stdout); \
+        fflush(stdout); \
+    } while(0)
 
 // Wait for user input
 #define WAIT_FOR_ENTER() \
@@ -317,12 +623,15 @@ static inline int is_arduino_connected(void) {
 
 // Get data count
 static inline int get_data_count(void) {
-    return data_count;
+    return (int)store_size();
 }
 
-// Check if data storage is full
+// Check if data storage is full: the next record needs a new block and
+// every block of the ring is live (see store_append)
 static inline int is_data_storage_full(void) {
-    return data_count >= MAX_DATA_RECORDS;
+    size_t end = store_end();
+    return end % STORE_BLOCK_RECORDS == 0 &&
+           end / STORE_BLOCK_RECORDS - store_first() / STORE_BLOCK_RECORDS >= STORE_MAX_BLOCKS;
 }
 
 #endif // SYSTEM_H
\ No newline at end of file
@@ -0,0 +1,974 @@
+#include "system.h"
+#include "metrics.h"
+
+#include <dirent.h>
+#include <math.h>
+#include <pthread.h>
+
+// ============================================================================
+// STORAGE TIERS
+// ============================================================================
+//
+// Long history is kept at decreasing resolution:
+//
+//   raw records (store, snapshot, journal)     newer than tier_raw_days
+//   per-minute rows, tiers/minute-<day>.tier   newer than tier_minute_days
+//   per-hour rows, tiers/hour.tier             everything older
+//
+// A row (tier_row_t) holds the count, min, max and average of every field
+// for one sensor over one minute or hour. At 1 Hz a minute row replaces 60
+// records (1920 bytes) with 56 bytes and an hour row replaces 3600.
+//
+// tier_tick(), called from the collection loop, does the work in steps:
+//
+//   - raw -> minute: whole minutes past the raw age are read from the head
+//     of the store and appended to the segment of their (UTC) day, which
+//     is synced before the minutes count as compacted. The store is then
+//     trimmed (delete_data_before, journaled) in large steps, since a trim
+//     rescans the sensor directory; until it is, readers ignore those rows
+//     and keep using the raw records.
+//   - minute -> hour: a day segment past the minute age is folded into
+//     hourly rows appended to the hour file, then deleted.
+//
+// Each step is charged the bytes it reads and writes against a token
+// bucket refilled at compact_kbps, so catching up on a long backlog does
+// not compete with ingest for the disk.
+//
+// Rows are synced before what they replace is dropped, and a step skips
+// what the tiers already cover, so a step redone after a crash does not
+// count anything twice. A torn row at the end of a file fails its CRC and
+// is cut off on open.
+//
+// Readers (cache.c, query.c) take rows before tier_floor(), the cutoff of
+// the last trim, and raw records from there on. A cursor may run on any
+// thread: the watermarks and the segment list are guarded by tier_lock,
+// which the ingest thread holds only to publish a step, and a segment is
+// only deleted under it.
+//
+// Station statistics (calculate_sensor_statistics) add per-sensor totals
+// of the rows below the floor, kept by tier_totals(): read once on open,
+// then only the rows each trim moves below the floor. Rows hold no
+// distribution, so percentiles cover the raw records only.
+//
+// Backups copy the tier files next to the snapshot and journal
+// (tier_open_files): hour.tier and the minute segments are append-only
+// like journal segments, so the same incremental copy applies.
+
+#define TIER_MINUTE_S           60
+#define TIER_HOUR_S             3600
+#define TIER_DAY_S              86400
+#define TIER_MAX_SEGMENTS       4096                        // days of per-minute rows
+#define TIER_ACC_SENSORS        256                         // sensors folded at once
+#define TIER_BATCH_ROWS         (4 * TIER_ACC_SENSORS)      // rows per write
+#define TIER_TICK_BYTES         (4u << 20)                  // per tick, budget or not
+#define TIER_TRIM_RECORDS       (16 * STORE_BLOCK_RECORDS)
+#define TIER_TRIM_INTERVAL_S    (6 * 3600)
+#define TIER_RETRY_S            60                          // pause after an I/O error
+
+// Running totals of one sensor over one row's span
+typedef struct tier_acc {
+    int32_t sensor_id;
+    uint32_t count;
+    float min[SENSOR_FIELD_COUNT], max[SENSOR_FIELD_COUNT];
+    double sum[SENSOR_FIELD_COUNT];
+} tier_acc_t;
+
+static pthread_mutex_t tier_lock = PTHREAD_MUTEX_INITIALIZER;
+static int tier_ready = 0;
+static time_t floor_ts = 0;             // readers: rows below, store from here on
+static time_t minute_until = 0;         // hour rows below, minute segments from here on
+static time_t seg_days[TIER_MAX_SEGMENTS];
+static int seg_count = 0;
+
+// Ingest thread only
+static time_t raw_until = 0;            // minutes below this are in a segment
+static int seg_fd = -1;                 // newest segment, open for appends
+static time_t seg_day = 0;
+static int hour_fd = -1;
+static size_t compact_pos = 0;          // next store record to compact
+static double tokens = 0;
+static uint64_t refill_ms = 0;
+static uint64_t tick_bytes = 0;
+static time_t last_trim = 0;
+static time_t paused_until = 0;
+static uint64_t tier_bytes = 0;
+
+static tier_acc_t acc[TIER_ACC_SENSORS];
+static int acc_count = 0;
+static tier_row_t batch[TIER_BATCH_ROWS];
+static int batch_len = 0;
+
+// Totals of the rows below totals_until, by sensor (ingest thread)
+static sensor_info_t *totals = NULL;
+static int totals_count = 0, totals_cap = 0;
+static time_t totals_until = 0;
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static inline time_t align_down(time_t t, time_t r) {
+    return t - ((t % r) + r) % r;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void segment_path(char *buf, size_t size, time_t day) {
+    snprintf(buf, size, "%s/minute-%016llx.tier", TIER_DIR, (unsigned long long)day);
+}
+
+static void hour_path(char *buf, size_t size) {
+    snprintf(buf, size, "%s/hour.tier", TIER_DIR);
+}
+
+static uint32_t row_crc(const tier_row_t *row) {
+    tier_row_t tmp = *row;
+    tmp.crc = 0;
+    return crc32_update(0, &tmp, sizeof(tmp));
+}
+
+static void sync_tier_dir(void) {
+    int fd = open(TIER_DIR, O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+static int cmp_day(const void *a, const void *b) {
+    time_t x = *(const time_t *)a, y = *(const time_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Cuts a torn or partial row off the end of the file. Returns the number of
+// rows and the last one in *last (if any).
+static off_t repair_tail(int fd, tier_row_t *last) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    off_t rows = st.st_size / (off_t)sizeof(tier_row_t);
+    while (rows > 0) {
+        ssize_t got = pread(fd, last, sizeof(*last), (rows - 1) * (off_t)sizeof(tier_row_t));
+        if (got < 0) {
+            return -1;      // unreadable is not torn: leave the file alone
+        }
+        if (got == (ssize_t)sizeof(*last) && last->crc == row_crc(last)) {
+            break;
+        }
+        rows--;
+    }
+    if (rows * (off_t)sizeof(tier_row_t) != st.st_size &&
+        ftruncate(fd, rows * (off_t)sizeof(tier_row_t)) != 0) {
+        return -1;
+    }
+    return rows;
+}
+
+// ============================================================================
+// FOLDING
+// ============================================================================
+
+static tier_acc_t* acc_get(int32_t sensor_id) {
+    for (int i = 0; i < acc_count; i++) {
+        if (acc[i].sensor_id == sensor_id) return &acc[i];
+    }
+    if (acc_count == TIER_ACC_SENSORS) {
+        return NULL;
+    }
+    tier_acc_t *a = &acc[acc_count++];
+    a->sensor_id = sensor_id;
+    a->count = 0;
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        a->min[f] = INFINITY;
+        a->max[f] = -INFINITY;
+        a->sum[f] = 0;
+    }
+    return a;
+}
+
+static inline void acc_add_record(tier_acc_t *a, const sensor_data_t *d) {
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        float v = d->values[f];
+        if (v < a->min[f]) a->min[f] = v;
+        if (v > a->max[f]) a->max[f] = v;
+        a->sum[f] += v;
+    }
+    a->count++;
+}
+
+static inline void acc_add_row(tier_acc_t *a, const tier_row_t *r) {
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        if (r->min[f] < a->min[f]) a->min[f] = r->min[f];
+        if (r->max[f] > a->max[f]) a->max[f] = r->max[f];
+        a->sum[f] += (double)r->avg[f] * r->count;
+    }
+    a->count += r->count;
+}
+
+// Moves the accumulated rows of span `start` to `out`, by sensor ID.
+// Returns the number of rows.
+static int acc_emit(time_t start, tier_row_t *out) {
+    for (int i = 1; i < acc_count; i++) {
+        tier_acc_t a = acc[i];
+        int j = i;
+        for (; j > 0 && acc[j - 1].sensor_id > a.sensor_id; j--) acc[j] = acc[j - 1];
+        acc[j] = a;
+    }
+    for (int i = 0; i < acc_count; i++) {
+        tier_row_t *r = &out[i];
+        memset(r, 0, sizeof(*r));
+        r->start = start;
+        r->sensor_id = acc[i].sensor_id;
+        r->count = acc[i].count;
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+            r->min[f] = acc[i].min[f];
+            r->max[f] = acc[i].max[f];
+            r->avg[f] = (float)(acc[i].sum[f] / (double)acc[i].count);
+        }
+        r->crc = row_crc(r);
+    }
+    int n = acc_count;
+    acc_count = 0;
+    return n;
+}
+
+// ============================================================================
+// I/O BUDGET
+// ============================================================================
+
+// Refills the bucket; 0 if this tick may not do more work
+static int budget_left(void) {
+    if (tick_bytes >= TIER_TICK_BYTES) {
+        return 0;
+    }
+    if (system_config.compact_kbps <= 0) {
+        return 1;
+    }
+    uint64_t now = now_ms();
+    double rate = system_config.compact_kbps * 1024.0 / 1000.0;    // bytes per ms
+    tokens += (double)(now - refill_ms) * rate;
+    if (tokens > rate * 1000) tokens = rate * 1000;                // one second of burst
+    refill_ms = now;
+    return tokens > 0;
+}
+
+static void charge(size_t bytes) {
+    tokens -= (double)bytes;
+    tick_bytes += bytes;
+    metrics_add(METRIC_COMPACT_BYTES, bytes);
+}
+
+static void io_failed(const char *what) {
+    system_log_append("ERROR", "tier: %s: %s, compaction paused", what, strerror(errno));
+    paused_until = time(NULL) + TIER_RETRY_S;
+}
+
+// ============================================================================
+// RAW -> MINUTE
+// ============================================================================
+
+// Appends `batch` to the segment of `day` and syncs it; the rows are then
+// compacted. On failure the segment is cut back and nothing is.
+static int flush_batch(time_t day, time_t until) {
+    if (batch_len == 0) {
+        return 0;
+    }
+    if (seg_fd < 0 || seg_day != day) {
+        char path[256];
+        if (seg_fd >= 0) close(seg_fd);
+        segment_path(path, sizeof(path), day);
+        seg_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        seg_day = day;
+        if (seg_fd < 0) {
+            io_failed("segment");
+            return -1;
+        }
+        pthread_mutex_lock(&tier_lock);
+        if (seg_count == 0 || seg_days[seg_count - 1] != day) {
+            if (seg_count == TIER_MAX_SEGMENTS) {
+                pthread_mutex_unlock(&tier_lock);
+                errno = ENOSPC;
+                io_failed("segment list");
+                return -1;
+            }
+            seg_days[seg_count++] = day;
+        }
+        pthread_mutex_unlock(&tier_lock);
+        sync_tier_dir();
+    }
+
+    struct stat st;
+    size_t len = (size_t)batch_len * sizeof(tier_row_t);
+    if (fstat(seg_fd, &st) != 0) {
+        io_failed("segment");
+        return -1;
+    }
+    if (write_full(seg_fd, batch, len) < 0 || fdatasync(seg_fd) != 0) {
+        io_failed("segment");
+        if (ftruncate(seg_fd, st.st_size) != 0) {
+            close(seg_fd);      // reopened (and repaired) by tier_open()
+            seg_fd = -1;
+        }
+        return -1;
+    }
+    charge(len);
+    tier_bytes += len;
+    raw_until = until;
+    batch_len = 0;
+    return 0;
+}
+
+// Folds whole minutes before `cutoff` from the head of the store into
+// minute rows. Returns 1 once caught up, 0 if the budget ran out, -1 on
+// an I/O error.
+static int compact_minutes(time_t cutoff) {
+    size_t synced_pos = compact_pos;
+    time_t batch_day = 0, batch_until = raw_until;
+    int rc = 1;
+
+    for (;;) {
+        if (compact_pos < store_first()) compact_pos = store_first();
+        if (compact_pos >= store_end()) break;
+        time_t minute = align_down(store_at(compact_pos)->timestamp, TIER_MINUTE_S);
+        if (minute + TIER_MINUTE_S > cutoff) break;
+        if (!budget_left()) {
+            rc = 0;
+            break;
+        }
+
+        // Covered already when a step is redone after a crash
+        int fold = minute >= raw_until;
+        time_t day = align_down(minute, TIER_DAY_S);
+        if (fold && (day != batch_day || batch_len + TIER_ACC_SENSORS > TIER_BATCH_ROWS)) {
+            if (flush_batch(batch_day, batch_until) != 0) {
+                compact_pos = synced_pos;
+                batch_len = 0;
+                return -1;
+            }
+            synced_pos = compact_pos;
+            batch_day = day;
+        }
+
+        store_iter_t it;
+        const sensor_data_t *span;
+        size_t n, records = 0;
+        store_iter_init(&it, compact_pos, store_end());
+        while ((n = store_iter_span(&it, &span)) > 0) {
+            size_t i = 0;
+            for (; i < n && span[i].timestamp < minute + TIER_MINUTE_S; i++) {
+                if (!fold) continue;
+                tier_acc_t *a = acc_get(span[i].sensor_id);
+                if (!a) {
+                    // More sensors than fit: a sensor may get two rows for
+                    // the minute, which readers merge (a crash before the
+                    // rest of the minute is synced loses that rest)
+                    batch_len += acc_emit(minute, &batch[batch_len]);
+                    if (batch_len + TIER_ACC_SENSORS > TIER_BATCH_ROWS &&
+                        flush_batch(batch_day, batch_until) != 0) {
+                        compact_pos = synced_pos;
+                        batch_len = 0;
+                        return -1;
+                    }
+                    a = acc_get(span[i].sensor_id);
+                }
+                acc_add_record(a, &span[i]);
+            }
+            records += i;
+            if (i < n) break;
+        }
+        compact_pos += records;
+        charge(records * sizeof(sensor_data_t));
+        if (fold) {
+            batch_len += acc_emit(minute, &batch[batch_len]);
+            batch_until = minute + TIER_MINUTE_S;
+            metrics_add(METRIC_COMPACT_RECORDS, records);
+        }
+    }
+
+    if (flush_batch(batch_day, batch_until) != 0) {
+        compact_pos = synced_pos;
+        batch_len = 0;
+        return -1;
+    }
+    return rc;
+}
+
+// ============================================================================
+// TOTALS
+// ============================================================================
+
+static sensor_info_t* totals_get(int32_t sensor_id) {
+    for (int i = 0; i < totals_count; i++) {
+        if (totals[i].sensor_id == sensor_id) return &totals[i];
+    }
+    if (totals_count == totals_cap) {
+        int cap = totals_cap ? totals_cap * 2 : 16;
+        sensor_info_t *p = realloc(totals, (size_t)cap * sizeof(*p));
+        if (!p) return NULL;
+        totals = p;
+        totals_cap = cap;
+    }
+    sensor_info_t *t = &totals[totals_count++];
+    memset(t, 0, sizeof(*t));
+    t->sensor_id = sensor_id;
+    return t;
+}
+
+// Adds the rows in [totals_until, until) to the totals
+static void totals_advance(time_t until) {
+    static tier_row_t rows[TIER_BATCH_ROWS];
+    tier_cursor_t c;
+    size_t n;
+    tier_cursor_open(&c, SENSOR_ID_ALL, totals_until, until);
+    while ((n = tier_cursor_next(&c, rows, TIER_BATCH_ROWS)) > 0) {
+        sensor_info_t *t = NULL;
+        for (size_t i = 0; i < n; i++) {
+            const tier_row_t *r = &rows[i];
+            if (!t || t->sensor_id != r->sensor_id) t = totals_get(r->sensor_id);
+            if (!t || r->count == 0) continue;
+            for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+                if (t->count == 0 || r->min[f] < t->min[f]) t->min[f] = r->min[f];
+                if (t->count == 0 || r->max[f] > t->max[f]) t->max[f] = r->max[f];
+                t->sum[f] += (double)r->avg[f] * r->count;
+            }
+            if (t->count == 0) t->first_seen = (time_t)r->start;
+            t->last_seen = (time_t)r->start;
+            t->count += r->count;
+        }
+    }
+    tier_cursor_close(&c);
+    if (until > totals_until) totals_until = until;
+}
+
+// Drops the compacted records from the store once enough have piled up
+static void maybe_trim(void) {
+    if (compact_pos <= store_first()) {
+        return;
+    }
+    size_t done = compact_pos - store_first();
+    size_t enough = store_size() / 4 > TIER_TRIM_RECORDS ? store_size() / 4 : TIER_TRIM_RECORDS;
+    time_t now = time(NULL);
+    if (done < enough && now - last_trim < TIER_TRIM_INTERVAL_S) {
+        return;
+    }
+    delete_data_before(raw_until);
+    last_trim = now;
+    pthread_mutex_lock(&tier_lock);
+    floor_ts = raw_until;
+    pthread_mutex_unlock(&tier_lock);
+    totals_advance(raw_until);
+}
+
+// ============================================================================
+// MINUTE -> HOUR
+// ============================================================================
+
+// Folds the oldest day segment into the hour file if it is older than
+// `cutoff` and entirely below the floor. Returns 1 if a day was folded.
+static int fold_day(time_t cutoff) {
+    pthread_mutex_lock(&tier_lock);
+    time_t day = seg_count ? seg_days[0] : 0;
+    int due = seg_count && day + TIER_DAY_S <= cutoff && day + TIER_DAY_S <= floor_ts;
+    pthread_mutex_unlock(&tier_lock);
+    if (!due || !budget_left()) {
+        return 0;
+    }
+    if (seg_fd >= 0 && seg_day == day) {
+        close(seg_fd);
+        seg_fd = -1;
+    }
+
+    char path[256];
+    segment_path(path, sizeof(path), day);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    tier_row_t *rows = NULL, *out = NULL;
+    size_t nrows = 0, nout = 0;
+    int ok = fd >= 0 && fstat(fd, &st) == 0;
+    if (ok) {
+        nrows = (size_t)st.st_size / sizeof(tier_row_t);
+        rows = malloc(nrows * sizeof(tier_row_t) + 1);
+        out = malloc(nrows * sizeof(tier_row_t) + 1);
+        ok = rows && out && (nrows == 0 || pread(fd, rows, nrows * sizeof(tier_row_t), 0) ==
+                                               (ssize_t)(nrows * sizeof(tier_row_t)));
+    }
+    if (fd >= 0) close(fd);
+    if (!ok) {
+        io_failed("segment read");
+        free(rows);
+        free(out);
+        return 0;
+    }
+
+    // Rows are in time order; below minute_until they were folded before
+    time_t hour = 0;
+    for (size_t i = 0; i < nrows && day >= minute_until; i++) {
+        const tier_row_t *r = &rows[i];
+        if (r->crc != row_crc(r)) continue;
+        time_t h = align_down((time_t)r->start, TIER_HOUR_S);
+        if (acc_count && h != hour) nout += (size_t)acc_emit(hour, &out[nout]);
+        hour = h;
+        tier_acc_t *a = acc_get(r->sensor_id);
+        if (!a) {
+            nout += (size_t)acc_emit(hour, &out[nout]);
+            a = acc_get(r->sensor_id);
+        }
+        acc_add_row(a, r);
+    }
+    if (acc_count) nout += (size_t)acc_emit(hour, &out[nout]);
+
+    size_t len = nout * sizeof(tier_row_t);
+    off_t before = lseek(hour_fd, 0, SEEK_END);
+    if (len && (write_full(hour_fd, out, len) < 0 || fdatasync(hour_fd) != 0)) {
+        io_failed("hour file");
+        if (before >= 0 && ftruncate(hour_fd, before) != 0) {
+            log_error("tier", strerror(errno));
+        }
+        free(rows);
+        free(out);
+        return 0;
+    }
+    free(rows);
+    free(out);
+    charge((size_t)st.st_size + len);
+
+    pthread_mutex_lock(&tier_lock);
+    minute_until = day + TIER_DAY_S;
+    memmove(seg_days, seg_days + 1, (size_t)--seg_count * sizeof(time_t));
+    unlink(path);
+    pthread_mutex_unlock(&tier_lock);
+    sync_tier_dir();
+    tier_bytes = tier_bytes + len > (uint64_t)st.st_size ? tier_bytes + len - (uint64_t)st.st_size : 0;
+    return 1;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+// Opens the tier files (creating TIER_DIR), repairs torn tails and derives
+// the watermarks from what is on disk and in the store. Called on startup
+// once the store is loaded, and after the store was replaced.
+int tier_open(void) {
+    tier_close();
+    if (mkdir(TIER_DIR, 0755) != 0 && errno != EEXIST) {
+        log_error("tier_open", strerror(errno));
+        return -1;
+    }
+
+    char path[256];
+    hour_path(path, sizeof(path));
+    hour_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    tier_row_t last;
+    off_t rows = hour_fd >= 0 ? repair_tail(hour_fd, &last) : -1;
+    if (rows < 0) {
+        log_error("tier_open", strerror(errno));
+        tier_close();
+        return -1;
+    }
+    time_t hours_until = rows ? align_down((time_t)last.start, TIER_DAY_S) + TIER_DAY_S : 0;
+    tier_bytes = (uint64_t)rows * sizeof(tier_row_t);
+
+    int count = 0;
+    DIR *dir = opendir(TIER_DIR);
+    struct dirent *de;
+    while (dir && (de = readdir(dir)) != NULL) {
+        unsigned long long day;
+        char tail[8];
+        if (sscanf(de->d_name, "minute-%16llx.%7s", &day, tail) != 2 || strcmp(tail, "tier") != 0) {
+            continue;
+        }
+        if ((time_t)day < hours_until) {
+            segment_path(path, sizeof(path), (time_t)day);
+            unlink(path);       // folded already, deleted by a step cut short
+            continue;
+        }
+        if (count < TIER_MAX_SEGMENTS) seg_days[count++] = (time_t)day;
+    }
+    if (dir) closedir(dir);
+    qsort(seg_days, (size_t)count, sizeof(time_t), cmp_day);
+
+    // The newest segment takes appends: its last whole row says how far
+    // the raw data is compacted
+    time_t until = hours_until;
+    while (count > 0) {
+        time_t day = seg_days[count - 1];
+        segment_path(path, sizeof(path), day);
+        int fd = open(path, O_RDWR | O_APPEND | O_CLOEXEC);
+        rows = fd >= 0 ? repair_tail(fd, &last) : -1;
+        if (rows > 0) {
+            seg_fd = fd;
+            seg_day = day;
+            until = (time_t)last.start + TIER_MINUTE_S;
+            break;
+        }
+        if (rows < 0) {
+            log_error("tier_open", strerror(errno));
+            if (fd >= 0) close(fd);
+            tier_close();
+            return -1;
+        }
+        close(fd);
+        unlink(path);       // nothing whole in it
+        count--;
+    }
+    for (int i = 0; i < count; i++) {
+        struct stat st;
+        segment_path(path, sizeof(path), seg_days[i]);
+        if (stat(path, &st) == 0) tier_bytes += (uint64_t)st.st_size;
+    }
+
+    // Raw records below raw_until that are still stored (a trim lost in a
+    // crash, or a restore) keep being read from the store
+    time_t floor = until;
+    if (store_size() > 0) {
+        time_t first = align_down(store_at(store_first())->timestamp, TIER_MINUTE_S);
+        if (first < floor) floor = first;
+    }
+
+    pthread_mutex_lock(&tier_lock);
+    seg_count = count;
+    minute_until = hours_until;
+    floor_ts = floor;
+    tier_ready = 1;
+    pthread_mutex_unlock(&tier_lock);
+
+    raw_until = until;
+    compact_pos = store_first();
+    tokens = 0;
+    refill_ms = now_ms();
+    last_trim = time(NULL);
+    paused_until = 0;
+    totals_count = 0;
+    totals_until = 0;
+    totals_advance(floor);
+    metrics_set(METRIC_TIER_BYTES, (int64_t)tier_bytes);
+    return 0;
+}
+
+void tier_close(void) {
+    pthread_mutex_lock(&tier_lock);
+    tier_ready = 0;
+    pthread_mutex_unlock(&tier_lock);
+    if (seg_fd >= 0) close(seg_fd);
+    if (hour_fd >= 0) close(hour_fd);
+    seg_fd = hour_fd = -1;
+    acc_count = batch_len = 0;
+    totals_count = 0;
+    totals_until = 0;
+}
+
+// Name of a tier file inside TIER_DIR, 0 if it is something else
+static int is_tier_file(const char *name) {
+    unsigned long long day;
+    char tail[8];
+    return strcmp(name, "hour.tier") == 0 ||
+           (sscanf(name, "minute-%16llx.%7s", &day, tail) == 2 && strcmp(tail, "tier") == 0);
+}
+
+// Closes the tiers and deletes every tier file (restore_data)
+void tier_discard(void) {
+    tier_close();
+    pthread_mutex_lock(&tier_lock);
+    DIR *dir = opendir(TIER_DIR);
+    struct dirent *de;
+    while (dir && (de = readdir(dir)) != NULL) {
+        if (is_tier_file(de->d_name)) {
+            char path[300];
+            snprintf(path, sizeof(path), "%s/%s", TIER_DIR, de->d_name);
+            unlink(path);
+        }
+    }
+    if (dir) closedir(dir);
+    seg_count = 0;
+    floor_ts = minute_until = 0;
+    pthread_mutex_unlock(&tier_lock);
+    sync_tier_dir();
+}
+
+// Deletes every tier file (clear_all_data) and starts over
+int tier_reset(void) {
+    tier_discard();
+    return tier_open();
+}
+
+// Called from the collection loop: compacts what has aged, within the
+// I/O budget
+void tier_tick(void) {
+    time_t now = time(NULL);
+    if (!tier_ready || system_config.tier_raw_days <= 0 || now < paused_until) {
+        return;
+    }
+    tick_bytes = 0;
+    time_t raw_age = (time_t)system_config.tier_raw_days * TIER_DAY_S;
+    time_t minute_age = (time_t)system_config.tier_minute_days * TIER_DAY_S;
+    if (minute_age < raw_age) minute_age = raw_age;
+
+    int rc = compact_minutes(align_down(now - raw_age, TIER_MINUTE_S));
+    if (rc < 0) {
+        return;
+    }
+    maybe_trim();
+    if (rc == 1) {
+        fold_day(align_down(now - minute_age, TIER_DAY_S));
+    }
+    metrics_set(METRIC_TIER_BYTES, (int64_t)tier_bytes);
+}
+
+// Timestamp below which records are read from the tiers (any thread)
+time_t tier_floor(void) {
+    pthread_mutex_lock(&tier_lock);
+    time_t t = tier_ready ? floor_ts : 0;
+    pthread_mutex_unlock(&tier_lock);
+    return t;
+}
+
+static const char* day_text(char *buf, size_t size, time_t t) {
+    struct tm tm_ts;
+    localtime_r(&t, &tm_ts);
+    strftime(buf, size, "%Y-%m-%d %H:%M", &tm_ts);
+    return buf;
+}
+
+void tier_print_status(void) {
+    char buf[32];
+    pthread_mutex_lock(&tier_lock);
+    time_t floor = floor_ts, until = minute_until, oldest_day = seg_count ? seg_days[0] : 0;
+    int segments = seg_count;
+    pthread_mutex_unlock(&tier_lock);
+
+    printf("Raw samples:      %zu records", store_size());
+    printf(floor > 0 ? ", from %s\n" : "\n", day_text(buf, sizeof(buf), floor));
+    printf("Per-minute rows:  %d day segments", segments);
+    printf(segments > 0 ? ", from %s\n" : "\n",
+           day_text(buf, sizeof(buf), oldest_day > until ? oldest_day : until));
+    printf("Per-hour rows:    %s", until > 0 ? "up to " : "none\n");
+    if (until > 0) printf("%s\n", day_text(buf, sizeof(buf), until));
+    printf("Tier files:       %.1f KiB\n", (double)tier_bytes / 1024);
+    printf("Kept raw %d days, per minute %d days, per hour after that\n",
+           system_config.tier_raw_days, system_config.tier_minute_days);
+    if (system_config.tier_raw_days <= 0) {
+        printf("Compaction is off\n");
+    } else if (system_config.compact_kbps > 0) {
+        printf("Compaction budget: %d KiB/s\n", system_config.compact_kbps);
+    } else {
+        printf("Compaction budget: unlimited\n");
+    }
+}
+
+// ============================================================================
+// READING
+// ============================================================================
+
+// Rows of `sensor_id` (or SENSOR_ID_ALL) with start in [from, to), in
+// time order, up to the floor. A reader merges rows with the same start
+// and sensor.
+int tier_cursor_open(tier_cursor_t *c, int sensor_id, time_t from, time_t to) {
+    c->sensor_id = sensor_id;
+    c->next = from;
+    c->to = to;
+    c->fd = -1;
+    c->pos = c->end = 0;
+    c->limit = from;
+    return 0;
+}
+
+// First row in fd with start >= t
+static off_t lower_bound(int fd, off_t rows, time_t t) {
+    off_t lo = 0, hi = rows;
+    while (lo < hi) {
+        off_t mid = lo + (hi - lo) / 2;
+        int64_t start;
+        if (pread(fd, &start, sizeof(start), mid * (off_t)sizeof(tier_row_t)) != (ssize_t)sizeof(start)) {
+            return lo;
+        }
+        if (start < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Opens the file holding the rows from c->next on. Returns -1 when there is
+// nothing left; c->fd stays -1 if that stretch has no file.
+static int cursor_advance(tier_cursor_t *c) {
+    char path[256];
+    pthread_mutex_lock(&tier_lock);
+    time_t stop = c->to < floor_ts ? c->to : floor_ts;
+    if (!tier_ready || c->next >= stop) {
+        pthread_mutex_unlock(&tier_lock);
+        return -1;
+    }
+    if (c->next < minute_until) {
+        // Re-read on every advance: a day folded meanwhile is found here
+        hour_path(path, sizeof(path));
+        c->limit = minute_until < stop ? minute_until : stop;
+    } else {
+        int i = 0;
+        while (i < seg_count && seg_days[i] + TIER_DAY_S <= c->next) i++;
+        if (i == seg_count || seg_days[i] >= stop) {
+            c->next = stop;
+            pthread_mutex_unlock(&tier_lock);
+            return -1;
+        }
+        if (seg_days[i] > c->next) c->next = seg_days[i];
+        segment_path(path, sizeof(path), seg_days[i]);
+        c->limit = seg_days[i] + TIER_DAY_S < stop ? seg_days[i] + TIER_DAY_S : stop;
+    }
+    c->fd = open(path, O_RDONLY | O_CLOEXEC);     // under the lock: not deleted yet
+    pthread_mutex_unlock(&tier_lock);
+
+    struct stat st;
+    if (c->fd < 0 || fstat(c->fd, &st) != 0) {
+        tier_cursor_close(c);
+        c->next = c->limit;
+        return 0;
+    }
+    off_t rows = st.st_size / (off_t)sizeof(tier_row_t);
+    c->pos = lower_bound(c->fd, rows, c->next) * (off_t)sizeof(tier_row_t);
+    c->end = rows * (off_t)sizeof(tier_row_t);
+    return 0;
+}
+
+// Reads up to `max` rows. Returns 0 at the end.
+size_t tier_cursor_next(tier_cursor_t *c, tier_row_t *rows, size_t max) {
+    for (;;) {
+        if (c->fd < 0) {
+            if (cursor_advance(c) < 0) return 0;
+            if (c->fd < 0) continue;
+        }
+        size_t want = (size_t)(c->end - c->pos) / sizeof(tier_row_t);
+        if (want > max) want = max;
+        ssize_t got = want ? pread(c->fd, rows, want * sizeof(tier_row_t), c->pos) : 0;
+        if (got <= 0) {
+            tier_cursor_close(c);
+            c->next = c->limit;
+            continue;
+        }
+        size_t n = (size_t)got / sizeof(tier_row_t), out = 0;
+        c->pos += (off_t)(n * sizeof(tier_row_t));
+        for (size_t i = 0; i < n; i++) {
+            const tier_row_t *r = &rows[i];
+            if (r->start >= c->limit) {
+                c->pos = c->end;
+                break;
+            }
+            if (r->start < c->next || r->crc != row_crc(r) ||
+                (c->sensor_id != SENSOR_ID_ALL && r->sensor_id != c->sensor_id)) {
+                continue;
+            }
+            rows[out++] = *r;
+        }
+        if (out > 0) {
+            return out;
+        }
+    }
+}
+
+void tier_cursor_close(tier_cursor_t *c) {
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+}
+
+// Totals of the rows below the floor for sensor_id (or SENSOR_ID_ALL),
+// in sensor_info_t form. Ingest thread. Returns the sample count.
+unsigned long tier_totals(int sensor_id, sensor_info_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->sensor_id = sensor_id;
+    for (int i = 0; i < totals_count; i++) {
+        const sensor_info_t *t = &totals[i];
+        if (t->count == 0 || (sensor_id != SENSOR_ID_ALL && t->sensor_id != sensor_id)) {
+            continue;
+        }
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+            if (out->count == 0 || t->min[f] < out->min[f]) out->min[f] = t->min[f];
+            if (out->count == 0 || t->max[f] > out->max[f]) out->max[f] = t->max[f];
+            out->sum[f] += t->sum[f];
+        }
+        if (out->count == 0 || t->first_seen < out->first_seen) out->first_seen = t->first_seen;
+        if (t->last_seen > out->last_seen) out->last_seen = t->last_seen;
+        out->count += t->count;
+    }
+    return out->count;
+}
+
+// ============================================================================
+// FILE ACCESS (backups)
+// ============================================================================
+
+// Opens every tier file read-only (any thread). Under tier_lock, so a day
+// being folded is in its minute segment, the hour file or both (tier_open
+// drops the duplicate). *files is malloc'd; returns the count, -1 on error.
+int tier_open_files(tier_file_t **files) {
+    int count = 0, cap = 0, rc = 0;
+    *files = NULL;
+    pthread_mutex_lock(&tier_lock);
+    DIR *dir = opendir(TIER_DIR);
+    struct dirent *de;
+    while (dir && (de = readdir(dir)) != NULL) {
+        if (!is_tier_file(de->d_name)) {
+            continue;
+        }
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            tier_file_t *p = realloc(*files, (size_t)cap * sizeof(*p));
+            if (!p) {
+                rc = -1;
+                break;
+            }
+            *files = p;
+        }
+        tier_file_t *f = &(*files)[count];
+        char path[300];
+        snprintf(f->name, sizeof(f->name), "%.31s", de->d_name);     // is_tier_file: at most 28
+        snprintf(path, sizeof(path), "%s/%s", TIER_DIR, de->d_name);
+        f->fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (f->fd < 0) {
+            rc = -1;
+            break;
+        }
+        count++;
+    }
+    if (dir) closedir(dir);
+    pthread_mutex_unlock(&tier_lock);
+    if (rc != 0) {
+        for (int i = 0; i < count; i++) close((*files)[i].fd);
+        free(*files);
+        *files = NULL;
+        return -1;
+    }
+    return count;
+}
+
+// CRC of the row at offset, -1 if there is no whole row there
+int tier_row_crc_at(int fd, off_t offset, uint32_t *crc) {
+    tier_row_t r;
+    if (pread(fd, &r, sizeof(r), offset) != (ssize_t)sizeof(r) || r.crc != row_crc(&r)) {
+        return -1;
+    }
+    *crc = r.crc;
+    return 0;
+}
+
+// End of the last whole row; *tail/*tail_crc get the offset and CRC of that
+// row (unchanged if the file holds none)
+off_t tier_file_extent(int fd, off_t *tail, uint32_t *tail_crc) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    off_t end = st.st_size / (off_t)sizeof(tier_row_t) * (off_t)sizeof(tier_row_t);
+    if (end > 0 && tier_row_crc_at(fd, end - (off_t)sizeof(tier_row_t), tail_crc) == 0) {
+        *tail = end - (off_t)sizeof(tier_row_t);
+    }
+    return end;
+}
@@ -0,0 +1,90 @@
+#include "system.h"
+#include "metrics.h"
+
+// ============================================================================
+// STAGE LATENCY TRACING
+// ============================================================================
+//
+// Every sample from a collector carries CLOCK_MONOTONIC stamps (SensorData
+// t_read, t_parse, t_write); the supervisor adds the time it read the pipe
+// and the reorder buffer the time the sample reached the store. The clock
+// is shared by all processes on the host, so the stamps line up:
+//
+//   read → parse → write → receive → commit
+//
+// Each interval goes into its own histogram (stage_*_seconds), plus
+// read → commit as stage_total_seconds. Collector-side intervals are
+// recorded on receipt, the others on commit; receive → commit includes the
+// wait in the reorder buffer, which is normally the largest part.
+//
+// With trace_sample_every = N > 0, one in N committed samples is also
+// written to TRACE_FILE as one line:
+//
+//   2025-10-14 20:00:00.123456789 sensor 3 parse 12.4 write 0.3 pipe 85.1 ingest 2000131.7 total 2000229.5
+//
+// (sample time, then microseconds per stage). The file is opened on the
+// first traced sample and line-buffered.
+
+static FILE *trace_fp = NULL;
+static unsigned long trace_counter = 0;
+
+static inline uint64_t stage(uint64_t from, uint64_t to) {
+    return to > from ? to - from : 0;
+}
+
+// Collector-side stages, on receipt by the supervisor. A sample without
+// stamps (t_read 0) is not counted.
+void trace_received(const sample_trace_t *t) {
+    if (!t->read_ns) {
+        return;
+    }
+    metrics_observe(METRIC_STAGE_PARSE_NS, stage(t->read_ns, t->parse_ns));
+    metrics_observe(METRIC_STAGE_WRITE_NS, stage(t->parse_ns, t->write_ns));
+    metrics_observe(METRIC_STAGE_PIPE_NS, stage(t->write_ns, t->receive_ns));
+}
+
+static void trace_write(const sensor_data_t *rec, const sample_trace_t *t) {
+    if (!trace_fp) {
+        trace_fp = fopen(TRACE_FILE, "a");
+        if (!trace_fp) {
+            log_error("trace", strerror(errno));
+            system_config.trace_sample_every = 0;
+            return;
+        }
+        setvbuf(trace_fp, NULL, _IOLBF, 0);
+    }
+    char when[32];
+    struct tm tm_ts;
+    localtime_r(&rec->timestamp, &tm_ts);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm_ts);
+    fprintf(trace_fp, "%s.%09d sensor %d parse %.1f write %.1f pipe %.1f ingest %.1f total %.1f\n",
+            when, rec->timestamp_ns, rec->sensor_id,
+            (double)stage(t->read_ns, t->parse_ns) / 1e3,
+            (double)stage(t->parse_ns, t->write_ns) / 1e3,
+            (double)stage(t->write_ns, t->receive_ns) / 1e3,
+            (double)stage(t->receive_ns, t->commit_ns) / 1e3,
+            (double)stage(t->read_ns, t->commit_ns) / 1e3);
+}
+
+// Store-side stages, once the record is in the store
+void trace_committed(const sensor_data_t *rec, const sample_trace_t *t) {
+    if (!t->receive_ns) {
+        return;
+    }
+    metrics_observe(METRIC_STAGE_INGEST_NS, stage(t->receive_ns, t->commit_ns));
+    if (t->read_ns) {
+        metrics_observe(METRIC_STAGE_TOTAL_NS, stage(t->read_ns, t->commit_ns));
+    }
+
+    int every = system_config.trace_sample_every;
+    if (every > 0 && ++trace_counter % (unsigned long)every == 0) {
+        trace_write(rec, t);
+    }
+}
+
+void trace_close(void) {
+    if (trace_fp) {
+        fclose(trace_fp);
+        trace_fp = NULL;
+    }
+}
@@ -0,0 +1,61 @@
+/* ui_adapt.h — Kiểu dữ liệu trung gian cho UI generic
+ * UI không phụ thuộc struct cụ thể của từng nhóm. Có hai cách mô tả buffer:
+ *
+ *   - UIItemExtractor: hàm đổi phần tử thứ i sang UIItem. Linh hoạt nhất
+ *     nhưng tốn một lời gọi gián tiếp cho mỗi phần tử.
+ *   - UILayout: mô tả stride/offset/kiểu của từng trường. UI đọc thẳng từ
+ *     buffer trong vòng lặp, không gọi hàm nào cho từng phần tử; với kiểu
+ *     float/int thông thường tốc độ ngang vòng lặp viết tay.
+ *
+ * Ví dụ:
+ *   static const UILayout my_layout = UI_LAYOUT(struct MyRow,
+ *       UI_FIELD(struct MyRow, when, UI_FIELD_TIME_T),
+ *       UI_FIELD(struct MyRow, temp, UI_FIELD_FLOAT),
+ *       UI_FIELD(struct MyRow, hum,  UI_FIELD_FLOAT),
+ *       UI_NO_FIELD);
+ */
+#ifndef UI_ADAPT_H
+#define UI_ADAPT_H
+
+#include <stddef.h>
+#include <time.h>
+
+/* Một mẫu dữ liệu theo góc nhìn của UI */
+typedef struct {
+    time_t ts;
+    float  temperature;
+    float  humidity;
+    int    gas_ppm;
+} UIItem;
+
+/* Đọc phần tử thứ i của buf vào *out. Trả về 0 nếu OK, âm nếu lỗi. */
+typedef int (*UIItemExtractor)(const void *buf, size_t i, UIItem *out);
+
+/* Kiểu lưu trữ của một trường trong struct nguồn */
+typedef enum {
+    UI_FIELD_NONE = 0,      /* không có trường này → 0 */
+    UI_FIELD_FLOAT,
+    UI_FIELD_DOUBLE,
+    UI_FIELD_INT,
+    UI_FIELD_TIME_T,
+    UI_FIELD_CTIME          /* chuỗi dạng ctime(): "Mon Jan  1 00:00:00 2024" */
+} UIFieldType;
+
+typedef struct {
+    UIFieldType type;
+    size_t      offset;
+} UIField;
+
+typedef struct {
+    size_t  stride;         /* sizeof(một phần tử) */
+    UIField ts;
+    UIField temperature;
+    UIField humidity;
+    UIField gas_ppm;
+} UILayout;
+
+#define UI_FIELD(type, member, kind)    { (kind), offsetof(type, member) }
+#define UI_NO_FIELD                     { UI_FIELD_NONE, 0 }
+#define UI_LAYOUT(type, ts, t, h, g)    { sizeof(type), ts, t, h, g }
+
+#endif
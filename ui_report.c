@@ -3,8 +3,14 @@
  * 
  * Cung cấp giao diện dạng ASCII hiển thị dữ liệu cảm biến, 
  * cảnh báo, biểu đồ và xuất báo cáo ra file report.txt
+ *
+ * Mọi hàm in đều viết một lần trên ui_src_t: hoặc UILayout (đọc trực tiếp
+ * theo stride/offset), hoặc UIItemExtractor (gọi hàm cho từng phần tử).
+ * Các hàm cho SensorData / sensor_data_t chỉ là UILayout dựng sẵn.
  */
 
+#define _GNU_SOURCE             /* strptime cho UI_FIELD_CTIME */
+#define UI_HAVE_SYSTEM_SENSOR
 #include "ui_report.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,8 +45,179 @@ void ui_print_menu(FILE *out){
         c(C_BOLD), c(C_RESET));
 }
 
-/* In bảng dữ liệu gần nhất */
-void ui_print_table(FILE *out, const SensorData *data, size_t n){
+/* =====================================
+ * NGUỒN DỮ LIỆU: UILayout hoặc UIItemExtractor
+ * ===================================== */
+
+const UILayout ui_layout_sensordata = UI_LAYOUT(SensorData,
+    UI_FIELD(SensorData, ts, UI_FIELD_TIME_T),
+    UI_FIELD(SensorData, temperature, UI_FIELD_FLOAT),
+    UI_FIELD(SensorData, humidity, UI_FIELD_FLOAT),
+    UI_FIELD(SensorData, gas_ppm, UI_FIELD_INT));
+
+const UILayout ui_layout_record = UI_LAYOUT(sensor_data_t,
+    UI_FIELD(sensor_data_t, timestamp, UI_FIELD_TIME_T),
+    UI_FIELD(sensor_data_t, temperature, UI_FIELD_FLOAT),
+    UI_FIELD(sensor_data_t, humidity, UI_FIELD_FLOAT),
+    UI_FIELD(sensor_data_t, gas_level, UI_FIELD_FLOAT));
+
+typedef struct {
+    const void      *buf;
+    const UILayout  *lay;       /* != NULL → đường nhanh */
+    UIItemExtractor  ex;
+} ui_src_t;
+
+/* Trường cần đọc; đường layout bỏ qua các trường không dùng */
+#define UI_M_TS     1u
+#define UI_M_TEMP   2u
+#define UI_M_HUM    4u
+#define UI_M_GAS    8u
+#define UI_M_ALL    (UI_M_TS | UI_M_TEMP | UI_M_HUM | UI_M_GAS)
+
+/* memcpy: struct nguồn có thể packed / không căn chỉnh */
+static inline double load_num(const unsigned char *p, UIFieldType type){
+    switch(type){
+        case UI_FIELD_FLOAT:  { float v;  memcpy(&v, p, sizeof v); return v; }
+        case UI_FIELD_DOUBLE: { double v; memcpy(&v, p, sizeof v); return v; }
+        case UI_FIELD_INT:    { int v;    memcpy(&v, p, sizeof v); return v; }
+        case UI_FIELD_TIME_T: { time_t v; memcpy(&v, p, sizeof v); return (double)v; }
+        default:              return 0.0;
+    }
+}
+
+static inline int round_int(double v){ return (int)(v < 0 ? v - 0.5 : v + 0.5); }
+
+static inline float load_float(const unsigned char *p, UIFieldType type){
+    if(type == UI_FIELD_FLOAT){ float v; memcpy(&v, p, sizeof v); return v; }
+    return (float)load_num(p, type);
+}
+
+static inline int load_int(const unsigned char *p, UIFieldType type){
+    if(type == UI_FIELD_INT){ int v; memcpy(&v, p, sizeof v); return v; }
+    return round_int(load_num(p, type));
+}
+
+static time_t load_time(const unsigned char *row, UIField f){
+    if(f.type == UI_FIELD_TIME_T){
+        time_t v;
+        memcpy(&v, row + f.offset, sizeof v);
+        return v;
+    }
+    if(f.type == UI_FIELD_CTIME){
+        struct tm tmv;
+        memset(&tmv, 0, sizeof(tmv));
+        tmv.tm_isdst = -1;
+        if(!strptime((const char*)(row + f.offset), "%a %b %d %H:%M:%S %Y", &tmv)) return 0;
+        return mktime(&tmv);
+    }
+    return (time_t)load_num(row + f.offset, f.type);
+}
+
+/* Đọc phần tử i; trả về âm nếu extractor báo lỗi (phần tử bị bỏ qua) */
+static inline int src_get(const ui_src_t *s, size_t i, UIItem *it, unsigned mask){
+    if(!s->lay) return s->ex(s->buf, i, it);
+
+    const UILayout *L = s->lay;
+    const unsigned char *row = (const unsigned char*)s->buf + i * L->stride;
+    if(mask & UI_M_TS)   it->ts = load_time(row, L->ts);
+    if(mask & UI_M_TEMP) it->temperature = load_float(row + L->temperature.offset, L->temperature.type);
+    if(mask & UI_M_HUM)  it->humidity = load_float(row + L->humidity.offset, L->humidity.type);
+    if(mask & UI_M_GAS)  it->gas_ppm = load_int(row + L->gas_ppm.offset, L->gas_ppm.type);
+    return 0;
+}
+
+
+/* =====================================
+ * THỐNG KÊ (đường nóng)
+ * ===================================== */
+
+typedef struct {
+    float t_min, t_max, h_min, h_max;
+    int g_min, g_max;
+    double t_sum, h_sum, g_sum;
+    size_t n;
+} ui_acc_t;
+
+static void acc_init(ui_acc_t *a){
+    a->t_min = a->h_min = 1e30f;
+    a->t_max = a->h_max = -1e30f;
+    a->g_min = 0x7fffffff;
+    a->g_max = -0x7fffffff - 1;
+    a->t_sum = a->h_sum = a->g_sum = 0.0;
+    a->n = 0;
+}
+
+static inline void acc_add(ui_acc_t *a, float t, float h, int g){
+    if(t < a->t_min) a->t_min = t;
+    if(t > a->t_max) a->t_max = t;
+    if(h < a->h_min) a->h_min = h;
+    if(h > a->h_max) a->h_max = h;
+    if(g < a->g_min) a->g_min = g;
+    if(g > a->g_max) a->g_max = g;
+    a->t_sum += t;
+    a->h_sum += h;
+    a->g_sum += g;
+    a->n++;
+}
+
+static void acc_finish(const ui_acc_t *a, UIStats *st){
+    memset(st, 0, sizeof(*st));
+    if(a->n == 0) return;
+    st->t_min = a->t_min; st->t_max = a->t_max; st->t_avg = (float)(a->t_sum / a->n);
+    st->h_min = a->h_min; st->h_max = a->h_max; st->h_avg = (float)(a->h_sum / a->n);
+    st->g_min = a->g_min; st->g_max = a->g_max; st->g_avg = a->g_sum / a->n;
+}
+
+/* Kiểu trường là hằng số tại mỗi chỗ gọi → switch trong load_* bị gập,
+ * vòng lặp còn lại chỉ là load + so sánh như viết tay. Bộ tích lũy là bản
+ * sao cục bộ: đọc qua unsigned char* có thể alias *a, nếu ghi thẳng vào *a
+ * compiler phải store/load lại mọi trường ở mỗi vòng. */
+static inline __attribute__((always_inline))
+void acc_layout(ui_acc_t *a, const unsigned char *p, size_t n, const UILayout *L,
+                UIFieldType tt, UIFieldType ht, UIFieldType gt){
+    const size_t stride = L->stride;
+    const size_t to = L->temperature.offset, ho = L->humidity.offset, go = L->gas_ppm.offset;
+    ui_acc_t acc = *a;
+    for(size_t i = 0; i < n; i++, p += stride){
+        acc_add(&acc, load_float(p + to, tt), load_float(p + ho, ht), load_int(p + go, gt));
+    }
+    *a = acc;
+}
+
+static void acc_source(ui_acc_t *a, const ui_src_t *s, size_t n){
+    const UILayout *L = s->lay;
+    if(L){
+        const unsigned char *p = s->buf;
+        UIFieldType tt = L->temperature.type, ht = L->humidity.type, gt = L->gas_ppm.type;
+        if(tt == UI_FIELD_FLOAT && ht == UI_FIELD_FLOAT && gt == UI_FIELD_INT)
+            acc_layout(a, p, n, L, UI_FIELD_FLOAT, UI_FIELD_FLOAT, UI_FIELD_INT);
+        else if(tt == UI_FIELD_FLOAT && ht == UI_FIELD_FLOAT && gt == UI_FIELD_FLOAT)
+            acc_layout(a, p, n, L, UI_FIELD_FLOAT, UI_FIELD_FLOAT, UI_FIELD_FLOAT);
+        else if(tt == UI_FIELD_FLOAT && ht == UI_FIELD_FLOAT && gt == UI_FIELD_NONE)
+            acc_layout(a, p, n, L, UI_FIELD_FLOAT, UI_FIELD_FLOAT, UI_FIELD_NONE);
+        else
+            acc_layout(a, p, n, L, tt, ht, gt);     /* kiểu hiếm: switch lúc chạy */
+        return;
+    }
+    UIItem it;
+    for(size_t i = 0; i < n; i++){
+        if(s->ex(s->buf, i, &it) == 0) acc_add(a, it.temperature, it.humidity, it.gas_ppm);
+    }
+}
+
+static void compute_stats(const ui_src_t *s, size_t n, UIStats *st){
+    ui_acc_t a;
+    acc_init(&a);
+    acc_source(&a, s, n);
+    acc_finish(&a, st);
+}
+
+
+/* =====================================
+ * HIỂN THỊ
+ * ===================================== */
+
+static void print_table(FILE *out, const ui_src_t *s, size_t n){
     if(n == 0){ fprintf(out, "(No data)\n"); return; }
 
     fprintf(out, "%s%-19s  %7s  %8s  %7s%s\n",
@@ -48,33 +225,41 @@ void ui_print_table(FILE *out, const SensorData *data, size_t n){
     fprintf(out, "-------------------  -------  --------  -------\n");
 
     size_t start = (n > 20) ? n - 20 : 0;  // chỉ in 20 dòng cuối
-    char buf[32];
+    char buf[32] = "";
+    time_t cached = (time_t)-1;             // mẫu cùng giây → khỏi gọi localtime lại
     for(size_t i = start; i < n; i++){
-        struct tm *tmv = localtime(&data[i].ts);
-        strftime(buf, sizeof(buf), "%H:%M:%S", tmv);
+        UIItem it;
+        if(src_get(s, i, &it, UI_M_ALL) < 0) continue;
+        if(it.ts != cached){
+            struct tm tmv;
+            localtime_r(&it.ts, &tmv);
+            strftime(buf, sizeof(buf), "%H:%M:%S", &tmv);
+            cached = it.ts;
+        }
         fprintf(out, "%-19s  %7.2f  %8.2f  %7d\n",
-            buf, data[i].temperature, data[i].humidity, data[i].gas_ppm);
+            buf, it.temperature, it.humidity, it.gas_ppm);
     }
 }
 
-/* Kiểm tra và in cảnh báo vượt ngưỡng */
-int ui_print_alert(FILE *out, const SensorData *last, Thresholds th){
-    if(!last) return 0;
+static int print_alert(FILE *out, const ui_src_t *s, size_t n, UIThresholds th){
+    if(n == 0) return 0;
+    UIItem last;
+    if(src_get(s, n-1, &last, UI_M_TEMP | UI_M_HUM | UI_M_GAS) < 0) return 0;
     int alert = 0;
 
-    if(last->temperature > th.temp_hi){
+    if(last.temperature > th.temp_hi){
         fprintf(out, "%s[ALERT]%s Nhiệt độ cao: %.2f > %.2f°C\n",
-                c(C_RED), c(C_RESET), last->temperature, th.temp_hi);
+                c(C_RED), c(C_RESET), last.temperature, th.temp_hi);
         alert = 1;
     }
-    if(last->humidity > th.humid_hi){
+    if(last.humidity > th.humid_hi){
         fprintf(out, "%s[ALERT]%s Độ ẩm cao: %.2f > %.2f%%\n",
-                c(C_RED), c(C_RESET), last->humidity, th.humid_hi);
+                c(C_RED), c(C_RESET), last.humidity, th.humid_hi);
         alert = 1;
     }
-    if(last->gas_ppm > th.gas_hi){
+    if(last.gas_ppm > th.gas_hi){
         fprintf(out, "%s[ALERT]%s Nồng độ khí gas cao: %d > %d ppm\n",
-                c(C_RED), c(C_RESET), last->gas_ppm, th.gas_hi);
+                c(C_RED), c(C_RESET), last.gas_ppm, th.gas_hi);
         alert = 1;
     }
 
@@ -84,39 +269,45 @@ int ui_print_alert(FILE *out, const SensorData *last, Thresholds th){
     return alert;
 }
 
-/* Vẽ biểu đồ ASCII cho nhiệt độ và độ ẩm */
-void ui_chart_temp_humid(FILE *out, const SensorData *data, size_t n){
+static void chart_temp_humid(FILE *out, const ui_src_t *s, size_t n){
     if(n == 0){ fprintf(out, "(No data to chart)\n"); return; }
 
-    // tìm giá trị lớn nhất để scale
+    // tìm giá trị lớn nhất để scale (dùng chung vòng thống kê)
+    ui_acc_t a;
+    acc_init(&a);
+    acc_source(&a, s, n);
     float maxv = 1.0f;
-    for(size_t i=0;i<n;i++){
-        if(data[i].temperature > maxv) maxv = data[i].temperature;
-        if(data[i].humidity > maxv)    maxv = data[i].humidity;
-    }
+    if(a.n && a.t_max > maxv) maxv = a.t_max;
+    if(a.n && a.h_max > maxv) maxv = a.h_max;
 
     fprintf(out, "%s[Biểu đồ ASCII]%s (max=%.2f)\n",
             c(C_BOLD), c(C_RESET), maxv);
 
     size_t start = (n > 20) ? n - 20 : 0;
     for(size_t i = start; i < n; i++){
-        int tlen = (int)((data[i].temperature / maxv) * CHART_W);
-        int hlen = (int)((data[i].humidity / maxv) * CHART_W);
+        UIItem it;
+        if(src_get(s, i, &it, UI_M_TEMP | UI_M_HUM) < 0) continue;
+        int tlen = (int)((it.temperature / maxv) * CHART_W);
+        int hlen = (int)((it.humidity / maxv) * CHART_W);
 
         fprintf(out, "T%02zu ", i);
         for(int k=0;k<tlen;k++) fputc('#', out);
-        fprintf(out, " (%.1f°C)\n", data[i].temperature);
+        fprintf(out, " (%.1f°C)\n", it.temperature);
 
         fprintf(out, "H%02zu ", i);
         for(int k=0;k<hlen;k++) fputc('*', out);
-        fprintf(out, " (%.1f%%)\n", data[i].humidity);
+        fprintf(out, " (%.1f%%)\n", it.humidity);
     }
 }
 
-/* Xuất báo cáo ra file report.txt */
-int ui_write_report(FILE *out, const SensorData *data, size_t n,
-                    const Stats *st, Thresholds th){
-    if(!out || !st) return -1;
+static int write_report(FILE *out, const ui_src_t *s, size_t n,
+                        const UIStats *st, UIThresholds th){
+    if(!out) return -1;
+    UIStats own;
+    if(!st){
+        compute_stats(s, n, &own);
+        st = &own;
+    }
 
     fprintf(out, "=== Sensor Report ===\n");
     fprintf(out, "Samples: %zu\n\n", n);
@@ -127,15 +318,84 @@ int ui_write_report(FILE *out, const SensorData *data, size_t n,
             st->h_min, st->h_avg, st->h_max);
     fprintf(out, "Gas (ppm):         min %d   | avg %.1f | max %d\n",
             st->g_min, st->g_avg, st->g_max);
+    if(st->has_pct){
+        fprintf(out, "Temperature P50/P95/P99: %.2f / %.2f / %.2f\n",
+                st->t_p50, st->t_p95, st->t_p99);
+        fprintf(out, "Gas P50/P95/P99:         %.1f / %.1f / %.1f\n",
+                st->g_p50, st->g_p95, st->g_p99);
+    }
 
     fprintf(out, "\nThresholds: T>%.2f, H>%.2f, G>%d\n",
             th.temp_hi, th.humid_hi, th.gas_hi);
 
-    if(n > 0){
-        const SensorData *last = &data[n-1];
+    UIItem last;
+    if(n > 0 && src_get(s, n-1, &last, UI_M_TEMP | UI_M_HUM | UI_M_GAS) == 0){
         fprintf(out, "Last sample: T=%.2f°C, H=%.2f%%, G=%d ppm\n",
-                last->temperature, last->humidity, last->gas_ppm);
+                last.temperature, last.humidity, last.gas_ppm);
     }
     fprintf(out, "\n(End of report)\n");
     return 0;
 }
+
+
+/* =====================================
+ * API: extractor / layout / SensorData
+ * ===================================== */
+
+#define SRC_EX(b, e)    { (b), NULL, (e) }
+#define SRC_LAY(b, l)   { (b), (l), NULL }
+
+void ui_print_table_g(FILE *out, const void *buf, size_t n, UIItemExtractor ex){
+    ui_src_t s = SRC_EX(buf, ex); print_table(out, &s, n);
+}
+int ui_print_alert_g(FILE *out, const void *buf, size_t n, UIItemExtractor ex, UIThresholds th){
+    ui_src_t s = SRC_EX(buf, ex); return print_alert(out, &s, n, th);
+}
+void ui_chart_temp_humid_g(FILE *out, const void *buf, size_t n, UIItemExtractor ex){
+    ui_src_t s = SRC_EX(buf, ex); chart_temp_humid(out, &s, n);
+}
+int ui_write_report_g(FILE *out, const void *buf, size_t n, UIItemExtractor ex,
+                      const UIStats *st, UIThresholds th){
+    ui_src_t s = SRC_EX(buf, ex); return write_report(out, &s, n, st, th);
+}
+void ui_compute_stats_g(const void *buf, size_t n, UIItemExtractor ex, UIStats *st){
+    ui_src_t s = SRC_EX(buf, ex); compute_stats(&s, n, st);
+}
+
+void ui_print_table_l(FILE *out, const void *buf, size_t n, const UILayout *lay){
+    ui_src_t s = SRC_LAY(buf, lay); print_table(out, &s, n);
+}
+int ui_print_alert_l(FILE *out, const void *buf, size_t n, const UILayout *lay, UIThresholds th){
+    ui_src_t s = SRC_LAY(buf, lay); return print_alert(out, &s, n, th);
+}
+void ui_chart_temp_humid_l(FILE *out, const void *buf, size_t n, const UILayout *lay){
+    ui_src_t s = SRC_LAY(buf, lay); chart_temp_humid(out, &s, n);
+}
+int ui_write_report_l(FILE *out, const void *buf, size_t n, const UILayout *lay,
+                      const UIStats *st, UIThresholds th){
+    ui_src_t s = SRC_LAY(buf, lay); return write_report(out, &s, n, st, th);
+}
+void ui_compute_stats_l(const void *buf, size_t n, const UILayout *lay, UIStats *st){
+    ui_src_t s = SRC_LAY(buf, lay); compute_stats(&s, n, st);
+}
+
+/* In bảng dữ liệu gần nhất */
+void ui_print_table(FILE *out, const SensorData *data, size_t n){
+    ui_print_table_l(out, data, n, &ui_layout_sensordata);
+}
+
+/* Kiểm tra và in cảnh báo vượt ngưỡng */
+int ui_print_alert(FILE *out, const SensorData *data, size_t n, UIThresholds th){
+    return ui_print_alert_l(out, data, n, &ui_layout_sensordata, th);
+}
+
+/* Vẽ biểu đồ ASCII cho nhiệt độ và độ ẩm */
+void ui_chart_temp_humid(FILE *out, const SensorData *data, size_t n){
+    ui_chart_temp_humid_l(out, data, n, &ui_layout_sensordata);
+}
+
+/* Xuất báo cáo ra file report.txt (st == NULL → tự tính) */
+int ui_write_report(FILE *out, const SensorData *data, size_t n,
+                    const UIStats *st, UIThresholds th){
+    return ui_write_report_l(out, data, n, &ui_layout_sensordata, st, th);
+}
@@ -15,6 +15,10 @@ typedef struct {
     float h_min, h_max, h_avg;
     int   g_min, g_max;
     double g_avg;
+    /* Phân vị (từ sketch, xem sketch.h); chỉ in khi has_pct != 0 */
+    int   has_pct;
+    float t_p50, t_p95, t_p99;
+    float g_p50, g_p95, g_p99;
 } UIStats;
 
 typedef struct {
@@ -50,12 +54,27 @@ int ui_write_report_g(FILE *out,
                       const void *buf, size_t n, UIItemExtractor ex,
                       const UIStats *st_or_null, UIThresholds th);
 
+/* Tính min/max/avg (không có phân vị) từ buffer generic */
+void ui_compute_stats_g(const void *buf, size_t n, UIItemExtractor ex, UIStats *st);
+
+/* ====== Cùng các hàm trên, mô tả buffer bằng UILayout (nhanh hơn) ====== */
+void ui_print_table_l(FILE *out, const void *buf, size_t n, const UILayout *lay);
+int  ui_print_alert_l(FILE *out, const void *buf, size_t n, const UILayout *lay,
+                      UIThresholds th);
+void ui_chart_temp_humid_l(FILE *out, const void *buf, size_t n, const UILayout *lay);
+int  ui_write_report_l(FILE *out, const void *buf, size_t n, const UILayout *lay,
+                       const UIStats *st_or_null, UIThresholds th);
+void ui_compute_stats_l(const void *buf, size_t n, const UILayout *lay, UIStats *st);
+
 /* ====== Tùy chọn tiện lợi (nếu nhóm dùng đúng struct SensorData) ====== */
 /* Định nghĩa macro này trước khi include nếu bạn có system.h chuẩn:
    #define UI_HAVE_SYSTEM_SENSOR
 */
 #ifdef UI_HAVE_SYSTEM_SENSOR
 #include "system.h"
+extern const UILayout ui_layout_sensordata;     /* SensorData (bản ghi từ collector) */
+extern const UILayout ui_layout_record;         /* sensor_data_t (bản ghi trong store) */
+
 void ui_print_table(FILE *out, const SensorData *a, size_t n);
 int  ui_print_alert(FILE *out, const SensorData *a, size_t n, UIThresholds th);
 void ui_chart_temp_humid(FILE *out, const SensorData *a, size_t n);
@@ -0,0 +1,119 @@
+#include "system.h"
+#include "metrics.h"
+
+#include <stddef.h>
+
+// ============================================================================
+// SAMPLE VALIDATION
+// ============================================================================
+//
+// Every sample from the collectors goes through here before ingest; the
+// collectors only check that a line parses (or a frame's CRC). Range rules
+// live in one place, the lo/hi columns of SENSOR_FIELDS (schema.h).
+//
+// The readings of a record are adjacent floats (sensor_data_t.values), so
+// each group of four is checked with one 4-lane compare against the lower
+// and upper limits (GCC vector extensions: SSE on x86, NEON on ARM). Lanes
+// past the last field are forced true. Checks are branch-free: a failed
+// lane adds one to that field's counter, a failed record gets quality 0
+// and a 0 bit in the validity mask, and compaction always copies and
+// advances the output by the bit. A batch with nothing to drop is not
+// copied at all.
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef int32_t v4i __attribute__((vector_size(16)));
+
+#define VALIDATE_CHUNK  64      // records per mask word
+#define VALIDATE_GROUPS ((SENSOR_FIELD_COUNT + 3) / 4)
+#define VALUES_OFFSET   offsetof(sensor_data_t, values)
+
+// Bytes loaded for group g: a whole vector when it stays inside the record
+// (the tail overlaps sensor_id/quality and is masked), else only the fields
+#define GROUP_BYTES(g) \
+    (VALUES_OFFSET + 16 * ((g) + 1) <= sizeof(sensor_data_t) ? 16 : \
+     (SENSOR_FIELD_COUNT - 4 * (g) < 4 ? SENSOR_FIELD_COUNT - 4 * (g) : 4) * sizeof(float))
+
+#define SCHEMA_LO_(field, stat, wtype, wire, key, label, unit, lo, ...)     lo,
+#define SCHEMA_HI_(field, stat, wtype, wire, key, label, unit, lo, hi, ...) hi,
+static const float limit_lo[VALIDATE_GROUPS * 4] = { SENSOR_FIELDS(SCHEMA_LO_) };
+static const float limit_hi[VALIDATE_GROUPS * 4] = { SENSOR_FIELDS(SCHEMA_HI_) };
+
+// Checks up to 64 records: bit i of the result is set if records[i] is
+// valid. Invalid records get quality 0. NaN fails every comparison.
+uint64_t validate_mask(sensor_data_t *records, size_t count, validate_counts_t *rejected) {
+    v4f lo[VALIDATE_GROUPS], hi[VALIDATE_GROUPS];
+    v4i unused[VALIDATE_GROUPS], failed[VALIDATE_GROUPS];
+    for (int g = 0; g < VALIDATE_GROUPS; g++) {
+        const v4i lane = { 4 * g, 4 * g + 1, 4 * g + 2, 4 * g + 3 };
+        memcpy(&lo[g], &limit_lo[4 * g], sizeof(v4f));
+        memcpy(&hi[g], &limit_hi[4 * g], sizeof(v4f));
+        unused[g] = lane >= SENSOR_FIELD_COUNT;
+        failed[g] = (v4i){ 0, 0, 0, 0 };
+    }
+
+    uint64_t mask = 0;
+    if (count > VALIDATE_CHUNK) count = VALIDATE_CHUNK;
+    for (size_t i = 0; i < count; i++) {
+        int32_t all = -1;
+        for (int g = 0; g < VALIDATE_GROUPS; g++) {
+            v4f v = { 0, 0, 0, 0 };
+            memcpy(&v, &records[i].values[4 * g], GROUP_BYTES(g));
+            v4i ok = (v >= lo[g]) & (v <= hi[g]);
+            ok |= unused[g];
+            failed[g] += ok + 1;    // -1 (true) + 1 = 0
+            all &= ok[0] & ok[1] & ok[2] & ok[3];
+        }
+        records[i].quality &= all;
+        mask |= (uint64_t)(all & 1) << i;
+    }
+    for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+        rejected->field[f] += (unsigned long)failed[f / 4][f % 4];
+    }
+    return mask;
+}
+
+// Validates a batch and moves the valid records to the front, in order.
+// Returns how many there are; *rejected is added to.
+size_t validate_records(sensor_data_t *records, size_t count, validate_counts_t *rejected) {
+    return validate_records_traced(records, NULL, count, rejected);
+}
+
+// Same, keeping traces[i] (if not NULL) with records[i]
+size_t validate_records_traced(sensor_data_t *records, sample_trace_t *traces, size_t count,
+                               validate_counts_t *rejected) {
+    validate_counts_t before = *rejected;
+    size_t out = 0;
+    for (size_t base = 0; base < count; base += VALIDATE_CHUNK) {
+        size_t n = count - base < VALIDATE_CHUNK ? count - base : VALIDATE_CHUNK;
+        uint64_t mask = validate_mask(records + base, n, rejected);
+        uint64_t full = n == VALIDATE_CHUNK ? ~0ull : (1ull << n) - 1;
+        if (mask == full && out == base) {
+            out += n;
+            continue;
+        }
+        for (size_t k = 0; k < n; k++) {
+            records[out] = records[base + k];
+            if (traces) traces[out] = traces[base + k];
+            out += (mask >> k) & 1;
+        }
+    }
+    if (out < count) {
+        for (int f = 0; f < SENSOR_FIELD_COUNT; f++) {
+            metrics_add(METRIC_REJECTED + f, rejected->field[f] - before.field[f]);
+        }
+    }
+    return out;
+}
+
+// Single record: 0 if valid, -1 (and quality 0) otherwise
+int validate_sensor_data(sensor_data_t *data) {
+    validate_counts_t rejected = { { 0 } };
+    return validate_mask(data, 1, &rejected) ? 0 : -1;
+}
+
+// is_valid_temperature(), is_valid_humidity(), ...
+#define SCHEMA_IS_VALID_(field, stat, wtype, wire, key, label, unit, lo, hi, ...) \
+    int is_valid_##field(float value) {                                         \
+        return value >= lo && value <= hi;                                      \
+    }
+SENSOR_FIELDS(SCHEMA_IS_VALID_)
@@ -0,0 +1,272 @@
+#include "system.h"
+#include "anomaly.h"
+
+#include <poll.h>
+#include <sys/ioctl.h>
+
+// ============================================================================
+// PAGED TABLE VIEW
+// ============================================================================
+//
+// Scrollable table over a range of records. Only the visible window is
+// fetched and formatted; every frame is built in one buffer, drawn with
+// ANSI cursor control (no clear/shell) and sent with a single write().
+//
+// Keys: Up/Down or k/j scroll a line, PgUp/PgDn or b/space a page,
+// Home/End or g/G jump to the first/last page, q or Esc leaves.
+// Without a terminal the first character of each input line is used.
+
+#define VIEW_FRAME_SIZE     65536
+#define VIEW_MIN_ROWS       5
+#define VIEW_MAX_ROWS       200
+#define VIEW_CHROME_ROWS    6       // title, header, rule, blank, status, prompt
+
+typedef enum {
+    KEY_NONE = 0, KEY_UP, KEY_DOWN, KEY_PAGE_UP, KEY_PAGE_DOWN,
+    KEY_HOME, KEY_END, KEY_QUIT
+} view_key_t;
+
+// Fills rows[0..n) with records from..from+n of the source
+typedef void (*view_fetch_fn)(void *ctx, size_t from, size_t n, const sensor_data_t **rows);
+
+typedef struct view_frame {
+    char buf[VIEW_FRAME_SIZE];
+    size_t len;
+} view_frame_t;
+
+static void frame_printf(view_frame_t *f, const char *fmt, ...) {
+    if (f->len >= sizeof(f->buf)) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(f->buf + f->len, sizeof(f->buf) - f->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        f->len += (size_t)n;
+        if (f->len > sizeof(f->buf)) f->len = sizeof(f->buf);
+    }
+}
+
+static int terminal_rows(void) {
+    struct winsize ws;
+    int rows = 24;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0) {
+        rows = ws.ws_row;
+    }
+    rows -= VIEW_CHROME_ROWS;
+    if (rows < VIEW_MIN_ROWS) rows = VIEW_MIN_ROWS;
+    if (rows > VIEW_MAX_ROWS) rows = VIEW_MAX_ROWS;
+    return rows;
+}
+
+// ============================================================================
+// INPUT
+// ============================================================================
+
+static view_key_t read_key_raw(void) {
+    unsigned char c;
+    if (read(STDIN_FILENO, &c, 1) != 1) {
+        return KEY_QUIT;
+    }
+    switch (c) {
+        case 'k': return KEY_UP;
+        case 'j': return KEY_DOWN;
+        case 'b': case 'p': return KEY_PAGE_UP;
+        case ' ': case 'n': return KEY_PAGE_DOWN;
+        case 'g': return KEY_HOME;
+        case 'G': return KEY_END;
+        case 'q': case 'Q': return KEY_QUIT;
+        case 27: break;
+        default: return KEY_NONE;
+    }
+
+    // Escape sequence, or a lone Esc if nothing follows quickly
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    unsigned char seq[3];
+    if (poll(&pfd, 1, 50) <= 0 || read(STDIN_FILENO, &seq[0], 1) != 1) return KEY_QUIT;
+    if (seq[0] != '[' && seq[0] != 'O') return KEY_NONE;
+    if (read(STDIN_FILENO, &seq[1], 1) != 1) return KEY_NONE;
+    switch (seq[1]) {
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'H': return KEY_HOME;
+        case 'F': return KEY_END;
+        default: break;
+    }
+    if (seq[1] >= '1' && seq[1] <= '8') {
+        if (read(STDIN_FILENO, &seq[2], 1) != 1 || seq[2] != '~') return KEY_NONE;
+        switch (seq[1]) {
+            case '1': case '7': return KEY_HOME;
+            case '4': case '8': return KEY_END;
+            case '5': return KEY_PAGE_UP;
+            case '6': return KEY_PAGE_DOWN;
+        }
+    }
+    return KEY_NONE;
+}
+
+static view_key_t read_key_line(void) {
+    char line[64];
+    if (!fgets(line, sizeof(line), stdin)) {
+        return KEY_QUIT;
+    }
+    switch (line[0]) {
+        case 'k': return KEY_UP;
+        case 'j': return KEY_DOWN;
+        case 'b': case 'p': return KEY_PAGE_UP;
+        case '\n': case ' ': case 'n': return KEY_PAGE_DOWN;
+        case 'g': return KEY_HOME;
+        case 'G': return KEY_END;
+        case 'q': case 'Q': return KEY_QUIT;
+        default: return KEY_NONE;
+    }
+}
+
+// ============================================================================
+// RENDERING
+// ============================================================================
+
+static void render(view_frame_t *f, const char *title, size_t total, size_t top,
+                   const sensor_data_t **rows, size_t n, int page_rows, int interactive) {
+    f->len = 0;
+    frame_printf(f, "\033[H");  // cursor home; each line clears its own tail
+
+    frame_printf(f, "=== %s ===\033[K\n", title);
+#define VIEW_HEAD_(field, stat, wtype, wire, key, label, unit, ...)  , #key
+#define VIEW_FMT_S_(field, ...) " %8s"
+#define VIEW_FMT_(field, ...)   " %8.1f"
+#define VIEW_ARG_(field, ...)   , d->field
+    frame_printf(f, "%-10s %-19s %6s" SENSOR_FIELDS(VIEW_FMT_S_) "  %-12s\033[K\n",
+                 "#", "Timestamp", "Sensor" SENSOR_FIELDS(VIEW_HEAD_), "Quality");
+    frame_printf(f, "----------------------------------------------------------------------------\033[K\n");
+
+    // localtime only when the second changes from the previous row
+    time_t cached_ts = (time_t)-1;
+    char time_str[32] = "";
+    for (size_t i = 0; i < n; i++) {
+        const sensor_data_t *d = rows[i];
+        if (d->timestamp != cached_ts) {
+            struct tm tm_ts;
+            localtime_r(&d->timestamp, &tm_ts);
+            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm_ts);
+            cached_ts = d->timestamp;
+        }
+        frame_printf(f, "%-10zu %-19s %6d" SENSOR_FIELDS(VIEW_FMT_) "  %3d %-8s\033[K\n",
+                     top + i + 1, time_str, d->sensor_id SENSOR_FIELDS(VIEW_ARG_),
+                     d->quality, anomaly_name(anomaly_from_quality(d->quality)));
+    }
+    for (int i = (int)n; i < page_rows; i++) {
+        frame_printf(f, "\033[K\n");
+    }
+
+    size_t last = total ? top + n : 0;
+    frame_printf(f, "\033[K\nRows %zu-%zu of %zu", total ? top + 1 : 0, last, total);
+    if (interactive) {
+        frame_printf(f, "   [Up/Down] line  [PgUp/PgDn] page  [Home/End]  [q] back\033[K\n\033[J");
+    } else {
+        frame_printf(f, "   n/Enter=next  p=prev  j/k=line  g/G=first/last  q=back\033[K\n\033[J> ");
+    }
+
+    // One write per frame
+    size_t off = 0;
+    while (off < f->len) {
+        ssize_t w = write(STDOUT_FILENO, f->buf + off, f->len - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        off += (size_t)w;
+    }
+}
+
+static int view_run(const char *title, size_t total, view_fetch_fn fetch, void *ctx) {
+    static view_frame_t frame;
+    static const sensor_data_t *rows[VIEW_MAX_ROWS];
+
+    int interactive = isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+    struct termios saved, raw;
+    if (interactive && tcgetattr(STDIN_FILENO, &saved) == 0) {
+        raw = saved;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    } else {
+        interactive = 0;
+    }
+
+    fflush(stdout);
+    // Start on the newest page
+    int page_rows = terminal_rows();
+    size_t top = total > (size_t)page_rows ? total - (size_t)page_rows : 0;
+
+    for (;;) {
+        page_rows = terminal_rows();
+        size_t max_top = total > (size_t)page_rows ? total - (size_t)page_rows : 0;
+        if (top > max_top) top = max_top;
+
+        size_t n = total - top < (size_t)page_rows ? total - top : (size_t)page_rows;
+        fetch(ctx, top, n, rows);
+        render(&frame, title, total, top, rows, n, page_rows, interactive);
+
+        view_key_t key = interactive ? read_key_raw() : read_key_line();
+        switch (key) {
+            case KEY_UP:        if (top > 0) top--; break;
+            case KEY_DOWN:      if (top < max_top) top++; break;
+            case KEY_PAGE_UP:   top = top > (size_t)page_rows ? top - (size_t)page_rows : 0; break;
+            case KEY_PAGE_DOWN: top += (size_t)page_rows; break;
+            case KEY_HOME:      top = 0; break;
+            case KEY_END:       top = max_top; break;
+            case KEY_QUIT:      goto done;
+            default:            break;
+        }
+    }
+
+done:
+    if (interactive) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    }
+    return 0;
+}
+
+// ============================================================================
+// SOURCES
+// ============================================================================
+
+typedef struct store_range {
+    size_t first;
+} store_range_t;
+
+static void fetch_store(void *ctx, size_t from, size_t n, const sensor_data_t **rows) {
+    const store_range_t *range = ctx;
+    store_iter_t it;
+    const sensor_data_t *span;
+    size_t got, k = 0;
+    store_iter_init(&it, range->first + from, range->first + from + n);
+    while ((got = store_iter_span(&it, &span)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            rows[k++] = &span[i];
+        }
+    }
+}
+
+static void fetch_sensor(void *ctx, size_t from, size_t n, const sensor_data_t **rows) {
+    int sensor_id = *(const int *)ctx;
+    for (size_t i = 0; i < n; i++) {
+        rows[i] = sensor_record_at(sensor_id, from + i);
+    }
+}
+
+int view_store_table(const char *title, size_t first, size_t end) {
+    if (first < store_first()) first = store_first();
+    if (end > store_end()) end = store_end();
+    store_range_t range = { first };
+    return view_run(title, end > first ? end - first : 0, fetch_store, &range);
+}
+
+int view_sensor_table(int sensor_id) {
+    char title[64];
+    snprintf(title, sizeof(title), "SENSOR %d RECORDS", sensor_id);
+    return view_run(title, sensor_record_count(sensor_id), fetch_sensor, &sensor_id);
+}